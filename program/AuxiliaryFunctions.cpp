@@ -19,25 +19,73 @@
 */
 
 #include "AuxiliaryFunctions.hpp"
+#include <cstring>
 #include <limits>
-#include <sstream>
+#include <sys/resource.h> //for getrusage()
 
 std::string uintToString(const unsigned int value)
 {
-  std::ostringstream s_str;
-  s_str << value;
-  return s_str.str();
+  char digits[cMaxUintChars];
+  return std::string(digits, uintToChars(digits, value));
+}
+
+char * uintToChars(char * first, const unsigned int value)
+{
+  // pairs of digits for 00 to 99, so the loop needs only one division for two digits
+  static const char cDigitPairs[] =
+      "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+      "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+      "8081828384858687888990919293949596979899";
+  unsigned int digits = 1;
+  for (unsigned int rest = value; rest >= 10; rest /= 10)
+    ++digits;
+  char * position = first + digits;
+  unsigned int rest = value;
+  while (rest >= 100)
+  {
+    const unsigned int pair = (rest % 100) * 2;
+    rest /= 100;
+    position -= 2;
+    std::memcpy(position, cDigitPairs + pair, 2);
+  } // while
+  if (rest >= 10)
+    std::memcpy(first, cDigitPairs + rest * 2, 2);
+  else
+    *first = static_cast<char>('0' + rest);
+  return first + digits;
+}
+
+char * uintToOctalChars(char * first, const unsigned int value)
+{
+  unsigned int digits = 1;
+  for (unsigned int rest = value; rest >= 8; rest >>= 3)
+    ++digits;
+  unsigned int rest = value;
+  for (char * position = first + digits; position != first; rest >>= 3)
+    *--position = static_cast<char>('0' + (rest & 7));
+  return first + digits;
+}
+
+void appendUint(std::string& str, const unsigned int value)
+{
+  char digits[cMaxUintChars];
+  str.append(digits, uintToChars(digits, value));
 }
 
 bool stringToUint(const std::string& str, unsigned int& value)
 {
-  if (str.empty())
+  return stringToUint(str.data(), str.size(), value);
+}
+
+bool stringToUint(const char * str, const std::size_t length, unsigned int& value)
+{
+  if (length == 0)
     return false;
   value = 0;
   const unsigned int cTenthLimit = std::numeric_limits<unsigned int>::max() / 10;
   const unsigned int cRealLimit = std::numeric_limits<unsigned int>::max();
-  std::string::size_type i = 0;
-  for ( ; i < str.size(); ++i)
+  std::size_t i = 0;
+  for ( ; i < length; ++i)
   {
     if ((str[i] >= '0') && (str[i] <= '9'))
     {
@@ -79,3 +127,12 @@ std::string slashify(const std::string& path)
   }
   return path;
 }
+
+unsigned long int getPeakMemoryUsage()
+{
+  struct rusage usage;
+  if (getrusage(RUSAGE_SELF, &usage) != 0)
+    return 0;
+  // ru_maxrss is given in kilobytes on Linux
+  return usage.ru_maxrss;
+}
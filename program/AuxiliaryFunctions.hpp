@@ -21,6 +21,8 @@
 #ifndef AUXILIARYFUNCTIONS_HPP
 #define AUXILIARYFUNCTIONS_HPP
 
+#include <cstddef>
+#include <limits>
 #include <string>
 
 /** \brief converts an unsigned integer value to its string representation
@@ -31,6 +33,42 @@
 std::string uintToString(const unsigned int value);
 
 
+/** \brief maximum number of characters that uintToChars() writes */
+const std::size_t cMaxUintChars = std::numeric_limits<unsigned int>::digits10 + 1;
+
+
+/** \brief writes the decimal digits of an unsigned integer, like std::to_chars of C++17
+ *
+ * \param first  start of the output, there has to be space for cMaxUintChars characters
+ * \param value  the unsigned integer
+ * \return Returns the position after the last written character.
+ * \remarks No null character is written, and no memory is allocated.
+ */
+char * uintToChars(char * first, const unsigned int value);
+
+
+/** \brief maximum number of characters that uintToOctalChars() writes */
+const std::size_t cMaxOctalChars = (std::numeric_limits<unsigned int>::digits + 2) / 3;
+
+
+/** \brief writes the octal digits of an unsigned integer, like std::oct does
+ *
+ * \param first  start of the output, there has to be space for cMaxOctalChars characters
+ * \param value  the unsigned integer
+ * \return Returns the position after the last written character.
+ * \remarks No null character and no leading zero is written.
+ */
+char * uintToOctalChars(char * first, const unsigned int value);
+
+
+/** \brief appends the decimal digits of an unsigned integer to a string
+ *
+ * \param str    the string
+ * \param value  the unsigned integer
+ */
+void appendUint(std::string& str, const unsigned int value);
+
+
 /** \brief tries to convert the string representation of an unsigned integer to an unsigned int
  *
  * \param str    the string that contains the number
@@ -41,6 +79,17 @@ std::string uintToString(const unsigned int value);
 bool stringToUint(const std::string& str, unsigned int& value);
 
 
+/** \brief tries to convert the characters of an unsigned integer to an unsigned int
+ *
+ * \param str     the characters of the number, not necessarily null-terminated
+ * \param length  number of characters
+ * \param value   the unsigned int that will be used to store the result
+ * \return Returns true on success, false on failure.
+ * \remarks If false is returned, the value of parameter value is undefined.
+ */
+bool stringToUint(const char * str, const std::size_t length, unsigned int& value);
+
+
 /** \brief adds a slash or backslash (or whatever is the path delimiter on the current
  * system) to the given path, if the path is not empty and has no path delimiter
  * as the last character yet.
@@ -49,4 +98,12 @@ bool stringToUint(const std::string& str, unsigned int& value);
  */
 std::string slashify(const std::string& path);
 
+
+/** \brief gets the peak memory usage (maximum resident set size) of the process
+ *
+ * \return Returns the peak memory usage in kilobytes, or zero if it is not
+ *         available.
+ */
+unsigned long int getPeakMemoryUsage();
+
 #endif // AUXILIARYFUNCTIONS_HPP
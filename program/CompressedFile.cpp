@@ -0,0 +1,660 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include "CompressedFile.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/uio.h> //for writev()
+#include <unistd.h>
+#ifdef CFS_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef CFS_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace
+{
+  const unsigned char cGzipMagic[2] = { 0x1F, 0x8B }; /* first bytes of gzip files */
+  const unsigned char cZstdMagic[4] = { 0x28, 0xB5, 0x2F, 0xFD }; /* first bytes of zstd frames */
+
+  /* gets the name of a compression for messages */
+  const char * compressionName(const Compression compression)
+  {
+    switch (compression)
+    {
+      case cmGzip:
+           return "gzip";
+      case cmZstd:
+           return "zstd";
+      default:
+           return "no compression";
+    } // switch
+  }
+
+  /* detects the compression by the first bytes of a file */
+  Compression compressionOfData(const char * data, const std::size_t size)
+  {
+    if ((size >= sizeof(cGzipMagic)) and (std::memcmp(data, cGzipMagic, sizeof(cGzipMagic)) == 0))
+      return cmGzip;
+    if ((size >= sizeof(cZstdMagic)) and (std::memcmp(data, cZstdMagic, sizeof(cZstdMagic)) == 0))
+      return cmZstd;
+    return cmNone;
+  }
+
+  /* writes all data to a file descriptor - returns false on errors, errno is set */
+  bool writeAll(const int fd, const char * data, std::size_t size)
+  {
+    while (size > 0)
+    {
+      const ssize_t written = write(fd, data, size);
+      if (written < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        return false;
+      }
+      data += written;
+      size -= written;
+    } // while
+    return true;
+  }
+
+  /* writes two blocks of data to a file descriptor with as few calls as
+     possible - returns false on errors, errno is set */
+  bool writeAll(const int fd, const char * first, std::size_t firstSize, const char * second, std::size_t secondSize)
+  {
+    while (firstSize > 0)
+    {
+      struct iovec parts[2] = { { const_cast<char*>(first), firstSize }, { const_cast<char*>(second), secondSize } };
+      const ssize_t written = writev(fd, parts, 2);
+      if (written < 0)
+      {
+        if (errno == EINTR)
+          continue;
+        return false;
+      }
+      if (static_cast<std::size_t>(written) >= firstSize)
+      {
+        second += written - firstSize;
+        secondSize -= written - firstSize;
+        firstSize = 0;
+      }
+      else
+      {
+        first += written;
+        firstSize -= written;
+      }
+    } // while
+    return writeAll(fd, second, secondSize);
+  }
+} //namespace
+
+
+Compression compressionOfFileName(const std::string& fileName)
+{
+  const std::string::size_type dot = fileName.rfind('.');
+  if (dot == std::string::npos)
+    return cmNone;
+  const std::string extension = fileName.substr(dot);
+  if (extension == ".gz")
+    return cmGzip;
+  if ((extension == ".zst") or (extension == ".zstd"))
+    return cmZstd;
+  return cmNone;
+}
+
+bool compressionAvailable(const Compression compression)
+{
+  switch (compression)
+  {
+    case cmNone:
+         return true;
+    case cmGzip:
+         #ifdef CFS_HAVE_ZLIB
+         return true;
+         #else
+         return false;
+         #endif
+    case cmZstd:
+         #ifdef CFS_HAVE_ZSTD
+         return true;
+         #else
+         return false;
+         #endif
+  } // switch
+  return false;
+}
+
+
+/* state of the compressor of a CompressingBuffer */
+struct CompressingBuffer::Codec
+{
+  Compression compression;
+  #ifdef CFS_HAVE_ZLIB
+  z_stream gzip;
+  #endif
+  #ifdef CFS_HAVE_ZSTD
+  ZSTD_CCtx * zstd;
+  #endif
+
+  explicit Codec(const Compression comp)
+  : compression(comp)
+  {
+    #ifdef CFS_HAVE_ZLIB
+    std::memset(&gzip, 0, sizeof(gzip));
+    #endif
+    #ifdef CFS_HAVE_ZSTD
+    zstd = NULL;
+    #endif
+  }
+
+  ~Codec()
+  {
+    #ifdef CFS_HAVE_ZLIB
+    if (compression == cmGzip)
+      deflateEnd(&gzip);
+    #endif
+    #ifdef CFS_HAVE_ZSTD
+    if (compression == cmZstd)
+      ZSTD_freeCCtx(zstd);
+    #endif
+  }
+};//struct
+
+CompressingBuffer::CompressingBuffer()
+: std::streambuf(),
+  mCodec(nullptr),
+  mBuffer(),
+  mOutput(),
+  mFd(-1),
+  mError()
+{
+}
+
+CompressingBuffer::~CompressingBuffer()
+{
+  std::string error;
+  close(error);
+}
+
+bool CompressingBuffer::open(const std::string& fileName, const Compression compression, const unsigned int threads, std::string& error)
+{
+  if (!compressionAvailable(compression))
+  {
+    error = std::string("Compression with ") + compressionName(compression) + " is not supported by this build.";
+    return false;
+  }
+  std::unique_ptr<Codec> codec(new Codec(compression));
+  switch (compression)
+  {
+    case cmNone:
+         codec.reset();
+         break;
+    case cmGzip:
+         #ifdef CFS_HAVE_ZLIB
+         // window size 15 plus 16 writes a gzip header instead of a zlib header
+         if (deflateInit2(&codec->gzip, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+         {
+           codec->compression = cmNone;
+           error = "Could not initialize gzip compression.";
+           return false;
+         }
+         #endif
+         break;
+    case cmZstd:
+         #ifdef CFS_HAVE_ZSTD
+         codec->zstd = ZSTD_createCCtx();
+         if (codec->zstd == NULL)
+         {
+           error = "Could not initialize zstd compression.";
+           return false;
+         }
+         // Libraries without support for threads reject this, they just
+         // compress on the calling thread then.
+         if (threads > 1)
+           ZSTD_CCtx_setParameter(codec->zstd, ZSTD_c_nbWorkers, threads);
+         #endif
+         break;
+  } // switch
+  #ifndef CFS_HAVE_ZSTD
+  (void) threads;
+  #endif
+
+  mFd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+  if (mFd < 0)
+  {
+    error = std::string("Could not create file: ") + strerror(errno);
+    return false;
+  }
+  mCodec = std::move(codec);
+  mBuffer.resize(cBufferSize);
+  if (mCodec != nullptr)
+    mOutput.resize(cBufferSize);
+  mError.clear();
+  setp(mBuffer.data(), mBuffer.data() + mBuffer.size());
+  return true;
+}
+
+bool CompressingBuffer::close(std::string& error)
+{
+  if (mFd < 0)
+    return true;
+  flush(true);
+  if ((::close(mFd) != 0) and mError.empty())
+    mError = std::string("Could not close file: ") + strerror(errno);
+  mFd = -1;
+  mCodec.reset();
+  setp(NULL, NULL);
+  error = mError;
+  return mError.empty();
+}
+
+CompressingBuffer::int_type CompressingBuffer::overflow(int_type ch)
+{
+  if ((mFd < 0) or !flush(false))
+    return traits_type::eof();
+  if (!traits_type::eq_int_type(ch, traits_type::eof()))
+  {
+    *pptr() = traits_type::to_char_type(ch);
+    pbump(1);
+  }
+  return traits_type::not_eof(ch);
+}
+
+int CompressingBuffer::sync()
+{
+  return ((mFd >= 0) and flush(false)) ? 0 : -1;
+}
+
+std::streamsize CompressingBuffer::xsputn(const char * data, std::streamsize count)
+{
+  // small pieces are collected in the buffer
+  if (count <= epptr() - pptr())
+  {
+    std::memcpy(pptr(), data, count);
+    pbump(count);
+    return count;
+  }
+  if ((mFd < 0) or !mError.empty())
+    return 0;
+  // Larger pieces are not copied into the buffer first. Without compression
+  // the buffer and the piece are written with one call.
+  if (mCodec == nullptr)
+  {
+    const char * buffered = pbase();
+    const std::size_t size = pptr() - pbase();
+    setp(mBuffer.data(), mBuffer.data() + mBuffer.size());
+    if (!writeAll(mFd, buffered, size, data, count))
+    {
+      mError = std::string("Could not write to file: ") + strerror(errno);
+      return 0;
+    }
+    return count;
+  }
+  return (flush(false) and compress(data, count, false)) ? count : 0;
+}
+
+bool CompressingBuffer::flush(const bool finish)
+{
+  if (!mError.empty())
+    return false;
+  const char * data = pbase();
+  const std::size_t size = pptr() - pbase();
+  setp(mBuffer.data(), mBuffer.data() + mBuffer.size());
+  return compress(data, size, finish);
+}
+
+bool CompressingBuffer::compress(const char * data, const std::size_t size, const bool finish)
+{
+  if (mCodec == nullptr)
+  {
+    if (!writeAll(mFd, data, size))
+      mError = std::string("Could not write to file: ") + strerror(errno);
+    return mError.empty();
+  }
+
+  // The output buffer is written whenever the compressor has filled it.
+  #ifdef CFS_HAVE_ZLIB
+  if (mCodec->compression == cmGzip)
+  {
+    z_stream& stream = mCodec->gzip;
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream.avail_in = size;
+    int ret = Z_OK;
+    do
+    {
+      stream.next_out = reinterpret_cast<Bytef*>(mOutput.data());
+      stream.avail_out = mOutput.size();
+      ret = deflate(&stream, finish ? Z_FINISH : Z_NO_FLUSH);
+      if (ret == Z_STREAM_ERROR)
+      {
+        mError = "gzip compression failed.";
+        return false;
+      }
+      if (!writeAll(mFd, mOutput.data(), mOutput.size() - stream.avail_out))
+      {
+        mError = std::string("Could not write to file: ") + strerror(errno);
+        return false;
+      }
+    } while ((stream.avail_out == 0) or (finish and (ret != Z_STREAM_END)));
+  }
+  #endif
+  #ifdef CFS_HAVE_ZSTD
+  if (mCodec->compression == cmZstd)
+  {
+    ZSTD_inBuffer input = { data, size, 0 };
+    while (true)
+    {
+      ZSTD_outBuffer output = { mOutput.data(), mOutput.size(), 0 };
+      const std::size_t remaining = ZSTD_compressStream2(mCodec->zstd, &output, &input, finish ? ZSTD_e_end : ZSTD_e_continue);
+      if (ZSTD_isError(remaining))
+      {
+        mError = std::string("zstd compression failed: ") + ZSTD_getErrorName(remaining);
+        return false;
+      }
+      if (!writeAll(mFd, mOutput.data(), output.pos))
+      {
+        mError = std::string("Could not write to file: ") + strerror(errno);
+        return false;
+      }
+      if (finish ? (remaining == 0) : (input.pos == input.size))
+        break;
+    } // while
+  }
+  #endif
+  return true;
+}
+
+
+/* state of the decompressor of a DecompressingBuffer */
+struct DecompressingBuffer::Codec
+{
+  Compression compression;
+  bool inStream; /* whether a compressed stream was started, but has not ended yet */
+  bool pending;  /* whether the decompressor may hold output without getting more input */
+  #ifdef CFS_HAVE_ZLIB
+  z_stream gzip;
+  #endif
+  #ifdef CFS_HAVE_ZSTD
+  ZSTD_DCtx * zstd;
+  #endif
+
+  explicit Codec(const Compression comp)
+  : compression(comp), inStream(false), pending(false)
+  {
+    #ifdef CFS_HAVE_ZLIB
+    std::memset(&gzip, 0, sizeof(gzip));
+    #endif
+    #ifdef CFS_HAVE_ZSTD
+    zstd = NULL;
+    #endif
+  }
+
+  ~Codec()
+  {
+    #ifdef CFS_HAVE_ZLIB
+    if (compression == cmGzip)
+      inflateEnd(&gzip);
+    #endif
+    #ifdef CFS_HAVE_ZSTD
+    if (compression == cmZstd)
+      ZSTD_freeDCtx(zstd);
+    #endif
+  }
+};//struct
+
+DecompressingBuffer::DecompressingBuffer()
+: std::streambuf(),
+  mCompression(cmNone),
+  mCodec(nullptr),
+  mInput(),
+  mInputStart(0),
+  mInputEnd(0),
+  mBuffer(),
+  mFd(-1),
+  mEndOfFile(false),
+  mError()
+{
+}
+
+DecompressingBuffer::~DecompressingBuffer()
+{
+  if (mFd >= 0)
+    ::close(mFd);
+}
+
+bool DecompressingBuffer::open(const std::string& fileName, std::string& error)
+{
+  mFd = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+  if (mFd < 0)
+  {
+    error = std::string("Could not open file: ") + strerror(errno);
+    return false;
+  }
+  // the file is read from front to back
+  posix_fadvise(mFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  mInput.resize(cBufferSize);
+  mBuffer.resize(cBufferSize);
+  setg(mBuffer.data(), mBuffer.data(), mBuffer.data());
+
+  // The first bytes decide about the compression.
+  while ((mInputEnd < sizeof(cZstdMagic)) and readInput())
+  { }
+  if (!mError.empty())
+  {
+    error = mError;
+    return false;
+  }
+  mCompression = compressionOfData(mInput.data(), mInputEnd);
+  if (!compressionAvailable(mCompression))
+  {
+    error = std::string("File is compressed with ") + compressionName(mCompression) + ", but this build does not support it.";
+    return false;
+  }
+  if (mCompression == cmNone)
+    return true;
+
+  mCodec.reset(new Codec(mCompression));
+  #ifdef CFS_HAVE_ZLIB
+  if (mCompression == cmGzip)
+  {
+    // window size 15 plus 16 only accepts gzip headers
+    if (inflateInit2(&mCodec->gzip, 15 + 16) != Z_OK)
+    {
+      mCodec->compression = cmNone;
+      error = "Could not initialize gzip decompression.";
+      return false;
+    }
+  }
+  #endif
+  #ifdef CFS_HAVE_ZSTD
+  if (mCompression == cmZstd)
+  {
+    mCodec->zstd = ZSTD_createDCtx();
+    if (mCodec->zstd == NULL)
+    {
+      error = "Could not initialize zstd decompression.";
+      return false;
+    }
+  }
+  #endif
+  return true;
+}
+
+Compression DecompressingBuffer::compression() const
+{
+  return mCompression;
+}
+
+std::size_t DecompressingBuffer::peek(char * data, const std::size_t count)
+{
+  std::size_t available = egptr() - gptr();
+  if (available < count)
+  {
+    // move the rest to the front and fill the buffer after it
+    std::memmove(mBuffer.data(), gptr(), available);
+    available = fill(available);
+    setg(mBuffer.data(), mBuffer.data(), mBuffer.data() + available);
+  }
+  const std::size_t copied = std::min(count, available);
+  std::memcpy(data, gptr(), copied);
+  return copied;
+}
+
+const std::string& DecompressingBuffer::error() const
+{
+  return mError;
+}
+
+Compression DecompressingBuffer::detect(const std::string& fileName)
+{
+  char start[sizeof(cZstdMagic)];
+  const int fd = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+    return cmNone;
+  const ssize_t bytes = read(fd, start, sizeof(start));
+  ::close(fd);
+  return (bytes > 0) ? compressionOfData(start, bytes) : cmNone;
+}
+
+DecompressingBuffer::int_type DecompressingBuffer::underflow()
+{
+  if (gptr() < egptr())
+    return traits_type::to_int_type(*gptr());
+  if (mFd < 0)
+    return traits_type::eof();
+  const std::size_t available = fill(0);
+  setg(mBuffer.data(), mBuffer.data(), mBuffer.data() + available);
+  if (available == 0)
+    return traits_type::eof();
+  return traits_type::to_int_type(*gptr());
+}
+
+bool DecompressingBuffer::readInput()
+{
+  if (mEndOfFile or !mError.empty())
+    return false;
+  if (mInputStart == mInputEnd)
+  {
+    mInputStart = 0;
+    mInputEnd = 0;
+  }
+  else if (mInputEnd == mInput.size())
+  {
+    std::memmove(mInput.data(), mInput.data() + mInputStart, mInputEnd - mInputStart);
+    mInputEnd -= mInputStart;
+    mInputStart = 0;
+  }
+  while (true)
+  {
+    const ssize_t bytes = read(mFd, mInput.data() + mInputEnd, mInput.size() - mInputEnd);
+    if (bytes > 0)
+    {
+      mInputEnd += bytes;
+      return true;
+    }
+    if (bytes == 0)
+    {
+      mEndOfFile = true;
+      return false;
+    }
+    if (errno != EINTR)
+    {
+      mError = std::string("Could not read file: ") + strerror(errno);
+      return false;
+    }
+  } // while
+}
+
+std::size_t DecompressingBuffer::fill(const std::size_t start)
+{
+  std::size_t end = start;
+  while ((end < mBuffer.size()) and mError.empty())
+  {
+    const bool pending = (mCodec != nullptr) and mCodec->pending;
+    if ((mInputStart == mInputEnd) and !pending and !readInput())
+      break;
+    char * output = mBuffer.data() + end;
+    const std::size_t capacity = mBuffer.size() - end;
+    const char * input = mInput.data() + mInputStart;
+    const std::size_t size = mInputEnd - mInputStart;
+    if (mCodec == nullptr)
+    {
+      const std::size_t copied = std::min(size, capacity);
+      std::memcpy(output, input, copied);
+      mInputStart += copied;
+      end += copied;
+      continue;
+    }
+    #ifdef CFS_HAVE_ZLIB
+    if (mCompression == cmGzip)
+    {
+      z_stream& stream = mCodec->gzip;
+      // another gzip member follows the previous one
+      if (!mCodec->inStream and (size > 0) and (inflateReset(&stream) != Z_OK))
+      {
+        mError = "Could not restart gzip decompression.";
+        break;
+      }
+      stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input));
+      stream.avail_in = size;
+      stream.next_out = reinterpret_cast<Bytef*>(output);
+      stream.avail_out = capacity;
+      const int ret = inflate(&stream, Z_NO_FLUSH);
+      if ((ret != Z_OK) and (ret != Z_STREAM_END) and (ret != Z_BUF_ERROR))
+      {
+        mError = std::string("Invalid gzip data: ") + ((stream.msg != NULL) ? stream.msg : "unknown error");
+        break;
+      }
+      mInputStart += size - stream.avail_in;
+      end += capacity - stream.avail_out;
+      mCodec->inStream = (ret != Z_STREAM_END) and ((ret != Z_BUF_ERROR) or mCodec->inStream);
+      mCodec->pending = (stream.avail_out == 0);
+    }
+    #endif
+    #ifdef CFS_HAVE_ZSTD
+    if (mCompression == cmZstd)
+    {
+      ZSTD_inBuffer in = { input, size, 0 };
+      ZSTD_outBuffer out = { output, capacity, 0 };
+      const std::size_t ret = ZSTD_decompressStream(mCodec->zstd, &out, &in);
+      if (ZSTD_isError(ret))
+      {
+        mError = std::string("Invalid zstd data: ") + ZSTD_getErrorName(ret);
+        break;
+      }
+      mInputStart += in.pos;
+      end += out.pos;
+      // zero means that a frame was completely decoded and flushed
+      mCodec->inStream = (ret != 0);
+      mCodec->pending = (out.pos == capacity);
+    }
+    #endif
+  } // while
+  if (mEndOfFile and (mInputStart == mInputEnd) and (mCodec != nullptr) and mCodec->inStream
+      and !mCodec->pending and mError.empty())
+    mError = std::string("Unexpected end of ") + compressionName(mCompression) + " data, file is truncated.";
+  if (!mError.empty())
+    return start;
+  return end;
+}
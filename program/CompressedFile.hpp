@@ -0,0 +1,222 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef COMPRESSEDFILE_HPP
+#define COMPRESSEDFILE_HPP
+
+#include <cstddef>
+#include <memory>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+/* compressions of stat files */
+enum Compression { cmNone, cmGzip, cmZstd };
+
+
+/** \brief gets the compression that matches the extension of a file name
+ *
+ * \param fileName  the file name
+ * \return Returns cmGzip for ".gz", cmZstd for ".zst" and cmNone otherwise.
+ */
+Compression compressionOfFileName(const std::string& fileName);
+
+
+/** \brief checks whether a compression is supported by this build
+ *
+ * \param compression  the compression
+ * \return Returns true, if files with that compression can be written and read.
+ * \remarks gzip requires zlib, zstd requires libzstd at compile time.
+ */
+bool compressionAvailable(const Compression compression);
+
+
+/** \brief stream buffer that writes a file and compresses it on the fly
+ *
+ * Data is collected in a buffer of fixed size and handed to the compressor
+ * whenever the buffer is full, so the memory usage does not depend on the
+ * size of the file. Without compression the buffer is written as it is.
+ * Pieces that do not fit into the buffer anymore are handed over directly,
+ * together with the buffer, instead of being copied into it first.
+ */
+class CompressingBuffer: public std::streambuf
+{
+  public:
+    static const std::size_t cBufferSize = 1024 * 1024; /**< size of the buffers in bytes */
+
+
+    /** \brief constructor */
+    CompressingBuffer();
+
+
+    /** \brief destructor - closes the file, if it is still open */
+    virtual ~CompressingBuffer();
+
+
+    /** \brief creates a file
+     *
+     * \param fileName     name of the file
+     * \param compression  compression of the file
+     * \param threads      number of threads that may compress at once. Only
+     *                     zstd can use more than one thread, and only if
+     *                     libzstd was built with support for it.
+     * \param error        will hold a message, if the function fails
+     * \return Returns true, if the file could be created. Returns false otherwise.
+     */
+    bool open(const std::string& fileName, const Compression compression, const unsigned int threads, std::string& error);
+
+
+    /** \brief compresses the remaining data, ends the stream and closes the file
+     *
+     * \param error  will hold a message, if the function fails
+     * \return Returns true, if all data was written. Returns false otherwise.
+     */
+    bool close(std::string& error);
+  protected:
+    virtual int_type overflow(int_type ch);
+    virtual std::streamsize xsputn(const char * data, std::streamsize count);
+    virtual int sync();
+  private:
+    struct Codec; /* state of the compressor */
+
+    std::unique_ptr<Codec> mCodec; /**< the compressor, or NULL for cmNone */
+    std::vector<char> mBuffer; /**< data that was not compressed yet */
+    std::vector<char> mOutput; /**< buffer for compressed data */
+    int mFd; /**< file descriptor of the file, or -1 */
+    std::string mError; /**< message of the first error, empty if there was none */
+
+    /** \brief compresses and writes the content of the buffer
+     *
+     * \param finish  If set to true, the compressed stream is ended.
+     * \return Returns true on success. Returns false otherwise.
+     */
+    bool flush(const bool finish);
+
+    /** \brief compresses and writes data
+     *
+     * \param data    the data
+     * \param size    size of the data in bytes
+     * \param finish  If set to true, the compressed stream is ended.
+     * \return Returns true on success. Returns false otherwise.
+     */
+    bool compress(const char * data, const std::size_t size, const bool finish);
+
+    // not copyable
+    CompressingBuffer(const CompressingBuffer& other) = delete;
+    CompressingBuffer& operator=(const CompressingBuffer& other) = delete;
+}; //class
+
+
+/** \brief stream buffer that reads a file and decompresses it on the fly
+ *
+ * The compression is detected by the magic bytes at the start of the file,
+ * other files are read as they are. The compressed and the decompressed data
+ * are read in buffers of fixed size. Concatenated streams (e.g. of
+ * "cat a.gz b.gz") are decompressed one after another.
+ *
+ * Errors end the input, error() returns the reason afterwards.
+ */
+class DecompressingBuffer: public std::streambuf
+{
+  public:
+    static const std::size_t cBufferSize = 64 * 1024; /**< size of the buffers in bytes */
+
+
+    /** \brief constructor */
+    DecompressingBuffer();
+
+
+    /** \brief destructor - closes the file */
+    virtual ~DecompressingBuffer();
+
+
+    /** \brief opens a file
+     *
+     * \param fileName  name of the file
+     * \param error     will hold a message, if the function fails
+     * \return Returns true, if the file could be opened and its compression
+     *         is supported. Returns false otherwise.
+     */
+    bool open(const std::string& fileName, std::string& error);
+
+
+    /** \brief gets the compression of the opened file */
+    Compression compression() const;
+
+
+    /** \brief copies the next bytes of the decompressed data without consuming them
+     *
+     * \param data   buffer for the bytes
+     * \param count  number of bytes to copy, at most cBufferSize
+     * \return Returns the number of copied bytes. It is only less than count,
+     *         if the data is shorter or an error occurred.
+     */
+    std::size_t peek(char * data, const std::size_t count);
+
+
+    /** \brief gets the message of the error that ended the input
+     *
+     * \return Returns the message. Returns an empty string, if there was no error.
+     */
+    const std::string& error() const;
+
+
+    /** \brief detects the compression of a file by its first bytes
+     *
+     * \param fileName  name of the file
+     * \return Returns the compression, cmNone for uncompressed or unreadable files.
+     */
+    static Compression detect(const std::string& fileName);
+  protected:
+    virtual int_type underflow();
+  private:
+    struct Codec; /* state of the decompressor */
+
+    Compression mCompression; /**< compression of the file */
+    std::unique_ptr<Codec> mCodec; /**< the decompressor, or NULL for cmNone */
+    std::vector<char> mInput; /**< compressed data, read from the file */
+    std::size_t mInputStart; /**< start of the data in mInput that was not decompressed yet */
+    std::size_t mInputEnd; /**< end of the data in mInput */
+    std::vector<char> mBuffer; /**< decompressed data, the get area */
+    int mFd; /**< file descriptor of the file, or -1 */
+    bool mEndOfFile; /**< whether the end of the file was read */
+    std::string mError; /**< message of the error, empty if there was none */
+
+    /** \brief fills mBuffer with decompressed data
+     *
+     * \param start  offset in mBuffer where the new data starts
+     * \return Returns the end of the data in mBuffer. Returns start at the
+     *         end of the data or on errors.
+     */
+    std::size_t fill(const std::size_t start);
+
+    /** \brief reads more data of the file into mInput
+     *
+     * \return Returns true, if data was read. Returns false at the end of the
+     *         file or on errors.
+     */
+    bool readInput();
+
+    // not copyable
+    DecompressingBuffer(const DecompressingBuffer& other) = delete;
+    DecompressingBuffer& operator=(const DecompressingBuffer& other) = delete;
+}; //class
+
+#endif // COMPRESSEDFILE_HPP
@@ -0,0 +1,311 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include "DirectoryHandle.hpp"
+#include "StatEngine.hpp"
+#include <cerrno>
+#include <fcntl.h>  //for openat(), AT_* constants
+#include <sys/resource.h> //for getrlimit()
+#include <unistd.h> //for close(), fchownat()
+
+DirectoryHandle::DirectoryHandle()
+: mFd(AT_FDCWD)
+{
+}
+
+DirectoryHandle::~DirectoryHandle()
+{
+  close();
+}
+
+bool DirectoryHandle::open(const std::string& path)
+{
+  close();
+  const int fd = ::open(path.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0)
+    return false;
+  mFd = fd;
+  return true;
+}
+
+bool DirectoryHandle::openAt(const DirectoryHandle& parent, const char * name)
+{
+  // open parent first, in case parent and this are the same object
+  const int fd = ::openat(parent.fd(), name, O_PATH | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+  close();
+  if (fd < 0)
+    return false;
+  mFd = fd;
+  return true;
+}
+
+void DirectoryHandle::close()
+{
+  if (mFd != AT_FDCWD)
+  {
+    // keep errno of a preceding failed call intact
+    const int errorCode = errno;
+    ::close(mFd);
+    errno = errorCode;
+    mFd = AT_FDCWD;
+  }
+}
+
+bool DirectoryHandle::isOpen() const
+{
+  return mFd != AT_FDCWD;
+}
+
+int DirectoryHandle::fd() const
+{
+  return mFd;
+}
+
+int DirectoryHandle::statEntry(const char * name, struct stat& statbuf) const
+{
+  return StatEngine::statAt(mFd, name, statbuf);
+}
+
+int DirectoryHandle::changeMode(const char * name, const mode_t mode) const
+{
+  return fchmodat(mFd, name, mode, 0);
+}
+
+int DirectoryHandle::changeOwnership(const char * name, const uid_t userID, const gid_t groupID) const
+{
+  return fchownat(mFd, name, userID, groupID, AT_SYMLINK_NOFOLLOW);
+}
+
+
+DirectoryChain::DirectoryChain()
+: mRoot(),
+  mNames(std::vector<std::string>()),
+  mLevels(std::vector<DirectoryHandle*>())
+{
+}
+
+DirectoryChain::~DirectoryChain()
+{
+  truncate(0);
+}
+
+bool DirectoryChain::open(const std::string& root)
+{
+  truncate(0);
+  return mRoot.open(root);
+}
+
+void DirectoryChain::truncate(const std::vector<std::string>::size_type levels)
+{
+  while (mLevels.size() > levels)
+  {
+    delete mLevels.back();
+    mLevels.pop_back();
+    mNames.pop_back();
+  }
+}
+
+const DirectoryHandle& DirectoryChain::parentOf(const std::string& relativePath, std::string& baseName)
+{
+  std::string::size_type start = 0;
+  // skip leading slashes, paths are always relative to the root
+  while ((start < relativePath.size()) && (relativePath[start] == '/'))
+    ++start;
+
+  std::vector<std::string>::size_type level = 0;
+  std::string::size_type slash = relativePath.find('/', start);
+  while (slash != std::string::npos)
+  {
+    if (slash == start)
+    {
+      // empty component ("a//b") - let the kernel deal with it
+      break;
+    }
+    const std::string component = relativePath.substr(start, slash - start);
+    if ((level >= mLevels.size()) || (mNames[level] != component))
+    {
+      truncate(level);
+      DirectoryHandle * handle = new DirectoryHandle();
+      if (!handle->openAt(level == 0 ? mRoot : *mLevels[level - 1], component.c_str()))
+      {
+        delete handle;
+        break;
+      }
+      mLevels.push_back(handle);
+      mNames.push_back(component);
+    }
+    ++level;
+    start = slash + 1;
+    slash = relativePath.find('/', start);
+  } // while
+
+  if (slash != std::string::npos)
+  {
+    // Some component could not be opened, fall back to root + full path.
+    baseName = relativePath.substr(relativePath.find_first_not_of('/'));
+    return mRoot;
+  }
+  baseName = relativePath.substr(start);
+  return (level == 0) ? mRoot : *mLevels[level - 1];
+}
+
+const DirectoryHandle& DirectoryChain::root() const
+{
+  return mRoot;
+}
+
+
+const std::size_t DirectoryStack::cDefaultMaxOpen;
+const std::size_t DirectoryStack::cReservedDescriptors;
+
+DirectoryStack::DirectoryStack(const std::size_t maxOpen)
+: mMaxOpen(maxOpen < 2 ? 2 : maxOpen),
+  mOpen(0),
+  mNames(std::vector<std::string>()),
+  mLevels(std::vector<DirectoryHandle*>())
+{
+}
+
+DirectoryStack::~DirectoryStack()
+{
+  clear();
+}
+
+void DirectoryStack::clear()
+{
+  while (!mLevels.empty())
+  {
+    delete mLevels.back();
+    mLevels.pop_back();
+    mNames.pop_back();
+  }
+  mOpen = 0;
+}
+
+bool DirectoryStack::open(const std::string& root)
+{
+  clear();
+  DirectoryHandle * handle = new DirectoryHandle();
+  if (!handle->open(root))
+  {
+    const int errorCode = errno;
+    delete handle;
+    errno = errorCode;
+    return false;
+  }
+  mLevels.push_back(handle);
+  mNames.push_back(root);
+  mOpen = 1;
+  return true;
+}
+
+bool DirectoryStack::push(const char * name)
+{
+  const DirectoryHandle * parent = top();
+  if (parent == NULL)
+    return false;
+  DirectoryHandle * handle = new DirectoryHandle();
+  if (!handle->openAt(*parent, name))
+  {
+    const int errorCode = errno;
+    delete handle;
+    errno = errorCode;
+    return false;
+  }
+  mLevels.push_back(handle);
+  mNames.push_back(name);
+  ++mOpen;
+  limit();
+  return true;
+}
+
+void DirectoryStack::pop()
+{
+  if (mLevels.size() > 1)
+  {
+    if (mLevels.back()->isOpen())
+      --mOpen;
+    delete mLevels.back();
+    mLevels.pop_back();
+    mNames.pop_back();
+  }
+}
+
+std::size_t DirectoryStack::depth() const
+{
+  return mLevels.empty() ? 0 : mLevels.size() - 1;
+}
+
+const DirectoryHandle * DirectoryStack::top()
+{
+  if (mLevels.empty())
+  {
+    errno = EBADF;
+    return NULL;
+  }
+  const std::vector<DirectoryHandle*>::size_type last = mLevels.size() - 1;
+  if (!mLevels[last]->isOpen())
+  {
+    // open all levels from the nearest open level (at least the root) upwards
+    std::vector<DirectoryHandle*>::size_type level = last;
+    while (!mLevels[level]->isOpen())
+      --level;
+    for (++level; level <= last; ++level)
+    {
+      if (!mLevels[level]->openAt(*mLevels[level - 1], mNames[level].c_str()))
+        return NULL;
+      ++mOpen;
+      // Only the root and the level that opens the next one are needed, so
+      // deep paths are opened again without exceeding the limit.
+      if ((mOpen > mMaxOpen) && (level > 1) && mLevels[level - 1]->isOpen())
+      {
+        mLevels[level - 1]->close();
+        --mOpen;
+      }
+    }
+    limit();
+  }
+  return mLevels[last];
+}
+
+std::size_t DirectoryStack::maxOpenFor(const unsigned int stacks)
+{
+  struct rlimit limits;
+  if ((stacks == 0) || (getrlimit(RLIMIT_NOFILE, &limits) != 0) || (limits.rlim_cur == RLIM_INFINITY))
+    return cDefaultMaxOpen;
+  if (limits.rlim_cur <= cReservedDescriptors + 2 * stacks)
+    return 2;
+  const std::size_t share = (limits.rlim_cur - cReservedDescriptors) / stacks;
+  return (share < cDefaultMaxOpen) ? share : cDefaultMaxOpen;
+}
+
+void DirectoryStack::limit()
+{
+  // The root and the top level stay open, the levels in between are needed
+  // later than the top level.
+  for (std::vector<DirectoryHandle*>::size_type level = 1; (mOpen > mMaxOpen) && (level + 1 < mLevels.size()); ++level)
+  {
+    if (mLevels[level]->isOpen())
+    {
+      mLevels[level]->close();
+      --mOpen;
+    }
+  }
+}
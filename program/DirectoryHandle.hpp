@@ -0,0 +1,283 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef DIRECTORYHANDLE_HPP
+#define DIRECTORYHANDLE_HPP
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+/** \brief wrapper around an open directory file descriptor
+ *
+ * All stat and change operations are done relative to the directory
+ * (fstatat(), fchmodat(), fchownat()), so the kernel only has to resolve a
+ * single path component instead of the whole path from the root again.
+ * Symbolic links are never followed for the entry itself.
+ *
+ * Directories are opened with O_PATH, so only search permission is required
+ * for them. getDirectoryFileList() opens the directory for reading on demand.
+ *
+ * A default-constructed handle refers to the current working directory,
+ * i.e. names are interpreted like ordinary paths.
+ */
+class DirectoryHandle
+{
+  public:
+    /** \brief constructor - handle refers to the current working directory */
+    DirectoryHandle();
+
+
+    /** \brief destructor - closes the directory, if it is open */
+    ~DirectoryHandle();
+
+
+    /** \brief opens the given directory
+     *
+     * \param path  path of the directory
+     * \return Returns true, if the directory could be opened.
+     *         Returns false otherwise. errno is set in that case.
+     * \remarks Symbolic links are followed for the path itself, because
+     *          this is meant for the directories given by the user.
+     */
+    bool open(const std::string& path);
+
+
+    /** \brief opens a subdirectory relative to another directory
+     *
+     * \param parent  handle of the parent directory
+     * \param name    name of the subdirectory within parent
+     * \return Returns true, if the directory could be opened.
+     *         Returns false otherwise. errno is set in that case, e.g. to
+     *         ELOOP, if name is a symbolic link, or to ENOTDIR, if name is
+     *         not a directory.
+     */
+    bool openAt(const DirectoryHandle& parent, const char * name);
+
+
+    /** \brief closes the directory, if it is open
+     *
+     * The handle refers to the current working directory afterwards.
+     */
+    void close();
+
+
+    /** \brief checks whether the handle refers to an opened directory
+     *
+     * \return Returns true, if a directory was opened via open() or openAt().
+     */
+    bool isOpen() const;
+
+
+    /** \brief gets the underlying file descriptor
+     *
+     * \return Returns the file descriptor, or AT_FDCWD for the current
+     *         working directory.
+     */
+    int fd() const;
+
+
+    /** \brief queries the status of an entry without following symbolic links
+     *
+     * \param name     name of the entry, relative to this directory
+     * \param statbuf  buffer that will hold the status information
+     * \return Returns zero on success. Returns -1 otherwise, errno is set.
+     */
+    int statEntry(const char * name, struct stat& statbuf) const;
+
+
+    /** \brief changes the permissions of an entry
+     *
+     * \param name  name of the entry, relative to this directory
+     * \param mode  the new file mode
+     * \return Returns zero on success. Returns -1 otherwise, errno is set.
+     * \remarks Callers have to make sure that the entry is not a symbolic
+     *          link, because fchmodat() does not support the flag
+     *          AT_SYMLINK_NOFOLLOW on Linux. Use statEntry() for that.
+     */
+    int changeMode(const char * name, const mode_t mode) const;
+
+
+    /** \brief changes the ownership of an entry without following symbolic links
+     *
+     * \param name     name of the entry, relative to this directory
+     * \param userID   the new owner
+     * \param groupID  the new group
+     * \return Returns zero on success. Returns -1 otherwise, errno is set.
+     */
+    int changeOwnership(const char * name, const uid_t userID, const gid_t groupID) const;
+  private:
+    int mFd; /**< file descriptor of the directory or AT_FDCWD */
+
+    // not copyable
+    DirectoryHandle(const DirectoryHandle& other);
+    DirectoryHandle& operator=(const DirectoryHandle& other);
+}; //class
+
+
+/** \brief keeps the directories along the most recently resolved relative path open
+ *
+ * Lines of a stat file contain paths relative to the destination directory,
+ * and parents are listed before their children. Resolving such a path via
+ * the chain only opens the components that differ from the previous path, so
+ * each entry can be handled relative to its parent directory.
+ */
+class DirectoryChain
+{
+  public:
+    /** \brief constructor */
+    DirectoryChain();
+
+
+    /** \brief destructor - closes all opened directories */
+    ~DirectoryChain();
+
+
+    /** \brief opens the root directory of the chain
+     *
+     * \param root  the directory that relative paths are resolved against
+     * \return Returns true, if the directory could be opened.
+     *         Returns false otherwise. errno is set in that case.
+     */
+    bool open(const std::string& root);
+
+
+    /** \brief gets the directory that contains the entry with the given relative path
+     *
+     * \param relativePath  path relative to the root directory, e.g. "a/b/c"
+     * \param baseName      variable that will hold the name of the entry
+     *                      relative to the returned directory
+     * \return Returns the handle of the parent directory of relativePath.
+     * \remarks If a parent directory cannot be opened (e.g. because it is a
+     *          symbolic link or does not exist), then the root directory is
+     *          returned and baseName contains the full relative path. Errors
+     *          will then be reported by the following operation on the entry.
+     */
+    const DirectoryHandle& parentOf(const std::string& relativePath, std::string& baseName);
+
+
+    /** \brief gets the root directory of the chain
+     *
+     * \return Returns the handle of the directory given to open().
+     */
+    const DirectoryHandle& root() const;
+  private:
+    DirectoryHandle mRoot; /**< root directory of the chain */
+    std::vector<std::string> mNames; /**< names of the opened directories, one per level */
+    std::vector<DirectoryHandle*> mLevels; /**< opened directories, one per level */
+
+    /** \brief closes all directories below the given level */
+    void truncate(const std::vector<std::string>::size_type levels);
+
+    // not copyable
+    DirectoryChain(const DirectoryChain& other);
+    DirectoryChain& operator=(const DirectoryChain& other);
+}; //class
+
+
+/** \brief stack of opened directories for an iterative walk, with a limited number of open descriptors
+ *
+ * The bottom of the stack is the root directory of the walk, every other
+ * level is a subdirectory of the level below it. If more levels than the
+ * given limit are open, the lowest open levels above the root are closed.
+ * top() opens them again by name, when the walk returns to them. So even very
+ * deep trees only need a bounded number of file descriptors.
+ */
+class DirectoryStack
+{
+  public:
+    static const std::size_t cDefaultMaxOpen = 64; /**< default limit of open directories */
+    static const std::size_t cReservedDescriptors = 16; /**< descriptors that maxOpenFor() leaves for other files */
+
+
+    /** \brief constructor
+     *
+     * \param maxOpen  maximum number of open directories, values below two
+     *                 are raised to two
+     */
+    explicit DirectoryStack(const std::size_t maxOpen = cDefaultMaxOpen);
+
+
+    /** \brief destructor - closes all opened directories */
+    ~DirectoryStack();
+
+
+    /** \brief removes all levels and opens the root directory
+     *
+     * \param root  path of the root directory
+     * \return Returns true, if the directory could be opened.
+     *         Returns false otherwise. errno is set in that case.
+     */
+    bool open(const std::string& root);
+
+
+    /** \brief opens a subdirectory of the top level and pushes it onto the stack
+     *
+     * \param name  name of the subdirectory within the top level
+     * \return Returns true, if the directory could be opened.
+     *         Returns false otherwise. errno is set in that case, see
+     *         DirectoryHandle::openAt().
+     */
+    bool push(const char * name);
+
+
+    /** \brief removes the top level, the root directory is never removed */
+    void pop();
+
+
+    /** \brief gets the number of levels above the root directory */
+    std::size_t depth() const;
+
+
+    /** \brief gets the top level, opens it again if required
+     *
+     * \return Returns the handle of the top level. Returns NULL, if it could
+     *         not be opened again, errno is set in that case.
+     */
+    const DirectoryHandle * top();
+
+
+    /** \brief gets a limit of open directories that fits the limit of open files of the process
+     *
+     * \param stacks  number of stacks that are used at the same time
+     * \return Returns cDefaultMaxOpen, if the soft limit RLIMIT_NOFILE allows
+     *         it for all stacks after cReservedDescriptors are left for other
+     *         files. Returns the share of each stack (at least two) otherwise.
+     */
+    static std::size_t maxOpenFor(const unsigned int stacks);
+  private:
+    std::size_t mMaxOpen; /**< maximum number of open directories */
+    std::size_t mOpen; /**< number of currently open directories */
+    std::vector<std::string> mNames; /**< names of the directories, one per level */
+    std::vector<DirectoryHandle*> mLevels; /**< directories, one per level, may be closed */
+
+    /** \brief closes the lowest open levels until the limit is met */
+    void limit();
+
+    /** \brief removes all levels, including the root */
+    void clear();
+
+    // not copyable
+    DirectoryStack(const DirectoryStack& other);
+    DirectoryStack& operator=(const DirectoryStack& other);
+}; //class
+
+#endif // DIRECTORYHANDLE_HPP
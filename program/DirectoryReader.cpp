@@ -0,0 +1,136 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include "DirectoryReader.hpp"
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>      //for DT_UNKNOWN
+#include <fcntl.h>       //for openat()
+#include <stdint.h>
+#include <sys/syscall.h> //for SYS_getdents64
+#include <unistd.h>      //for syscall(), close()
+
+namespace
+{
+  /* layout of the records returned by getdents64(), see getdents(2) */
+  struct linux_dirent64 {
+      uint64_t d_ino;
+      int64_t d_off;
+      unsigned short d_reclen;
+      unsigned char d_type;
+      char d_name[1];
+  };//struct
+} //namespace
+
+DirectoryEntryView::DirectoryEntryView()
+: name(NULL), length(0), type(DT_UNKNOWN)
+{ }
+
+bool DirectoryEntryView::isDotOrDotDot() const
+{
+  return (name[0] == '.') && ((length == 1) || ((length == 2) && (name[1] == '.')));
+}
+
+
+const std::size_t DirectoryReader::cDefaultBufferSize;
+const std::size_t DirectoryReader::cMinimumBufferSize;
+std::size_t DirectoryReader::sDefaultBufferSize = DirectoryReader::cDefaultBufferSize;
+
+DirectoryReader::DirectoryReader(const std::size_t bufferSize)
+: mBuffer(std::vector<char>(bufferSize < cMinimumBufferSize ? cMinimumBufferSize : bufferSize)),
+  mFilled(0),
+  mOffset(0),
+  mFd(-1),
+  mError(0)
+{
+}
+
+DirectoryReader::~DirectoryReader()
+{
+  close();
+}
+
+bool DirectoryReader::open(const DirectoryHandle& directory)
+{
+  close();
+  // Handles are opened with O_PATH, so we need a readable descriptor here.
+  mFd = openat(directory.fd(), ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (mFd < 0)
+  {
+    mError = errno;
+    return false;
+  }
+  return true;
+}
+
+bool DirectoryReader::next(DirectoryEntryView& entry)
+{
+  if (mFd < 0)
+    return false;
+  if (mOffset >= mFilled)
+  {
+    // buffer is used up, get next batch of entries
+    const long bytes = syscall(SYS_getdents64, mFd, &mBuffer[0], mBuffer.size());
+    if (bytes <= 0)
+    {
+      // zero means end of directory
+      if (bytes < 0)
+        mError = errno;
+      mFilled = 0;
+      mOffset = 0;
+      return false;
+    }
+    mFilled = static_cast<std::size_t>(bytes);
+    mOffset = 0;
+  }
+  const linux_dirent64 * record = reinterpret_cast<const linux_dirent64*>(&mBuffer[mOffset]);
+  mOffset += record->d_reclen;
+  entry.name = record->d_name;
+  entry.length = std::strlen(record->d_name);
+  entry.type = record->d_type;
+  return true;
+}
+
+int DirectoryReader::error() const
+{
+  return mError;
+}
+
+void DirectoryReader::close()
+{
+  if (mFd >= 0)
+  {
+    ::close(mFd);
+    mFd = -1;
+  }
+  mFilled = 0;
+  mOffset = 0;
+  mError = 0;
+}
+
+std::size_t DirectoryReader::defaultBufferSize()
+{
+  return sDefaultBufferSize;
+}
+
+void DirectoryReader::setDefaultBufferSize(const std::size_t bufferSize)
+{
+  sDefaultBufferSize = (bufferSize < cMinimumBufferSize) ? cMinimumBufferSize : bufferSize;
+}
@@ -0,0 +1,130 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef DIRECTORYREADER_HPP
+#define DIRECTORYREADER_HPP
+
+#include <cstddef>
+#include <vector>
+#include "DirectoryHandle.hpp"
+
+/* structure for an entry returned by DirectoryReader - the name is not copied */
+struct DirectoryEntryView {
+    const char * name;   /* null-terminated name, points into the reader's buffer */
+    std::size_t length;  /* length of name, without terminating null */
+    unsigned char type;  /* type of the entry (DT_DIR, DT_REG, ...), may be DT_UNKNOWN */
+
+    /* constructor */
+    DirectoryEntryView();
+
+    /* returns true, if the entry is "." or ".." */
+    bool isDotOrDotDot() const;
+};//struct
+
+
+/** \brief reads directory entries in bulk via getdents64()
+ *
+ * The reader fetches as many entries as fit into its buffer with a single
+ * system call and hands them out without copying the names. The buffer is
+ * allocated once and reused for every directory that is opened with the
+ * same reader, so a directory has to be read completely before the next one
+ * is opened.
+ */
+class DirectoryReader
+{
+  public:
+    static const std::size_t cDefaultBufferSize = 256 * 1024; /**< initial default buffer size in bytes */
+    static const std::size_t cMinimumBufferSize = 4 * 1024; /**< smallest allowed buffer size in bytes */
+
+
+    /** \brief constructor
+     *
+     * \param bufferSize  size of the buffer in bytes, values below
+     *                    cMinimumBufferSize are raised to that value
+     */
+    explicit DirectoryReader(const std::size_t bufferSize = defaultBufferSize());
+
+
+    /** \brief destructor - closes the current directory */
+    ~DirectoryReader();
+
+
+    /** \brief starts reading the given directory
+     *
+     * \param directory  the directory that shall be read
+     * \return Returns true, if the directory could be opened for reading.
+     *         Returns false otherwise. errno is set in that case.
+     * \remarks A previously opened directory is closed, and all entries
+     *          that were returned for it become invalid.
+     */
+    bool open(const DirectoryHandle& directory);
+
+
+    /** \brief gets the next entry of the directory
+     *
+     * \param entry  variable that will hold the next entry
+     * \return Returns true, if an entry was read. Returns false, if there are
+     *         no more entries or an error occurred. Use error() to tell the
+     *         difference.
+     * \remarks The name of the entry is only valid until the next call of
+     *          next(), open() or close().
+     */
+    bool next(DirectoryEntryView& entry);
+
+
+    /** \brief gets the error code of the last failed read
+     *
+     * \return Returns zero, if no error occurred. Returns the errno value of
+     *         the failed read otherwise.
+     */
+    int error() const;
+
+
+    /** \brief closes the current directory */
+    void close();
+
+
+    /** \brief gets the buffer size that is used, if none is given to the constructor
+     *
+     * \return Returns the default buffer size in bytes.
+     */
+    static std::size_t defaultBufferSize();
+
+
+    /** \brief sets the buffer size that is used, if none is given to the constructor
+     *
+     * \param bufferSize  the new default buffer size in bytes
+     */
+    static void setDefaultBufferSize(const std::size_t bufferSize);
+  private:
+    std::vector<char> mBuffer; /**< buffer for the data returned by getdents64() */
+    std::size_t mFilled; /**< number of valid bytes in mBuffer */
+    std::size_t mOffset; /**< offset of the next entry in mBuffer */
+    int mFd;    /**< descriptor of the directory that is read, or -1 */
+    int mError; /**< error code of the last failed read, or zero */
+
+    static std::size_t sDefaultBufferSize; /**< buffer size used by default */
+
+    // not copyable
+    DirectoryReader(const DirectoryReader& other);
+    DirectoryReader& operator=(const DirectoryReader& other);
+}; //class
+
+#endif // DIRECTORYREADER_HPP
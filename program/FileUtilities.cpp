@@ -19,14 +19,28 @@
 */
 
 #include "FileUtilities.hpp"
+#include <atomic>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
 #include <cerrno>
 #include <cstring>
+#include <fcntl.h> //for AT_FDCWD
 #include <pwd.h>
 #include <grp.h>
 #include <unistd.h>
 #include "AuxiliaryFunctions.hpp"
+#include "DirectoryReader.hpp"
+#include "IDMapping.hpp"
+#include "LinkTracker.hpp"
+#include "LogSink.hpp"
 #include "ModeUtility.hpp"
+#include "MountBoundary.hpp"
+#include "NameCache.hpp"
+#include "PathFilter.hpp"
+#include "StatEngine.hpp"
+#include "WorkStealingPool.hpp"
 
 #if defined(__linux__) || defined(linux)
   //Linux directory entries
@@ -35,133 +49,385 @@
   #error "Unknown operating system! Only compiles on Linux-like systems."
 #endif
 
+FileStatus::FileStatus()
+: mode(0), userID(0), groupID(0), device(0), inode(0), linkCount(0)
+{ }
+
+FileStatus::FileStatus(const struct stat& statbuf)
+: mode(statbuf.st_mode), userID(statbuf.st_uid), groupID(statbuf.st_gid),
+  device(statbuf.st_dev), inode(statbuf.st_ino), linkCount(statbuf.st_nlink)
+{ }
+
 FileEntry::FileEntry()
-: fileName(""), isDirectory(false)
+: fileName(""), isDirectory(false), hasStatus(false), status(FileStatus())
 { }
 
 std::vector<FileEntry> getDirectoryFileList(const std::string& Directory)
 {
-  std::vector<FileEntry> result;
-  FileEntry one;
-  #if defined(__linux__) || defined(linux)
-  //Linux part
-  DIR * direc = opendir(Directory.c_str());
-  if (direc == NULL)
+  DirectoryHandle handle;
+  if (!handle.open(Directory))
   {
     std::cout << "getDirectoryFileList: ERROR: unable to open directory "
               <<"\""<<Directory<<"\". Returning empty list.\n";
-    return result;
-  }//if
+    return std::vector<FileEntry>();
+  }
+  return getDirectoryFileList(handle);
+}//function
 
-  struct dirent* entry = readdir(direc);
-  while (entry != NULL)
+/* adds the entries of the engine's batch to the list, using the status of the entries */
+static void addBatchToFileList(const DirectoryHandle& directory, StatEngine& engine, std::vector<StatResult>& results, std::vector<FileEntry>& list)
+{
+  engine.query(directory, results);
+  FileEntry one;
+  for (std::size_t i = 0; i < engine.size(); ++i)
   {
-    one.fileName = std::string(entry->d_name);
-    struct stat statbuf;
-    int ret = lstat((Directory + pathDelimiter + one.fileName).c_str(), &statbuf);
-    if (0 != ret)
+    one.fileName.assign(engine.name(i), engine.length(i));
+    one.hasStatus = false;
+    if (0 != results[i].error)
     {
       //error while querying status of file, fall back to DT_DIR
-      one.isDirectory = entry->d_type==DT_DIR;
+      one.isDirectory = engine.type(i)==DT_DIR;
+      list.push_back(one);
     }
-    else
+    else if (!isUnwantedMode(results[i].status.st_mode))
     {
-      one.isDirectory = ((statbuf.st_mode & S_IFDIR) == S_IFDIR);
+      one.isDirectory = S_ISDIR(results[i].status.st_mode);
+      one.hasStatus = true;
+      one.status = FileStatus(results[i].status);
+      list.push_back(one);
     }
+  }//for
+  engine.clear();
+}
+
+std::vector<FileEntry> getDirectoryFileList(const DirectoryHandle& directory, const bool withStatus)
+{
+  std::vector<FileEntry> result;
+  FileEntry one;
+  DirectoryReader reader;
+  if (!reader.open(directory))
+  {
+    std::cout << "getDirectoryFileList: ERROR: unable to open directory. "
+              << "Returning empty list.\n";
+    return result;
+  }//if
 
+  std::unique_ptr<StatEngine> engine = StatEngine::create();
+  std::vector<StatResult> results;
+  DirectoryEntryView entry;
+  while (reader.next(entry))
+  {
     //check for socket, pipes, block device and char device, which we don't want
-    if (entry->d_type != DT_SOCK && entry->d_type != DT_FIFO && entry->d_type != DT_BLK
-        && entry->d_type != DT_CHR)
+    if (!isUnwantedType(entry.type))
     {
-      result.push_back(one);
+      if (!withStatus && (entry.type != DT_UNKNOWN))
+      {
+        // type is all we need, and the file system already told us
+        one.fileName.assign(entry.name, entry.length);
+        one.hasStatus = false;
+        one.isDirectory = entry.type==DT_DIR;
+        result.push_back(one);
+      }
+      else
+      {
+        // query status in batches
+        engine->add(entry.name, entry.length, entry.type);
+        if (engine->full())
+          addBatchToFileList(directory, *engine, results, result);
+      }
     }
-    entry = readdir(direc);
   }//while
-  closedir(direc);
-  #else
-    #error "Unknown operating system!"
-  #endif
+  addBatchToFileList(directory, *engine, results, result);
   return result;
 }//function
 
+bool isUnwantedType(const unsigned char type)
+{
+  return (type == DT_SOCK) || (type == DT_FIFO) || (type == DT_BLK) || (type == DT_CHR);
+}
+
+bool isUnwantedMode(const mode_t mode)
+{
+  return S_ISSOCK(mode) || S_ISFIFO(mode) || S_ISBLK(mode) || S_ISCHR(mode);
+}
+
 std::string getHumanReadableOwnership(const struct stat& statbuf)
 {
   return getHumanReadableOwnership(statbuf.st_uid, statbuf.st_gid);
 }
 
+std::string getHumanReadableOwnership(const FileStatus& status)
+{
+  return getHumanReadableOwnership(status.userID, status.groupID);
+}
+
 std::string getHumanReadableOwnership(const uid_t userID, const gid_t groupID)
 {
-  std::string result = "";
-  struct passwd *pwd = getpwuid(userID);
-  if (NULL!=pwd)
-    result = std::string(pwd->pw_name);
+  // messages are printed for every changed file, so names are cached
+  NameCache& names = NameCache::shared();
+  std::string result;
+  const std::string * name = names.userName(userID);
+  if (name != NULL)
+    result.append(*name);
   else
-    result = uintToString(userID);
-  result = result + ":";
+    appendUint(result, userID);
+  result.push_back(':');
 
-  struct group * grp = getgrgid(groupID);
-  if (NULL!=grp)
-    result = result + std::string(grp->gr_name);
+  name = names.groupName(groupID);
+  if (name != NULL)
+    result.append(*name);
   else
-    result = result + uintToString(groupID);
+    appendUint(result, groupID);
   return result;
 }
 
-bool copy_file_stats(const std::string& src_path, const std::string& dest_path, const bool permissions, const bool ownership, const bool verbose, const bool dryRun)
+void writeModeChange(std::ostream& out, const std::string& path, const mode_t from, const mode_t to, const bool dryRun)
 {
-  if (!(permissions or ownership))
+  char digits[cMaxOctalChars];
+  out << (dryRun ? "Would change mode of " : "Changing mode of ") << path << " from ";
+  out.write(digits, uintToOctalChars(digits, Mode::onlyPermissions(from)) - digits);
+  out << " to ";
+  out.write(digits, uintToOctalChars(digits, Mode::onlyPermissions(to)) - digits);
+  out << "...\n";
+}
+
+/* writes "user:group" like getHumanReadableOwnership(), but without building a string */
+static void writeOwnership(std::ostream& out, const uid_t userID, const gid_t groupID)
+{
+  NameCache& names = NameCache::shared();
+  char digits[cMaxUintChars];
+  const std::string * name = names.userName(userID);
+  if (name != NULL)
+    out.write(name->data(), name->size());
+  else
+    out.write(digits, uintToChars(digits, userID) - digits);
+  out.put(':');
+  name = names.groupName(groupID);
+  if (name != NULL)
+    out.write(name->data(), name->size());
+  else
+    out.write(digits, uintToChars(digits, groupID) - digits);
+}
+
+void writeOwnershipChange(std::ostream& out, const std::string& path, const uid_t fromUser, const gid_t fromGroup,
+                          const uid_t toUser, const gid_t toGroup, const bool dryRun)
+{
+  out << (dryRun ? "Would change ownership of \"" : "Changing ownership of \"") << path << "\" from ";
+  writeOwnership(out, fromUser, fromGroup);
+  out << " to ";
+  writeOwnership(out, toUser, toGroup);
+  out << "...\n";
+}
+
+bool getUserName(const uid_t userID, std::string& name)
+{
+  // getpwuid() is not thread-safe, so use the reentrant version
+  long size = sysconf(_SC_GETPW_R_SIZE_MAX);
+  std::vector<char> buffer(size > 0 ? size : 1024);
+  struct passwd pwd;
+  struct passwd * result = NULL;
+  int ret = getpwuid_r(userID, &pwd, &buffer[0], buffer.size(), &result);
+  while (ret == ERANGE)
   {
-    std::cout << "Hint: No stats for change!\n";
-    return true;
+    buffer.resize(buffer.size() * 2);
+    ret = getpwuid_r(userID, &pwd, &buffer[0], buffer.size(), &result);
   }
-  struct stat src_statbuf;
-  int ret = lstat(src_path.c_str(), &src_statbuf);
-  if (0 != ret)
+  if ((ret != 0) || (result == NULL))
+    return false;
+  name = std::string(pwd.pw_name);
+  return true;
+}
+
+bool getGroupName(const gid_t groupID, std::string& name)
+{
+  // getgrgid() is not thread-safe, so use the reentrant version
+  long size = sysconf(_SC_GETGR_R_SIZE_MAX);
+  std::vector<char> buffer(size > 0 ? size : 1024);
+  struct group grp;
+  struct group * result = NULL;
+  int ret = getgrgid_r(groupID, &grp, &buffer[0], buffer.size(), &result);
+  while (ret == ERANGE)
   {
-    int errorCode = errno;
-    std::cout << "Error while querying status of \"" << src_path << "\": Code " << errorCode << " (" << strerror(errorCode) << ").\n";
+    buffer.resize(buffer.size() * 2);
+    ret = getgrgid_r(groupID, &grp, &buffer[0], buffer.size(), &result);
+  }
+  if ((ret != 0) || (result == NULL))
     return false;
+  name = std::string(grp.gr_name);
+  return true;
+}
+
+bool getUserID(const std::string& name, uid_t& userID)
+{
+  // getpwnam() is not thread-safe, so use the reentrant version
+  long size = sysconf(_SC_GETPW_R_SIZE_MAX);
+  std::vector<char> buffer(size > 0 ? size : 1024);
+  struct passwd pwd;
+  struct passwd * result = NULL;
+  int ret = getpwnam_r(name.c_str(), &pwd, &buffer[0], buffer.size(), &result);
+  while (ret == ERANGE)
+  {
+    buffer.resize(buffer.size() * 2);
+    ret = getpwnam_r(name.c_str(), &pwd, &buffer[0], buffer.size(), &result);
   }
-  struct stat dest_statbuf;
-  ret = lstat(dest_path.c_str(), &dest_statbuf);
-  if (0 != ret)
+  if ((ret != 0) || (result == NULL))
+    return false;
+  userID = pwd.pw_uid;
+  return true;
+}
+
+bool getGroupID(const std::string& name, gid_t& groupID)
+{
+  // getgrnam() is not thread-safe, so use the reentrant version
+  long size = sysconf(_SC_GETGR_R_SIZE_MAX);
+  std::vector<char> buffer(size > 0 ? size : 1024);
+  struct group grp;
+  struct group * result = NULL;
+  int ret = getgrnam_r(name.c_str(), &grp, &buffer[0], buffer.size(), &result);
+  while (ret == ERANGE)
   {
-    int errorCode = errno;
+    buffer.resize(buffer.size() * 2);
+    ret = getgrnam_r(name.c_str(), &grp, &buffer[0], buffer.size(), &result);
+  }
+  if ((ret != 0) || (result == NULL))
+    return false;
+  groupID = grp.gr_gid;
+  return true;
+}
+
+void listUsers(IDNameList& users)
+{
+  users.clear();
+  setpwent();
+  const struct passwd * entry = NULL;
+  while ((entry = getpwent()) != NULL)
+    users.push_back(std::make_pair(static_cast<unsigned int>(entry->pw_uid), std::string(entry->pw_name)));
+  endpwent();
+}
+
+void listGroups(IDNameList& groups)
+{
+  groups.clear();
+  setgrent();
+  const struct group * entry = NULL;
+  while ((entry = getgrent()) != NULL)
+    groups.push_back(std::make_pair(static_cast<unsigned int>(entry->gr_gid), std::string(entry->gr_name)));
+  endgrent();
+}
+
+bool readIDNameFile(const std::string& fileName, IDNameList& entries)
+{
+  entries.clear();
+  std::ifstream input(fileName.c_str(), std::ios_base::in | std::ios_base::binary);
+  if (!input.is_open())
+  {
+    const int errorCode = errno;
+    LogSink::errors() << "Error: Could not open file \"" << fileName << "\": Code "
+              << errorCode << " (" << strerror(errorCode) << ").\n";
+    return false;
+  }
+  std::string line;
+  unsigned int lineNumber = 0;
+  while (std::getline(input, line))
+  {
+    ++lineNumber;
+    if (line.empty() or (line[0] == '#') or (line[0] == '+') or (line[0] == '-'))
+      continue;
+    const std::string::size_type nameEnd = line.find(':');
+    const std::string::size_type passwordEnd = (nameEnd != std::string::npos) ? line.find(':', nameEnd + 1) : std::string::npos;
+    const std::string::size_type idEnd = (passwordEnd != std::string::npos) ? line.find(':', passwordEnd + 1) : std::string::npos;
+    unsigned int id = 0;
+    if ((nameEnd == 0) or (idEnd == std::string::npos)
+        or !stringToUint(line.substr(passwordEnd + 1, idEnd - passwordEnd - 1), id))
+    {
+      LogSink::errors() << "Error: Line " << lineNumber << " of \"" << fileName
+                << "\" is not a valid entry of a user or group.\n";
+      return false;
+    }
+    entries.push_back(std::make_pair(id, line.substr(0, nameEnd)));
+  } // while
+  if (input.bad())
+  {
+    LogSink::errors() << "Error: Could not read file \"" << fileName << "\".\n";
+    return false;
+  }
+  return true;
+}
+
+static bool apply_entry_stats(const FileStatus& src_status, const std::string& src_path,
+                              const StatResult& dest_result, const DirectoryHandle& dest_dir, const char * dest_name, const std::string& dest_path,
+                              std::ostream& out, const bool permissions, const bool ownership, const bool verbose, const bool dryRun);
+
+/* copies file permissions and/or ownership of one entry to an entry relative
+   to the given destination directory. The paths are only used for messages,
+   which are written to out. */
+static bool copy_entry_stats(const FileStatus& src_status, const std::string& src_path,
+                             const DirectoryHandle& dest_dir, const char * dest_name, const std::string& dest_path,
+                             std::ostream& out, const bool permissions, const bool ownership, const bool verbose, const bool dryRun)
+{
+  StatResult dest_result;
+  dest_result.error = 0;
+  if (0 != dest_dir.statEntry(dest_name, dest_result.status))
+    dest_result.error = errno;
+  return apply_entry_stats(src_status, src_path, dest_result, dest_dir, dest_name, dest_path, out, permissions, ownership, verbose, dryRun);
+}
+
+/* like copy_entry_stats(), but with already queried status of the destination */
+static bool apply_entry_stats(const FileStatus& src_status, const std::string& src_path,
+                              const StatResult& dest_result, const DirectoryHandle& dest_dir, const char * dest_name, const std::string& dest_path,
+                              std::ostream& out, const bool permissions, const bool ownership, const bool verbose, const bool dryRun)
+{
+  if (!(permissions or ownership))
+  {
+    out << "Hint: No stats for change!\n";
+    return true;
+  }
+  if (0 != dest_result.error)
+  {
+    const int errorCode = dest_result.error;
     if (errorCode == ENOENT)
     {
       // destination file does not exist, skip silently
       return true;
     }
-    std::cout << "Error while querying status of \"" << dest_path << "\": Code "
+    LogSink::errors(out) << "Error while querying status of \"" << dest_path << "\": Code "
               << errorCode << " (" << strerror(errorCode) << ").\n";
     return false;
   }
+  const struct stat& dest_statbuf = dest_result.status;
+  int ret = 0;
   // check for equivalence
-  if ((dest_statbuf.st_dev == src_statbuf.st_dev) and (dest_statbuf.st_ino==src_statbuf.st_ino))
+  if ((dest_statbuf.st_dev == src_status.device) and (dest_statbuf.st_ino==src_status.inode))
   {
-    std::cout << "Error: " << src_path << " and " << dest_path << " are the same file!\n";
+    LogSink::errors(out) << "Error: " << src_path << " and " << dest_path << " are the same file!\n";
     return false;
   }
+  // IDs of the source may belong to another user namespace
+  const IDMapping& mapping = IDMapping::shared();
+  const uid_t userID = mapping.mapUser(src_status.userID);
+  const gid_t groupID = mapping.mapGroup(src_status.groupID);
+  // another hard link of the destination may have been handled already
+  if (LinkTracker::shared().alreadyApplied(dest_statbuf, src_status.mode, userID, groupID))
+    return true;
 
-  // mode change allowed?
-  if (permissions)
+  // mode change allowed? (Permissions of symbolic links are never used on
+  // Linux, and chmod() would change the target of the link instead.)
+  if (permissions and !S_ISLNK(dest_statbuf.st_mode))
   {
     // check for required permission change
-    if (Mode::onlyPermissions(dest_statbuf.st_mode) != Mode::onlyPermissions(src_statbuf.st_mode))
+    if (Mode::onlyPermissions(dest_statbuf.st_mode) != Mode::onlyPermissions(src_status.mode))
     {
       if (verbose or dryRun)
       {
-        std::cout << (dryRun ? "Would change mode of " : "Changing mode of ")
-                  << dest_path << " from " << std::oct << Mode::onlyPermissions(dest_statbuf.st_mode)
-                  << " to " << std::oct << Mode::onlyPermissions(src_statbuf.st_mode) << std::dec <<"...\n";
+        writeModeChange(out, dest_path, dest_statbuf.st_mode, src_status.mode, dryRun);
       }
       if (!dryRun)
       {
-        ret = chmod(dest_path.c_str(), src_statbuf.st_mode);
+        ret = dest_dir.changeMode(dest_name, src_status.mode);
         if (0!=ret)
         {
           int errorCode = errno;
-          std::cout << "Error while changing mode of \"" << dest_path
+          LogSink::errors(out) << "Error while changing mode of \"" << dest_path
                     << "\": Code " << errorCode << " (" << strerror(errorCode) << ").\n";
           return false;
         }
@@ -173,21 +439,19 @@ bool copy_file_stats(const std::string& src_path, const std::string& dest_path,
   if (ownership)
   {
     // change needed?
-    if ((dest_statbuf.st_uid!=src_statbuf.st_uid) or (dest_statbuf.st_gid!=src_statbuf.st_gid))
+    if ((dest_statbuf.st_uid!=userID) or (dest_statbuf.st_gid!=groupID))
     {
       if (verbose or dryRun)
       {
-          std::cout << (dryRun ? "Would change ownership of \"" : "Changing ownership of \"")
-                    << dest_path << "\" from " << getHumanReadableOwnership(dest_statbuf)
-                    << " to " << getHumanReadableOwnership(src_statbuf) << "...\n";
+        writeOwnershipChange(out, dest_path, dest_statbuf.st_uid, dest_statbuf.st_gid, userID, groupID, dryRun);
       }
       if (!dryRun)
       {
-        ret = lchown(dest_path.c_str(), src_statbuf.st_uid, src_statbuf.st_gid);
+        ret = dest_dir.changeOwnership(dest_name, userID, groupID);
         if (0!=ret)
         {
           int errorCode = errno;
-          std::cout << "Error while changing ownership of \"" << dest_path
+          LogSink::errors(out) << "Error while changing ownership of \"" << dest_path
                     << "\": Code " << errorCode << " (" << strerror(errorCode)
                     << ").\n";
           return false;
@@ -198,31 +462,427 @@ bool copy_file_stats(const std::string& src_path, const std::string& dest_path,
   return true;
 }
 
-bool copy_stats_recursive(const std::string& src_dir, const std::string& dest_dir, const bool permissions, const bool ownership, const bool verbose, const bool dryRun)
+bool copy_file_stats(const std::string& src_path, const std::string& dest_path, const bool permissions, const bool ownership, const bool verbose, const bool dryRun)
+{
+  struct stat src_statbuf;
+  if (0 != StatEngine::statAt(AT_FDCWD, src_path.c_str(), src_statbuf))
+  {
+    int errorCode = errno;
+    LogSink::errors() << "Error while querying status of \"" << src_path << "\": Code " << errorCode << " (" << strerror(errorCode) << ").\n";
+    return false;
+  }
+  // default handle: paths are resolved relative to the working directory
+  const DirectoryHandle cwd;
+  return copy_entry_stats(FileStatus(src_statbuf), src_path, cwd, dest_path.c_str(), dest_path, std::cout, permissions, ownership, verbose, dryRun);
+}
+
+/* copies the stats of the entries of a batch from one directory to another
+
+   parameters:
+       src_dir, dest_dir   - the opened source and destination directory
+       src_path, dest_path - paths of those directories, used for messages.
+                             Will be extended temporarily for each entry.
+       src_root_length     - length of the path of the source directory given
+                             by the user, for the relative paths of filters
+       engine              - engine that holds the names of the batch, it is
+                             cleared afterwards
+       src_results,
+       dest_results        - vectors for the results of the engine
+       subDirectories      - names of subdirectories are appended to it, each
+                             one followed by a null character
+       out                 - stream for messages
+
+   return value:
+       Returns true in case of success, or false if an error occurred.
+*/
+static bool copy_batch_stats(const DirectoryHandle& src_dir, const DirectoryHandle& dest_dir, std::string& src_path, std::string& dest_path, const std::string::size_type src_root_length, StatEngine& engine, std::vector<StatResult>& src_results, std::vector<StatResult>& dest_results, std::string& subDirectories, std::ostream& out, const bool permissions, const bool ownership, const bool verbose, const bool dryRun)
 {
-  const std::vector<FileEntry> files = getDirectoryFileList(src_dir);
-  for (std::vector<FileEntry>::size_type i = 0; i < files.size(); ++i)
+  engine.query(src_dir, src_results);
+  engine.query(dest_dir, dest_results);
+  const std::string::size_type src_length = src_path.size();
+  const std::string::size_type dest_length = dest_path.size();
+  PathFilter& filter = PathFilter::shared();
+  for (std::size_t i = 0; i < engine.size(); ++i)
   {
-    if ((files[i].fileName!= "..") && (files[i].fileName != "."))
+    // only entries of unknown type still need to be checked
+    if ((0 == src_results[i].error)
+        and filter.excludesQueried(src_path, src_root_length, engine.name(i), engine.length(i), engine.type(i), src_results[i].status.st_mode))
+      continue;
+    src_path.append(1, pathDelimiter).append(engine.name(i), engine.length(i));
+    dest_path.append(1, pathDelimiter).append(engine.name(i), engine.length(i));
+    if (0 != src_results[i].error)
+    {
+      const int errorCode = src_results[i].error;
+      LogSink::errors(out) << "Error while querying status of \"" << src_path << "\": Code "
+          << errorCode << " (" << strerror(errorCode) << ").\n";
+      return false;
+    }
+    const struct stat& src_statbuf = src_results[i].status;
+    if (!isUnwantedMode(src_statbuf.st_mode)
+        and !MountBoundary::shared().outside(src_statbuf, src_path, out, verbose or dryRun))
     {
       // handle file/directory itself
-      if (!copy_file_stats(src_dir+pathDelimiter+files[i].fileName, dest_dir+pathDelimiter+files[i].fileName, permissions, ownership, verbose, dryRun))
+      if (!apply_entry_stats(FileStatus(src_statbuf), src_path, dest_results[i], dest_dir, engine.name(i), dest_path, out, permissions, ownership, verbose, dryRun))
       {
         return false;
       }
-      // handle directory content, if it's a directory
-      if (files[i].isDirectory)
-      {
-        if (!copy_stats_recursive(src_dir+pathDelimiter+files[i].fileName, dest_dir+pathDelimiter+files[i].fileName, permissions, ownership, verbose, dryRun))
-        {
-          return false;
-        }
-      }
-    } // if not dot or dot+dot
+      if (S_ISDIR(src_statbuf.st_mode))
+        subDirectories.append(engine.name(i), engine.length(i) + 1);
+    }
+    src_path.resize(src_length);
+    dest_path.resize(dest_length);
   } // for
+  engine.clear();
   return true;
 }
 
+/* copies the stats of all entries of one directory, but not of the content of
+   its subdirectories
+
+   parameters:
+       src_dir, dest_dir   - the opened source and destination directory
+       src_path, dest_path - paths of those directories, used for messages.
+                             Will be extended temporarily for each entry.
+       src_root_length     - see copy_batch_stats()
+       reader              - reader for the source directory
+       engine              - engine for the status queries
+       subDirectories      - will hold the names of the subdirectories, each
+                             one followed by a null character
+       out                 - stream for messages
+
+   return value:
+       Returns true in case of success, or false if an error occurred.
+*/
+static bool copy_directory_entries(const DirectoryHandle& src_dir, const DirectoryHandle& dest_dir, std::string& src_path, std::string& dest_path, const std::string::size_type src_root_length, DirectoryReader& reader, StatEngine& engine, std::string& subDirectories, std::ostream& out, const bool permissions, const bool ownership, const bool verbose, const bool dryRun)
+{
+  if (!reader.open(src_dir))
+  {
+    const int errorCode = errno;
+    LogSink::errors(out) << "Error: Could not read directory \"" << src_path << "\": Code "
+        << errorCode << " (" << strerror(errorCode) << ").\n";
+    return false;
+  }
+  // Entries are queried in batches, the engine copies their names.
+  engine.clear();
+  std::vector<StatResult> src_results;
+  std::vector<StatResult> dest_results;
+  PathFilter& filter = PathFilter::shared();
+  DirectoryEntryView entry;
+  while (reader.next(entry))
+  {
+    // excluded entries are skipped before their status is queried
+    if (entry.isDotOrDotDot() or isUnwantedType(entry.type)
+        or filter.excludes(src_path, src_root_length, entry.name, entry.length, entry.type))
+      continue;
+    engine.add(entry.name, entry.length, entry.type);
+    if (engine.full() and !copy_batch_stats(src_dir, dest_dir, src_path, dest_path, src_root_length, engine, src_results, dest_results, subDirectories, out, permissions, ownership, verbose, dryRun))
+      return false;
+  } // while
+  if (reader.error() != 0)
+  {
+    const int errorCode = reader.error();
+    LogSink::errors(out) << "Error: Could not read directory \"" << src_path << "\": Code "
+        << errorCode << " (" << strerror(errorCode) << ").\n";
+    return false;
+  }
+  reader.close();
+  return copy_batch_stats(src_dir, dest_dir, src_path, dest_path, src_root_length, engine, src_results, dest_results, subDirectories, out, permissions, ownership, verbose, dryRun);
+}
+
+/* checks the error of opening a destination subdirectory
+
+   parameters:
+       errorCode - errno value of the failed opening
+       dest_path - path of the subdirectory, used for messages
+       out       - stream for messages
+
+   return value:
+       Returns true, if the content of the directory shall just be skipped
+       (destination does not exist or is no directory), or false if it is a
+       real error.
+*/
+static bool check_destination_open_error(const int errorCode, const std::string& dest_path, std::ostream& out, const bool verbose, const bool dryRun)
+{
+  if ((errorCode == ELOOP) or (errorCode == ENOTDIR))
+  {
+    // Destination is not a directory (or a symbolic link), so there
+    // is nothing to do for the directory content.
+    if (verbose or dryRun)
+      out << "Info: \"" << dest_path << "\" is not a directory, skipping its content.\n";
+    return true;
+  }
+  if (errorCode != ENOENT)
+  {
+    LogSink::errors(out) << "Error: Could not open directory \"" << dest_path << "\": Code "
+        << errorCode << " (" << strerror(errorCode) << ").\n";
+    return false;
+  }
+  // ENOENT: destination does not exist, skip silently
+  return true;
+}
+
+/* opens a subdirectory in the source and in the destination
+
+   parameters:
+       src_parent, dest_parent - the opened parent directories
+       name                    - name of the subdirectory
+       src_path, dest_path     - paths of the subdirectories, used for messages
+       src_sub, dest_sub       - handles that will be opened
+       skip                    - will be set to true, if the destination does
+                                 not exist or is no directory, i.e. if there
+                                 is nothing to do for the directory content
+       out                     - stream for messages
+
+   return value:
+       Returns true in case of success, or false if an error occurred.
+*/
+static bool open_subdirectories(const DirectoryHandle& src_parent, const DirectoryHandle& dest_parent, const char * name, const std::string& src_path, const std::string& dest_path, DirectoryHandle& src_sub, DirectoryHandle& dest_sub, bool& skip, std::ostream& out, const bool verbose, const bool dryRun)
+{
+  skip = false;
+  if (!src_sub.openAt(src_parent, name))
+  {
+    const int errorCode = errno;
+    LogSink::errors(out) << "Error: Could not open directory \"" << src_path << "\": Code "
+        << errorCode << " (" << strerror(errorCode) << ").\n";
+    return false;
+  }
+  if (!dest_sub.openAt(dest_parent, name))
+  {
+    skip = true;
+    return check_destination_open_error(errno, dest_path, out, verbose, dryRun);
+  }
+  return true;
+}
+
+/* sequential part of copy_stats_recursive(): walks both trees iteratively
+
+   parameters:
+       src, dest           - stacks whose root is the opened source and
+                             destination directory
+       src_path, dest_path - paths of those directories, used for messages.
+                             Will be extended temporarily for each entry.
+       reader              - reader for the source directories, its buffer is
+                             shared by all directories
+       engine              - engine for the status queries, shared by all
+                             directories
+
+   Only the names of subdirectories that still have to be visited are kept
+   for each level, and the stacks limit the number of open directories.
+*/
+static bool copy_stats_iterative(DirectoryStack& src, DirectoryStack& dest, std::string& src_path, std::string& dest_path, DirectoryReader& reader, StatEngine& engine, const bool permissions, const bool ownership, const bool verbose, const bool dryRun)
+{
+  /* level of the walk - the names of the subdirectories are null-terminated
+     and handled after the directory has been read completely, because the
+     reader's buffer will be reused */
+  struct Level
+  {
+    std::string subDirectories;
+    std::string::size_type next; /* offset of the next subdirectory */
+    std::string::size_type src_length; /* length of src_path for this level */
+    std::string::size_type dest_length; /* length of dest_path for this level */
+  };
+  std::vector<Level> levels;
+  // filters match paths relative to the source directory
+  const std::string::size_type src_root_length = src_path.size();
+  bool newLevel = true;
+  while (true)
+  {
+    if (newLevel)
+    {
+      // read the directory on top of the stacks
+      const DirectoryHandle * src_dir = src.top();
+      const DirectoryHandle * dest_dir = (src_dir == NULL) ? NULL : dest.top();
+      if ((src_dir == NULL) or (dest_dir == NULL))
+      {
+        const int errorCode = errno;
+        LogSink::errors() << "Error: Could not open directory \"" << ((src_dir == NULL) ? src_path : dest_path) << "\": Code "
+                  << errorCode << " (" << strerror(errorCode) << ").\n";
+        return false;
+      }
+      levels.push_back(Level());
+      levels.back().next = 0;
+      levels.back().src_length = src_path.size();
+      levels.back().dest_length = dest_path.size();
+      if (!copy_directory_entries(*src_dir, *dest_dir, src_path, dest_path, src_root_length, reader, engine, levels.back().subDirectories, std::cout, permissions, ownership, verbose, dryRun))
+        return false;
+      newLevel = false;
+    }
+
+    Level& level = levels.back();
+    src_path.resize(level.src_length);
+    dest_path.resize(level.dest_length);
+    if (level.next >= level.subDirectories.size())
+    {
+      // directory is done, continue with its parent
+      levels.pop_back();
+      if (levels.empty())
+        return true;
+      src.pop();
+      dest.pop();
+      continue;
+    }
+
+    // handle next subdirectory
+    const char * name = level.subDirectories.c_str() + level.next;
+    level.next += std::strlen(name) + 1;
+    src_path.append(1, pathDelimiter).append(name);
+    dest_path.append(1, pathDelimiter).append(name);
+    if (!src.push(name))
+    {
+      const int errorCode = errno;
+      LogSink::errors() << "Error: Could not open directory \"" << src_path << "\": Code "
+                << errorCode << " (" << strerror(errorCode) << ").\n";
+      return false;
+    }
+    if (!dest.push(name))
+    {
+      const int errorCode = errno;
+      src.pop();
+      if (!check_destination_open_error(errorCode, dest_path, std::cout, verbose, dryRun))
+        return false;
+      continue;
+    }
+    newLevel = true;
+  } // while
+}
+
+namespace
+{
+  /* shared state of the workers of a parallel copy */
+  struct ParallelCopy
+  {
+    WorkStealingPool pool; /* pool that executes one task per directory */
+    std::vector<std::unique_ptr<DirectoryReader> > readers; /* one reader per worker */
+    std::vector<std::unique_ptr<StatEngine> > engines; /* one stat engine per worker */
+    std::mutex outputMutex; /* serializes the output of the tasks */
+    std::atomic<bool> failed; /* whether any task failed */
+    std::string::size_type srcRootLength; /* length of the path of the source directory */
+    bool permissions;
+    bool ownership;
+    bool verbose;
+    bool dryRun;
+
+    ParallelCopy(const unsigned int jobs, const std::string::size_type rootLength, const bool perm, const bool own, const bool verb, const bool dry)
+    : pool(jobs), readers(), engines(), outputMutex(), failed(false), srcRootLength(rootLength),
+      permissions(perm), ownership(own), verbose(verb), dryRun(dry)
+    {
+      for (unsigned int i = 0; i < pool.workers(); ++i)
+      {
+        readers.push_back(std::unique_ptr<DirectoryReader>(new DirectoryReader()));
+        engines.push_back(StatEngine::create());
+      }
+    }
+  };//struct
+
+  void copy_subdirectory_task(ParallelCopy& copy, const unsigned int worker,
+                              const std::shared_ptr<DirectoryHandle>& src_parent, const std::shared_ptr<DirectoryHandle>& dest_parent,
+                              const std::string& name, const std::string& src_path, const std::string& dest_path);
+
+  /* writes collected messages of a task and records failures */
+  void finish_task(ParallelCopy& copy, MessageBuffer& out, const bool success)
+  {
+    if (out.size() > 0)
+    {
+      std::lock_guard<std::mutex> lock(copy.outputMutex);
+      out.write(std::cout);
+    }
+    if (!success)
+    {
+      copy.failed = true;
+      copy.pool.stop();
+    }
+  }
+
+  /* task of the parallel copy: copies the stats of the entries of one opened
+     directory and submits one task per subdirectory */
+  void copy_directory_task(ParallelCopy& copy, const unsigned int worker,
+                           const std::shared_ptr<DirectoryHandle>& src_dir, const std::shared_ptr<DirectoryHandle>& dest_dir,
+                           std::string src_path, std::string dest_path)
+  {
+    // Messages are collected per directory, so that lines of different
+    // workers do not get mixed up.
+    MessageBuffer out;
+    std::string subDirectories;
+    const bool success = copy_directory_entries(*src_dir, *dest_dir, src_path, dest_path, copy.srcRootLength, *copy.readers[worker], *copy.engines[worker], subDirectories, out.messages(), copy.permissions, copy.ownership, copy.verbose, copy.dryRun);
+
+    // Subdirectories are opened by their own task, so that queued tasks only
+    // keep their parents open instead of one descriptor per task.
+    std::string::size_type start = 0;
+    while (success and (start < subDirectories.size()))
+    {
+      const std::string name(subDirectories.c_str() + start);
+      start += name.size() + 1;
+      const std::string src_sub_path = src_path + pathDelimiter + name;
+      const std::string dest_sub_path = dest_path + pathDelimiter + name;
+      copy.pool.submit(worker, [&copy, src_dir, dest_dir, name, src_sub_path, dest_sub_path] (const unsigned int w)
+        {
+          copy_subdirectory_task(copy, w, src_dir, dest_dir, name, src_sub_path, dest_sub_path);
+        });
+    } // while
+    finish_task(copy, out, success);
+  }
+
+  /* task of the parallel copy: opens a subdirectory and handles it */
+  void copy_subdirectory_task(ParallelCopy& copy, const unsigned int worker,
+                              const std::shared_ptr<DirectoryHandle>& src_parent, const std::shared_ptr<DirectoryHandle>& dest_parent,
+                              const std::string& name, const std::string& src_path, const std::string& dest_path)
+  {
+    std::shared_ptr<DirectoryHandle> src_sub = std::make_shared<DirectoryHandle>();
+    std::shared_ptr<DirectoryHandle> dest_sub = std::make_shared<DirectoryHandle>();
+    MessageBuffer out;
+    bool skip = false;
+    const bool success = open_subdirectories(*src_parent, *dest_parent, name.c_str(), src_path, dest_path, *src_sub, *dest_sub, skip, out.messages(), copy.verbose, copy.dryRun);
+    finish_task(copy, out, success);
+    if (success and !skip)
+      copy_directory_task(copy, worker, src_sub, dest_sub, src_path, dest_path);
+  }
+} //namespace
+
+/* reports that the source or destination directory given by the user could
+   not be opened, returns the result for copy_stats_recursive() */
+static bool report_root_open_error(const bool source, const std::string& path, const int errorCode)
+{
+  // destination does not exist, so there is nothing to change
+  if (!source and (errorCode == ENOENT))
+    return true;
+  LogSink::errors() << "Error: Could not open " << (source ? "source" : "destination") << " directory \""
+            << path << "\": Code " << errorCode << " (" << strerror(errorCode) << ").\n";
+  return false;
+}
+
+bool copy_stats_recursive(const std::string& src_dir, const std::string& dest_dir, const bool permissions, const bool ownership, const bool verbose, const bool dryRun, const unsigned int jobs)
+{
+  if (jobs <= 1)
+  {
+    // both walks share the limit of open files
+    DirectoryStack src(DirectoryStack::maxOpenFor(2));
+    if (!src.open(src_dir) or !MountBoundary::shared().setRoot(*src.top()))
+      return report_root_open_error(true, src_dir, errno);
+    DirectoryStack dest(DirectoryStack::maxOpenFor(2));
+    if (!dest.open(dest_dir))
+      return report_root_open_error(false, dest_dir, errno);
+    std::string src_path(src_dir);
+    std::string dest_path(dest_dir);
+    DirectoryReader reader;
+    std::unique_ptr<StatEngine> engine = StatEngine::create();
+    return copy_stats_iterative(src, dest, src_path, dest_path, reader, *engine, permissions, ownership, verbose, dryRun);
+  }
+
+  std::shared_ptr<DirectoryHandle> src = std::make_shared<DirectoryHandle>();
+  if (!src->open(src_dir) or !MountBoundary::shared().setRoot(*src))
+    return report_root_open_error(true, src_dir, errno);
+  std::shared_ptr<DirectoryHandle> dest = std::make_shared<DirectoryHandle>();
+  if (!dest->open(dest_dir))
+    return report_root_open_error(false, dest_dir, errno);
+  ParallelCopy copy(jobs, src_dir.size(), permissions, ownership, verbose, dryRun);
+  copy.pool.submit(0, [&copy, src, dest, src_dir, dest_dir] (const unsigned int worker)
+    {
+      copy_directory_task(copy, worker, src, dest, src_dir, dest_dir);
+    });
+  copy.pool.run();
+  return !copy.failed;
+}
+
 bool fileExists(const std::string& fileName)
 {
   return access(fileName.c_str(), F_OK) == 0;
@@ -21,9 +21,12 @@
 #ifndef FILEUTILITIES_HPP
 #define FILEUTILITIES_HPP
 
+#include <ostream>
 #include <string>
+#include <utility>
 #include <vector>
 #include <sys/stat.h>
+#include "DirectoryHandle.hpp"
 
 #if defined(_WIN32)
   const char pathDelimiter = '\\';
@@ -33,10 +36,29 @@
   #error "Unknown operating system!"
 #endif
 
+/* structure for the status information of a file that is used by the programme,
+   i.e. a compact subset of struct stat */
+struct FileStatus {
+    mode_t mode;    /* file type and permissions */
+    uid_t userID;   /* user ID of owner */
+    gid_t groupID;  /* group ID of owner */
+    dev_t device;   /* ID of the device that contains the file */
+    ino_t inode;    /* inode number */
+    nlink_t linkCount; /* number of hard links */
+
+    /* constructor */
+    FileStatus();
+
+    /* constructor - takes the relevant data from statbuf */
+    explicit FileStatus(const struct stat& statbuf);
+};//struct
+
 /* structure for file list entries */
 struct FileEntry {
     std::string fileName;
     bool isDirectory;
+    bool hasStatus;    /* whether status contains the data of the entry */
+    FileStatus status; /* status of the entry (only valid, if hasStatus is true) */
 
     /* constructor */
     FileEntry();
@@ -45,6 +67,25 @@ struct FileEntry {
 /* returns a list of all files in the given directory as a vector */
 std::vector<FileEntry> getDirectoryFileList(const std::string& Directory);
 
+/* returns a list of all files in the given opened directory as a vector
+
+   parameters:
+       directory   - the opened directory
+       withStatus  - If set to true, the status of each entry is queried and
+                     stored in FileEntry::status. If set to false, the type
+                     reported by the directory itself is used where possible,
+                     and the entries have no status (hasStatus is false).
+*/
+std::vector<FileEntry> getDirectoryFileList(const DirectoryHandle& directory, const bool withStatus = true);
+
+/* returns true, if the directory entry type (DT_*) is a socket, pipe, block
+   device or char device, which we don't want */
+bool isUnwantedType(const unsigned char type);
+
+/* returns true, if the file mode denotes a socket, pipe, block device or char
+   device, which we don't want */
+bool isUnwantedMode(const mode_t mode);
+
 
 /** \brief transforms user ID and group ID into names
  *
@@ -56,6 +97,105 @@ std::string getHumanReadableOwnership(const uid_t userID, const gid_t groupID);
 
 std::string getHumanReadableOwnership(const struct stat& statbuf);
 
+std::string getHumanReadableOwnership(const FileStatus& status);
+
+
+/** \brief writes the message about a change of the permissions of a file
+ *
+ * \param out     stream for the message
+ * \param path    path of the file
+ * \param from    current mode of the file
+ * \param to      new mode of the file
+ * \param dryRun  whether the change is only shown
+ * \remarks Dry runs print this for every file, so the message is written
+ *          without temporary strings and without the number formatting of
+ *          the stream.
+ */
+void writeModeChange(std::ostream& out, const std::string& path, const mode_t from, const mode_t to, const bool dryRun);
+
+
+/** \brief writes the message about a change of the owner of a file, see writeModeChange()
+ *
+ * \param out        stream for the message
+ * \param path       path of the file
+ * \param fromUser   current user ID of the file
+ * \param fromGroup  current group ID of the file
+ * \param toUser     new user ID of the file
+ * \param toGroup    new group ID of the file
+ * \param dryRun     whether the change is only shown
+ */
+void writeOwnershipChange(std::ostream& out, const std::string& path, const uid_t fromUser, const gid_t fromGroup,
+                          const uid_t toUser, const gid_t toGroup, const bool dryRun);
+
+
+/** \brief gets the name of a user, thread-safe
+ *
+ * \param userID  the user ID
+ * \param name    variable that will hold the user name
+ * \return Returns true, if the user exists. Returns false otherwise.
+ */
+bool getUserName(const uid_t userID, std::string& name);
+
+
+/** \brief gets the name of a group, thread-safe
+ *
+ * \param groupID  the group ID
+ * \param name     variable that will hold the group name
+ * \return Returns true, if the group exists. Returns false otherwise.
+ */
+bool getGroupName(const gid_t groupID, std::string& name);
+
+
+/** \brief gets the ID of a user, thread-safe
+ *
+ * \param name    the user name
+ * \param userID  variable that will hold the user ID
+ * \return Returns true, if the user exists. Returns false otherwise.
+ */
+bool getUserID(const std::string& name, uid_t& userID);
+
+
+/** \brief gets the ID of a group, thread-safe
+ *
+ * \param name     the group name
+ * \param groupID  variable that will hold the group ID
+ * \return Returns true, if the group exists. Returns false otherwise.
+ */
+bool getGroupID(const std::string& name, gid_t& groupID);
+
+
+/* list of IDs and their names, see listUsers() and listGroups() */
+typedef std::vector<std::pair<unsigned int, std::string> > IDNameList;
+
+
+/** \brief lists all users of the user database, not thread-safe
+ *
+ * \param users  list that will hold the ID and name of every user in the order
+ *               of the database, so a name may be listed twice
+ * \remarks Some directory services (e.g. SSSD without enumerate = true) do
+ *          not list all of their users.
+ */
+void listUsers(IDNameList& users);
+
+
+/** \brief lists all groups of the group database, not thread-safe
+ *
+ * \param groups  list that will hold the ID and name of every group, see listUsers()
+ */
+void listGroups(IDNameList& groups);
+
+
+/** \brief reads the users or groups of a file in the format of /etc/passwd or /etc/group
+ *
+ * \param fileName  name of the file, e.g. the /etc/passwd of a container image
+ * \param entries   list that will hold the ID and name of every entry, see listUsers()
+ * \return Returns true, if the file could be read. Returns false otherwise,
+ *         e.g. if a line has no valid ID.
+ * \remarks Both formats start with "name:password:ID:", so one function reads both.
+ *          Empty lines, comments and NIS entries (+ or -) are skipped.
+ */
+bool readIDNameFile(const std::string& fileName, IDNameList& entries);
+
 /* copies file permissions and/or ownership from file src_path to dest_path without copying the file itself
 
    parameters:
@@ -71,7 +211,22 @@ std::string getHumanReadableOwnership(const struct stat& statbuf);
 */
 bool copy_file_stats(const std::string& src_path, const std::string& dest_path, const bool permissions, const bool ownership, const bool verbose, const bool dryRun);
 
-bool copy_stats_recursive(const std::string& src_dir, const std::string& dest_dir, const bool permissions, const bool ownership, const bool verbose, const bool dryRun);
+/* copies file permissions and/or ownership of all files in src_dir and its subdirectories
+   to the files with the same relative path in dest_dir
+
+   parameters:
+       src_dir     - the source directory
+       dest_dir    - the destination directory
+       permissions, ownership, verbose, dryRun - see copy_file_stats()
+       jobs        - number of threads that handle directories in parallel.
+                     With one job, directories are handled sequentially.
+                     With more jobs, messages of different directories may
+                     appear in a different order.
+
+   return value:
+       Returns true in case of success, or false if an error occurred.
+*/
+bool copy_stats_recursive(const std::string& src_dir, const std::string& dest_dir, const bool permissions, const bool ownership, const bool verbose, const bool dryRun, const unsigned int jobs = 1);
 
 /** \brief checks for existence of file @fileName
  *
@@ -0,0 +1,169 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+
+#ifndef FLATNAMEMAP_HPP
+#define FLATNAMEMAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+/** \brief maps names to values in a hash table with open addressing
+ *
+ * All entries are stored in one array and collisions are resolved by linear
+ * probing, so a lookup usually touches a single slot instead of following
+ * the pointers of a tree or of the buckets of std::unordered_map. Names can
+ * be looked up without constructing a std::string. Entries are never
+ * removed, the table grows when it is half full.
+ */
+template<typename Value>
+class FlatNameMap
+{
+  public:
+    /** \brief constructor - empty map */
+    FlatNameMap()
+    : mSlots(),
+      mSize(0)
+    {
+    }
+
+
+    /** \brief finds a name
+     *
+     * \param name    the name
+     * \param length  length of the name in bytes
+     * \return Returns a pointer to the value of the name, if it is in the map.
+     *         Returns NULL otherwise. The pointer is valid until the next
+     *         call of insert().
+     */
+    const Value * find(const char * name, const std::size_t length) const
+    {
+      if (mSlots.empty())
+        return NULL;
+      const std::uint64_t hashValue = hash(name, length);
+      const std::size_t mask = mSlots.size() - 1;
+      for (std::size_t i = hashValue & mask; mSlots[i].used; i = (i + 1) & mask)
+      {
+        const Slot& slot = mSlots[i];
+        if ((slot.hash == hashValue) && (slot.name.size() == length)
+            && (std::memcmp(slot.name.data(), name, length) == 0))
+          return &slot.value;
+      } // for
+      return NULL;
+    }
+
+
+    /** \brief finds a name, see above */
+    const Value * find(const std::string& name) const
+    {
+      return find(name.data(), name.size());
+    }
+
+
+    /** \brief adds a name, if it is not in the map yet
+     *
+     * \param name   the name
+     * \param value  the value of the name
+     * \return Returns true, if the name was added. Returns false, if the map
+     *         already had a value for the name. That value is kept.
+     */
+    bool insert(const std::string& name, const Value& value)
+    {
+      if (2 * (mSize + 1) > mSlots.size())
+        grow();
+      const std::uint64_t hashValue = hash(name.data(), name.size());
+      const std::size_t mask = mSlots.size() - 1;
+      std::size_t i = hashValue & mask;
+      for ( ; mSlots[i].used; i = (i + 1) & mask)
+      {
+        const Slot& slot = mSlots[i];
+        if ((slot.hash == hashValue) && (slot.name == name))
+          return false;
+      } // for
+      Slot& slot = mSlots[i];
+      slot.used = true;
+      slot.hash = hashValue;
+      slot.name = name;
+      slot.value = value;
+      ++mSize;
+      return true;
+    }
+
+
+    /** \brief gets the number of names in the map */
+    std::size_t size() const
+    {
+      return mSize;
+    }
+  private:
+    /* entry of the table */
+    struct Slot {
+        bool used; /* whether the slot holds a name */
+        std::uint64_t hash; /* hash of the name */
+        std::string name; /* the name */
+        Value value; /* value of the name */
+
+        /* constructor - unused slot */
+        Slot()
+        : used(false), hash(0), name(), value()
+        {
+        }
+    };//struct
+
+    std::vector<Slot> mSlots; /**< the table, its size is a power of two */
+    std::size_t mSize; /**< number of used slots */
+
+    /** \brief FNV-1a hash of a name */
+    static std::uint64_t hash(const char * name, const std::size_t length)
+    {
+      std::uint64_t result = 14695981039346656037ULL;
+      for (std::size_t i = 0; i < length; ++i)
+      {
+        result ^= static_cast<unsigned char>(name[i]);
+        result *= 1099511628211ULL;
+      } // for
+      return result;
+    }
+
+    /** \brief doubles the size of the table and moves all entries */
+    void grow()
+    {
+      std::vector<Slot> old(mSlots.empty() ? 16 : 2 * mSlots.size());
+      old.swap(mSlots);
+      const std::size_t mask = mSlots.size() - 1;
+      for (Slot& slot : old)
+      {
+        if (!slot.used)
+          continue;
+        std::size_t i = slot.hash & mask;
+        while (mSlots[i].used)
+          i = (i + 1) & mask;
+        mSlots[i].used = true;
+        mSlots[i].hash = slot.hash;
+        mSlots[i].name.swap(slot.name);
+        mSlots[i].value = slot.value;
+      } // for
+    }
+}; //class
+
+#endif // FLATNAMEMAP_HPP
@@ -0,0 +1,92 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include "IDMapping.hpp"
+#include <algorithm>
+#include <limits>
+#include "AuxiliaryFunctions.hpp"
+
+IDMapping::IDMapping()
+: mUsers(),
+  mGroups()
+{
+}
+
+bool IDMapping::addUserRange(const std::string& range)
+{
+  return add(range, mUsers);
+}
+
+bool IDMapping::addGroupRange(const std::string& range)
+{
+  return add(range, mGroups);
+}
+
+bool IDMapping::empty() const
+{
+  return mUsers.empty() and mGroups.empty();
+}
+
+bool IDMapping::add(const std::string& text, std::vector<Range>& ranges)
+{
+  const std::string::size_type firstColon = text.find(':');
+  if (firstColon == std::string::npos)
+    return false;
+  const std::string::size_type secondColon = text.find(':', firstColon + 1);
+  if (secondColon == std::string::npos)
+    return false;
+  Range range;
+  if (!stringToUint(text.substr(0, firstColon), range.first)
+      or !stringToUint(text.substr(firstColon + 1, secondColon - firstColon - 1), range.target)
+      or !stringToUint(text.substr(secondColon + 1), range.count)
+      or (range.count == 0))
+    return false;
+  // The last ID is reserved, chown() treats it as "do not change".
+  const unsigned int last = std::numeric_limits<unsigned int>::max();
+  if ((range.count - 1 >= last - range.first) or (range.count - 1 >= last - range.target))
+    return false;
+  const std::vector<Range>::iterator next = std::upper_bound(ranges.begin(), ranges.end(), range,
+      [] (const Range& a, const Range& b) { return a.first < b.first; });
+  if ((next != ranges.end()) and (range.first + (range.count - 1) >= next->first))
+    return false;
+  if ((next != ranges.begin()) and ((next - 1)->first + ((next - 1)->count - 1) >= range.first))
+    return false;
+  ranges.insert(next, range);
+  return true;
+}
+
+unsigned int IDMapping::map(const std::vector<Range>& ranges, const unsigned int id)
+{
+  // last range that starts at or before the ID
+  std::vector<Range>::const_iterator range = std::upper_bound(ranges.begin(), ranges.end(), id,
+      [] (const unsigned int value, const Range& candidate) { return value < candidate.first; });
+  if (range == ranges.begin())
+    return id;
+  --range;
+  if (id - range->first >= range->count)
+    return id;
+  return range->target + (id - range->first);
+}
+
+IDMapping& IDMapping::shared()
+{
+  static IDMapping instance;
+  return instance;
+}
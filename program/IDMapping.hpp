@@ -0,0 +1,103 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+
+#ifndef IDMAPPING_HPP
+#define IDMAPPING_HPP
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+
+/** \brief maps ranges of user IDs and group IDs to other ranges
+ *
+ * This is used to restore or copy ownership into trees that belong to a user
+ * namespace, where e.g. the IDs 0 to 65535 of the container are 100000 to
+ * 165535 on the host. IDs outside of all ranges are not changed.
+ */
+class IDMapping
+{
+  public:
+    /** \brief constructor - no ranges, i.e. all IDs are kept */
+    IDMapping();
+
+
+    /** \brief adds a range of user IDs
+     *
+     * \param range  the range as "FIRST:TARGET:COUNT", i.e. COUNT IDs
+     *               starting with FIRST are mapped to the IDs starting with
+     *               TARGET, like in /etc/subuid or uid_map
+     * \return Returns true, if the range was added. Returns false, if the
+     *         text is not a valid range or if it overlaps another range.
+     */
+    bool addUserRange(const std::string& range);
+
+
+    /** \brief adds a range of group IDs, see addUserRange() */
+    bool addGroupRange(const std::string& range);
+
+
+    /** \brief checks whether any ranges are set */
+    bool empty() const;
+
+
+    /** \brief gets the mapped ID of a user ID */
+    uid_t mapUser(const uid_t userID) const
+    {
+      return mUsers.empty() ? userID : map(mUsers, userID);
+    }
+
+
+    /** \brief gets the mapped ID of a group ID */
+    gid_t mapGroup(const gid_t groupID) const
+    {
+      return mGroups.empty() ? groupID : map(mGroups, groupID);
+    }
+
+
+    /** \brief gets the mapping that is used by all parts of the program
+     *
+     * \remarks The ranges have to be set before any threads use the mapping.
+     */
+    static IDMapping& shared();
+  private:
+    /* range of IDs that are mapped */
+    struct Range {
+        unsigned int first; /* first ID of the range */
+        unsigned int target; /* ID that first is mapped to */
+        unsigned int count; /* number of IDs in the range */
+    };//struct
+
+    std::vector<Range> mUsers; /**< ranges of user IDs, sorted by first ID */
+    std::vector<Range> mGroups; /**< ranges of group IDs, sorted by first ID */
+
+    /** \brief parses a range and adds it to a list of ranges
+     *
+     * \param text    the range as "FIRST:TARGET:COUNT"
+     * \param ranges  mUsers or mGroups
+     * \return Returns true, if the range was added. Returns false otherwise.
+     */
+    static bool add(const std::string& text, std::vector<Range>& ranges);
+
+    /** \brief maps an ID with a non-empty list of ranges */
+    static unsigned int map(const std::vector<Range>& ranges, const unsigned int id);
+}; //class
+
+#endif // IDMAPPING_HPP
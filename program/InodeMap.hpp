@@ -0,0 +1,135 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+
+#ifndef INODEMAP_HPP
+#define INODEMAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** \brief maps inodes, i.e. pairs of device and inode number, to values
+ *
+ * Like FlatNameMap, all entries are stored in one array with open addressing
+ * and linear probing. Trees with many hard links have one entry per inode,
+ * so a slot only holds the two numbers and the value. Entries are never
+ * removed, the table grows when it is half full.
+ */
+template<typename Value>
+class InodeMap
+{
+  public:
+    /** \brief constructor - empty map */
+    InodeMap()
+    : mSlots(),
+      mSize(0)
+    {
+    }
+
+
+    /** \brief finds an inode and adds it, if it is not in the map yet
+     *
+     * \param device    ID of the device that contains the inode
+     * \param inode     the inode number
+     * \param value     value of the inode, if it has to be added
+     * \param inserted  will be set to true, if the inode was added, or to
+     *                  false, if it was in the map already
+     * \return Returns the value of the inode in the map. The reference is
+     *         valid until the next call of insert().
+     */
+    Value& insert(const std::uint64_t device, const std::uint64_t inode, const Value& value, bool& inserted)
+    {
+      if (2 * (mSize + 1) > mSlots.size())
+        grow();
+      const std::size_t mask = mSlots.size() - 1;
+      std::size_t i = hash(device, inode) & mask;
+      for ( ; mSlots[i].used; i = (i + 1) & mask)
+      {
+        if ((mSlots[i].inode == inode) && (mSlots[i].device == device))
+        {
+          inserted = false;
+          return mSlots[i].value;
+        }
+      } // for
+      Slot& slot = mSlots[i];
+      slot.used = true;
+      slot.device = device;
+      slot.inode = inode;
+      slot.value = value;
+      ++mSize;
+      inserted = true;
+      return slot.value;
+    }
+
+
+    /** \brief gets the number of inodes in the map */
+    std::size_t size() const
+    {
+      return mSize;
+    }
+  private:
+    /* entry of the table */
+    struct Slot {
+        std::uint64_t device; /* ID of the device */
+        std::uint64_t inode; /* inode number */
+        Value value; /* value of the inode */
+        bool used; /* whether the slot holds an inode */
+
+        /* constructor - unused slot */
+        Slot()
+        : device(0), inode(0), value(), used(false)
+        {
+        }
+    };//struct
+
+    std::vector<Slot> mSlots; /**< the table, its size is a power of two */
+    std::size_t mSize; /**< number of used slots */
+
+    /** \brief mixes device and inode number, so that consecutive inode
+     *         numbers do not end up in consecutive slots */
+    static std::uint64_t hash(const std::uint64_t device, const std::uint64_t inode)
+    {
+      std::uint64_t result = inode ^ (device * 0x9E3779B97F4A7C15ULL);
+      result ^= result >> 33;
+      result *= 0xFF51AFD7ED558CCDULL;
+      result ^= result >> 33;
+      return result;
+    }
+
+    /** \brief doubles the size of the table and moves all entries */
+    void grow()
+    {
+      std::vector<Slot> old(mSlots.empty() ? 64 : 2 * mSlots.size());
+      old.swap(mSlots);
+      const std::size_t mask = mSlots.size() - 1;
+      for (const Slot& slot : old)
+      {
+        if (!slot.used)
+          continue;
+        std::size_t i = hash(slot.device, slot.inode) & mask;
+        while (mSlots[i].used)
+          i = (i + 1) & mask;
+        mSlots[i] = slot;
+      } // for
+    }
+}; //class
+
+#endif // INODEMAP_HPP
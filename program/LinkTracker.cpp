@@ -0,0 +1,64 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include "LinkTracker.hpp"
+
+LinkTracker::LinkTracker()
+: mMutex(),
+  mInodes(),
+  mSkipped(0)
+{
+}
+
+bool LinkTracker::alreadyApplied(const struct stat& status, const mode_t mode, const uid_t userID, const gid_t groupID)
+{
+  if (S_ISDIR(status.st_mode) or (status.st_nlink < 2))
+    return false;
+  Applied applied;
+  applied.mode = mode;
+  applied.userID = userID;
+  applied.groupID = groupID;
+  std::lock_guard<std::mutex> lock(mMutex);
+  bool inserted = false;
+  Applied& previous = mInodes.insert(status.st_dev, status.st_ino, applied, inserted);
+  if (inserted)
+    return false;
+  if ((previous.mode == mode) and (previous.userID == userID) and (previous.groupID == groupID))
+  {
+    ++mSkipped;
+    return true;
+  }
+  // Links of the inode shall get different stats, so the last one wins like
+  // without tracking.
+  previous = applied;
+  return false;
+}
+
+unsigned long long LinkTracker::skipped()
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mSkipped;
+}
+
+LinkTracker& LinkTracker::shared()
+{
+  static LinkTracker instance;
+  return instance;
+}
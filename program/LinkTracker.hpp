@@ -0,0 +1,81 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+
+#ifndef LINKTRACKER_HPP
+#define LINKTRACKER_HPP
+
+#include <mutex>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "InodeMap.hpp"
+
+/** \brief remembers which stats the inodes with several hard links got
+ *
+ * Each link of an inode is a separate directory entry, so without this the
+ * same inode is compared and changed once per link. Directories are never
+ * tracked, their link count only reflects their subdirectories.
+ *
+ * All functions are thread-safe.
+ */
+class LinkTracker
+{
+  public:
+    /** \brief constructor - no inodes */
+    LinkTracker();
+
+
+    /** \brief checks whether an entry is a link of an inode that already got the same stats
+     *
+     * \param status   current status of the entry
+     * \param mode     the mode that the entry shall get
+     * \param userID   the user ID that the entry shall get
+     * \param groupID  the group ID that the entry shall get
+     * \return Returns true, if another link of the inode got the same stats
+     *         before, so the entry can be skipped. Returns false, if the
+     *         stats have to be applied. The stats are remembered in that case.
+     */
+    bool alreadyApplied(const struct stat& status, const mode_t mode, const uid_t userID, const gid_t groupID);
+
+
+    /** \brief gets the number of entries that alreadyApplied() allowed to skip */
+    unsigned long long skipped();
+
+
+    /** \brief gets the tracker that is shared by all parts of the program */
+    static LinkTracker& shared();
+  private:
+    /* stats that an inode got */
+    struct Applied {
+        mode_t mode;
+        uid_t userID;
+        gid_t groupID;
+    };//struct
+
+    std::mutex mMutex; /**< protects the map and the counter */
+    InodeMap<Applied> mInodes; /**< inode -> stats that it got */
+    unsigned long long mSkipped; /**< number of skipped entries */
+
+    // not copyable
+    LinkTracker(const LinkTracker& other) = delete;
+    LinkTracker& operator=(const LinkTracker& other) = delete;
+}; //class
+
+#endif // LINKTRACKER_HPP
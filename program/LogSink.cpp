@@ -0,0 +1,258 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include "LogSink.hpp"
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <unistd.h>
+
+/* sink that errors() refers to, only changed while no other threads run */
+static LogSink * activeSink = NULL;
+
+LogSink::ErrorBuffer::ErrorBuffer(LogSink& sink)
+: std::streambuf(),
+  mSink(sink)
+{
+}
+
+LogSink::ErrorBuffer::int_type LogSink::ErrorBuffer::overflow(int_type c)
+{
+  if (traits_type::eq_int_type(c, traits_type::eof()))
+    return traits_type::not_eof(c);
+  const char character = traits_type::to_char_type(c);
+  xsputn(&character, 1);
+  return c;
+}
+
+std::streamsize LogSink::ErrorBuffer::xsputn(const char * s, std::streamsize count)
+{
+  // keep the order of messages and errors
+  mSink.sync();
+  mSink.writeAll(s, count);
+  return count;
+}
+
+LogSink::LogSink(std::ostream& stream, const int fd, const bool background)
+: std::streambuf(),
+  mStream(stream),
+  mPrevious(NULL),
+  mPreviousActive(activeSink),
+  mFd(fd),
+  mFailed(false),
+  mActive(cBufferSize),
+  mPending(background ? cBufferSize : 0),
+  mPendingSize(0),
+  mWriting(false),
+  mStop(false),
+  mMutex(),
+  mChanged(),
+  mWriter(),
+  mErrorBuffer(*this),
+  mErrors(&mErrorBuffer)
+{
+  // messages that were written before still wait in the C library
+  mStream.flush();
+  std::fflush(stdout);
+  setp(mActive.data(), mActive.data() + mActive.size());
+  if (background)
+    mWriter = std::thread(&LogSink::writerLoop, this);
+  mPrevious = mStream.rdbuf(this);
+  activeSink = this;
+}
+
+LogSink::~LogSink()
+{
+  sync();
+  if (mWriter.joinable())
+  {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mStop = true;
+    }
+    mChanged.notify_all();
+    mWriter.join();
+  }
+  mStream.rdbuf(mPrevious);
+  activeSink = mPreviousActive;
+}
+
+std::ostream& LogSink::errors()
+{
+  return (activeSink != NULL) ? activeSink->mErrors : std::cout;
+}
+
+std::ostream& LogSink::errors(std::ostream& out)
+{
+  const MessageBuffer::PartBuffer * part = dynamic_cast<const MessageBuffer::PartBuffer*>(out.rdbuf());
+  if (part != NULL)
+  {
+    // errors of collected messages are collected, too
+    return part->mOwner.mErrors;
+  }
+  return errors();
+}
+
+LogSink::int_type LogSink::overflow(int_type c)
+{
+  handOff();
+  if (!traits_type::eq_int_type(c, traits_type::eof()))
+  {
+    *pptr() = traits_type::to_char_type(c);
+    pbump(1);
+  }
+  return traits_type::not_eof(c);
+}
+
+int LogSink::sync()
+{
+  handOff();
+  if (mWriter.joinable())
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mChanged.wait(lock, [this] { return !mWriting; });
+  }
+  return 0;
+}
+
+void LogSink::handOff()
+{
+  const std::size_t size = pptr() - pbase();
+  if (size == 0)
+    return;
+  if (!mWriter.joinable())
+    writeAll(mActive.data(), size);
+  else
+  {
+    // The writer has to finish the previous buffer first, so the memory
+    // stays bounded when messages are produced faster than written.
+    std::unique_lock<std::mutex> lock(mMutex);
+    mChanged.wait(lock, [this] { return !mWriting; });
+    mActive.swap(mPending);
+    mPendingSize = size;
+    mWriting = true;
+    lock.unlock();
+    mChanged.notify_all();
+  }
+  setp(mActive.data(), mActive.data() + mActive.size());
+}
+
+void LogSink::writeAll(const char * data, std::size_t size)
+{
+  while ((size > 0) and !mFailed)
+  {
+    const ssize_t written = write(mFd, data, size);
+    if (written > 0)
+    {
+      data += written;
+      size -= written;
+    }
+    else if ((written < 0) and (errno != EINTR))
+      mFailed = true;
+  } // while
+}
+
+void LogSink::writerLoop()
+{
+  std::unique_lock<std::mutex> lock(mMutex);
+  while (true)
+  {
+    mChanged.wait(lock, [this] { return mWriting or mStop; });
+    if (mWriting)
+    {
+      lock.unlock();
+      writeAll(mPending.data(), mPendingSize);
+      lock.lock();
+      mWriting = false;
+      mChanged.notify_all();
+    }
+    else
+      return;
+  } // while
+}
+
+
+MessageBuffer::PartBuffer::PartBuffer(MessageBuffer& owner, const bool error)
+: std::streambuf(),
+  mOwner(owner),
+  mError(error)
+{
+}
+
+MessageBuffer::PartBuffer::int_type MessageBuffer::PartBuffer::overflow(int_type c)
+{
+  if (traits_type::eq_int_type(c, traits_type::eof()))
+    return traits_type::not_eof(c);
+  const char character = traits_type::to_char_type(c);
+  mOwner.append(mError, &character, 1);
+  return c;
+}
+
+std::streamsize MessageBuffer::PartBuffer::xsputn(const char * s, std::streamsize count)
+{
+  mOwner.append(mError, s, count);
+  return count;
+}
+
+MessageBuffer::MessageBuffer()
+: mParts(),
+  mSize(0),
+  mMessageBuffer(*this, false),
+  mErrorBuffer(*this, true),
+  mMessages(&mMessageBuffer),
+  mErrors(&mErrorBuffer)
+{
+}
+
+std::ostream& MessageBuffer::messages()
+{
+  return mMessages;
+}
+
+std::ostream& MessageBuffer::errors()
+{
+  return mErrors;
+}
+
+std::size_t MessageBuffer::size() const
+{
+  return mSize;
+}
+
+void MessageBuffer::write(std::ostream& out)
+{
+  for (const std::pair<bool, std::string>& part : mParts)
+  {
+    if (part.first)
+      LogSink::errors() << part.second;
+    else
+      out << part.second;
+  } // for
+  mParts.clear();
+  mSize = 0;
+}
+
+void MessageBuffer::append(const bool error, const char * data, const std::size_t size)
+{
+  if (mParts.empty() or (mParts.back().first != error))
+    mParts.push_back(std::make_pair(error, std::string()));
+  mParts.back().second.append(data, size);
+  mSize += size;
+}
@@ -0,0 +1,201 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef LOGSINK_HPP
+#define LOGSINK_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/** \brief buffered sink for the messages of a run
+ *
+ * The constructor redirects a stream (usually std::cout) into the sink, so
+ * messages are formatted into a large buffer instead of being passed to the
+ * C library piece by piece. Full buffers are written by a background thread
+ * while the next one is filled, so a run only waits for the terminal or
+ * pipe when it produces messages faster than they can be written.
+ *
+ * Errors have a separate channel, see errors(). It is not buffered: all
+ * messages that were written before are written first, then the error.
+ *
+ * Like any stream buffer, the sink must not be used by several threads at
+ * once. Parallel parts of the program collect their messages in a
+ * MessageBuffer and write them under a mutex.
+ */
+class LogSink : public std::streambuf
+{
+  public:
+    /** \brief size of the buffers in bytes */
+    static const std::size_t cBufferSize = 1024 * 1024;
+
+
+    /** \brief constructor - redirects a stream into the sink
+     *
+     * \param stream      the stream, e.g. std::cout. Its previous stream
+     *                    buffer is restored by the destructor.
+     * \param fd          file descriptor that the messages are written to
+     * \param background  whether full buffers are written by a background
+     *                    thread (true) or by the thread that fills them (false)
+     */
+    LogSink(std::ostream& stream, const int fd, const bool background = true);
+
+
+    /** \brief destructor - writes all messages and restores the stream */
+    ~LogSink();
+
+
+    /** \brief gets the stream for error messages
+     *
+     * \return Returns the unbuffered error channel of the active sink.
+     *         Returns std::cout, if there is none.
+     */
+    static std::ostream& errors();
+
+
+    /** \brief gets the stream for error messages that belong to other messages
+     *
+     * \param out  the stream that gets the other messages
+     * \return Returns the error part of a MessageBuffer, if out is the message
+     *         part of it. Returns errors() otherwise.
+     */
+    static std::ostream& errors(std::ostream& out);
+  protected:
+    /** \brief hands the full buffer to the writer and starts a new one */
+    int_type overflow(int_type c) override;
+
+
+    /** \brief writes all messages so far and waits until they are written */
+    int sync() override;
+  private:
+    /* unbuffered stream buffer of the error channel */
+    class ErrorBuffer : public std::streambuf
+    {
+      public:
+        explicit ErrorBuffer(LogSink& sink);
+      protected:
+        int_type overflow(int_type c) override;
+        std::streamsize xsputn(const char * s, std::streamsize count) override;
+      private:
+        LogSink& mSink; /**< sink whose messages are written first */
+    }; //class
+
+    std::ostream& mStream; /**< the redirected stream */
+    std::streambuf * mPrevious; /**< previous stream buffer of mStream */
+    LogSink * mPreviousActive; /**< sink that was active before this one */
+    int mFd; /**< file descriptor for the output */
+    bool mFailed; /**< whether writing failed, e.g. because a pipe was closed */
+    std::vector<char> mActive; /**< buffer that is filled */
+    std::vector<char> mPending; /**< buffer that is written by the writer thread */
+    std::size_t mPendingSize; /**< number of bytes in mPending */
+    bool mWriting; /**< whether mPending still has to be written */
+    bool mStop; /**< whether the writer thread shall stop */
+    std::mutex mMutex; /**< protects mPending, mPendingSize, mWriting and mStop */
+    std::condition_variable mChanged; /**< signals changes of mWriting and mStop */
+    std::thread mWriter; /**< the background thread, if any */
+    ErrorBuffer mErrorBuffer; /**< stream buffer of the error channel */
+    std::ostream mErrors; /**< stream of the error channel */
+
+    /** \brief passes the filled part of mActive to the writer */
+    void handOff();
+
+    /** \brief writes data to mFd, gives up after the first error */
+    void writeAll(const char * data, std::size_t size);
+
+    /** \brief function of the writer thread */
+    void writerLoop();
+
+    // not copyable
+    LogSink(const LogSink& other) = delete;
+    LogSink& operator=(const LogSink& other) = delete;
+}; //class
+
+
+/** \brief collects the messages of a parallel task, so that they can be written at once
+ *
+ * Messages and errors are collected in the order they were written. write()
+ * passes the messages to a stream and the errors to the error channel of the
+ * active sink, so errors of parallel tasks are not delayed by the buffer of
+ * the sink.
+ */
+class MessageBuffer
+{
+  public:
+    /** \brief constructor - empty buffer */
+    MessageBuffer();
+
+
+    /** \brief gets the stream for normal messages */
+    std::ostream& messages();
+
+
+    /** \brief gets the stream for error messages */
+    std::ostream& errors();
+
+
+    /** \brief gets the number of collected bytes */
+    std::size_t size() const;
+
+
+    /** \brief writes all collected messages in order and clears the buffer
+     *
+     * \param out  stream for the normal messages, errors go to LogSink::errors()
+     */
+    void write(std::ostream& out);
+  private:
+    friend class LogSink;
+
+    /* stream buffer that appends to one kind of part */
+    class PartBuffer : public std::streambuf
+    {
+      public:
+        PartBuffer(MessageBuffer& owner, const bool error);
+      protected:
+        int_type overflow(int_type c) override;
+        std::streamsize xsputn(const char * s, std::streamsize count) override;
+      private:
+        friend class LogSink;
+
+        MessageBuffer& mOwner; /**< buffer that collects the parts */
+        bool mError; /**< whether this is the buffer for errors */
+    }; //class
+
+    std::vector<std::pair<bool, std::string> > mParts; /**< collected parts, true for errors */
+    std::size_t mSize; /**< number of collected bytes */
+    PartBuffer mMessageBuffer; /**< stream buffer of mMessages */
+    PartBuffer mErrorBuffer; /**< stream buffer of mErrors */
+    std::ostream mMessages; /**< stream for normal messages */
+    std::ostream mErrors; /**< stream for error messages */
+
+    /** \brief appends to the last part, or starts a new one for another kind */
+    void append(const bool error, const char * data, const std::size_t size);
+
+    // not copyable
+    MessageBuffer(const MessageBuffer& other) = delete;
+    MessageBuffer& operator=(const MessageBuffer& other) = delete;
+}; //class
+
+#endif // LOGSINK_HPP
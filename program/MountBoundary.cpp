@@ -0,0 +1,99 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include "MountBoundary.hpp"
+#include "FileUtilities.hpp"
+
+MountBoundary::MountBoundary()
+: mEnabled(false),
+  mRootDevice(0),
+  mMutex(),
+  mMountPoints(),
+  mCount(0)
+{
+}
+
+void MountBoundary::setEnabled(const bool enabled)
+{
+  mEnabled = enabled;
+}
+
+bool MountBoundary::enabled() const
+{
+  return mEnabled;
+}
+
+bool MountBoundary::setRoot(const DirectoryHandle& root)
+{
+  if (!mEnabled)
+    return true;
+  struct stat statbuf;
+  if (fstat(root.fd(), &statbuf) != 0)
+    return false;
+  mRootDevice = statbuf.st_dev;
+  return true;
+}
+
+bool MountBoundary::pruned(const std::string& path)
+{
+  if (!mEnabled)
+    return false;
+  std::lock_guard<std::mutex> lock(mMutex);
+  return belowMountPoint(path);
+}
+
+unsigned long long MountBoundary::mountPoints()
+{
+  return mCount;
+}
+
+bool MountBoundary::prune(const std::string& path, std::ostream& out, const bool verbose)
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  // Walks never get below a mount point, but restoring from a stat file
+  // checks every listed path.
+  if (belowMountPoint(path))
+    return true;
+  mMountPoints.insert(path);
+  mCount = mMountPoints.size();
+  if (verbose)
+    out << "Info: \"" << path << "\" is on another file system, skipping it and its content.\n";
+  return true;
+}
+
+bool MountBoundary::belowMountPoint(const std::string& path) const
+{
+  if (mMountPoints.empty())
+    return false;
+  std::string::size_type slash = path.find(pathDelimiter, 1);
+  while (slash != std::string::npos)
+  {
+    if (mMountPoints.find(path.substr(0, slash)) != mMountPoints.end())
+      return true;
+    slash = path.find(pathDelimiter, slash + 1);
+  } // while
+  return mMountPoints.find(path) != mMountPoints.end();
+}
+
+MountBoundary& MountBoundary::shared()
+{
+  static MountBoundary instance;
+  return instance;
+}
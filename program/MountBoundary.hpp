@@ -0,0 +1,147 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef MOUNTBOUNDARY_HPP
+#define MOUNTBOUNDARY_HPP
+
+#include <atomic>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <unordered_set>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "DirectoryHandle.hpp"
+
+/** \brief keeps walks on the file system of their root directory, see --one-file-system
+ *
+ * Entries whose device differs from the one of the root are mount points of
+ * other file systems (or lie below them). They are skipped together with
+ * their content, so their directories are never opened or read. The mount
+ * point itself is skipped, too, because its status already is the one of
+ * the root directory of the other file system.
+ *
+ * setEnabled() and setRoot() have to be called before the walk starts, the
+ * other functions are thread-safe.
+ */
+class MountBoundary
+{
+  public:
+    /** \brief constructor - disabled, every entry is inside */
+    MountBoundary();
+
+
+    /** \brief sets whether entries on other file systems are skipped */
+    void setEnabled(const bool enabled);
+
+
+    /** \brief checks whether entries on other file systems are skipped */
+    bool enabled() const;
+
+
+    /** \brief sets the root directory of the next walk
+     *
+     * \param root  the opened root directory
+     * \return Returns true, if the device of the root could be determined or
+     *         if the boundary is disabled. Returns false otherwise.
+     */
+    bool setRoot(const DirectoryHandle& root);
+
+
+    /** \brief checks whether an entry is on another file system than the root
+     *
+     * \param status   status of the entry
+     * \param prefix   start of the path of the entry, e.g. the root directory
+     * \param path     rest of the path of the entry. Both are only joined for
+     *                 entries on other file systems.
+     * \param out      stream for messages
+     * \param verbose  whether to list the skipped mount points
+     * \return Returns true, if the entry and its content shall be skipped.
+     *         Returns false otherwise.
+     */
+    bool outside(const struct stat& status, const std::string& prefix, const std::string& path, std::ostream& out, const bool verbose)
+    {
+      if (!mEnabled or (status.st_dev == mRootDevice))
+        return false;
+      return prune(prefix + path, out, verbose);
+    }
+
+
+    /** \brief checks whether an entry is on another file system than the root
+     *
+     * Same as above, for entries whose whole path is already known.
+     */
+    bool outside(const struct stat& status, const std::string& path, std::ostream& out, const bool verbose)
+    {
+      if (!mEnabled or (status.st_dev == mRootDevice))
+        return false;
+      return prune(path, out, verbose);
+    }
+
+
+    /** \brief checks whether a path is a skipped mount point or lies below one
+     *
+     * \param path  the path, in the same form as given to outside()
+     */
+    bool pruned(const std::string& path);
+
+
+    /** \brief checks whether a path is a skipped mount point or lies below one
+     *
+     * Same as above, for paths that are split like for outside(). Both parts
+     * are only joined after a mount point was skipped, so lines of a stat file
+     * can be checked before their entries are queried.
+     */
+    bool pruned(const std::string& prefix, const std::string& path)
+    {
+      if (!mEnabled or (mCount.load(std::memory_order_relaxed) == 0))
+        return false;
+      return pruned(prefix + path);
+    }
+
+
+    /** \brief gets the number of mount points that were skipped */
+    unsigned long long mountPoints();
+
+
+    /** \brief gets the boundary that is shared by all parts of the program */
+    static MountBoundary& shared();
+  private:
+    bool mEnabled; /**< whether entries on other file systems are skipped */
+    dev_t mRootDevice; /**< device of the root directory of the walk */
+    std::mutex mMutex; /**< protects the set of mount points */
+    std::unordered_set<std::string> mMountPoints; /**< paths of skipped mount points */
+    std::atomic<unsigned long long> mCount; /**< number of elements of mMountPoints */
+
+    /** \brief records a skipped entry, lists it as mount point unless it lies below one
+     *
+     * \return Returns always true, see outside().
+     */
+    bool prune(const std::string& path, std::ostream& out, const bool verbose);
+
+    /** \brief checks whether a path or one of its parents is in mMountPoints, mMutex has to be locked */
+    bool belowMountPoint(const std::string& path) const;
+
+    // not copyable
+    MountBoundary(const MountBoundary& other) = delete;
+    MountBoundary& operator=(const MountBoundary& other) = delete;
+}; //class
+
+#endif // MOUNTBOUNDARY_HPP
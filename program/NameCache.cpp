@@ -0,0 +1,125 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include "NameCache.hpp"
+
+LookupCounts::LookupCounts()
+: database(0),
+  cached(0)
+{
+}
+
+LookupCounts& LookupCounts::operator+=(const LookupCounts& other)
+{
+  database += other.database;
+  cached += other.cached;
+  return *this;
+}
+
+NameCache::NameCache()
+: mMutex(),
+  mUsers(),
+  mGroups(),
+  mNumeric(false),
+  mComplete(false),
+  mCounts()
+{
+}
+
+const std::string * NameCache::userName(const uid_t userID)
+{
+  return find(mUsers, userID, true);
+}
+
+const std::string * NameCache::groupName(const gid_t groupID)
+{
+  return find(mGroups, groupID, false);
+}
+
+void NameCache::addUser(const uid_t userID, const std::string& name)
+{
+  add(mUsers, userID, name);
+}
+
+void NameCache::addGroup(const gid_t groupID, const std::string& name)
+{
+  add(mGroups, groupID, name);
+}
+
+void NameCache::preload(const IDNameList& users, const IDNameList& groups)
+{
+  for (const auto& user : users)
+    add(mUsers, user.first, user.second);
+  for (const auto& group : groups)
+    add(mGroups, group.first, group.second);
+  std::lock_guard<std::mutex> lock(mMutex);
+  mComplete = true;
+}
+
+void NameCache::setNumeric(const bool numeric)
+{
+  mNumeric = numeric;
+}
+
+LookupCounts NameCache::counts()
+{
+  std::lock_guard<std::mutex> lock(mMutex);
+  return mCounts;
+}
+
+const std::string * NameCache::find(Table& table, const unsigned int id, const bool user)
+{
+  if (mNumeric)
+    return NULL;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    const Table::const_iterator found = table.find(id);
+    if ((found != table.end()) || mComplete)
+    {
+      ++mCounts.cached;
+      return ((found != table.end()) && found->second.known) ? &found->second.name : NULL;
+    }
+    ++mCounts.database;
+  }
+  // The lookup may take a while, so other threads must not wait for it. If
+  // two threads look up the same ID, the first result is kept.
+  Entry entry;
+  entry.known = user ? getUserName(id, entry.name) : getGroupName(id, entry.name);
+  if (!entry.known)
+    entry.name.clear();
+  std::lock_guard<std::mutex> lock(mMutex);
+  const Entry& cached = table.insert(std::make_pair(id, entry)).first->second;
+  return cached.known ? &cached.name : NULL;
+}
+
+void NameCache::add(Table& table, const unsigned int id, const std::string& name)
+{
+  Entry entry;
+  entry.known = true;
+  entry.name = name;
+  std::lock_guard<std::mutex> lock(mMutex);
+  table.insert(std::make_pair(id, entry));
+}
+
+NameCache& NameCache::shared()
+{
+  static NameCache instance;
+  return instance;
+}
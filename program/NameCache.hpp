@@ -0,0 +1,147 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef NAMECACHE_HPP
+#define NAMECACHE_HPP
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <sys/types.h>
+#include "FileUtilities.hpp"
+
+/* numbers of lookups of names and IDs, for the summary of a run */
+struct LookupCounts {
+    unsigned long long database; /* lookups in the user or group database */
+    unsigned long long cached; /* lookups that were answered without the database */
+
+    /* constructor - no lookups */
+    LookupCounts();
+
+    /* adds the counts of another object */
+    LookupCounts& operator+=(const LookupCounts& other);
+};//struct
+
+/** \brief caches the names of user IDs and group IDs
+ *
+ * Every ID is looked up only once, IDs without a name are cached, too. The
+ * lookups of the user database can be slow (e.g. with LDAP), and trees
+ * usually have only a few owners, so this saves most of them.
+ *
+ * All functions except setNumeric() are thread-safe. Names are never
+ * removed, so the returned pointers stay valid as long as the cache exists.
+ */
+class NameCache
+{
+  public:
+    /** \brief constructor - empty cache */
+    NameCache();
+
+
+    /** \brief gets the name of a user
+     *
+     * \param userID  the user ID
+     * \return Returns a pointer to the name, if the user exists. Returns NULL otherwise.
+     */
+    const std::string * userName(const uid_t userID);
+
+
+    /** \brief gets the name of a group
+     *
+     * \param groupID  the group ID
+     * \return Returns a pointer to the name, if the group exists. Returns NULL otherwise.
+     */
+    const std::string * groupName(const gid_t groupID);
+
+
+    /** \brief adds the name of a user that is already known, e.g. from a lookup by name
+     *
+     * \param userID  the user ID
+     * \param name    the name of the user
+     */
+    void addUser(const uid_t userID, const std::string& name);
+
+
+    /** \brief adds the name of a group that is already known, e.g. from a lookup by name
+     *
+     * \param groupID  the group ID
+     * \param name     the name of the group
+     */
+    void addGroup(const gid_t groupID, const std::string& name);
+
+
+    /** \brief fills the cache with all users and groups of the databases
+     *
+     * IDs that are not in the lists are considered to have no name from now
+     * on, so the databases are not used anymore.
+     * \param users   IDs and names of all users, see listUsers()
+     * \param groups  IDs and names of all groups, see listGroups()
+     */
+    void preload(const IDNameList& users, const IDNameList& groups);
+
+
+    /** \brief sets whether IDs are used without names
+     *
+     * \param numeric  If set to true, no ID has a name and the databases are
+     *                 not used, see --numeric-ids. Has to be called before the
+     *                 cache is used by several threads.
+     */
+    void setNumeric(const bool numeric);
+
+
+    /** \brief gets the numbers of lookups so far */
+    LookupCounts counts();
+
+
+    /** \brief gets the cache that is shared by all parts of the program */
+    static NameCache& shared();
+  private:
+    /* cached name of an ID */
+    struct Entry {
+        bool known; /* whether the ID has a name */
+        std::string name; /* the name, empty if it is not known */
+    };//struct
+    typedef std::unordered_map<unsigned int, Entry> Table;
+
+    std::mutex mMutex; /**< protects the tables */
+    Table mUsers; /**< user ID -> name */
+    Table mGroups; /**< group ID -> name */
+    bool mNumeric; /**< whether no ID has a name */
+    bool mComplete; /**< whether the tables hold all IDs that have a name */
+    LookupCounts mCounts; /**< numbers of lookups */
+
+    /** \brief gets a name from a table, looks it up on a miss
+     *
+     * \param table  mUsers or mGroups
+     * \param id     the ID
+     * \param user   whether the ID is a user ID or a group ID
+     * \return Returns a pointer to the name. Returns NULL, if the ID has none.
+     */
+    const std::string * find(Table& table, const unsigned int id, const bool user);
+
+    /** \brief adds a known name to a table, if the ID is not in it yet */
+    void add(Table& table, const unsigned int id, const std::string& name);
+
+    // not copyable
+    NameCache(const NameCache& other) = delete;
+    NameCache& operator=(const NameCache& other) = delete;
+}; //class
+
+#endif // NAMECACHE_HPP
@@ -0,0 +1,348 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include "PathFilter.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include "LogSink.hpp"
+
+/* checks whether a character is in the class that starts at pattern, i.e. at
+   a '['. Moves pattern behind the class. Returns false for an unterminated
+   class, pattern is not moved then. */
+static bool parseClass(const char *& pattern, const char * patternEnd, const char c, bool& matched)
+{
+  const char * p = pattern + 1;
+  const bool negate = (p < patternEnd) and ((*p == '!') or (*p == '^'));
+  if (negate)
+    ++p;
+  bool found = false;
+  // a ']' right at the start is a normal character
+  bool first = true;
+  while ((p < patternEnd) and (first or (*p != ']')))
+  {
+    first = false;
+    char low = *p;
+    if ((low == '\\') and (p + 1 < patternEnd))
+      low = *++p;
+    char high = low;
+    if ((p + 2 < patternEnd) and (p[1] == '-') and (p[2] != ']'))
+    {
+      high = p[2];
+      p += 2;
+    }
+    if ((c >= low) and (c <= high))
+      found = true;
+    ++p;
+  } // while
+  if (p >= patternEnd)
+    return false;
+  pattern = p + 1;
+  matched = (found != negate);
+  return true;
+}
+
+/* matches text against a glob pattern, '*' does not match '/' but "**" does */
+static bool globMatch(const char * pattern, const char * patternEnd, const char * text, const char * textEnd)
+{
+  while (pattern < patternEnd)
+  {
+    char c = *pattern;
+    if (c == '*')
+    {
+      const bool anything = (pattern + 1 < patternEnd) and (pattern[1] == '*');
+      while ((pattern < patternEnd) and (*pattern == '*'))
+        ++pattern;
+      if (pattern == patternEnd)
+        return anything or (std::memchr(text, '/', textEnd - text) == NULL);
+      for (const char * t = text; ; ++t)
+      {
+        if (globMatch(pattern, patternEnd, t, textEnd))
+          return true;
+        if ((t == textEnd) or (!anything and (*t == '/')))
+          return false;
+      } // for
+    }
+    if (text == textEnd)
+      return false;
+    if (c == '?')
+    {
+      if (*text == '/')
+        return false;
+      ++pattern;
+      ++text;
+      continue;
+    }
+    if (c == '[')
+    {
+      bool matched = false;
+      if (parseClass(pattern, patternEnd, *text, matched))
+      {
+        if (!matched or (*text == '/'))
+          return false;
+        ++text;
+        continue;
+      }
+      // unterminated class, '[' is a normal character
+    }
+    else if ((c == '\\') and (pattern + 1 < patternEnd))
+    {
+      c = *++pattern;
+    }
+    if (c != *text)
+      return false;
+    ++pattern;
+    ++text;
+  } // while
+  return text == textEnd;
+}
+
+/* checks whether a pattern contains any wildcards */
+static bool hasWildcards(const char * pattern, const std::size_t length)
+{
+  for (std::size_t i = 0; i < length; ++i)
+  {
+    const char c = pattern[i];
+    if ((c == '*') or (c == '?') or (c == '[') or (c == '\\'))
+      return true;
+  } // for
+  return false;
+}
+
+PathFilter::PathFilter()
+: mActive(false),
+  mDirectoryRules(false),
+  mIncludes(),
+  mNames(),
+  mDirectoryNames(),
+  mRules(),
+  mExcluded(0)
+{
+}
+
+bool PathFilter::addRule(const std::string& pattern, const bool include)
+{
+  std::string::size_type begin = 0;
+  std::string::size_type end = pattern.size();
+  const bool directoryOnly = (end > 0) and (pattern[end - 1] == '/');
+  while ((end > begin) and (pattern[end - 1] == '/'))
+    --end;
+  const bool anchored = (begin < end) and (pattern[begin] == '/');
+  while ((begin < end) and (pattern[begin] == '/'))
+    ++begin;
+  if (begin == end)
+    return false;
+
+  Rule rule;
+  rule.index = mIncludes.size();
+  rule.directoryOnly = directoryOnly;
+  rule.anchored = anchored;
+  rule.pattern = pattern.substr(begin, end - begin);
+  mIncludes.push_back(include);
+  mActive = true;
+  mDirectoryRules = mDirectoryRules or directoryOnly;
+
+  const char * const text = rule.pattern.c_str();
+  const std::size_t length = rule.pattern.size();
+  if (anchored or (rule.pattern.find('/') != std::string::npos) or (rule.pattern.find("**") != std::string::npos))
+    rule.kind = rkPath;
+  else if (!hasWildcards(text, length))
+  {
+    // Only the first rule for a name can ever match.
+    (directoryOnly ? mDirectoryNames : mNames).insert(rule.pattern, rule.index);
+    return true;
+  }
+  else if ((length > 1) and (text[0] == '*') and !hasWildcards(text + 1, length - 1))
+  {
+    rule.kind = rkSuffix;
+    rule.pattern.erase(0, 1);
+  }
+  else if ((length > 1) and (text[length - 1] == '*') and !hasWildcards(text, length - 1))
+  {
+    rule.kind = rkPrefix;
+    rule.pattern.erase(length - 1);
+  }
+  else
+    rule.kind = rkName;
+  mRules.push_back(rule);
+  return true;
+}
+
+bool PathFilter::addRulesFromFile(const std::string& fileName)
+{
+  std::ifstream input(fileName.c_str(), std::ios_base::in | std::ios_base::binary);
+  if (!input.is_open())
+  {
+    const int errorCode = errno;
+    LogSink::errors() << "Error: Could not open file \"" << fileName << "\": Code "
+                      << errorCode << " (" << strerror(errorCode) << ").\n";
+    return false;
+  }
+  std::string line;
+  while (std::getline(input, line))
+  {
+    if (!line.empty() and (line[line.size() - 1] == '\r'))
+      line.erase(line.size() - 1);
+    if (line.empty() or (line[0] == '#') or (line[0] == ';'))
+      continue;
+    addRule(line, false);
+  } // while
+  if (input.bad())
+  {
+    LogSink::errors() << "Error: Could not read file \"" << fileName << "\".\n";
+    return false;
+  }
+  return true;
+}
+
+bool PathFilter::matches(const char * directory, std::size_t dirLength, const char * name, const std::size_t length, const bool isDirectory) const
+{
+  // index of the first matching rule, rules without wildcards need a lookup only
+  unsigned int first = mIncludes.size();
+  const unsigned int * found = mNames.find(name, length);
+  if (found != NULL)
+    first = *found;
+  if (isDirectory and ((found = mDirectoryNames.find(name, length)) != NULL) and (*found < first))
+    first = *found;
+
+  std::string path;
+  for (const Rule& rule : mRules)
+  {
+    if (rule.index >= first)
+      break;
+    if (rule.directoryOnly and !isDirectory)
+      continue;
+    const std::size_t size = rule.pattern.size();
+    bool matched = false;
+    switch (rule.kind)
+    {
+      case rkSuffix:
+           matched = (length >= size) and (std::memcmp(name + length - size, rule.pattern.data(), size) == 0);
+           break;
+      case rkPrefix:
+           matched = (length >= size) and (std::memcmp(name, rule.pattern.data(), size) == 0);
+           break;
+      case rkName:
+           matched = globMatch(rule.pattern.data(), rule.pattern.data() + size, name, name + length);
+           break;
+      case rkPath:
+           if (path.empty())
+           {
+             // the relative path is only needed for rules like "a/b"
+             while ((dirLength > 0) and (directory[0] == '/'))
+             {
+               ++directory;
+               --dirLength;
+             }
+             while ((dirLength > 0) and (directory[dirLength - 1] == '/'))
+               --dirLength;
+             path.assign(directory, dirLength);
+             if (!path.empty())
+               path.append(1, '/');
+             path.append(name, length);
+           }
+           // Unanchored patterns may start at every component of the path.
+           for (std::string::size_type start = 0; !matched and (start != std::string::npos); )
+           {
+             matched = globMatch(rule.pattern.data(), rule.pattern.data() + size, path.data() + start, path.data() + path.size());
+             if (rule.anchored)
+               break;
+             start = path.find('/', start);
+             if (start != std::string::npos)
+               ++start;
+           } // for
+           break;
+    } // swi
+    if (matched)
+    {
+      first = rule.index;
+      break;
+    }
+  } // for
+  return (first < mIncludes.size()) and !mIncludes[first];
+}
+
+bool PathFilter::parentsMatch(const std::string& path, std::string::size_type& last) const
+{
+  last = 0;
+  std::string::size_type slash = path.find('/');
+  while (slash != std::string::npos)
+  {
+    if ((slash > last) and matches(path.data(), last, path.data() + last, slash - last, true))
+      return true;
+    last = slash + 1;
+    slash = path.find('/', last);
+  } // while
+  return false;
+}
+
+bool PathFilter::excludesChecked(const std::string& directory, const std::string::size_type start, const char * name, const std::size_t length, const bool isDirectory)
+{
+  const std::size_t dirLength = (start < directory.size()) ? directory.size() - start : 0;
+  if (!matches(directory.data() + directory.size() - dirLength, dirLength, name, length, isDirectory))
+    return false;
+  ++mExcluded;
+  return true;
+}
+
+bool PathFilter::excludesPathChecked(const std::string& path)
+{
+  std::string::size_type last = 0;
+  if (parentsMatch(path, last)
+      or (!mDirectoryRules and matches(path.data(), last, path.data() + last, path.size() - last, false)))
+  {
+    ++mExcluded;
+    return true;
+  }
+  return false;
+}
+
+bool PathFilter::excludesQueriedPathChecked(const std::string& path, const mode_t mode)
+{
+  // the parents have been checked by excludesPath() already
+  const std::string::size_type slash = path.rfind('/');
+  const std::string::size_type last = (slash == std::string::npos) ? 0 : slash + 1;
+  if (!matches(path.data(), last, path.data() + last, path.size() - last, S_ISDIR(mode)))
+    return false;
+  ++mExcluded;
+  return true;
+}
+
+bool PathFilter::hides(const std::string& path) const
+{
+  if (!mActive)
+    return false;
+  std::string::size_type last = 0;
+  return parentsMatch(path, last)
+      or matches(path.data(), last, path.data() + last, path.size() - last, false)
+      or matches(path.data(), last, path.data() + last, path.size() - last, true);
+}
+
+unsigned long long PathFilter::excluded() const
+{
+  return mExcluded;
+}
+
+PathFilter& PathFilter::shared()
+{
+  static PathFilter instance;
+  return instance;
+}
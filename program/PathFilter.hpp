@@ -0,0 +1,216 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef PATHFILTER_HPP
+#define PATHFILTER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <dirent.h> //for DT_UNKNOWN, DT_DIR
+#include <sys/stat.h>
+#include <sys/types.h>
+#include "FlatNameMap.hpp"
+
+/** \brief include and exclude rules for entries, see --exclude and --include
+ *
+ * The rules work like the ones of rsync: they are checked in the order in
+ * which they were given, and the first matching rule decides. Entries that
+ * no rule matches are included. A pattern without '/' is matched against
+ * the name of an entry, e.g. ".git" or "*.tmp". Other patterns are matched
+ * against the path relative to the root of the walk, a leading '/' anchors
+ * them at the root. A trailing '/' restricts a rule to directories. In
+ * patterns, '*' matches anything but '/', "**" matches anything, '?'
+ * matches one character and [...] one character of a class.
+ *
+ * The rules are compiled once: names without wildcards are looked up in a
+ * hash table, "*suffix" and "prefix*" are compared directly, only other
+ * patterns need the general matcher. Excluded directories are not read, so
+ * their content costs nothing.
+ *
+ * Rules have to be added before the filter is used by several threads, the
+ * other functions are thread-safe.
+ */
+class PathFilter
+{
+  public:
+    /** \brief constructor - no rules, everything is included */
+    PathFilter();
+
+
+    /** \brief adds a rule
+     *
+     * \param pattern  the pattern, see above
+     * \param include  true for an include rule, false for an exclude rule
+     * \return Returns true, if the rule was added. Returns false, if the
+     *         pattern is empty.
+     */
+    bool addRule(const std::string& pattern, const bool include);
+
+
+    /** \brief adds an exclude rule for each line of a file, see --exclude-from
+     *
+     * \param fileName  name of the file. Empty lines and lines that start with
+     *                  '#' or ';' are skipped.
+     * \return Returns true, if the file could be read. Returns false otherwise.
+     */
+    bool addRulesFromFile(const std::string& fileName);
+
+
+    /** \brief checks whether there are any rules */
+    bool active() const
+    {
+      return mActive;
+    }
+
+
+    /** \brief checks whether an entry of a walk is excluded, before its status is known
+     *
+     * \param directory  path of the directory of the entry
+     * \param start      the part of directory from this offset on is the path
+     *                   relative to the root of the walk, delimiters at its
+     *                   start and end are ignored
+     * \param name       name of the entry
+     * \param length     length of the name
+     * \param type       type of the entry (DT_*), as reported by the directory
+     * \return Returns true, if the entry and its content shall be skipped.
+     *         Returns false otherwise. If the type is DT_UNKNOWN and a rule
+     *         for directories could match, the entry has to be checked again
+     *         by excludesQueried() when its status is known.
+     */
+    bool excludes(const std::string& directory, const std::string::size_type start, const char * name, const std::size_t length, const unsigned char type)
+    {
+      if (!mActive or ((type == DT_UNKNOWN) and mDirectoryRules))
+        return false;
+      return excludesChecked(directory, start, name, length, type == DT_DIR);
+    }
+
+
+    /** \brief checks an entry of a walk again, after its status was queried
+     *
+     * \param directory, start, name, length, type  same as for excludes()
+     * \param mode  the mode of the entry from its status
+     * \return Returns true, if the entry and its content shall be skipped.
+     *         Returns false otherwise, also if excludes() already decided.
+     */
+    bool excludesQueried(const std::string& directory, const std::string::size_type start, const char * name, const std::size_t length, const unsigned char type, const mode_t mode)
+    {
+      if (!mActive or (type != DT_UNKNOWN) or !mDirectoryRules)
+        return false;
+      return excludesChecked(directory, start, name, length, S_ISDIR(mode));
+    }
+
+
+    /** \brief checks whether a path of a stat file is excluded, before its status is known
+     *
+     * \param path  path relative to the root, e.g. "a/b/c"
+     * \return Returns true, if the path or one of its parent directories is
+     *         excluded. Returns false otherwise. The entry has to be checked
+     *         again by excludesQueriedPath() when its status is known.
+     */
+    bool excludesPath(const std::string& path)
+    {
+      if (!mActive)
+        return false;
+      return excludesPathChecked(path);
+    }
+
+
+    /** \brief checks a path of a stat file again, after its status was queried
+     *
+     * \param path  path relative to the root, e.g. "a/b/c"
+     * \param mode  the mode of the entry from its status
+     * \return Returns true, if the entry shall be skipped, because a rule for
+     *         directories excludes it. Returns false otherwise.
+     */
+    bool excludesQueriedPath(const std::string& path, const mode_t mode)
+    {
+      if (!mActive or !mDirectoryRules)
+        return false;
+      return excludesQueriedPathChecked(path, mode);
+    }
+
+
+    /** \brief checks whether a path would be excluded as file or as directory, e.g. for messages
+     *
+     * \param path  path relative to the root, e.g. "a/b/c"
+     * \remarks Does not count the path as excluded.
+     */
+    bool hides(const std::string& path) const;
+
+
+    /** \brief gets the number of entries that were excluded */
+    unsigned long long excluded() const;
+
+
+    /** \brief gets the filter that is shared by all parts of the program */
+    static PathFilter& shared();
+  private:
+    /* the ways a rule is matched */
+    enum Kind { rkSuffix, rkPrefix, rkName, rkPath };
+
+    /* compiled rule that needs more than a lookup of the name */
+    struct Rule {
+        unsigned int index; /* position in the list of all rules */
+        Kind kind; /* how the rule is matched */
+        bool directoryOnly; /* whether the rule only matches directories */
+        bool anchored; /* whether a path pattern starts at the root */
+        std::string pattern; /* the literal part for suffix and prefix rules, the pattern otherwise */
+    };//struct
+
+    bool mActive; /**< whether there are any rules */
+    bool mDirectoryRules; /**< whether some rules only match directories */
+    std::vector<bool> mIncludes; /**< whether the rule at an index is an include rule */
+    FlatNameMap<unsigned int> mNames; /**< names without wildcards -> index of the first rule */
+    FlatNameMap<unsigned int> mDirectoryNames; /**< same as mNames, for rules that only match directories */
+    std::vector<Rule> mRules; /**< all other rules, ordered by index */
+    std::atomic<unsigned long long> mExcluded; /**< number of excluded entries */
+
+    /** \brief checks whether an entry is excluded
+     *
+     * \param directory    start of the path of the directory of the entry,
+     *                     relative to the root of the walk
+     * \param dirLength    length of that path
+     * \param name         name of the entry
+     * \param length       length of the name
+     * \param isDirectory  whether the entry is a directory
+     * \return Returns true, if the first matching rule excludes the entry.
+     */
+    bool matches(const char * directory, std::size_t dirLength, const char * name, const std::size_t length, const bool isDirectory) const;
+
+    /** \brief checks whether the parent directories of a path are excluded
+     *
+     * \param path  path relative to the root
+     * \param last  will be set to the offset of the last component of path
+     */
+    bool parentsMatch(const std::string& path, std::string::size_type& last) const;
+
+    /* slow paths of the inline functions, they count excluded entries */
+    bool excludesChecked(const std::string& directory, const std::string::size_type start, const char * name, const std::size_t length, const bool isDirectory);
+    bool excludesPathChecked(const std::string& path);
+    bool excludesQueriedPathChecked(const std::string& path, const mode_t mode);
+
+    // not copyable
+    PathFilter(const PathFilter& other) = delete;
+    PathFilter& operator=(const PathFilter& other) = delete;
+}; //class
+
+#endif // PATHFILTER_HPP
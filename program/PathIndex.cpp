@@ -0,0 +1,151 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include "PathIndex.hpp"
+#include <cstring>
+
+const PathIndex::Id PathIndex::cNotFound;
+
+PathIndex::PathIndex()
+: mText(),
+  mDirectories(),
+  mPaths(),
+  mDirectoryTable(),
+  mPathTable()
+{
+  mDirectoryTable.size = 0;
+  mPathTable.size = 0;
+}
+
+PathIndex::Id PathIndex::insert(const std::string& path)
+{
+  const std::string::size_type slash = path.rfind('/');
+  const std::string::size_type directoryLength = (slash == std::string::npos) ? 0 : slash + 1;
+  const std::uint32_t directoryHash = hash(cNotFound, path.data(), directoryLength);
+  Id directory = lookup(mDirectoryTable, mDirectories, directoryHash, cNotFound, path.data(), directoryLength);
+  if (directory == cNotFound)
+    directory = add(mDirectoryTable, mDirectories, directoryHash, cNotFound, path.data(), directoryLength);
+
+  const char * name = path.data() + directoryLength;
+  const std::size_t length = path.size() - directoryLength;
+  const std::uint32_t nameHash = hash(directory, name, length);
+  const Id id = lookup(mPathTable, mPaths, nameHash, directory, name, length);
+  if (id != cNotFound)
+    return id;
+  return add(mPathTable, mPaths, nameHash, directory, name, length);
+}
+
+PathIndex::Id PathIndex::findDirectory(const std::string& directory) const
+{
+  return lookup(mDirectoryTable, mDirectories, hash(cNotFound, directory.data(), directory.size()),
+                cNotFound, directory.data(), directory.size());
+}
+
+PathIndex::Id PathIndex::find(const Id directory, const char * name, const std::size_t length) const
+{
+  if (directory == cNotFound)
+    return cNotFound;
+  return lookup(mPathTable, mPaths, hash(directory, name, length), directory, name, length);
+}
+
+std::size_t PathIndex::size() const
+{
+  return mPaths.size();
+}
+
+std::string PathIndex::path(const Id id) const
+{
+  const Name& name = mPaths[id];
+  const Name& directory = mDirectories[name.directory];
+  std::string result(mText, directory.offset, directory.length);
+  result.append(mText, name.offset, name.length);
+  return result;
+}
+
+PathIndex::Id PathIndex::lookup(const Table& table, const std::vector<Name>& names, const std::uint32_t hashValue, const Id directory,
+                                const char * name, const std::size_t length) const
+{
+  if (table.slots.empty())
+    return cNotFound;
+  const std::size_t mask = table.slots.size() - 1;
+  for (std::size_t i = hashValue & mask; table.slots[i].id != cNotFound; i = (i + 1) & mask)
+  {
+    const Slot& slot = table.slots[i];
+    if (slot.hash != hashValue)
+      continue;
+    const Name& candidate = names[slot.id];
+    if ((candidate.directory == directory) && (candidate.length == length)
+        && (std::memcmp(mText.data() + candidate.offset, name, length) == 0))
+      return slot.id;
+  } // for
+  return cNotFound;
+}
+
+PathIndex::Id PathIndex::add(Table& table, std::vector<Name>& names, const std::uint32_t hashValue, const Id directory,
+                             const char * name, const std::size_t length)
+{
+  if (2 * (table.size + 1) > table.slots.size())
+  {
+    // double the size of the table and move all slots
+    Slot unused;
+    unused.hash = 0;
+    unused.id = cNotFound;
+    std::vector<Slot> old(table.slots.empty() ? 16 : 2 * table.slots.size(), unused);
+    old.swap(table.slots);
+    const std::size_t mask = table.slots.size() - 1;
+    for (const Slot& slot : old)
+    {
+      if (slot.id == cNotFound)
+        continue;
+      std::size_t i = slot.hash & mask;
+      while (table.slots[i].id != cNotFound)
+        i = (i + 1) & mask;
+      table.slots[i] = slot;
+    } // for
+  }
+
+  Name entry;
+  entry.offset = mText.size();
+  entry.length = static_cast<std::uint32_t>(length);
+  entry.directory = directory;
+  mText.append(name, length);
+  const Id id = static_cast<Id>(names.size());
+  names.push_back(entry);
+
+  const std::size_t mask = table.slots.size() - 1;
+  std::size_t i = hashValue & mask;
+  while (table.slots[i].id != cNotFound)
+    i = (i + 1) & mask;
+  table.slots[i].hash = hashValue;
+  table.slots[i].id = id;
+  ++table.size;
+  return id;
+}
+
+std::uint32_t PathIndex::hash(const Id directory, const char * name, const std::size_t length)
+{
+  std::uint64_t result = 14695981039346656037ULL ^ (directory * 0x9E3779B97F4A7C15ULL);
+  for (std::size_t i = 0; i < length; ++i)
+  {
+    result ^= static_cast<unsigned char>(name[i]);
+    result *= 1099511628211ULL;
+  } // for
+  return static_cast<std::uint32_t>(result ^ (result >> 32));
+}
@@ -0,0 +1,144 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef PATHINDEX_HPP
+#define PATHINDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** \brief compact index of relative paths, e.g. of all lines of a stat file
+ *
+ * Paths are split into their directory and their name. Each directory is
+ * stored once, each path only stores its name, so deep trees do not repeat
+ * the same prefixes over and over. All names are kept in one text block,
+ * and the hash tables use open addressing with slots of eight bytes, like
+ * FlatNameMap does. Besides the text, a path needs 16 bytes for its record
+ * and 16 to 32 bytes for its slots.
+ *
+ * Every path gets an ID, starting at zero, so callers can keep the data of
+ * the paths in a vector.
+ */
+class PathIndex
+{
+  public:
+    /* ID of a path or of a directory */
+    typedef std::uint32_t Id;
+
+    static const Id cNotFound = 0xFFFFFFFF; /**< ID of paths that are not in the index */
+
+
+    /** \brief constructor - empty index */
+    PathIndex();
+
+
+    /** \brief adds a path, if it is not in the index yet
+     *
+     * \param path  the path, e.g. "a/b/c"
+     * \return Returns the ID of the path. Adding a path again returns the
+     *         same ID.
+     */
+    Id insert(const std::string& path);
+
+
+    /** \brief finds a directory of the paths
+     *
+     * \param directory  path of the directory with trailing slash, e.g. "a/b/",
+     *                   or an empty string for the top level
+     * \return Returns the ID of the directory. Returns cNotFound, if no path
+     *         is in that directory.
+     */
+    Id findDirectory(const std::string& directory) const;
+
+
+    /** \brief finds a path by its directory and its name
+     *
+     * \param directory  ID of the directory, see findDirectory()
+     * \param name       name of the entry
+     * \param length     length of the name in bytes
+     * \return Returns the ID of the path. Returns cNotFound, if the path is
+     *         not in the index.
+     */
+    Id find(const Id directory, const char * name, const std::size_t length) const;
+
+
+    /** \brief gets the number of paths */
+    std::size_t size() const;
+
+
+    /** \brief gets a path
+     *
+     * \param id  ID of the path
+     * \return Returns the path that was given to insert().
+     */
+    std::string path(const Id id) const;
+  private:
+    /* directory or name of a path in mText */
+    struct Name {
+        std::uint64_t offset; /* position of the text */
+        std::uint32_t length; /* length of the text */
+        Id directory; /* directory of a path, cNotFound for directories */
+    };//struct
+
+    /* slot of a hash table, refers to an element of mDirectories or mPaths */
+    struct Slot {
+        std::uint32_t hash; /* hash of the name */
+        Id id; /* index of the name, cNotFound for unused slots */
+    };//struct
+
+    /* hash table with open addressing */
+    struct Table {
+        std::vector<Slot> slots; /* the slots, the number is a power of two */
+        std::size_t size; /* number of used slots */
+    };//struct
+
+    std::string mText; /**< directories and names of all paths */
+    std::vector<Name> mDirectories; /**< the directories, index is the ID */
+    std::vector<Name> mPaths; /**< the paths, index is the ID */
+    Table mDirectoryTable; /**< hash table of mDirectories */
+    Table mPathTable; /**< hash table of mPaths */
+
+    /** \brief finds a name in a table
+     *
+     * \param table      mDirectoryTable or mPathTable
+     * \param names      mDirectories or mPaths
+     * \param hashValue  hash of the name, see hash()
+     * \param directory  ID of the directory of the name, cNotFound for directories
+     * \param name       the name
+     * \param length     length of the name
+     * \return Returns the ID of the name. Returns cNotFound, if it is not in the table.
+     */
+    Id lookup(const Table& table, const std::vector<Name>& names, const std::uint32_t hashValue, const Id directory,
+              const char * name, const std::size_t length) const;
+
+    /** \brief adds a name that is not in a table yet
+     *
+     * \return Returns the ID of the new name.
+     */
+    Id add(Table& table, std::vector<Name>& names, const std::uint32_t hashValue, const Id directory,
+           const char * name, const std::size_t length);
+
+    /** \brief FNV-1a hash of a name in a directory */
+    static std::uint32_t hash(const Id directory, const char * name, const std::size_t length);
+}; //class
+
+#endif // PATHINDEX_HPP
@@ -19,334 +19,306 @@
 */
 
 #include "SaveRestore.hpp"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include <utility>
 #include <vector>
 #include <cerrno>  //for errno
 #include <cstring> //for strerror()
+#include <dirent.h> //for DT_UNKNOWN
+#include <fcntl.h>  //for AT_FDCWD
 #include <pwd.h>
 #include <grp.h>
 #include <unistd.h> //for lchown()
 #include "AuxiliaryFunctions.hpp"
+#include "DirectoryReader.hpp"
 #include "FileUtilities.hpp"
+#include "IDMapping.hpp"
+#include "LinkTracker.hpp"
+#include "LogSink.hpp"
 #include "ModeUtility.hpp"
+#include "MountBoundary.hpp"
+#include "NameCache.hpp"
+#include "PathFilter.hpp"
+#include "WorkStealingPool.hpp"
+
+/* IDs of all users and groups, see preloadIDs() */
+struct SaveRestore::PreloadedIDs {
+    FlatNameMap<unsigned int> users; /* user name -> user ID */
+    FlatNameMap<unsigned int> groups; /* group name -> group ID */
+};//struct
 
 SaveRestore::SaveRestore(const bool useCache)
 : mUseCache(useCache),
-  mUserCache(std::map<std::string, uid_t>()),
-  mGroupCache(std::map<std::string, gid_t>())
+  mUserCache(),
+  mGroupCache(),
+  mNumericIDs(false),
+  mPreloadedIDs(),
+  mLookups()
+{
+}
+
+void SaveRestore::setNumericIDs(const bool numeric)
+{
+  mNumericIDs = numeric;
+}
+
+void SaveRestore::preloadIDs(const IDNameList& users, const IDNameList& groups)
+{
+  // Like getpwnam(), the first entry of a name wins.
+  std::shared_ptr<PreloadedIDs> preloaded = std::make_shared<PreloadedIDs>();
+  for (const auto& user : users)
+    preloaded->users.insert(user.second, user.first);
+  for (const auto& group : groups)
+    preloaded->groups.insert(group.second, group.first);
+  mPreloadedIDs = preloaded;
+  NameCache::shared().preload(users, groups);
+}
+
+const LookupCounts& SaveRestore::lookupCounts() const
 {
+  return mLookups;
 }
 
 bool SaveRestore::getStatString(const std::string& src_path, const std::string& removeSuffix, std::string& statLine)
 {
   struct stat src_statbuf;
-  int ret = lstat(src_path.c_str(), &src_statbuf);
+  int ret = StatEngine::statAt(AT_FDCWD, src_path.c_str(), src_statbuf);
   if (0 != ret)
   {
     // error while querying status of src_path
     return false;
   }
 
-  statLine.clear();
-  // read access for user
-  if ((src_statbuf.st_mode & S_IRUSR) == S_IRUSR)
-    statLine = "r";
-  else
-    statLine = "-";
-  // write access for user
-  if ((src_statbuf.st_mode & S_IWUSR) == S_IWUSR)
-    statLine.append("w");
-  else
-    statLine.append("-");
-  // executable bit for user
-  if ((src_statbuf.st_mode & S_IXUSR) == S_IXUSR)
+  // file name without suffix
+  if (!removeSuffix.empty() && (src_path.substr(0, removeSuffix.size()) == removeSuffix))
   {
-    // UID bit set?
-    if ((src_statbuf.st_mode & S_ISUID) == S_ISUID)
-      statLine.append("s");
-    else
-      statLine.append("x");
+    getStatString(FileStatus(src_statbuf), src_path.substr(removeSuffix.size()), statLine);
   }
   else
   {
-    // UID bit set?
-    if ((src_statbuf.st_mode & S_ISUID) == S_ISUID)
-      statLine.append("S");
-    else
-      statLine.append("-");
+    getStatString(FileStatus(src_statbuf), src_path, statLine);
   }
+  return true;
+}
 
-  // read access for group
-  if ((src_statbuf.st_mode & S_IRGRP) == S_IRGRP)
-    statLine.append("r");
-  else
-    statLine.append("-");
-  // write access for group
-  if ((src_statbuf.st_mode & S_IWGRP) == S_IWGRP)
-    statLine.append("w");
-  else
-    statLine.append("-");
-  // executable bit for group
-  if ((src_statbuf.st_mode & S_IXGRP) == S_IXGRP)
-  {
-    // GID bit set?
-    if ((src_statbuf.st_mode & S_ISGID) == S_ISGID)
-      statLine.append("s");
-    else
-      statLine.append("x");
-  }
-  else
-  {
-    // GID bit set?
-    if ((src_statbuf.st_mode & S_ISGID) == S_ISGID)
-      statLine.append("S");
-    else
-      statLine.append("-");
-  }
+// The tables below rely on the traditional values of the mode bits, which
+// POSIX requires for tar and cpio, too.
+static_assert((S_IRUSR == 0400) and (S_IWUSR == 0200) and (S_IXUSR == 0100)
+              and (S_IRGRP == 040) and (S_IWGRP == 020) and (S_IXGRP == 010)
+              and (S_IROTH == 04) and (S_IWOTH == 02) and (S_IXOTH == 01)
+              and (S_ISUID == 04000) and (S_ISGID == 02000) and (S_ISVTX == 01000),
+              "Mode bits have unexpected values.");
 
-  // read access for others
-  if ((src_statbuf.st_mode & S_IROTH) == S_IROTH)
-    statLine.append("r");
-  else
-    statLine.append("-");
-  // write access for others
-  if ((src_statbuf.st_mode & S_IWOTH) == S_IWOTH)
-    statLine.append("w");
-  else
-    statLine.append("-");
-  // executable bit for others
-  if ((src_statbuf.st_mode & S_IXOTH) == S_IXOTH)
-  {
-    // sticky bit set?
-    if ((src_statbuf.st_mode & S_ISVTX) == S_ISVTX)
-      statLine.append("t");
-    else
-      statLine.append("x");
-  }
-  else
-  {
-    // GID bit set?
-    if ((src_statbuf.st_mode & S_ISVTX) == S_ISVTX)
-      statLine.append("T");
-    else
-      statLine.append("-");
-  }
+/* list of indices 0, 1, ..., N-1 for the generation of tables, like
+   std::make_index_sequence of C++14 */
+template<unsigned int... I> struct Indices {};
+template<unsigned int N, unsigned int... I> struct MakeIndices: MakeIndices<N-1, N-1, I...> {};
+template<unsigned int... I> struct MakeIndices<0, I...> { typedef Indices<I...> type; };
 
-  // space before user name
-  statLine += " ";
+/* character for the execute column of a triad with the execute bit and the
+   special bit (set-user-ID, set-group-ID or sticky) */
+constexpr char executeChar(const unsigned int triad, const bool execute, const bool special)
+{
+  return special ? (triad == 2 ? (execute ? 't' : 'T') : (execute ? 's' : 'S'))
+                 : (execute ? 'x' : '-');
+}
 
-  const struct passwd *pwd = getpwuid(src_statbuf.st_uid);
-  if (NULL != pwd)
-    statLine += std::string(pwd->pw_name);
-  else
-    statLine += "?";
-  statLine += " " + uintToString(src_statbuf.st_uid);
+/* character of column 0 to 2 of triad 0 (user), 1 (group) or 2 (others),
+   index has the read, write and execute bits and the special bit as 8 */
+constexpr char triadChar(const unsigned int triad, const unsigned int index, const unsigned int column)
+{
+  return column == 0 ? ((index & 4) ? 'r' : '-')
+       : column == 1 ? ((index & 2) ? 'w' : '-')
+       : executeChar(triad, (index & 1) != 0, (index & 8) != 0);
+}
+
+/* the three characters of each triad, for all combinations of its bits */
+struct TriadStrings {
+    char chars[48][4]; /* 16 * triad + index of triadChar(), column - fourth one is padding */
+};//struct
+
+template<unsigned int... I>
+constexpr TriadStrings makeTriadStrings(Indices<I...>)
+{
+  return TriadStrings{ { { triadChar(I / 16, I % 16, 0), triadChar(I / 16, I % 16, 1), triadChar(I / 16, I % 16, 2), '\0' }... } };
+}
+
+static constexpr TriadStrings cTriadStrings = makeTriadStrings(MakeIndices<48>::type());
+
+/* marks invalid characters in cModeBits */
+static const unsigned int cInvalidModeChar = 0x10000;
+
+/* mode bits that a character stands for at a position of a mode string, or
+   cInvalidModeChar, if it is not allowed there */
+constexpr unsigned int modeCharBits(const unsigned int position, const char c)
+{
+  return (position % 3 == 0) ? (c == 'r' ? (0400u >> position)
+                                 : c == '-' ? 0 : cInvalidModeChar)
+       : (position % 3 == 1) ? (c == 'w' ? (0400u >> position)
+                                 : c == '-' ? 0 : cInvalidModeChar)
+       : (c == '-') ? 0
+       : (c == 'x') ? (0400u >> position)
+       : (c == executeChar(position / 3, true, true)) ? ((0400u >> position) | (04000u >> (position / 3)))
+       : (c == executeChar(position / 3, false, true)) ? (04000u >> (position / 3))
+       : cInvalidModeChar;
+}
+
+/* mode bits of all characters at one position of a mode string */
+struct ModeCharBits {
+    unsigned int bits[256]; /* indexed by the character as unsigned char */
+};//struct
+
+template<unsigned int... I>
+constexpr ModeCharBits makeModeCharBits(const unsigned int position, Indices<I...>)
+{
+  return ModeCharBits{ { modeCharBits(position, static_cast<char>(I))... } };
+}
+
+static constexpr ModeCharBits cModeBits[9] = {
+    makeModeCharBits(0, MakeIndices<256>::type()), makeModeCharBits(1, MakeIndices<256>::type()),
+    makeModeCharBits(2, MakeIndices<256>::type()), makeModeCharBits(3, MakeIndices<256>::type()),
+    makeModeCharBits(4, MakeIndices<256>::type()), makeModeCharBits(5, MakeIndices<256>::type()),
+    makeModeCharBits(6, MakeIndices<256>::type()), makeModeCharBits(7, MakeIndices<256>::type()),
+    makeModeCharBits(8, MakeIndices<256>::type())
+};
+
+void SaveRestore::appendModeString(const mode_t mode, std::string& modeString)
+{
+  // one table entry per triad, the special bit is the fourth bit of the index
+  const char * const user = cTriadStrings.chars[((mode >> 6) & 7) | ((mode & S_ISUID) >> 8)];
+  const char * const group = cTriadStrings.chars[16 + (((mode >> 3) & 7) | ((mode & S_ISGID) >> 7))];
+  const char * const others = cTriadStrings.chars[32 + ((mode & 7) | ((mode & S_ISVTX) >> 6))];
+  const char chars[9] = { user[0], user[1], user[2], group[0], group[1], group[2], others[0], others[1], others[2] };
+  modeString.append(chars, 9);
+}
+
+void SaveRestore::getStatString(const FileStatus& status, const std::string& fileName, std::string& statLine)
+{
+  statLine.clear();
+  appendStatString(status, fileName, statLine);
+}
 
-  // space before group name
-  statLine += " ";
+void SaveRestore::appendStatString(const FileStatus& status, const std::string& fileName, std::string& statLine)
+{
+  appendModeString(status.mode, statLine);
 
-  const struct group * grp = getgrgid(src_statbuf.st_gid);
-  if (NULL != grp)
-    statLine += std::string(grp->gr_name);
+  // The cache is thread-safe, because save() may run on several threads.
+  NameCache& names = NameCache::shared();
+  statLine.push_back(' ');
+  const std::string * name = names.userName(status.userID);
+  if (name != NULL)
+    statLine.append(*name);
   else
-    statLine += "?";
-  statLine += " " + uintToString(src_statbuf.st_gid);
+    statLine.push_back('?');
+  statLine.push_back(' ');
+  appendUint(statLine, status.userID);
 
-  // file name + space
-  if (removeSuffix.empty())
-  {
-    statLine += " " + src_path;
-  }
+  statLine.push_back(' ');
+  name = names.groupName(status.groupID);
+  if (name != NULL)
+    statLine.append(*name);
   else
-  {
-    if (src_path.substr(0, removeSuffix.size()) == removeSuffix)
-    {
-      std::string temp(src_path);
-      temp.erase(0, removeSuffix.size());
-      statLine += " " + temp;
-    }
-    else
-    {
-      statLine += " " + src_path;
-    }
-  } // else (removeSuffix not empty)
-  return true;
+    statLine.push_back('?');
+  statLine.push_back(' ');
+  appendUint(statLine, status.groupID);
+
+  statLine.push_back(' ');
+  statLine.append(fileName);
 }
 
 
 bool SaveRestore::stringToMode(const std::string& mode_string, mode_t& mode)
+{
+  return stringToMode(mode_string.data(), mode_string.size(), mode);
+}
+
+bool SaveRestore::stringToMode(const char * mode_string, const std::size_t length, mode_t& mode)
 {
   // string should be exactly nine characters long
-  if (mode_string.size() != 9)
+  if (length != 9)
+    return false;
+  // Each character has its bits at its position, invalid characters have an
+  // additional bit, so the whole string is checked at once.
+  const unsigned char * const chars = reinterpret_cast<const unsigned char*>(mode_string);
+  const unsigned int bits = cModeBits[0].bits[chars[0]] | cModeBits[1].bits[chars[1]] | cModeBits[2].bits[chars[2]]
+                          | cModeBits[3].bits[chars[3]] | cModeBits[4].bits[chars[4]] | cModeBits[5].bits[chars[5]]
+                          | cModeBits[6].bits[chars[6]] | cModeBits[7].bits[chars[7]] | cModeBits[8].bits[chars[8]];
+  if ((bits & cInvalidModeChar) != 0)
     return false;
-  // read access for user
-  switch(mode_string[0])
-  {
-    case 'r':
-         mode = S_IRUSR;
-         break;
-    case '-':
-         mode = 0;
-         break;
-    default:
-         // invalid character
-         return false;
-  } // swi
-
-  // write access for user
-  switch(mode_string[1])
-  {
-    case 'w':
-         mode |= S_IWUSR;
-         break;
-    case '-':
-         // mode |= 0;
-         break;
-    default:
-         // invalid character
-         return false;
-  } // swi
-
-  // executable status for user
-  switch(mode_string[2])
-  {
-    case 'x':
-         mode |= S_IXUSR;
-         break;
-    case '-':
-         // mode |= 0;
-         break;
-    case 's':
-         mode |= (S_IXUSR | S_ISUID);
-         break;
-    case 'S':
-         mode |= S_ISUID;
-         break;
-    default:
-         // invalid character
-         return false;
-  } // swi
-
-  // read access for group
-  switch(mode_string[3])
-  {
-    case 'r':
-         mode |= S_IRGRP;
-         break;
-    case '-':
-         // mode |= 0;
-         break;
-    default:
-         // invalid character
-         return false;
-  }
-
-  // write access for group
-  switch(mode_string[4])
-  {
-    case 'w':
-         mode |= S_IWGRP;
-         break;
-    case '-':
-         // mode |= 0;
-         break;
-    default:
-         // invalid character
-         return false;
-  }
-
-  // executable status for group
-  switch(mode_string[5])
-  {
-    case 'x':
-         mode |= S_IXGRP;
-         break;
-    case '-':
-         // mode |= 0;
-         break;
-    case 's':
-         mode |= (S_IXGRP | S_ISGID);
-         break;
-    case 'S':
-         mode |= S_ISGID;
-         break;
-    default:
-         // invalid character
-         return false;
-  }
-
-  // read access for others
-  switch(mode_string[6])
-  {
-    case 'r':
-         mode |= S_IROTH;
-         break;
-    case '-':
-         // mode |= 0;
-         break;
-    default:
-         // invalid character
-         return false;
-  } // swi
-
-  // write access for others
-  switch(mode_string[7])
-  {
-    case 'w':
-         mode |= S_IWOTH;
-         break;
-    case '-':
-         // mode |= 0;
-         break;
-    default:
-         // invalid character
-         return false;
-  }
-
-  // executable bit for others
-  switch(mode_string[8])
-  {
-    case 'x':
-         mode |= S_IXOTH;
-         break;
-    case '-':
-         // mode |= 0;
-         break;
-    case 't':
-         mode |= (S_IXOTH | S_ISVTX);
-         break;
-    case 'T':
-         mode |= S_ISVTX;
-         break;
-    default:
-         // invalid character
-         return false;
-  }
-
-  // finished successfully
+  mode = bits;
   return true;
 }
 
-bool SaveRestore::stringToUID(const std::string& user_name, const std::string& uid_string, uid_t& UID)
+bool SaveRestore::lookUpID(const std::string& name, const bool user, unsigned int& id)
 {
-  if ((user_name != "?") && (!user_name.empty()))
+  if (mPreloadedIDs)
   {
-    // Can we use the cache and is the name already in the cache?
-    if (mUseCache)
-    {
-      const std::map<std::string, uid_t>::const_iterator found = mUserCache.find(user_name);
-      if (found != mUserCache.end())
-        return found->second;
-    }
-    const struct passwd* ptr = getpwnam(user_name.c_str());
-    if (ptr != NULL)
+    // Names that the databases did not list are unknown, so they are not
+    // looked up again.
+    ++mLookups.cached;
+    const FlatNameMap<unsigned int>& table = user ? mPreloadedIDs->users : mPreloadedIDs->groups;
+    const unsigned int * found = table.find(name);
+    if (found == NULL)
+      return false;
+    id = *found;
+    return true;
+  }
+  FlatNameMap<CachedID>& cache = user ? mUserCache : mGroupCache;
+  // Can we use the cache and is the name already in the cache?
+  if (mUseCache)
+  {
+    const CachedID * found = cache.find(name);
+    if (found != NULL)
     {
-      UID = ptr->pw_uid;
-      if (mUseCache)
-        mUserCache[user_name] = ptr->pw_uid;
-      return true;
+      ++mLookups.cached;
+      id = found->id;
+      return found->known;
     }
-  } // if user_name not "?"
+  }
+  ++mLookups.database;
+  CachedID entry;
+  entry.id = 0;
+  if (user)
+  {
+    uid_t UID = 0;
+    entry.known = getUserID(name, UID);
+    entry.id = UID;
+  }
+  else
+  {
+    gid_t GID = 0;
+    entry.known = getGroupID(name, GID);
+    entry.id = GID;
+  }
+  if (mUseCache)
+  {
+    // Unknown names are cached, too, so they are looked up only once.
+    cache.insert(name, entry);
+    // messages about changed ownership need the name again
+    if (entry.known && user)
+      NameCache::shared().addUser(entry.id, name);
+    else if (entry.known)
+      NameCache::shared().addGroup(entry.id, name);
+  }
+  id = entry.id;
+  return entry.known;
+}
+
+bool SaveRestore::stringToUID(const std::string& user_name, const std::string& uid_string, uid_t& UID)
+{
+  unsigned int id = 0;
+  if (!mNumericIDs && (user_name != "?") && (!user_name.empty()) && lookUpID(user_name, true, id))
+  {
+    UID = id;
+    return true;
+  }
   // fall back on uid string
   unsigned int possibleUID = 0;
   if (stringToUint(uid_string, possibleUID))
@@ -359,25 +331,12 @@ bool SaveRestore::stringToUID(const std::string& user_name, const std::string& u
 
 bool SaveRestore::stringToGID(const std::string& group_name, const std::string& gid_string, gid_t& GID)
 {
-  if ((group_name != "?") && (!group_name.empty()))
+  unsigned int id = 0;
+  if (!mNumericIDs && (group_name != "?") && (!group_name.empty()) && lookUpID(group_name, false, id))
   {
-    // Can we use the cache and is the name in the cache already?
-    if (mUseCache)
-    {
-      const std::map<std::string, gid_t>::const_iterator found = mGroupCache.find(group_name);
-      if (found != mGroupCache.end())
-        return found->second;
-    }
-
-    const struct group* ptr = getgrnam(group_name.c_str());
-    if (ptr != NULL)
-    {
-      GID = ptr->gr_gid;
-      if (mUseCache)
-        mGroupCache[group_name] = ptr->gr_gid;
-      return true;
-    }
-  } // if group_name not "?"
+    GID = id;
+    return true;
+  }
   // fall back on gid string
   unsigned int possibleGID = 0;
   if (stringToUint(gid_string, possibleGID))
@@ -390,327 +349,1798 @@ bool SaveRestore::stringToGID(const std::string& group_name, const std::string&
 
 bool SaveRestore::statLineToData(const std::string& statLine, mode_t& mode, uid_t& UID, gid_t& GID, std::string& filename)
 {
-  if (statLine.empty())
+  StatLineFields fields;
+  if (!splitStatLine(statLine.data(), statLine.size(), fields)
+      or !stringToMode(fields.mode.data, fields.mode.size, mode)
+      or !stringToUID(fields.userName.str(), fields.userID.str(), UID)
+      or !stringToGID(fields.groupName.str(), fields.groupID.str(), GID))
     return false;
+  filename.assign(fields.path.data, fields.path.size);
+  return true;
+}
 
-  std::string modeString;
-  std::string name;
-  std::string idString;
-  filename.clear();
+/* node of the directory tree that is built by a parallel save */
+struct SaveRestore::SaveNode
+{
+  std::string records; /* encoded records of the entries of the directory */
+  std::vector<std::unique_ptr<SaveNode> > children; /* one node per subdirectory, in the order of the records */
+  bool done; /* whether records and children are complete */
 
-  std::string::const_iterator sIter = statLine.begin();
-  while (sIter != statLine.end())
-  {
-    if (*sIter != ' ')
-    {
-      modeString.push_back(*sIter);
-    }
-    else
-    {
-      // space - break out of loop
-      break;
-    }
-    ++sIter;
-  }
-  if (!stringToMode(modeString, mode))
-    return false;
+  SaveNode()
+  : records(), children(), done(false)
+  { }
+};//struct
 
-  if (sIter == statLine.end())
-    return false;
-  ++sIter;
-  while (sIter != statLine.end())
+/* shared state of the workers of a parallel save */
+struct SaveRestore::ParallelSave
+{
+  WorkStealingPool pool; /* pool that executes one task per directory */
+  std::vector<std::unique_ptr<DirectoryReader> > readers; /* one reader per worker */
+  std::vector<std::unique_ptr<StatEngine> > engines; /* one stat engine per worker */
+  std::mutex outputMutex; /* serializes messages of the tasks */
+  std::mutex nodeMutex; /* protects SaveNode::done and finished */
+  std::condition_variable nodeDone; /* signals completed nodes to the writer */
+  std::atomic<bool> failed; /* whether any task failed */
+  bool finished; /* whether the pool has finished */
+  std::string basePath; /* path of the saved directory, used for messages */
+  bool verbose;
+  StatFileWriter& writer; /* encodes the records, writes them in the writer thread */
+
+  ParallelSave(const unsigned int jobs, const std::string& base, const bool verb, StatFileWriter& statWriter)
+  : pool(jobs), readers(), engines(), outputMutex(), nodeMutex(), nodeDone(),
+    failed(false), finished(false), basePath(base), verbose(verb), writer(statWriter)
   {
-    if (*sIter != ' ')
-    {
-      name.push_back(*sIter);
-    }
-    else
+    for (unsigned int i = 0; i < pool.workers(); ++i)
     {
-      // space - break out of loop
-      break;
+      readers.push_back(std::unique_ptr<DirectoryReader>(new DirectoryReader()));
+      engines.push_back(StatEngine::create());
     }
-    ++sIter;
   }
+};//struct
 
-  // skip space
-  if (sIter == statLine.end())
+bool SaveRestore::save(const std::string& src_directory, const std::string& statFileName, const bool verbose, const unsigned int jobs, const StatFileFormat format, const Compression compression)
+{
+  // We don't want to overwrite an existing file.
+  if (fileExists(statFileName))
+  {
+    if (verbose)
+      LogSink::errors() << "Error: file " << statFileName << " already exists and we do not want to overwrite it.\n";
     return false;
-  ++sIter;
+  }
 
-  while (sIter != statLine.end())
+  DirectoryStack stack(DirectoryStack::maxOpenFor(1));
+  if (!stack.open(src_directory))
   {
-    if (*sIter != ' ')
-    {
-      idString.push_back(*sIter);
-    }
-    else
-    {
-      // space - break out of loop
-      break;
-    }
-    ++sIter;
+    if (verbose)
+      LogSink::errors() << "Error: Directory \"" << src_directory << "\" does not exist or is empty.\n";
+    return false;
   }
-
-  if (!stringToUID(name, idString, UID))
+  if (!MountBoundary::shared().setRoot(*stack.top()))
+  {
+    if (verbose)
+      LogSink::errors() << "Error: Could not get the file system of directory \"" << src_directory << "\".\n";
     return false;
+  }
 
-  // skip space
-  if (sIter == statLine.end())
+  // open file for writing, it is compressed on the fly
+  CompressingBuffer statBuffer;
+  std::string error;
+  if (!statBuffer.open(statFileName, compression, jobs, error))
+  {
+    if (verbose)
+      LogSink::errors() << "Error: Could not create/open file " << statFileName << ": " << error << "\n";
     return false;
-  ++sIter;
-
-  name.clear();
-  idString.clear();
+  }
+  std::ostream statStream(&statBuffer);
 
-  while (sIter != statLine.end())
+  StatFileWriter writer(format, statStream);
+  bool success = writer.begin();
+  if (!success)
   {
-    if (*sIter != ' ')
-    {
-      name.push_back(*sIter);
-    }
-    else
-    {
-      // space - break out of loop
-      break;
-    }
-    ++sIter;
+    if (verbose)
+      LogSink::errors() << "Error: Failed to write to info file.\n";
   }
-
-  // skip space
-  if (sIter == statLine.end())
-    return false;
-  ++sIter;
-
-  while (sIter != statLine.end())
+  else if (jobs <= 1)
   {
-    if (*sIter != ' ')
-    {
-      idString.push_back(*sIter);
-    }
-    else
-    {
-      // space - break out of loop
-      break;
-    }
-    ++sIter;
+    DirectoryReader reader;
+    std::unique_ptr<StatEngine> engine = StatEngine::create();
+    success = saveIterative(stack, slashify(src_directory), reader, *engine, writer, verbose);
   }
-
-  if (!stringToGID(name, idString, GID))
-    return false;
-
-  // skip space
-  if (sIter == statLine.end())
-    return false;
-  ++sIter;
-
-  filename = std::string(sIter, statLine.end());
-  return (!filename.empty());
+  else
+  {
+    // tasks share their parent directory, so the root needs its own handle
+    std::shared_ptr<DirectoryHandle> directory = std::make_shared<DirectoryHandle>();
+    success = directory->openAt(*stack.top(), ".")
+          and saveParallel(directory, slashify(src_directory), writer, verbose, jobs);
+  }
+  // close file, this writes the end of the compressed data
+  if (!statBuffer.close(error) and success)
+  {
+    if (verbose)
+      LogSink::errors() << "Error: Failed to write to info file: " << error << "\n";
+    success = false;
+  }
+  if (success and verbose and (writer.links() > 0))
+    std::cout << "Hard links: " << writer.links() << " entries were saved as links of an inode that was saved before.\n";
+  return success;
 }
 
-bool SaveRestore::save(const std::string& src_directory, const std::string& statFileName, const bool verbose)
+bool SaveRestore::saveDirectoryEntries(const DirectoryHandle& directory, const std::string& basePath, std::string& relativePath, DirectoryReader& reader, StatEngine& engine, StatFileWriter& writer, std::string& records, const bool writeBatches, std::string& subDirectories, std::ostream& out, const bool verbose)
 {
-  // We don't want to overwrite an existing file.
-  if (fileExists(statFileName))
+  // directory does not exist or is not readable
+  if (!reader.open(directory))
   {
     if (verbose)
-      std::cout << "Error: file " << statFileName << " already exists and we do not want to overwrite it.\n";
+      LogSink::errors(out) << "Error: Directory \"" << basePath << relativePath << "\" does not exist or is empty.\n";
     return false;
   }
 
-  // open file for writing
-  std::ofstream statStream(statFileName.c_str(), std::ios::out | std::ios::binary);
-  if (!statStream.good())
+  // Entries are queried in batches, the engine copies their names.
+  engine.clear();
+  std::vector<StatResult> results;
+  PathFilter& filter = PathFilter::shared();
+  DirectoryEntryView entry;
+  while (reader.next(entry))
+  {
+    // excluded entries are skipped before their status is queried
+    if (entry.isDotOrDotDot() or isUnwantedType(entry.type)
+        or filter.excludes(relativePath, 0, entry.name, entry.length, entry.type))
+      continue;
+    #ifdef DEBUG
+    out << "DEBUG: entry " << basePath << relativePath << entry.name << "\n";
+    #endif // DEBUG
+    engine.add(entry.name, entry.length, entry.type);
+    if (engine.full() and !saveBatch(directory, basePath, relativePath, engine, results, writer, records, writeBatches, subDirectories, out, verbose))
+      return false;
+  } // while
+  if (reader.error() != 0)
   {
     if (verbose)
-      std::cout << "Error: Could not create/open file " << statFileName << ".\n";
+      LogSink::errors(out) << "Error: Could not read directory \"" << basePath << relativePath << "\".\n";
     return false;
   }
-
-  const bool success = saveRecursive(src_directory, slashify(src_directory), statStream, verbose);
-  // close file
-  statStream.close();
-  return success;
+  reader.close();
+  return saveBatch(directory, basePath, relativePath, engine, results, writer, records, writeBatches, subDirectories, out, verbose);
 }
 
-bool SaveRestore::saveRecursive(const std::string& src_directory, const std::string& removeSuffix, std::ofstream& statStream, const bool verbose)
+bool SaveRestore::saveBatch(const DirectoryHandle& directory, const std::string& basePath, std::string& relativePath, StatEngine& engine, std::vector<StatResult>& results, StatFileWriter& writer, std::string& records, const bool writeBatches, std::string& subDirectories, std::ostream& out, const bool verbose)
 {
-  const std::vector<FileEntry> files = getDirectoryFileList(src_directory);
-  // empty directory or directory does not exist
-  if (files.empty())
+  engine.query(directory, results);
+  PathFilter& filter = PathFilter::shared();
+  const std::string::size_type prefixLength = relativePath.size();
+  for (std::size_t i = 0; i < engine.size(); ++i)
   {
-    if (verbose)
-      std::cout << "Error: Directory \"" << src_directory << "\" does not exist or is empty.\n";
-    return false;
-  }
-
-  #ifdef DEBUG
+    // only entries of unknown type still need to be checked
+    if ((0 == results[i].error)
+        and filter.excludesQueried(relativePath, 0, engine.name(i), engine.length(i), engine.type(i), results[i].status.st_mode))
+      continue;
+    relativePath.append(engine.name(i), engine.length(i));
+    // handle file/directory itself
+    if (0 != results[i].error)
+    {
+      if (verbose)
+        LogSink::errors(out) << "Error: Could not generate info line for file " << (basePath + relativePath) << ".\n";
+      return false;
+    }
+    const struct stat& statbuf = results[i].status;
+    if (!isUnwantedMode(statbuf.st_mode)
+        and !MountBoundary::shared().outside(statbuf, basePath, relativePath, out, verbose))
+    {
+      writer.encode(FileStatus(statbuf), relativePath, records);
+      if (S_ISDIR(statbuf.st_mode))
+        subDirectories.append(engine.name(i), engine.length(i) + 1);
+    }
+    relativePath.resize(prefixLength);
+  } // for
+  engine.clear();
+  // write to file
+  if (writeBatches)
   {
-    std::cout << "DEBUG: content of files (" << files.size() << " entries):\n";
-    unsigned int i;
-    for (i = 0; i < files.size(); ++i)
+    if (!writer.write(records))
     {
-      std::cout << (files[i].isDirectory ? "  d " : "  f ") << files[i].fileName << "\n";
-    } //for
-    std::cout << "--- end of files ---\n";
-  } //scope
-  #endif // DEBUG
+      if (verbose)
+        LogSink::errors(out) << "Error: Failed to write to info file.\n";
+      return false;
+    }
+    records.clear();
+  }
+  return true;
+}
 
-  unsigned int i;
-  for (i = 0; i < files.size(); ++i)
+bool SaveRestore::saveIterative(DirectoryStack& stack, const std::string& basePath, DirectoryReader& reader, StatEngine& engine, StatFileWriter& writer, const bool verbose)
+{
+  /* level of the walk - the names of the subdirectories are null-terminated
+     and saved after the directory has been read completely, because the
+     reader's buffer will be reused */
+  struct Level
+  {
+    std::string subDirectories;
+    std::string::size_type next; /* offset of the next subdirectory */
+    std::string::size_type pathLength; /* length of relativePath for this level */
+  };
+  std::vector<Level> levels;
+  // path relative to basePath, with trailing slash (empty for basePath itself)
+  std::string relativePath;
+  // records of the current batch
+  std::string records;
+  bool newLevel = true;
+  while (true)
   {
-    if ((files[i].fileName != "..") and (files[i].fileName != "."))
+    if (newLevel)
     {
-      // handle file/directory itself
-      std::string line;
-      if (!getStatString(slashify(src_directory)+files[i].fileName, removeSuffix, line))
+      // read the directory on top of the stack
+      const DirectoryHandle * directory = stack.top();
+      if (directory == NULL)
       {
         if (verbose)
-          std::cout << "Error: Could not generate info line for file " << (slashify(src_directory)+files[i].fileName) << ".\n";
+          LogSink::errors() << "Error: Directory \"" << basePath << relativePath << "\" does not exist or is empty.\n";
         return false;
       }
-      // write to file
-      statStream.write(line.c_str(), line.size());
-      statStream.write("\n", 1);
-      if (!statStream.good())
-      {
-        if (verbose)
-          std::cout << "Error: Failed to write to info file.\n";
+      levels.push_back(Level());
+      levels.back().next = 0;
+      levels.back().pathLength = relativePath.size();
+      if (!saveDirectoryEntries(*directory, basePath, relativePath, reader, engine, writer, records, true, levels.back().subDirectories, std::cout, verbose))
         return false;
-      }
+      newLevel = false;
+    }
+
+    Level& level = levels.back();
+    relativePath.resize(level.pathLength);
+    if (level.next >= level.subDirectories.size())
+    {
+      // directory is done, continue with its parent
+      levels.pop_back();
+      if (levels.empty())
+        return true;
+      stack.pop();
+      continue;
+    }
+
+    // handle next subdirectory
+    const char * name = level.subDirectories.c_str() + level.next;
+    level.next += std::strlen(name) + 1;
+    relativePath.append(name).append(1, pathDelimiter);
+    if (!stack.push(name))
+    {
+      if (verbose)
+        LogSink::errors() << "Error: Directory \"" << basePath << relativePath << "\" does not exist or is empty.\n";
+      return false;
+    }
+    newLevel = true;
+  } // while
+}
+
+bool SaveRestore::saveParallel(const std::shared_ptr<DirectoryHandle>& directory, const std::string& basePath, StatFileWriter& writer, const bool verbose, const unsigned int jobs)
+{
+  ParallelSave state(jobs, basePath, verbose, writer);
+  SaveNode root;
+  state.pool.submit(0, [&state, directory, &root] (const unsigned int worker)
+    {
+      saveDirectoryTask(state, worker, directory, std::string(), &root);
+    });
 
-      // handle directory content, if it's a directory
-      if (files[i].isDirectory)
+  // The writer emits the records of completed directories in the same order
+  // as the sequential save, while the workers are still busy with the rest.
+  bool written = false;
+  std::thread writerThread([&state, &root, &written] ()
+    {
+      written = writeNodes(state, root);
+    });
+  state.pool.run();
+  {
+    std::lock_guard<std::mutex> lock(state.nodeMutex);
+    state.finished = true;
+  }
+  state.nodeDone.notify_all();
+  writerThread.join();
+  return written and !state.failed;
+}
+
+void SaveRestore::saveDirectoryTask(ParallelSave& state, const unsigned int worker, const std::shared_ptr<DirectoryHandle>& directory, std::string relativePath, SaveNode * node)
+{
+  // Messages are collected per directory, so that lines of different
+  // workers do not get mixed up.
+  MessageBuffer out;
+  std::string subDirectories;
+  const bool success = saveDirectoryEntries(*directory, state.basePath, relativePath, *state.readers[worker], *state.engines[worker], state.writer, node->records, false, subDirectories, out.messages(), state.verbose);
+
+  // Subdirectories are opened by their own task, so that queued tasks only
+  // keep their parents open instead of one descriptor per task.
+  std::string::size_type start = 0;
+  while (success and (start < subDirectories.size()))
+  {
+    const std::string name(subDirectories.c_str() + start);
+    start += name.size() + 1;
+    const std::string subPath = relativePath + name + pathDelimiter;
+    node->children.push_back(std::unique_ptr<SaveNode>(new SaveNode()));
+    SaveNode * child = node->children.back().get();
+    state.pool.submit(worker, [&state, directory, name, subPath, child] (const unsigned int w)
       {
-        if (!saveRecursive(slashify(src_directory)+files[i].fileName, removeSuffix, statStream, verbose))
+        std::shared_ptr<DirectoryHandle> subDirectory = std::make_shared<DirectoryHandle>();
+        if (!subDirectory->openAt(*directory, name.c_str()))
         {
-          return false;
+          MessageBuffer message;
+          if (state.verbose)
+            message.errors() << "Error: Directory \"" << state.basePath << subPath << "\" does not exist or is empty.\n";
+          finishNode(state, child, message, false);
+          return;
         }
-      }
-    } // if not dot or dot+dot
-  } // for
-  return true;
+        saveDirectoryTask(state, w, subDirectory, subPath, child);
+      });
+  } // while
+  finishNode(state, node, out, success);
 }
 
-bool SaveRestore::restore(const std::string& dest_directory, const std::string& statFileName, const bool permissions, const bool ownership, const bool verbose, const bool dryRun)
+void SaveRestore::finishNode(ParallelSave& state, SaveNode * node, MessageBuffer& out, const bool success)
 {
-  if (!(permissions || ownership))
+  if (out.size() > 0)
   {
-    std::cout << "Hint: No stats to change!\n";
-    return true;
+    std::lock_guard<std::mutex> lock(state.outputMutex);
+    out.write(std::cout);
   }
-  if (!fileExists(statFileName))
+  if (!success)
   {
-    std::cout << "Error: file " << statFileName << " does not exist.\n";
-    return false;
+    state.failed = true;
+    state.pool.stop();
   }
-
-  // open file for reading
-  std::ifstream statStream(statFileName.c_str(), std::ios::in | std::ios::binary);
-  if (!statStream.good())
   {
-    std::cout << "Error: Could not open file " << statFileName << ".\n";
-    return false;
+    std::lock_guard<std::mutex> lock(state.nodeMutex);
+    node->done = true;
   }
+  // The node must not be used after this point, the writer may delete it.
+  state.nodeDone.notify_all();
+}
 
-
-  mode_t mode;
-  uid_t UID;
-  gid_t GID;
-  std::string file;
-
-  struct stat dest_statbuf;
-  int ret = 0;
-
-  const unsigned int cMaxLine = 256;
-  char buffer[cMaxLine];
-  std::string line = "";
-  while (statStream.getline(buffer, cMaxLine-1))
+bool SaveRestore::writeNodes(ParallelSave& state, SaveNode& root)
+{
+  // pre-order traversal: records of a directory, then its subdirectories
+  std::vector<std::pair<SaveNode*, std::vector<std::unique_ptr<SaveNode> >::size_type> > stack;
+  SaveNode * next = &root;
+  while (next != NULL)
   {
-    buffer[cMaxLine-1] = '\0';
-    line = std::string(buffer);
-    if (!statLineToData(line, mode, UID, GID, file))
     {
-      statStream.close();
-      std::cout << "Error: Could not extract data from line \"" << line << "\"!\n";
+      std::unique_lock<std::mutex> lock(state.nodeMutex);
+      state.nodeDone.wait(lock, [&state, next] { return next->done or state.finished or state.failed; });
+      if (!next->done or state.failed)
+        return false;
+    }
+    if (!state.writer.write(next->records))
+    {
+      if (state.verbose)
+      {
+        std::lock_guard<std::mutex> lock(state.outputMutex);
+        LogSink::errors() << "Error: Failed to write to info file.\n";
+      }
+      state.failed = true;
+      state.pool.stop();
       return false;
     }
+    std::string().swap(next->records);
+    stack.push_back(std::make_pair(next, 0));
 
-
-    const std::string destinationFile(slashify(dest_directory) + file);
-
-    ret = lstat(destinationFile.c_str(), &dest_statbuf);
-    if (0 != ret)
+    // find next node: first unwritten child of the deepest node
+    next = NULL;
+    while (!stack.empty() and (next == NULL))
     {
-      const int errorCode = errno;
-      if (errorCode != ENOENT)
+      SaveNode * node = stack.back().first;
+      const std::vector<std::unique_ptr<SaveNode> >::size_type index = stack.back().second;
+      if (index < node->children.size())
       {
-        std::cout << "Error while querying status of \"" << destinationFile << "\": Code "
-                  << errorCode << " (" << strerror(errorCode) << ").\n";
-        statStream.close();
-        return false;
+        // free the previous child, it has been written completely
+        if (index > 0)
+          node->children[index - 1].reset();
+        next = node->children[index].get();
+        ++stack.back().second;
       }
       else
       {
-        // destination file does not exist, skip silently - except when verbose
-        if (verbose or dryRun)
-          std::cout << "Info: file \""<<destinationFile<<"\" does not exist, skipping.\n";
+        node->children.clear();
+        stack.pop_back();
       }
+    } // while
+  } // while
+  return true;
+}
+
+/* directory mode change that is applied after the content of the directory */
+struct SaveRestore::DeferredMode
+{
+  std::string::size_type position; /* position of the line in the stat file */
+  std::string file; /* path relative to the destination directory */
+  mode_t mode; /* new mode */
+  mode_t oldMode; /* mode before the change, used for messages */
+};//struct
+
+/* parsed line of the stat file in the index of restoreByWalk() */
+struct SaveRestore::IndexedLine
+{
+  std::string::size_type position; /* position of the line in the stat file */
+  mode_t mode;
+  uid_t UID;
+  gid_t GID;
+  bool found; /* whether the entry was found in the destination directory */
+};//struct
+
+/* index of restoreByWalk(): paths relative to the destination and their lines */
+struct SaveRestore::LineIndex
+{
+  PathIndex paths; /* the paths, the ID of a path is the index of its line */
+  std::vector<IndexedLine> lines; /* line per path ID */
+};//struct
+
+/* parsed line of the stat file whose entry waits for the status query of its batch */
+struct SaveRestore::PendingLine
+{
+  std::string::size_type position; /* position of the line in the stat file */
+  std::string file; /* path relative to the destination directory */
+  mode_t mode;
+  uid_t UID;
+  gid_t GID;
+};//struct
+
+/* resolved definitions of users, groups and inodes of a binary or dictionary stat file */
+struct SaveRestore::ResolvedNames
+{
+  /* stats of an inode whose hard links are saved as links */
+  struct Inode {
+      mode_t mode;
+      uid_t UID;
+      gid_t GID;
+  };//struct
+
+  std::vector<uid_t> users;  /* user ID per user index */
+  std::vector<gid_t> groups; /* group ID per group index */
+  std::vector<Inode> inodes; /* stats per inode index */
+};//struct
+
+/* reads the lines of a stat file one by one */
+class SaveRestore::EntryReader
+{
+  public:
+    EntryReader()
+    : mError()
+    { }
+
+    virtual ~EntryReader()
+    { }
+
+    /* reads the next line - returns false at the end or on errors */
+    virtual bool next(PendingLine& entry) = 0;
+
+    /* returns true, if next() stopped because of an error */
+    bool failed() const
+    {
+      return !mError.empty();
     }
-    else
+
+    /* gets the message of the error */
+    const std::string& error() const
     {
-      // mode change requested?
-      if (permissions)
+      return mError;
+    }
+  protected:
+    std::string mError; /* message of the error, empty if there was none */
+};//class
+
+/* parses the lines of a text stat file, with or without dictionary */
+class SaveRestore::TextEntryReader: public EntryReader
+{
+  public:
+    /* If names is NULL, lines contain the names and IDs of users and groups.
+       Otherwise the file has a dictionary and lines contain indices. If define
+       is true, definitions are resolved and added to names. Otherwise they
+       are skipped, and names has to contain all of them. */
+    TextEntryReader(SaveRestore& parser, ResolvedNames * names, const bool define)
+    : EntryReader(), mParser(parser), mNames(names), mDefine(define),
+      mUserName(), mUserID(), mUID(0), mGroupName(), mGroupID(), mGID(0)
+    { }
+  protected:
+    /* parses a line with the given spaces - isEntry is set to false for
+       lines of the dictionary, returns false on errors */
+    bool parseLine(const TextView& line, const LineTokens& tokens, PendingLine& entry, bool& isEntry)
+    {
+      isEntry = true;
+      bool parsed;
+      if (mNames == NULL)
+        parsed = parseNamedEntry(line, tokens, entry);
+      else if ((line.size > 0) and (line.data[0] == '#'))
       {
-        if (Mode::onlyPermissions(dest_statbuf.st_mode) != Mode::onlyPermissions(mode))
+        if (line.startsWith(DictionaryStatFormat::cLink))
+          parsed = parseLinkEntry(line, tokens, entry);
+        else
         {
-          if (verbose or dryRun)
-            std::cout << (dryRun ? "Would change mode of " : "Changing mode of ")
-                      << destinationFile << " from " << std::oct << Mode::onlyPermissions(dest_statbuf.st_mode)
-                      << " to " << std::oct << Mode::onlyPermissions(mode) << std::dec <<"...\n";
-          if (!dryRun)
-          {
-            ret = chmod(destinationFile.c_str(), mode);
-            if (0 != ret)
-            {
-              int errorCode = errno;
-              std::cout << "Error while changing mode of \"" << destinationFile
-                        << "\": Code " << errorCode << " (" << strerror(errorCode) << ").\n";
-              statStream.close();
-              return false;
-            } // if ret != 0
-          } // if not dryRun
-        } // if permissions do not match
-      } // if permissions shall be adjusted
-
-      if (ownership)
+          isEntry = false;
+          return define(line.str());
+        }
+      }
+      else
+        parsed = parseIndexedEntry(line, tokens, entry);
+      if (!parsed)
+        mError = "Could not extract data from line \"" + line.str() + "\"!";
+      return parsed;
+    }
+  private:
+    SaveRestore& mParser;
+    ResolvedNames * mNames;
+    bool mDefine;
+    // Owner and group of the previous line. Consecutive lines usually have
+    // the same ones, so they only have to be resolved when they change.
+    std::string mUserName;
+    std::string mUserID;
+    uid_t mUID;
+    std::string mGroupName;
+    std::string mGroupID;
+    gid_t mGID;
+
+    /* checks whether line starts with prefix */
+    static bool startsWith(const std::string& line, const char * prefix)
+    {
+      return line.compare(0, std::strlen(prefix), prefix) == 0;
+    }
+
+    /* parses a line like "rwxr-xr-x user 1000 group 1000 path" without
+       copying its fields, except for the path */
+    bool parseNamedEntry(const TextView& line, const LineTokens& tokens, PendingLine& entry)
+    {
+      StatLineFields fields;
+      if (!splitStatLine(line, tokens, fields) or !stringToMode(fields.mode.data, fields.mode.size, entry.mode))
+        return false;
+      if (mUserName.empty() or !fields.userName.equals(mUserName) or !fields.userID.equals(mUserID))
       {
-        // check, if user and group match
-        if ((dest_statbuf.st_uid != UID) || (dest_statbuf.st_gid != GID))
+        mUserName.assign(fields.userName.data, fields.userName.size);
+        mUserID.assign(fields.userID.data, fields.userID.size);
+        if (!mParser.stringToUID(mUserName, mUserID, mUID))
         {
-          if (verbose or dryRun)
+          mUserName.clear();
+          return false;
+        }
+      }
+      if (mGroupName.empty() or !fields.groupName.equals(mGroupName) or !fields.groupID.equals(mGroupID))
+      {
+        mGroupName.assign(fields.groupName.data, fields.groupName.size);
+        mGroupID.assign(fields.groupID.data, fields.groupID.size);
+        if (!mParser.stringToGID(mGroupName, mGroupID, mGID))
+        {
+          mGroupName.clear();
+          return false;
+        }
+      }
+      entry.UID = mUID;
+      entry.GID = mGID;
+      entry.file.assign(fields.path.data, fields.path.size);
+      return true;
+    }
+
+    /* handles a line of the dictionary, names are resolved only once */
+    bool define(const std::string& line)
+    {
+      if (startsWith(line, DictionaryStatFormat::cInode))
+        return !mDefine or defineInode(line);
+      const bool user = startsWith(line, DictionaryStatFormat::cUser);
+      if (!user and !startsWith(line, DictionaryStatFormat::cGroup))
+      {
+        if (line == DictionaryStatFormat::cHeader)
+          return true;
+        mError = "Unsupported line \"" + line + "\" in stat file!";
+        return false;
+      }
+      if (!mDefine)
+        return true;
+      const std::string::size_type start = std::strlen(user ? DictionaryStatFormat::cUser : DictionaryStatFormat::cGroup);
+      const std::string::size_type space = line.rfind(' ');
+      if (space < start + 1)
+      {
+        mError = "Invalid definition \"" + line + "\" in stat file!";
+        return false;
+      }
+      const std::string name = line.substr(start, space - start);
+      const std::string id = line.substr(space + 1);
+      bool resolved;
+      if (user)
+      {
+        uid_t UID;
+        resolved = mParser.stringToUID(name, id, UID);
+        if (resolved)
+          mNames->users.push_back(UID);
+      }
+      else
+      {
+        gid_t GID;
+        resolved = mParser.stringToGID(name, id, GID);
+        if (resolved)
+          mNames->groups.push_back(GID);
+      }
+      if (!resolved)
+        mError = "Could not resolve definition \"" + line + "\" in stat file!";
+      return resolved;
+    }
+
+    /* handles a line like "#inode rw-r--r-- 0 1" of the dictionary */
+    bool defineInode(const std::string& line)
+    {
+      const std::string::size_type start = std::strlen(DictionaryStatFormat::cInode);
+      const std::string::size_type userStart = line.find(' ', start) + 1;
+      const std::string::size_type groupStart = (userStart != 0) ? line.find(' ', userStart) + 1 : 0;
+      ResolvedNames::Inode inode;
+      unsigned int user = 0;
+      unsigned int group = 0;
+      if ((groupStart == 0)
+          or !stringToMode(line.data() + start, userStart - 1 - start, inode.mode)
+          or !stringToUint(line.data() + userStart, groupStart - 1 - userStart, user) or (user >= mNames->users.size())
+          or !stringToUint(line.data() + groupStart, line.size() - groupStart, group) or (group >= mNames->groups.size()))
+      {
+        mError = "Invalid definition \"" + line + "\" in stat file!";
+        return false;
+      }
+      inode.UID = mNames->users[user];
+      inode.GID = mNames->groups[group];
+      mNames->inodes.push_back(inode);
+      return true;
+    }
+
+    /* parses an entry line like "#link 0 path" of a dictionary file */
+    bool parseLinkEntry(const TextView& line, const LineTokens& tokens, PendingLine& entry)
+    {
+      if (tokens.spaceCount < 2)
+        return false;
+      const char * const end = line.data + line.size;
+      const char * const inodeStart = tokens.spaces[0] + 1;
+      const char * const inodeEnd = tokens.spaces[1];
+      unsigned int inode = 0;
+      if ((inodeEnd + 1 == end) or !stringToUint(inodeStart, inodeEnd - inodeStart, inode)
+          or (inode >= mNames->inodes.size()))
+        return false;
+      const ResolvedNames::Inode& stats = mNames->inodes[inode];
+      entry.mode = stats.mode;
+      entry.UID = stats.UID;
+      entry.GID = stats.GID;
+      entry.file.assign(inodeEnd + 1, end - inodeEnd - 1);
+      return true;
+    }
+
+    /* parses an entry line like "rwxr-xr-x 0 1 path" of a dictionary file */
+    bool parseIndexedEntry(const TextView& line, const LineTokens& tokens, PendingLine& entry)
+    {
+      if ((tokens.spaceCount < 3) or !stringToMode(line.data, tokens.spaces[0] - line.data, entry.mode))
+        return false;
+      const char * const end = line.data + line.size;
+      const char * const userStart = tokens.spaces[0] + 1;
+      const char * const userEnd = tokens.spaces[1];
+      const char * const groupStart = userEnd + 1;
+      const char * const groupEnd = tokens.spaces[2];
+      if (groupEnd + 1 == end)
+        return false;
+      unsigned int user = 0;
+      unsigned int group = 0;
+      if (!stringToUint(userStart, userEnd - userStart, user) or (user >= mNames->users.size())
+          or !stringToUint(groupStart, groupEnd - groupStart, group) or (group >= mNames->groups.size()))
+        return false;
+      entry.UID = mNames->users[user];
+      entry.GID = mNames->groups[group];
+      entry.file.assign(groupEnd + 1, end - groupEnd - 1);
+      return true;
+    }
+};//class
+
+/* reads lines of a text stat file from a (decompressing) stream buffer,
+   position is the line number */
+class SaveRestore::TextStreamReader: public TextEntryReader
+{
+  public:
+    TextStreamReader(DecompressingBuffer& input, SaveRestore& parser, ResolvedNames * names = NULL)
+    : TextEntryReader(parser, names, true), mInput(input), mLines(input), mPosition(0)
+    { }
+
+    virtual bool next(PendingLine& entry)
+    {
+      TextView line;
+      LineTokens tokens;
+      bool isEntry = false;
+      while (!isEntry)
+      {
+        if (!mLines.next(line, tokens))
+        {
+          mError = mInput.error();
+          return false;
+        }
+        entry.position = mPosition++;
+        if (!parseLine(line, tokens, entry, isEntry))
+        {
+          // a truncated file ends with an incomplete line
+          if (!mInput.error().empty())
+            mError = mInput.error();
+          return false;
+        }
+      } // while
+      return true;
+    }
+  private:
+    DecompressingBuffer& mInput;
+    LineReader mLines;
+    std::string::size_type mPosition;
+};//class
+
+/* reads the lines of a part of a text stat file in memory, position is the offset */
+class SaveRestore::TextRangeReader: public TextEntryReader
+{
+  public:
+    TextRangeReader(const char * data, const std::string::size_type start, const std::string::size_type end, SaveRestore& parser,
+                    ResolvedNames * names = NULL, const bool define = false)
+    : TextEntryReader(parser, names, define), mData(data), mNext(start), mEnd(end)
+    { }
+
+    virtual bool next(PendingLine& entry)
+    {
+      LineTokens tokens;
+      bool isEntry = false;
+      while (!isEntry)
+      {
+        if (mNext >= mEnd)
+          return false;
+        entry.position = mNext;
+        const TextView line = nextLine(tokens);
+        if (!parseLine(line, tokens, entry, isEntry))
+          return false;
+      } // while
+      return true;
+    }
+
+    /* handles all lines of the dictionary in the range, but skips entries */
+    bool readDefinitions()
+    {
+      PendingLine unused;
+      LineTokens tokens;
+      bool isEntry = false;
+      while (mNext < mEnd)
+      {
+        const TextView line = nextLine(tokens);
+        if ((line.size > 0) and (line.data[0] == '#') and !parseLine(line, tokens, unused, isEntry))
+          return false;
+      } // while
+      return true;
+    }
+  private:
+    const char * mData;
+    std::string::size_type mNext;
+    std::string::size_type mEnd;
+
+    /* gets the line at mNext and its spaces and moves mNext to the following line */
+    TextView nextLine(LineTokens& tokens)
+    {
+      const char * const start = mData + mNext;
+      tokens.spaceCount = 0;
+      const char * lineEnd = Tokenizer::fastest().scanLine(start, mData + mEnd, tokens);
+      if (lineEnd == NULL)
+        lineEnd = mData + mEnd;
+      mNext = lineEnd - mData + 1;
+      return TextView(start, lineEnd - start);
+    }
+};//class
+
+/* reads the entries of a part of a binary stat file, position is the offset
+   of the record */
+class SaveRestore::BinaryEntryReader: public EntryReader
+{
+  public:
+    /* If define is true, definitions are resolved and added to names.
+       Otherwise they are skipped, and names has to contain all of them.
+       previousPath is the path of the entry before start, it is required
+       for front-coded files. */
+    BinaryEntryReader(const BinaryStatFile& file, const std::size_t start, const std::size_t end, SaveRestore& parser,
+                      ResolvedNames& names, const bool define, const std::string& previousPath = std::string())
+    : EntryReader(), mFile(&file), mStream(NULL), mInput(NULL), mNext(start), mEnd(end), mParser(parser), mNames(names),
+      mDefine(define), mPath(previousPath)
+    { }
+
+    /* reads all records of a stream, e.g. of a compressed file, and resolves
+       the definitions */
+    BinaryEntryReader(BinaryStatStream& stream, const DecompressingBuffer& input, SaveRestore& parser, ResolvedNames& names)
+    : EntryReader(), mFile(NULL), mStream(&stream), mInput(&input), mNext(stream.begin()),
+      mEnd(std::numeric_limits<std::size_t>::max()), mParser(parser), mNames(names), mDefine(true), mPath()
+    { }
+
+    /* gets the path of the entry that was read last */
+    const std::string& path() const
+    {
+      return mPath;
+    }
+
+    virtual bool next(PendingLine& entry)
+    {
+      BinaryStatFormat::Record record;
+      while (mNext < mEnd)
+      {
+        const std::size_t offset = mNext;
+        const bool decoded = (mStream != NULL) ? mStream->next(mNext, record) : mFile->next(mNext, record);
+        if (!decoded and (mInput != NULL) and !mInput->error().empty())
+        {
+          mError = mInput->error();
+          return false;
+        }
+        if (!decoded and (mStream != NULL) and mStream->finished())
+          return false;
+        if (!decoded or (mNext > mEnd))
+        {
+          mError = "Invalid or truncated record at offset " + uintToString(offset) + " of binary stat file!";
+          return false;
+        }
+        if ((record.type == BinaryStatFormat::rtEntry) or (record.type == BinaryStatFormat::rtLink))
+        {
+          if ((record.type == BinaryStatFormat::rtEntry)
+              and ((record.user >= mNames.users.size()) or (record.group >= mNames.groups.size())))
+          {
+            mError = "Record at offset " + uintToString(offset) + " refers to an undefined user or group!";
+            return false;
+          }
+          if ((record.type == BinaryStatFormat::rtLink) and (record.inode >= mNames.inodes.size()))
+          {
+            mError = "Record at offset " + uintToString(offset) + " refers to an undefined inode!";
+            return false;
+          }
+          if (record.shared > mPath.size())
+          {
+            mError = "Record at offset " + uintToString(offset) + " shares more bytes than the previous path has!";
+            return false;
+          }
+          // The path is rebuilt in place, it only changes after the shared part.
+          mPath.replace(record.shared, std::string::npos, record.text, record.length);
+          entry.position = offset;
+          entry.file.assign(mPath);
+          if (record.type == BinaryStatFormat::rtEntry)
+          {
+            entry.mode = record.mode;
+            entry.UID = mNames.users[record.user];
+            entry.GID = mNames.groups[record.group];
+          }
+          else
+          {
+            const ResolvedNames::Inode& inode = mNames.inodes[record.inode];
+            entry.mode = inode.mode;
+            entry.UID = inode.UID;
+            entry.GID = inode.GID;
+          }
+          if (entry.file.empty())
           {
-            std::cout << (dryRun ? "Would change ownership of \"" : "Changing ownership of \"")
-                      << destinationFile << "\" from " << getHumanReadableOwnership(dest_statbuf)
-                      << " to " << getHumanReadableOwnership(UID, GID) << "...\n";
+            mError = "Record at offset " + uintToString(offset) + " has an empty path!";
+            return false;
           }
-          if (!dryRun)
+          return true;
+        }
+        if (record.type == BinaryStatFormat::rtInode)
+        {
+          if (mDefine and !defineInode(record))
           {
-            ret = lchown((dest_directory + file).c_str(), UID, GID);
-            if (0 != ret)
+            mError = "Inode record at offset " + uintToString(offset) + " refers to an undefined user or group!";
+            return false;
+          }
+          continue;
+        }
+        if (mDefine and !define(record))
+        {
+          mError = "Could not resolve name \"" + std::string(record.text, record.length)
+                 + "\" at offset " + uintToString(offset) + " of binary stat file!";
+          return false;
+        }
+      } // while
+      return false;
+    }
+  private:
+    const BinaryStatFile * mFile; /* the mapped file, or NULL for streams */
+    BinaryStatStream * mStream; /* the stream, or NULL for mapped files */
+    const DecompressingBuffer * mInput; /* input of the stream, or NULL */
+    std::size_t mNext;
+    std::size_t mEnd;
+    SaveRestore& mParser;
+    ResolvedNames& mNames;
+    bool mDefine;
+    std::string mPath; /* path of the current entry */
+
+    /* adds the stats of an inode record to the inode table */
+    bool defineInode(const BinaryStatFormat::Record& record)
+    {
+      if ((record.user >= mNames.users.size()) or (record.group >= mNames.groups.size()))
+        return false;
+      ResolvedNames::Inode inode;
+      inode.mode = record.mode;
+      inode.UID = mNames.users[record.user];
+      inode.GID = mNames.groups[record.group];
+      mNames.inodes.push_back(inode);
+      return true;
+    }
+
+    /* resolves a definition once, names are preferred over IDs like in text files */
+    bool define(const BinaryStatFormat::Record& record)
+    {
+      const std::string name = (record.length == 0) ? std::string("?") : std::string(record.text, record.length);
+      const std::string id = uintToString(record.id);
+      if (record.type == BinaryStatFormat::rtUser)
+      {
+        uid_t UID;
+        if (!mParser.stringToUID(name, id, UID))
+          return false;
+        mNames.users.push_back(UID);
+        return true;
+      }
+      gid_t GID;
+      if (!mParser.stringToGID(name, id, GID))
+        return false;
+      mNames.groups.push_back(GID);
+      return true;
+    }
+};//class
+
+/* size of the messages a restore task collects before it writes them */
+static const std::size_t cMessageFlushSize = 64 * 1024;
+
+/* bounded queue of batches of parsed lines - one thread reads a stat file
+   that is decompressed on the fly, while the workers apply the batches */
+class SaveRestore::LineQueue
+{
+  public:
+    static const std::size_t cBatchSize = 4096; /* lines per batch */
+
+    /* capacity is the maximum number of queued batches */
+    explicit LineQueue(const std::size_t capacity)
+    : mCapacity(capacity), mBatches(), mFinished(false), mMutex(), mChanged()
+    { }
+
+    /* adds a batch and clears it, waits while the queue is full - returns
+       false, if the queue was finished in the meantime */
+    bool push(std::vector<PendingLine>& batch)
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mChanged.wait(lock, [this] { return mFinished or (mBatches.size() < mCapacity); });
+      if (mFinished)
+        return false;
+      mBatches.push_back(std::vector<PendingLine>());
+      mBatches.back().swap(batch);
+      mChanged.notify_all();
+      return true;
+    }
+
+    /* takes the next batch, waits while the queue is empty - returns false,
+       if the queue is finished and empty */
+    bool pop(std::vector<PendingLine>& batch)
+    {
+      std::unique_lock<std::mutex> lock(mMutex);
+      mChanged.wait(lock, [this] { return mFinished or !mBatches.empty(); });
+      if (mBatches.empty())
+        return false;
+      batch.swap(mBatches.front());
+      mBatches.pop_front();
+      mChanged.notify_all();
+      return true;
+    }
+
+    /* no batches are added anymore - queued batches are dropped, if discard is true */
+    void finish(const bool discard)
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mFinished = true;
+      if (discard)
+        mBatches.clear();
+      mChanged.notify_all();
+    }
+  private:
+    std::size_t mCapacity;
+    std::deque<std::vector<PendingLine> > mBatches;
+    bool mFinished;
+    std::mutex mMutex;
+    std::condition_variable mChanged;
+};//class
+
+/* reads the lines of the batches of a LineQueue */
+class SaveRestore::QueueReader: public EntryReader
+{
+  public:
+    explicit QueueReader(LineQueue& queue)
+    : EntryReader(), mQueue(queue), mBatch(), mNext(0)
+    { }
+
+    virtual bool next(PendingLine& entry)
+    {
+      while (mNext >= mBatch.size())
+      {
+        mBatch.clear();
+        mNext = 0;
+        if (!mQueue.pop(mBatch))
+          return false;
+      } // while
+      std::swap(entry, mBatch[mNext++]);
+      return true;
+    }
+  private:
+    LineQueue& mQueue;
+    std::vector<PendingLine> mBatch; /* the current batch */
+    std::vector<PendingLine>::size_type mNext; /* index of the next line in mBatch */
+};//class
+
+SaveRestore::RestoreResult SaveRestore::restoreEntry(DirectoryChain& chain, const std::string& destPrefix, const std::string& file,
+                                                     const mode_t mode, const uid_t UID, const gid_t GID, const std::string::size_type position,
+                                                     const bool permissions, const bool ownership, const bool verbose, const bool dryRun,
+                                                     const bool retryDenied, const StatResult * prefetched, std::vector<DeferredMode>& deferred, std::ostream& out)
+{
+  const std::string destinationFile(destPrefix + file);
+  std::string baseName;
+  const DirectoryHandle& parent = chain.parentOf(file, baseName);
+
+  struct stat dest_statbuf;
+  int ret = 0;
+  if ((prefetched != NULL) and (prefetched->error == 0))
+    dest_statbuf = prefetched->status;
+  else
+  {
+    // Query again after a failed prefetch, because a previous line may have
+    // made the parent directory accessible in the meantime.
+    ret = parent.statEntry(baseName.c_str(), dest_statbuf);
+  }
+  if (0 != ret)
+  {
+    const int errorCode = errno;
+    if ((errorCode == EACCES) and retryDenied)
+    {
+      // A parent directory may become accessible by a line that is handled
+      // by another worker, so try again later.
+      return rrAccessDenied;
+    }
+    if (errorCode != ENOENT)
+    {
+      LogSink::errors(out) << "Error while querying status of \"" << destinationFile << "\": Code "
+          << errorCode << " (" << strerror(errorCode) << ").\n";
+      return rrFailed;
+    }
+    // destination file does not exist, skip silently - except when verbose
+    if (verbose or dryRun)
+      out << "Info: file \""<<destinationFile<<"\" does not exist, skipping.\n";
+    return rrDone;
+  }
+  // entries on other file systems are left alone with --one-file-system
+  if (MountBoundary::shared().outside(dest_statbuf, destPrefix, file, out, verbose or dryRun)
+      or PathFilter::shared().excludesQueriedPath(file, dest_statbuf.st_mode))
+    return rrDone;
+
+  return applyEntry(parent, baseName, destinationFile, dest_statbuf, file, mode, UID, GID, position,
+                    permissions, ownership, verbose, dryRun, deferred, out) ? rrDone : rrFailed;
+}
+
+bool SaveRestore::applyEntry(const DirectoryHandle& parent, const std::string& baseName, const std::string& destinationFile,
+                             const struct stat& dest_statbuf, const std::string& file, const mode_t mode, const uid_t UID, const gid_t GID,
+                             const std::string::size_type position, const bool permissions, const bool ownership, const bool verbose,
+                             const bool dryRun, std::vector<DeferredMode>& deferred, std::ostream& out)
+{
+  // IDs of the stat file may belong to another user namespace
+  const IDMapping& mapping = IDMapping::shared();
+  const uid_t userID = mapping.mapUser(UID);
+  const gid_t groupID = mapping.mapGroup(GID);
+  // another hard link of the entry may have been handled already
+  if (LinkTracker::shared().alreadyApplied(dest_statbuf, mode, userID, groupID))
+    return true;
+
+  // mode change requested? (Never for symbolic links, see copy_file_stats().)
+  if (permissions and !S_ISLNK(dest_statbuf.st_mode)
+      and (Mode::onlyPermissions(dest_statbuf.st_mode) != Mode::onlyPermissions(mode)))
+  {
+    const mode_t oldPermissions = Mode::onlyPermissions(dest_statbuf.st_mode);
+    if (S_ISDIR(dest_statbuf.st_mode) and ((oldPermissions & ~Mode::onlyPermissions(mode)) != 0))
+    {
+      // The new mode removes some permissions of the directory, which could
+      // prevent access to its content. Change it after the content is done.
+      DeferredMode change;
+      change.position = position;
+      change.file = file;
+      change.mode = mode;
+      change.oldMode = oldPermissions;
+      deferred.push_back(change);
+    }
+    else if (!changeEntryMode(parent, baseName, destinationFile, oldPermissions, mode, verbose, dryRun, out))
+    {
+      return false;
+    }
+  } // if permissions shall be adjusted
+
+  if (ownership)
+  {
+    // check, if user and group match
+    if ((dest_statbuf.st_uid != userID) || (dest_statbuf.st_gid != groupID))
+    {
+      if (verbose or dryRun)
+      {
+        writeOwnershipChange(out, destinationFile, dest_statbuf.st_uid, dest_statbuf.st_gid, userID, groupID, dryRun);
+      }
+      if (!dryRun)
+      {
+        if (0 != parent.changeOwnership(baseName.c_str(), userID, groupID))
+        {
+          const int errorCode = errno;
+          LogSink::errors(out) << "Error while changing ownership of \"" << destinationFile
+              << "\": Code " << errorCode << " (" << strerror(errorCode)
+              << ").\n";
+          return false;
+        } // if changeOwnership() failed
+      } // if not dry run
+    } // if owners do not match
+  } // if ownership shall be adjusted
+  return true;
+}
+
+bool SaveRestore::changeEntryMode(const DirectoryHandle& parent, const std::string& baseName, const std::string& destinationFile,
+                                  const mode_t oldMode, const mode_t mode, const bool verbose, const bool dryRun, std::ostream& out)
+{
+  if (verbose or dryRun)
+    writeModeChange(out, destinationFile, oldMode, mode, dryRun);
+  if (dryRun)
+    return true;
+  if (0 != parent.changeMode(baseName.c_str(), mode))
+  {
+    const int errorCode = errno;
+    LogSink::errors(out) << "Error while changing mode of \"" << destinationFile
+        << "\": Code " << errorCode << " (" << strerror(errorCode) << ").\n";
+    return false;
+  }
+  return true;
+}
+
+bool SaveRestore::applyDeferredModes(const std::string& dest_directory, std::vector<DeferredMode>& deferred, const bool verbose, const bool dryRun)
+{
+  // descending position, i.e. children before their parents
+  std::sort(deferred.begin(), deferred.end(),
+            [] (const DeferredMode& a, const DeferredMode& b) { return a.position > b.position; });
+  DirectoryChain chain;
+  if (!chain.open(dest_directory))
+  {
+    const int errorCode = errno;
+    LogSink::errors() << "Error: Could not open directory \"" << dest_directory << "\": Code "
+              << errorCode << " (" << strerror(errorCode) << ").\n";
+    return false;
+  }
+  const std::string destPrefix(slashify(dest_directory));
+  std::string baseName;
+  for (const DeferredMode& change : deferred)
+  {
+    const DirectoryHandle& parent = chain.parentOf(change.file, baseName);
+    if (!changeEntryMode(parent, baseName, destPrefix + change.file, change.oldMode, change.mode, verbose, dryRun, std::cout))
+      return false;
+  } // for
+  return true;
+}
+
+bool SaveRestore::continuesBatch(const std::vector<PendingLine>& pending, const std::string& file)
+{
+  if (pending.empty())
+    return true;
+  const std::string& first = pending.front().file;
+  const std::string::size_type slash = first.rfind('/');
+  const std::string::size_type length = (slash == std::string::npos) ? 0 : slash + 1;
+  return (file.size() > length) and (file.find('/', length) == std::string::npos)
+      and (file.compare(0, length, first, 0, length) == 0);
+}
+
+bool SaveRestore::restoreBatch(DirectoryChain& chain, StatEngine& engine, std::vector<PendingLine>& pending, std::vector<StatResult>& results,
+                               const std::string& destPrefix, const bool permissions, const bool ownership, const bool verbose, const bool dryRun,
+                               std::vector<PendingLine> * denied, std::vector<DeferredMode>& deferred, std::ostream& out)
+{
+  if (pending.empty())
+    return true;
+  // All lines are in the same directory, so only the base names are queried.
+  // The kernel does not have to resolve the whole path for each of them.
+  std::string baseName;
+  const DirectoryHandle& parent = chain.parentOf(pending.front().file, baseName);
+  const std::string::size_type offset = pending.front().file.size() - baseName.size();
+  for (const PendingLine& one : pending)
+    engine.add(one.file.c_str() + offset, one.file.size() - offset, DT_UNKNOWN);
+  engine.query(parent, results);
+  bool success = true;
+  for (std::size_t i = 0; i < pending.size(); ++i)
+  {
+    const PendingLine& one = pending[i];
+    const RestoreResult result = restoreEntry(chain, destPrefix, one.file,
+                                              one.mode, one.UID, one.GID, one.position, permissions, ownership,
+                                              verbose, dryRun, denied != NULL, &results[i], deferred, out);
+    if (result == rrFailed)
+    {
+      success = false;
+      break;
+    }
+    if (result == rrAccessDenied)
+      denied->push_back(one);
+  } // for
+  pending.clear();
+  engine.clear();
+  return success;
+}
+
+bool SaveRestore::restore(const std::string& dest_directory, const std::string& statFileName, const bool permissions, const bool ownership, const bool verbose, const bool dryRun, const unsigned int jobs, const bool walkDestination)
+{
+  if (!(permissions || ownership))
+  {
+    std::cout << "Hint: No stats to change!\n";
+    return true;
+  }
+  if (!fileExists(statFileName))
+  {
+    LogSink::errors() << "Error: file " << statFileName << " does not exist.\n";
+    return false;
+  }
+
+  // open destination directory, entries are handled relative to their parent
+  DirectoryChain chain;
+  if (!chain.open(dest_directory))
+  {
+    const int errorCode = errno;
+    LogSink::errors() << "Error: Could not open directory \"" << dest_directory << "\": Code "
+              << errorCode << " (" << strerror(errorCode) << ").\n";
+    return false;
+  }
+  if (!MountBoundary::shared().setRoot(chain.root()))
+  {
+    const int errorCode = errno;
+    LogSink::errors() << "Error: Could not get the file system of directory \"" << dest_directory << "\": Code "
+              << errorCode << " (" << strerror(errorCode) << ").\n";
+    return false;
+  }
+
+  // The format is detected by the first bytes of the file. Compressed files
+  // are decompressed on the fly, so only uncompressed binary files can be
+  // mapped into memory. Compressed binary files are decoded from the stream.
+  BinaryStatFile binaryFile;
+  DecompressingBuffer statInput;
+  BinaryStatStream binaryStream(statInput);
+  bool streamed = false;
+  StatFileFormat format = BinaryStatFile::detectFormat(statFileName);
+  std::string error;
+  if (format == sfBinary)
+  {
+    if (!binaryFile.open(statFileName, error))
+    {
+      LogSink::errors() << "Error: Could not read file " << statFileName << ": " << error << "\n";
+      return false;
+    }
+  }
+  else
+  {
+    // open file for reading
+    if (!statInput.open(statFileName, error))
+    {
+      LogSink::errors() << "Error: Could not open file " << statFileName << ": " << error << "\n";
+      return false;
+    }
+    if (statInput.compression() != cmNone)
+    {
+      char start[BinaryStatFile::cDetectionSize];
+      format = BinaryStatFile::detectFormat(start, statInput.peek(start, sizeof(start)));
+      if (format == sfBinary)
+      {
+        const bool opened = binaryStream.open(error);
+        if (!statInput.error().empty())
+          error = statInput.error();
+        if (!opened or !statInput.error().empty())
+        {
+          LogSink::errors() << "Error: Could not read file " << statFileName << ": " << error << "\n";
+          return false;
+        }
+        streamed = true;
+      }
+    }
+  }
+  const bool binary = (format == sfBinary);
+  const bool dictionary = (format == sfDictionary);
+
+  if (jobs > 1 and !walkDestination)
+  {
+    return restoreParallel(dest_directory, statFileName, statInput, (binary and !streamed) ? &binaryFile : NULL,
+                           streamed ? &binaryStream : NULL, dictionary, permissions, ownership, verbose, dryRun, jobs);
+  }
+
+  ResolvedNames names;
+  std::unique_ptr<EntryReader> reader;
+  if (streamed)
+    reader.reset(new BinaryEntryReader(binaryStream, statInput, *this, names));
+  else if (binary)
+    reader.reset(new BinaryEntryReader(binaryFile, binaryFile.begin(), binaryFile.end(), *this, names, true));
+  else
+    reader.reset(new TextStreamReader(statInput, *this, dictionary ? &names : NULL));
+
+  if (walkDestination)
+  {
+    return restoreByWalk(dest_directory, *reader, permissions, ownership, verbose, dryRun);
+  }
+
+  const std::string destPrefix(slashify(dest_directory));
+  std::vector<DeferredMode> deferred;
+  // Status of the entries is queried in batches.
+  std::unique_ptr<StatEngine> engine = StatEngine::create();
+  std::vector<PendingLine> pending;
+  std::vector<StatResult> results;
+
+  PathFilter& filter = PathFilter::shared();
+  MountBoundary& boundary = MountBoundary::shared();
+  PendingLine one;
+  while (reader->next(one))
+  {
+    if (filter.excludesPath(one.file))
+      continue;
+    // Saved entries are grouped by directory, so batches end at directory changes.
+    if (!continuesBatch(pending, one.file)
+        and !restoreBatch(chain, *engine, pending, results, destPrefix, permissions, ownership,
+                          verbose, dryRun, NULL, deferred, std::cout))
+      return false;
+    // Mount points are found by the batches of their parent directory, which
+    // are done before the first line of their content.
+    if (boundary.pruned(destPrefix, one.file))
+      continue;
+    pending.push_back(one);
+    if ((pending.size() >= StatEngine::cBatchSize)
+        and !restoreBatch(chain, *engine, pending, results, destPrefix, permissions, ownership,
+                          verbose, dryRun, NULL, deferred, std::cout))
+      return false;
+  } // while
+  if (reader->failed())
+  {
+    LogSink::errors() << "Error: " << reader->error() << "\n";
+    return false;
+  }
+
+  if (!restoreBatch(chain, *engine, pending, results, destPrefix, permissions, ownership,
+                    verbose, dryRun, NULL, deferred, std::cout))
+    return false;
+  return applyDeferredModes(dest_directory, deferred, verbose, dryRun);
+}
+
+bool SaveRestore::restoreParallel(const std::string& dest_directory, const std::string& statFileName, DecompressingBuffer& statInput, const BinaryStatFile * binaryFile, BinaryStatStream * binaryStream, const bool dictionary, const bool permissions, const bool ownership, const bool verbose, const bool dryRun, const unsigned int jobs)
+{
+  // Uncompressed text files are mapped into memory, so that they can be split
+  // into chunks at line boundaries. Binary files are already mapped. Other
+  // files are read by one thread, which hands batches of lines to the workers.
+  MappedFile textFile;
+  const bool streamed = (binaryFile == NULL) and ((binaryStream != NULL) or (statInput.compression() != cmNone));
+  if ((binaryFile == NULL) and !streamed)
+  {
+    std::string error;
+    if (!textFile.open(statFileName, error))
+    {
+      LogSink::errors() << "Error: Could not read file " << statFileName << ": " << error << "\n";
+      return false;
+    }
+  }
+  const char * const data = textFile.data();
+  const std::string::size_type dataSize = (binaryFile == NULL) ? textFile.size() : binaryFile->end();
+
+  WorkStealingPool pool(jobs);
+  const unsigned int workers = pool.workers();
+  // Several chunks per worker allow to balance chunks of different costs.
+  const std::string::size_type chunkSize = dataSize / (workers * 4) + 1;
+  std::vector<std::pair<std::string::size_type, std::string::size_type> > chunks;
+  // paths of the entries before the chunks, for front-coded binary files
+  std::vector<std::string> previousPaths;
+  ResolvedNames names;
+  if (streamed)
+  {
+    // one task per worker, each one takes batches until the queue is finished
+    for (unsigned int i = 0; i < workers; ++i)
+      chunks.push_back(std::make_pair(0, 0));
+  }
+  else if (binaryFile == NULL)
+  {
+    std::string::size_type start = 0;
+    while (start < dataSize)
+    {
+      const char * newLine = static_cast<const char*>(std::memchr(data + std::min(start + chunkSize, dataSize - 1), '\n',
+                                                                  dataSize - std::min(start + chunkSize, dataSize - 1)));
+      const std::string::size_type end = (newLine == NULL) ? dataSize : newLine - data + 1;
+      chunks.push_back(std::make_pair(start, end));
+      start = end;
+    } // while
+    // All names of the dictionary are resolved before the workers start, so
+    // the workers only need to look up the indices.
+    if (dictionary)
+    {
+      TextRangeReader definitions(data, 0, dataSize, *this, &names, true);
+      if (!definitions.readDefinitions())
+      {
+        LogSink::errors() << "Error: " << definitions.error() << "\n";
+        return false;
+      }
+    }
+  }
+  else
+  {
+    // Records have no separator, so one pass over the file finds the chunk
+    // boundaries. It resolves all definitions on the way, so the workers
+    // only need to look up the indices.
+    std::size_t start = binaryFile->begin();
+    BinaryEntryReader definitions(*binaryFile, start, dataSize, *this, names, true);
+    PendingLine one;
+    previousPaths.push_back(std::string());
+    std::string previousPath;
+    while (definitions.next(one))
+    {
+      if (one.position >= start + chunkSize)
+      {
+        chunks.push_back(std::make_pair(start, one.position));
+        previousPaths.push_back(previousPath);
+        start = one.position;
+      }
+      previousPath = definitions.path();
+    } // while
+    if (definitions.failed())
+    {
+      LogSink::errors() << "Error: " << definitions.error() << "\n";
+      return false;
+    }
+    if (start < dataSize)
+      chunks.push_back(std::make_pair(start, dataSize));
+  }
+  if (chunks.empty())
+    return true;
+
+  // Each worker has its own name cache and its own directory chain, so
+  // nothing but the output has to be synchronized. Preloaded IDs are only
+  // read, so they are shared.
+  std::vector<std::unique_ptr<SaveRestore> > parsers;
+  std::vector<std::unique_ptr<DirectoryChain> > chains;
+  std::vector<std::unique_ptr<StatEngine> > engines;
+  std::vector<std::vector<DeferredMode> > deferred(workers);
+  std::vector<std::vector<PendingLine> > denied(workers);
+  for (unsigned int i = 0; i < workers; ++i)
+  {
+    parsers.push_back(std::unique_ptr<SaveRestore>(new SaveRestore(mUseCache)));
+    parsers.back()->mNumericIDs = mNumericIDs;
+    parsers.back()->mPreloadedIDs = mPreloadedIDs;
+    chains.push_back(std::unique_ptr<DirectoryChain>(new DirectoryChain()));
+    engines.push_back(StatEngine::create());
+    if (!chains.back()->open(dest_directory))
+    {
+      const int errorCode = errno;
+      LogSink::errors() << "Error: Could not open directory \"" << dest_directory << "\": Code "
+                << errorCode << " (" << strerror(errorCode) << ").\n";
+      return false;
+    }
+  }
+  const std::string destPrefix(slashify(dest_directory));
+  std::mutex outputMutex;
+  std::atomic<bool> failed(false);
+  LineQueue queue(2 * workers);
+
+  for (unsigned int chunk = 0; chunk < chunks.size(); ++chunk)
+  {
+    const std::string::size_type start = chunks[chunk].first;
+    const std::string::size_type end = chunks[chunk].second;
+    pool.submit(chunk, [&, start, end, chunk] (const unsigned int worker)
+      {
+        MessageBuffer out;
+        StatEngine& engine = *engines[worker];
+        std::vector<PendingLine> pending;
+        std::vector<StatResult> results;
+        std::unique_ptr<EntryReader> reader;
+        if (streamed)
+          reader.reset(new QueueReader(queue));
+        else if (binaryFile != NULL)
+          reader.reset(new BinaryEntryReader(*binaryFile, start, end, *parsers[worker], names, false, previousPaths[chunk]));
+        else
+          reader.reset(new TextRangeReader(data, start, end, *parsers[worker], dictionary ? &names : NULL, false));
+        // writes the collected messages, tasks on a queue run until the end
+        // of the file and must not keep all their messages
+        const auto flush = [&] ()
+          {
+            if (out.size() > 0)
             {
-              const int errorCode = errno;
-              statStream.close();
-              std::cout << "Error while changing ownership of \"" << destinationFile
-                        << "\": Code " << errorCode << " (" << strerror(errorCode)
-                        << ").\n";
-              return false;
-            } // if 0 != ret
-          } // if not dry run
-        } // if owners do not match
-      } // if ownership shall be adjusted
-    } // else (lstat succeeded)
+              std::lock_guard<std::mutex> lock(outputMutex);
+              out.write(std::cout);
+            }
+          };
+        PendingLine one;
+        while (!failed and reader->next(one))
+        {
+          if (PathFilter::shared().excludesPath(one.file))
+            continue;
+          if (!continuesBatch(pending, one.file))
+          {
+            if (!restoreBatch(*chains[worker], engine, pending, results, destPrefix, permissions,
+                              ownership, verbose, dryRun, &denied[worker], deferred[worker], out.messages()))
+            {
+              failed = true;
+              break;
+            }
+            if (out.size() >= cMessageFlushSize)
+              flush();
+          }
+          if (MountBoundary::shared().pruned(destPrefix, one.file))
+            continue;
+          pending.push_back(one);
+          if ((pending.size() >= StatEngine::cBatchSize)
+              and !restoreBatch(*chains[worker], engine, pending, results, destPrefix, permissions,
+                                ownership, verbose, dryRun, &denied[worker], deferred[worker], out.messages()))
+            failed = true;
+        } // while
+        if (reader->failed())
+        {
+          out.errors() << "Error: " << reader->error() << "\n";
+          failed = true;
+        }
+        if (!failed and !restoreBatch(*chains[worker], engine, pending, results, destPrefix, permissions,
+                                      ownership, verbose, dryRun, &denied[worker], deferred[worker], out.messages()))
+          failed = true;
+        // a failed batch might leave entries behind
+        pending.clear();
+        engine.clear();
+        if (failed)
+        {
+          pool.stop();
+          queue.finish(true);
+        }
+        flush();
+      });
+  } // for
+
+  std::thread producer;
+  std::unique_ptr<EntryReader> streamReader;
+  if (streamed)
+  {
+    // The names are resolved while the file is read, so the workers get
+    // complete lines and the queue bounds the memory.
+    if (binaryStream != NULL)
+      streamReader.reset(new BinaryEntryReader(*binaryStream, statInput, *this, names));
+    else
+      streamReader.reset(new TextStreamReader(statInput, *this, dictionary ? &names : NULL));
+    producer = std::thread([&] ()
+      {
+        std::vector<PendingLine> batch;
+        PendingLine one;
+        while (!failed and streamReader->next(one))
+        {
+          batch.push_back(one);
+          if ((batch.size() >= LineQueue::cBatchSize) and !queue.push(batch))
+            break;
+        } // while
+        if (streamReader->failed())
+          failed = true;
+        else if (!failed and !batch.empty())
+          queue.push(batch);
+        queue.finish(failed);
+      });
+  }
+  pool.run();
+  if (producer.joinable())
+    producer.join();
+  for (const std::unique_ptr<SaveRestore>& parser : parsers)
+    mLookups += parser->mLookups;
+  if (streamReader and streamReader->failed())
+    LogSink::errors() << "Error: " << streamReader->error() << "\n";
+  if (failed)
+    return false;
+
+  // Retry lines whose parent directory was not accessible, in file order.
+  // All chunks are done now, so every directory that gets more permissions
+  // has them already.
+  std::vector<PendingLine> retries;
+  std::vector<DeferredMode> allDeferred;
+  for (unsigned int i = 0; i < workers; ++i)
+  {
+    retries.insert(retries.end(), denied[i].begin(), denied[i].end());
+    allDeferred.insert(allDeferred.end(), deferred[i].begin(), deferred[i].end());
+  }
+  std::sort(retries.begin(), retries.end(),
+            [] (const PendingLine& a, const PendingLine& b) { return a.position < b.position; });
+  for (const PendingLine& retry : retries)
+  {
+    if (MountBoundary::shared().pruned(destPrefix, retry.file))
+      continue;
+    if (restoreEntry(*chains[0], destPrefix, retry.file, retry.mode, retry.UID, retry.GID, retry.position, permissions, ownership,
+                     verbose, dryRun, false, NULL, allDeferred, std::cout) != rrDone)
+      return false;
+  } // for
+  return applyDeferredModes(dest_directory, allDeferred, verbose, dryRun);
+}
+
+bool SaveRestore::restoreByWalk(const std::string& dest_directory, EntryReader& entries, const bool permissions, const bool ownership, const bool verbose, const bool dryRun)
+{
+  // load the stat file into the index - later lines replace earlier lines
+  // with the same path, like they would do when applied one by one
+  LineIndex index;
+  IndexedLine indexed;
+  indexed.found = false;
+  PendingLine one;
+  while (entries.next(one))
+  {
+    indexed.position = one.position;
+    indexed.mode = one.mode;
+    indexed.UID = one.UID;
+    indexed.GID = one.GID;
+    const PathIndex::Id id = index.paths.insert(one.file);
+    if (id < index.lines.size())
+      index.lines[id] = indexed;
+    else
+      index.lines.push_back(indexed);
   } // while
+  if (entries.failed())
+  {
+    LogSink::errors() << "Error: " << entries.error() << "\n";
+    return false;
+  }
 
-  statStream.close();
-  return true;
+  DirectoryStack stack(DirectoryStack::maxOpenFor(1));
+  if (!stack.open(dest_directory))
+  {
+    const int errorCode = errno;
+    LogSink::errors() << "Error: Could not open directory \"" << dest_directory << "\": Code "
+              << errorCode << " (" << strerror(errorCode) << ").\n";
+    return false;
+  }
+  const std::string destPrefix(slashify(dest_directory));
+  DirectoryReader reader;
+  std::unique_ptr<StatEngine> engine = StatEngine::create();
+  std::vector<DeferredMode> deferred;
+
+  // Walk the destination like saveIterative() walks the source, so each
+  // directory is read once and its entries are joined against the index.
+  struct Level
+  {
+    std::string subDirectories; /* null-terminated names of subdirectories */
+    std::string::size_type next; /* offset of the next subdirectory */
+    std::string::size_type pathLength; /* length of relativePath for this level */
+  };
+  std::vector<Level> levels;
+  std::string relativePath;
+  bool newLevel = true;
+  while (true)
+  {
+    if (newLevel)
+    {
+      const DirectoryHandle * directory = stack.top();
+      if (directory == NULL)
+      {
+        const int errorCode = errno;
+        LogSink::errors() << "Error: Could not open directory \"" << destPrefix << relativePath << "\": Code "
+                  << errorCode << " (" << strerror(errorCode) << ").\n";
+        return false;
+      }
+      levels.push_back(Level());
+      levels.back().next = 0;
+      levels.back().pathLength = relativePath.size();
+      if (!restoreDirectoryEntries(*directory, destPrefix, relativePath, reader, *engine, index, levels.back().subDirectories,
+                                   permissions, ownership, verbose, dryRun, deferred))
+        return false;
+      newLevel = false;
+    }
+
+    Level& level = levels.back();
+    relativePath.resize(level.pathLength);
+    if (level.next >= level.subDirectories.size())
+    {
+      levels.pop_back();
+      if (levels.empty())
+        break;
+      stack.pop();
+      continue;
+    }
+
+    const char * name = level.subDirectories.c_str() + level.next;
+    level.next += std::strlen(name) + 1;
+    relativePath.append(name).append(1, pathDelimiter);
+    if (!stack.push(name))
+    {
+      const int errorCode = errno;
+      LogSink::errors() << "Error: Could not open directory \"" << destPrefix << relativePath << "\": Code "
+                << errorCode << " (" << strerror(errorCode) << ").\n";
+      return false;
+    }
+    newLevel = true;
+  } // while
+
+  // report lines whose entry was not found, in the order of the file
+  if (verbose or dryRun)
+  {
+    std::vector<std::pair<std::string::size_type, PathIndex::Id> > missing;
+    MountBoundary& boundary = MountBoundary::shared();
+    const PathFilter& filter = PathFilter::shared();
+    for (PathIndex::Id id = 0; id < index.lines.size(); ++id)
+    {
+      if (index.lines[id].found)
+        continue;
+      // entries on other file systems were skipped on purpose
+      const std::string path = index.paths.path(id);
+      if (!boundary.pruned(destPrefix, path) and !filter.hides(path))
+        missing.push_back(std::make_pair(index.lines[id].position, id));
+    }
+    std::sort(missing.begin(), missing.end());
+    for (const std::pair<std::string::size_type, PathIndex::Id>& item : missing)
+    {
+      std::cout << "Info: file \"" << destPrefix << index.paths.path(item.second) << "\" does not exist, skipping.\n";
+    }
+  }
+  return applyDeferredModes(dest_directory, deferred, verbose, dryRun);
+}
+
+bool SaveRestore::restoreDirectoryEntries(const DirectoryHandle& directory, const std::string& destPrefix, std::string& relativePath,
+                                          DirectoryReader& reader, StatEngine& engine, LineIndex& index, std::string& subDirectories,
+                                          const bool permissions, const bool ownership, const bool verbose, const bool dryRun,
+                                          std::vector<DeferredMode>& deferred)
+{
+  if (!reader.open(directory))
+  {
+    const int errorCode = errno;
+    LogSink::errors() << "Error: Could not read directory \"" << destPrefix << relativePath << "\": Code "
+              << errorCode << " (" << strerror(errorCode) << ").\n";
+    return false;
+  }
+
+  engine.clear();
+  std::vector<StatResult> results;
+  PathFilter& filter = PathFilter::shared();
+  DirectoryEntryView entry;
+  while (reader.next(entry))
+  {
+    if (entry.isDotOrDotDot() or isUnwantedType(entry.type)
+        or filter.excludes(relativePath, 0, entry.name, entry.length, entry.type))
+      continue;
+    engine.add(entry.name, entry.length, entry.type);
+    if (engine.full() and !restoreWalkBatch(directory, destPrefix, relativePath, engine, results, index, subDirectories,
+                                            permissions, ownership, verbose, dryRun, deferred))
+      return false;
+  } // while
+  if (reader.error() != 0)
+  {
+    const int errorCode = reader.error();
+    LogSink::errors() << "Error: Could not read directory \"" << destPrefix << relativePath << "\": Code "
+              << errorCode << " (" << strerror(errorCode) << ").\n";
+    return false;
+  }
+  reader.close();
+  return restoreWalkBatch(directory, destPrefix, relativePath, engine, results, index, subDirectories,
+                          permissions, ownership, verbose, dryRun, deferred);
+}
+
+bool SaveRestore::restoreWalkBatch(const DirectoryHandle& directory, const std::string& destPrefix, std::string& relativePath,
+                                   StatEngine& engine, std::vector<StatResult>& results, LineIndex& index, std::string& subDirectories,
+                                   const bool permissions, const bool ownership, const bool verbose, const bool dryRun,
+                                   std::vector<DeferredMode>& deferred)
+{
+  engine.query(directory, results);
+  const std::string::size_type prefixLength = relativePath.size();
+  // all entries of the batch are in the same directory
+  const PathIndex::Id indexDirectory = index.paths.findDirectory(relativePath);
+  bool success = true;
+  for (std::size_t i = 0; (i < engine.size()) and success; ++i)
+  {
+    const std::string baseName(engine.name(i), engine.length(i));
+    // only entries of unknown type still need to be checked
+    const bool excluded = (results[i].error == 0)
+        and PathFilter::shared().excludesQueried(relativePath, 0, baseName.c_str(), baseName.size(), engine.type(i), results[i].status.st_mode);
+    relativePath.append(baseName);
+    if (results[i].error == 0)
+    {
+      const struct stat& dest_statbuf = results[i].status;
+      if (!excluded and !isUnwantedMode(dest_statbuf.st_mode)
+          and !MountBoundary::shared().outside(dest_statbuf, destPrefix, relativePath, std::cout, verbose or dryRun))
+      {
+        const PathIndex::Id found = index.paths.find(indexDirectory, baseName.c_str(), baseName.size());
+        if (found == PathIndex::cNotFound)
+        {
+          if (verbose or dryRun)
+            std::cout << "Info: file \"" << destPrefix << relativePath << "\" is not listed in the stat file, skipping.\n";
+        }
+        else
+        {
+          IndexedLine& indexed = index.lines[found];
+          indexed.found = true;
+          success = applyEntry(directory, baseName, destPrefix + relativePath, dest_statbuf, relativePath,
+                               indexed.mode, indexed.UID, indexed.GID, indexed.position,
+                               permissions, ownership, verbose, dryRun, deferred, std::cout);
+        }
+        if (S_ISDIR(dest_statbuf.st_mode))
+          subDirectories.append(engine.name(i), engine.length(i) + 1);
+      } // if wanted entry
+    }
+    else if (results[i].error != ENOENT)
+    {
+      // entries that were removed since the directory was read are skipped
+      const int errorCode = results[i].error;
+      LogSink::errors() << "Error while querying status of \"" << destPrefix << relativePath << "\": Code "
+                << errorCode << " (" << strerror(errorCode) << ").\n";
+      success = false;
+    }
+    relativePath.resize(prefixLength);
+  } // for
+  engine.clear();
+  return success;
 }
@@ -21,10 +21,25 @@
 #ifndef SAVERESTORE_HPP
 #define SAVERESTORE_HPP
 
+#include <cstddef>
 #include <fstream>
-#include <map>
+#include <memory>
+#include <ostream>
 #include <string>
+#include <utility>
+#include <vector>
 #include <sys/stat.h>
+#include "CompressedFile.hpp"
+#include "DirectoryHandle.hpp"
+#include "DirectoryReader.hpp"
+#include "FileUtilities.hpp"
+#include "FlatNameMap.hpp"
+#include "LogSink.hpp"
+#include "NameCache.hpp"
+#include "PathIndex.hpp"
+#include "StatEngine.hpp"
+#include "StatFile.hpp"
+#include "TextParser.hpp"
 
 class SaveRestore
 {
@@ -38,6 +53,30 @@ class SaveRestore
     SaveRestore(const bool useCache = true);
 
 
+    /** \brief sets whether user and group names are ignored
+     *
+     * \param numeric  If set to true, stringToUID() and stringToGID() only use
+     *                 the numeric IDs and never look up a name, see --numeric-ids.
+     */
+    void setNumericIDs(const bool numeric);
+
+
+    /** \brief sets all users and groups, so that no name has to be looked up later
+     *
+     * Names that are not in the lists are considered unknown afterwards, so
+     * their numeric ID is used. The shared NameCache is filled with the names,
+     * too. Parsers for parallel restores share the lists.
+     * \param users   IDs and names of all users, e.g. from listUsers() or readIDNameFile()
+     * \param groups  IDs and names of all groups, e.g. from listGroups() or readIDNameFile()
+     * \remarks Not thread-safe, should be called before any threads are started.
+     */
+    void preloadIDs(const IDNameList& users, const IDNameList& groups);
+
+
+    /** \brief gets the numbers of name lookups of stringToUID() and stringToGID() */
+    const LookupCounts& lookupCounts() const;
+
+
     /** \brief generates a string that contains all required file stats
      *
      * \param src_path   file name of the source file
@@ -49,6 +88,34 @@ class SaveRestore
     static bool getStatString(const std::string& src_path, const std::string& removeSuffix, std::string& statLine);
 
 
+    /** \brief generates a string that contains all required file stats from already queried status information
+     *
+     * \param status    status of the file, e.g. from getDirectoryFileList()
+     * \param fileName  file name that will be written into the string
+     * \param statLine  string that shall hold the information
+     */
+    static void getStatString(const FileStatus& status, const std::string& fileName, std::string& statLine);
+
+
+    /** \brief appends the stats of a file like getStatString() does, without clearing the string
+     *
+     * \param status    status of the file
+     * \param fileName  file name that will be written into the string
+     * \param statLine  string that the information is appended to
+     * \remarks Integers are formatted directly into the string, so this does
+     *          not allocate memory, as long as the string has enough capacity.
+     */
+    static void appendStatString(const FileStatus& status, const std::string& fileName, std::string& statLine);
+
+
+    /** \brief appends the mode string (like "rwxr-xr--") of a file mode
+     *
+     * \param mode        the file mode, bits other than permissions are ignored
+     * \param modeString  string that the nine characters are appended to
+     */
+    static void appendModeString(const mode_t mode, std::string& modeString);
+
+
     /** \brief creates file mode (for chmod) from a string like "rwxr-xr--"
      *
      * \param mode_string a valid mode string, e.g. "rwxr-xr--"
@@ -61,6 +128,17 @@ class SaveRestore
     static bool stringToMode(const std::string& mode_string, mode_t& mode);
 
 
+    /** \brief creates file mode (for chmod) from the characters of a mode string
+     *
+     * \param mode_string  the characters, not necessarily null-terminated
+     * \param length       number of characters, has to be nine for valid strings
+     * \param mode         variable that will be used to store the resulting mode
+     * \return Returns true, if the characters could be translated to a mode_t
+     *         value. Returns false otherwise.
+     */
+    static bool stringToMode(const char * mode_string, const std::size_t length, mode_t& mode);
+
+
     /** \brief creates user ID (for chown) from a string
      *
      * \param user_name  the user name (e.g. "user1")
@@ -102,12 +180,21 @@ class SaveRestore
      * \param src_directory the directory whose info shall be saved
      * \param statFileName  name of the file that will be used to store the info
      * \param verbose       if set to true, shows more info about errors
+     * \param jobs          number of threads that read directories in parallel.
+     *                      The stat file is the same for any number of jobs.
+     * \param format        format of the stat file
+     * \param compression   compression of the stat file. zstd uses up to
+     *                      jobs threads for it, if libzstd supports that.
      * \return Returns true, if all info was saved. Returns false otherwise.
      */
-    static bool save(const std::string& src_directory, const std::string& statFileName, const bool verbose);
+    static bool save(const std::string& src_directory, const std::string& statFileName, const bool verbose, const unsigned int jobs = 1, const StatFileFormat format = sfText, const Compression compression = cmNone);
 
 
-    /** \brief tries to restore the file information (permissions + owner/group) from a text file
+    /** \brief tries to restore the file information (permissions + owner/group) from a stat file
+     *
+     * The format of the file (text, text with dictionary or binary) and its
+     * compression (gzip, zstd or none) are detected by its first bytes.
+     * Uncompressed binary files are mapped into memory instead of being read.
      *
      * \param dest_directory  the directory whose info shall be restored
      * \param statFileName    name of the file that will be used to load the info
@@ -115,15 +202,295 @@ class SaveRestore
      * \param ownership       If set to true, ownership of dest_directory's contents will be adjusted.
      * \param verbose         if set to true, shows more info about errors
      * \param dryRun          If set to true, no actual changes will be made, but the function just shows what would be changed.
+     * \param jobs            number of threads that apply chunks of the file in parallel
+     * \param walkDestination If set to true, the stat file is loaded into an
+     *                        index and the destination directory is walked once
+     *                        instead of looking up each line's path. See
+     *                        restoreByWalk(). jobs is ignored in that case.
      * \return Returns true, if all info was restored. Returns false otherwise.
+     * \remarks Mode changes that remove permissions from a directory are
+     *          applied after all other lines, deepest directories first, so
+     *          that they cannot block access to the directory's content.
      */
-    bool restore(const std::string& dest_directory, const std::string& statFileName, const bool permissions, const bool ownership, const bool verbose, const bool dryRun);
+    bool restore(const std::string& dest_directory, const std::string& statFileName, const bool permissions, const bool ownership, const bool verbose, const bool dryRun, const unsigned int jobs = 1, const bool walkDestination = false);
   private:
     bool mUseCache; /**< whether caches are used or not */
-    std::map<std::string, uid_t> mUserCache;  /**< caches user name -> user ID associations */
-    std::map<std::string, gid_t> mGroupCache; /**< caches group name -> group ID associations */
+    /* cached ID of a user or group name */
+    struct CachedID {
+        bool known; /* whether the name exists */
+        unsigned int id; /* the ID, if the name exists */
+    };//struct
+    struct PreloadedIDs;
+
+    FlatNameMap<CachedID> mUserCache;  /**< caches user name -> user ID associations */
+    FlatNameMap<CachedID> mGroupCache; /**< caches group name -> group ID associations */
+    bool mNumericIDs; /**< whether names are ignored */
+    std::shared_ptr<const PreloadedIDs> mPreloadedIDs; /**< all users and groups, if preloaded */
+    LookupCounts mLookups; /**< numbers of name lookups */
+
+    struct SaveNode;
+    struct ParallelSave;
+    struct DeferredMode;
+    struct PendingLine;
+    struct IndexedLine;
+    struct LineIndex;
+    struct ResolvedNames;
+    class EntryReader;
+    class TextEntryReader;
+    class TextStreamReader;
+    class TextRangeReader;
+    class BinaryEntryReader;
+    class LineQueue;
+    class QueueReader;
+
+    /** \brief gets the ID of a user or group name from the caches or the database
+     *
+     * \param name  the name of the user or group
+     * \param user  true for a user name, false for a group name
+     * \param id    variable that will hold the ID
+     * \return Returns true, if the name exists. Returns false otherwise.
+     */
+    bool lookUpID(const std::string& name, const bool user, unsigned int& id);
+
+    /* result of restoreEntry() */
+    enum RestoreResult { rrDone, rrFailed, rrAccessDenied };
+
+    /** \brief saves the stats of the entries of an opened directory, but not of the content of its subdirectories
+     *
+     * \param directory      the opened directory
+     * \param basePath       path of the directory given to save(), used for messages
+     * \param relativePath   path of directory relative to basePath, including a
+     *                       trailing slash (empty for the base directory itself).
+     *                       Will be extended temporarily for each entry.
+     * \param reader         reader for the directory
+     * \param engine         engine for the status queries
+     * \param writer         writer that encodes the records
+     * \param records        the records are appended to this fragment
+     * \param writeBatches   If set to true, the records are written and removed
+     *                       from the fragment after each batch. Otherwise they
+     *                       are kept for the caller.
+     * \param subDirectories will hold the names of the subdirectories, each one
+     *                       followed by a null character
+     * \param out            stream for messages
+     * \param verbose        if set to true, shows more info about errors
+     * \return Returns true, if all info was saved. Returns false otherwise.
+     */
+    static bool saveDirectoryEntries(const DirectoryHandle& directory, const std::string& basePath, std::string& relativePath, DirectoryReader& reader, StatEngine& engine, StatFileWriter& writer, std::string& records, const bool writeBatches, std::string& subDirectories, std::ostream& out, const bool verbose);
+
+
+    /** \brief saves the stats of the entries of the engine's batch and clears the batch
+     *
+     * Parameters are the same as for saveDirectoryEntries(), results is used
+     * for the results of the engine. Names of subdirectories are appended to
+     * subDirectories.
+     */
+    static bool saveBatch(const DirectoryHandle& directory, const std::string& basePath, std::string& relativePath, StatEngine& engine, std::vector<StatResult>& results, StatFileWriter& writer, std::string& records, const bool writeBatches, std::string& subDirectories, std::ostream& out, const bool verbose);
+
+
+    /** \brief saves the stats of all entries of a directory and its subdirectories
+     *
+     * The tree is walked iteratively, so its depth is not limited by the size
+     * of the call stack. Only the names of subdirectories that still have to
+     * be visited are kept per level, and the stack limits the number of open
+     * directories.
+     *
+     * \param stack       stack whose root is the opened directory
+     * \param basePath    path of the directory given to save(), used for messages
+     * \param reader      reader whose buffer is shared by all directories
+     * \param engine      engine for the status queries, shared by all directories
+     * \param writer      writer for the stat file
+     * \param verbose     if set to true, shows more info about errors
+     * \return Returns true, if all info was saved. Returns false otherwise.
+     */
+    static bool saveIterative(DirectoryStack& stack, const std::string& basePath, DirectoryReader& reader, StatEngine& engine, StatFileWriter& writer, const bool verbose);
+
+
+    /** \brief saves the stats of an opened directory and its subdirectories with several threads
+     *
+     * Each directory is read by its own task into a fragment. A writer thread
+     * writes the fragments in the same order as saveIterative() would do.
+     *
+     * \param directory   the opened directory
+     * \param basePath    path of the directory given to save(), used for messages
+     * \param writer      writer for the stat file
+     * \param verbose     if set to true, shows more info about errors
+     * \param jobs        number of threads
+     * \return Returns true, if all info was saved. Returns false otherwise.
+     */
+    static bool saveParallel(const std::shared_ptr<DirectoryHandle>& directory, const std::string& basePath, StatFileWriter& writer, const bool verbose, const unsigned int jobs);
+
+
+    /** \brief task of saveParallel() that saves one directory and submits tasks for its subdirectories */
+    static void saveDirectoryTask(ParallelSave& state, const unsigned int worker, const std::shared_ptr<DirectoryHandle>& directory, std::string relativePath, SaveNode * node);
+
+
+    /** \brief marks a node as completed and writes the messages of its task */
+    static void finishNode(ParallelSave& state, SaveNode * node, MessageBuffer& out, const bool success);
+
+
+    /** \brief writes the records of all nodes in order, as soon as they are completed
+     *
+     * \return Returns true, if all records were written. Returns false otherwise.
+     */
+    static bool writeNodes(ParallelSave& state, SaveNode& root);
+
+
+    /** \brief restores permissions and/or ownership of one entry
+     *
+     * \param chain        directory chain of the destination directory
+     * \param destPrefix   destination directory with trailing slash, used for messages
+     * \param file         path of the entry relative to the destination directory
+     * \param mode         the new mode
+     * \param UID          the new owner
+     * \param GID          the new group
+     * \param position     position of the line in the stat file
+     * \param permissions  If set to true, permissions will be adjusted.
+     * \param ownership    If set to true, ownership will be adjusted.
+     * \param verbose      if set to true, shows more info
+     * \param dryRun       If set to true, no actual changes will be made.
+     * \param retryDenied  If set to true, the function returns rrAccessDenied
+     *                     instead of an error, if a parent is not accessible.
+     * \param prefetched   already queried status of the entry, or NULL. The
+     *                     status is queried again, if the query failed.
+     * \param deferred     mode changes that remove permissions from a directory
+     *                     are added to this list instead of being applied
+     * \param out          stream for messages
+     * \return Returns rrDone, if the entry was handled. Returns rrAccessDenied
+     *         or rrFailed otherwise.
+     */
+    static RestoreResult restoreEntry(DirectoryChain& chain, const std::string& destPrefix, const std::string& file,
+                                      const mode_t mode, const uid_t UID, const gid_t GID, const std::string::size_type position,
+                                      const bool permissions, const bool ownership, const bool verbose, const bool dryRun,
+                                      const bool retryDenied, const StatResult * prefetched, std::vector<DeferredMode>& deferred, std::ostream& out);
+
+
+    /** \brief applies permissions and/or ownership to an entry whose status is known
+     *
+     * \param parent           the directory that contains the entry
+     * \param baseName         name of the entry within parent
+     * \param destinationFile  full path of the entry, used for messages
+     * \param dest_statbuf     current status of the entry
+     * \return Returns true, if the entry was handled. Returns false otherwise.
+     * \remarks The remaining parameters are the same as for restoreEntry().
+     */
+    static bool applyEntry(const DirectoryHandle& parent, const std::string& baseName, const std::string& destinationFile,
+                           const struct stat& dest_statbuf, const std::string& file, const mode_t mode, const uid_t UID, const gid_t GID,
+                           const std::string::size_type position, const bool permissions, const bool ownership, const bool verbose,
+                           const bool dryRun, std::vector<DeferredMode>& deferred, std::ostream& out);
+
+
+    /** \brief checks whether a line belongs to the current batch of lines
+     *
+     * \param pending  the current batch, see restoreBatch()
+     * \param file     path of the line, relative to the destination directory
+     * \return Returns true, if the batch is empty or if the entry is in the
+     *         same directory as the entries of the batch. Returns false, if
+     *         the batch has to be restored before the line is added.
+     */
+    static bool continuesBatch(const std::vector<PendingLine>& pending, const std::string& file);
+
+
+    /** \brief restores the entries of a batch of lines and clears the batch
+     *
+     * The status of the entries is queried relative to their parent directory,
+     * so all lines of a batch have to be in the same directory, see
+     * continuesBatch().
+     * \param chain     directory chain of the destination directory
+     * \param engine    engine for the status queries, has to be empty
+     * \param pending   the parsed lines
+     * \param results   vector for the results of the engine
+     * \param denied    If not NULL, lines whose parent directory is not
+     *                  accessible are added to it instead of failing.
+     *                  See restoreEntry().
+     * \return Returns true, if all lines were handled. Returns false otherwise.
+     * \remarks The remaining parameters are the same as for restoreEntry().
+     */
+    static bool restoreBatch(DirectoryChain& chain, StatEngine& engine, std::vector<PendingLine>& pending, std::vector<StatResult>& results,
+                             const std::string& destPrefix, const bool permissions, const bool ownership, const bool verbose, const bool dryRun,
+                             std::vector<PendingLine> * denied, std::vector<DeferredMode>& deferred, std::ostream& out);
+
 
-    static bool saveRecursive(const std::string& src_directory, const std::string& removeSuffix, std::ofstream& statStream, const bool verbose);
+    /** \brief changes the mode of an entry relative to its parent directory and shows what it does
+     *
+     * \return Returns true, if the mode was changed (or would have been changed
+     *         in a dry run). Returns false otherwise.
+     */
+    static bool changeEntryMode(const DirectoryHandle& parent, const std::string& baseName, const std::string& destinationFile,
+                                const mode_t oldMode, const mode_t mode, const bool verbose, const bool dryRun, std::ostream& out);
+
+
+    /** \brief applies deferred directory mode changes, the deepest directories first
+     *
+     * \return Returns true, if all changes were applied. Returns false otherwise.
+     */
+    static bool applyDeferredModes(const std::string& dest_directory, std::vector<DeferredMode>& deferred, const bool verbose, const bool dryRun);
+
+
+    /** \brief restores the file information with several threads
+     *
+     * Uncompressed files are mapped into memory and split into chunks at line
+     * or record boundaries, which are applied by the workers of a pool. Each
+     * worker uses its own caches for user and group names. Compressed files
+     * are read by one thread instead, which passes batches of lines to the
+     * workers through a bounded queue. Lines whose parent directory is not
+     * accessible yet are retried after all chunks are done.
+     *
+     * \param statFileName name of the stat file
+     * \param statInput   the opened stat file, unused for mapped binary files
+     * \param binaryFile  the mapped binary stat file, or NULL
+     * \param binaryStream the opened compressed binary stat file, or NULL
+     * \param dictionary  whether the text file has a dictionary of users and groups
+     * \return Returns true, if all info was restored. Returns false otherwise.
+     */
+    bool restoreParallel(const std::string& dest_directory, const std::string& statFileName, DecompressingBuffer& statInput, const BinaryStatFile * binaryFile, BinaryStatStream * binaryStream, const bool dictionary, const bool permissions, const bool ownership, const bool verbose, const bool dryRun, const unsigned int jobs);
+
+
+    /** \brief restores the file information by walking the destination directory once
+     *
+     * All lines of entries are loaded into an index that is keyed by the
+     * relative path, see PathIndex. Then the destination directory is walked like save()
+     * walks the source, and each entry is looked up in the index. So entries
+     * are found by reading their directories sequentially instead of
+     * resolving every path of the file on its own. Entries that are not
+     * listed in the file and lines whose entry does not exist are reported,
+     * if verbose or dryRun is set.
+     *
+     * \return Returns true, if all info was restored. Returns false otherwise.
+     * \remarks Symbolic links to directories are not followed by the walk, so
+     *          lines with paths through such links are treated as missing.
+     */
+    static bool restoreByWalk(const std::string& dest_directory, EntryReader& entries, const bool permissions, const bool ownership, const bool verbose, const bool dryRun);
+
+
+    /** \brief restores the entries of an opened directory that are listed in the index, but not the content of its subdirectories
+     *
+     * \param directory       the opened directory
+     * \param destPrefix      destination directory with trailing slash, used for messages
+     * \param relativePath    path of directory relative to the destination, with
+     *                        trailing slash. Will be extended temporarily for each entry.
+     * \param reader          reader for the directory
+     * \param engine          engine for the status queries
+     * \param index           the index of restoreByWalk(), found lines are marked
+     * \param subDirectories  will hold the names of the subdirectories, each one
+     *                        followed by a null character
+     * \return Returns true, if all entries were handled. Returns false otherwise.
+     * \remarks The remaining parameters are the same as for restoreEntry().
+     */
+    static bool restoreDirectoryEntries(const DirectoryHandle& directory, const std::string& destPrefix, std::string& relativePath,
+                                        DirectoryReader& reader, StatEngine& engine, LineIndex& index, std::string& subDirectories,
+                                        const bool permissions, const bool ownership, const bool verbose, const bool dryRun,
+                                        std::vector<DeferredMode>& deferred);
+
+
+    /** \brief restores the entries of the engine's batch and clears the batch
+     *
+     * Parameters are the same as for restoreDirectoryEntries(), results is
+     * used for the results of the engine.
+     */
+    static bool restoreWalkBatch(const DirectoryHandle& directory, const std::string& destPrefix, std::string& relativePath,
+                                 StatEngine& engine, std::vector<StatResult>& results, LineIndex& index, std::string& subDirectories,
+                                 const bool permissions, const bool ownership, const bool verbose, const bool dryRun,
+                                 std::vector<DeferredMode>& deferred);
 }; //class
 
 #endif // SAVERESTORE_HPP
@@ -0,0 +1,372 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include "StatEngine.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>          //for AT_SYMLINK_NOFOLLOW
+#include <linux/io_uring.h>
+#include <stdint.h>
+#include <sys/mman.h>       //for mmap()
+#include <sys/syscall.h>    //for __NR_io_uring_*
+#include <sys/sysmacros.h>  //for makedev()
+#include <unistd.h>         //for syscall(), close()
+
+const std::size_t StatEngine::cBatchSize;
+const unsigned int StatEngine::cStatxMask;
+StatEngine::Kind StatEngine::sDefaultKind = StatEngine::ekSynchronous;
+bool StatEngine::sSynchronize = true;
+std::atomic<bool> StatEngine::sStatxAvailable(true);
+
+StatEngine::StatEngine()
+: mNames(),
+  mItems()
+{
+}
+
+StatEngine::~StatEngine()
+{
+}
+
+void StatEngine::add(const char * name, const std::size_t length, const unsigned char type)
+{
+  Item item;
+  item.offset = mNames.size();
+  item.length = length;
+  item.type = type;
+  mItems.push_back(item);
+  mNames.append(name, length).append(1, '\0');
+}
+
+std::size_t StatEngine::size() const
+{
+  return mItems.size();
+}
+
+bool StatEngine::full() const
+{
+  return mItems.size() >= cBatchSize;
+}
+
+void StatEngine::clear()
+{
+  mNames.clear();
+  mItems.clear();
+}
+
+const char * StatEngine::name(const std::size_t index) const
+{
+  return mNames.c_str() + mItems[index].offset;
+}
+
+std::size_t StatEngine::length(const std::size_t index) const
+{
+  return mItems[index].length;
+}
+
+unsigned char StatEngine::type(const std::size_t index) const
+{
+  return mItems[index].type;
+}
+
+void StatEngine::query(const DirectoryHandle& directory, std::vector<StatResult>& results)
+{
+  results.resize(mItems.size());
+  if (!mItems.empty())
+    queryAll(directory.fd(), results);
+}
+
+std::unique_ptr<StatEngine> StatEngine::create()
+{
+  if (sDefaultKind == ekIoUring)
+  {
+    IoUringStatEngine * engine = new IoUringStatEngine();
+    if (engine->available())
+      return std::unique_ptr<StatEngine>(engine);
+    delete engine;
+  }
+  return std::unique_ptr<StatEngine>(new SynchronousStatEngine());
+}
+
+int StatEngine::statAt(const int directory, const char * name, struct stat& status)
+{
+  if (sStatxAvailable)
+  {
+    struct statx buffer;
+    if (0 == statx(directory, name, statxFlags(), cStatxMask, &buffer))
+    {
+      statxToStat(buffer, status);
+      return 0;
+    }
+    if (errno != ENOSYS)
+      return -1;
+    // kernels before 4.11 have no statx()
+    sStatxAvailable = false;
+  }
+  return fstatat(directory, name, &status, AT_SYMLINK_NOFOLLOW);
+}
+
+void StatEngine::setSynchronizeAttributes(const bool synchronize)
+{
+  sSynchronize = synchronize;
+}
+
+int StatEngine::statxFlags()
+{
+  return AT_SYMLINK_NOFOLLOW | (sSynchronize ? AT_STATX_SYNC_AS_STAT : AT_STATX_DONT_SYNC);
+}
+
+void StatEngine::statxToStat(const struct statx& source, struct stat& destination)
+{
+  std::memset(&destination, 0, sizeof(destination));
+  destination.st_dev = makedev(source.stx_dev_major, source.stx_dev_minor);
+  destination.st_ino = source.stx_ino;
+  destination.st_mode = source.stx_mode;
+  destination.st_nlink = source.stx_nlink;
+  destination.st_uid = source.stx_uid;
+  destination.st_gid = source.stx_gid;
+}
+
+bool StatEngine::setDefaultKind(const Kind kind)
+{
+  if (kind == ekIoUring)
+  {
+    const IoUringStatEngine probe;
+    if (!probe.available())
+    {
+      sDefaultKind = ekSynchronous;
+      return false;
+    }
+  }
+  sDefaultKind = kind;
+  return true;
+}
+
+
+SynchronousStatEngine::SynchronousStatEngine()
+: StatEngine()
+{
+}
+
+void SynchronousStatEngine::queryAll(const int directory, std::vector<StatResult>& results)
+{
+  for (std::size_t i = 0; i < results.size(); ++i)
+  {
+    results[i].error = 0;
+    if (0 != statAt(directory, name(i), results[i].status))
+      results[i].error = errno;
+  }
+}
+
+
+struct IoUringStatEngine::Ring
+{
+  int fd; /* file descriptor of the ring */
+  void * sqRing; /* mapped submission queue ring */
+  std::size_t sqRingSize;
+  void * cqRing; /* mapped completion queue ring, may be the same as sqRing */
+  std::size_t cqRingSize;
+  struct io_uring_sqe * sqes; /* mapped array of submission queue entries */
+  std::size_t sqesSize;
+  unsigned int * sqTail;
+  unsigned int * sqMask;
+  unsigned int * sqArray;
+  unsigned int sqEntries;
+  unsigned int * cqHead;
+  unsigned int * cqTail;
+  unsigned int * cqMask;
+  struct io_uring_cqe * cqes;
+  bool broken; /* whether io_uring_enter() failed unexpectedly */
+  std::vector<struct statx> buffers; /* one buffer per submission queue entry */
+
+  Ring()
+  : fd(-1), sqRing(MAP_FAILED), sqRingSize(0), cqRing(MAP_FAILED), cqRingSize(0),
+    sqes(NULL), sqesSize(0), sqTail(NULL), sqMask(NULL), sqArray(NULL), sqEntries(0),
+    cqHead(NULL), cqTail(NULL), cqMask(NULL), cqes(NULL), broken(false), buffers()
+  { }
+
+  ~Ring()
+  {
+    if (sqes != NULL)
+      munmap(sqes, sqesSize);
+    if ((cqRing != MAP_FAILED) && (cqRing != sqRing))
+      munmap(cqRing, cqRingSize);
+    if (sqRing != MAP_FAILED)
+      munmap(sqRing, sqRingSize);
+    if (fd >= 0)
+      close(fd);
+  }
+
+  /* sets up the ring, returns true on success */
+  bool setup(const unsigned int entries)
+  {
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0)
+      return false;
+
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned int);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    const bool singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMap)
+    {
+      if (cqRingSize > sqRingSize)
+        sqRingSize = cqRingSize;
+      cqRingSize = sqRingSize;
+    }
+    sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED)
+      return false;
+    if (singleMap)
+      cqRing = sqRing;
+    else
+    {
+      cqRing = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+      if (cqRing == MAP_FAILED)
+        return false;
+    }
+    sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    void * mapped = mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (mapped == MAP_FAILED)
+      return false;
+    sqes = static_cast<struct io_uring_sqe*>(mapped);
+
+    char * sq = static_cast<char*>(sqRing);
+    sqTail = reinterpret_cast<unsigned int*>(sq + params.sq_off.tail);
+    sqMask = reinterpret_cast<unsigned int*>(sq + params.sq_off.ring_mask);
+    sqArray = reinterpret_cast<unsigned int*>(sq + params.sq_off.array);
+    sqEntries = params.sq_entries;
+    char * cq = static_cast<char*>(cqRing);
+    cqHead = reinterpret_cast<unsigned int*>(cq + params.cq_off.head);
+    cqTail = reinterpret_cast<unsigned int*>(cq + params.cq_off.tail);
+    cqMask = reinterpret_cast<unsigned int*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+    buffers.resize(sqEntries);
+    return supportsStatx();
+  }
+
+  /* checks whether the kernel supports IORING_OP_STATX (Linux 5.6+) */
+  bool supportsStatx() const
+  {
+    const unsigned int cOps = 256;
+    std::vector<char> buffer(sizeof(struct io_uring_probe) + cOps * sizeof(struct io_uring_probe_op), 0);
+    struct io_uring_probe * probe = reinterpret_cast<struct io_uring_probe*>(&buffer[0]);
+    if (syscall(__NR_io_uring_register, fd, IORING_REGISTER_PROBE, probe, cOps) < 0)
+      return false;
+    return (probe->last_op >= IORING_OP_STATX)
+        && ((probe->ops[IORING_OP_STATX].flags & IO_URING_OP_SUPPORTED) != 0);
+  }
+};//struct
+
+IoUringStatEngine::IoUringStatEngine()
+: StatEngine(),
+  mRing(new Ring())
+{
+  if (!mRing->setup(cBatchSize))
+    mRing.reset();
+}
+
+IoUringStatEngine::~IoUringStatEngine()
+{
+}
+
+bool IoUringStatEngine::available() const
+{
+  return mRing.get() != NULL;
+}
+
+void IoUringStatEngine::queryAll(const int directory, std::vector<StatResult>& results)
+{
+  Ring& ring = *mRing;
+  std::vector<bool> done(results.size(), false);
+  std::size_t base = 0;
+  while ((base < results.size()) && !ring.broken)
+  {
+    // fill the submission queue with as many requests as fit into it
+    const unsigned int count = (results.size() - base < ring.sqEntries) ? (results.size() - base) : ring.sqEntries;
+    const unsigned int tail = *ring.sqTail;
+    for (unsigned int i = 0; i < count; ++i)
+    {
+      const unsigned int index = (tail + i) & *ring.sqMask;
+      struct io_uring_sqe * sqe = &ring.sqes[index];
+      std::memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = IORING_OP_STATX;
+      sqe->fd = directory;
+      sqe->addr = reinterpret_cast<uintptr_t>(name(base + i));
+      sqe->len = cStatxMask;
+      sqe->off = reinterpret_cast<uintptr_t>(&ring.buffers[i]);
+      sqe->statx_flags = statxFlags();
+      sqe->user_data = base + i;
+      ring.sqArray[index] = index;
+    }
+    // The kernel must see the entries before the new tail.
+    __atomic_store_n(ring.sqTail, tail + count, __ATOMIC_RELEASE);
+
+    // submit all of them and wait for the completions
+    unsigned int toSubmit = count;
+    unsigned int completed = 0;
+    while (completed < count)
+    {
+      const long ret = syscall(__NR_io_uring_enter, ring.fd, toSubmit, count - completed, IORING_ENTER_GETEVENTS, NULL, 0);
+      if (ret < 0)
+      {
+        if ((errno == EINTR) || (errno == EAGAIN) || (errno == EBUSY))
+          continue;
+        // Should not happen. Remaining entries are queried synchronously.
+        ring.broken = true;
+        break;
+      }
+      toSubmit -= (static_cast<unsigned int>(ret) < toSubmit) ? ret : toSubmit;
+      unsigned int head = *ring.cqHead;
+      const unsigned int cqTail = __atomic_load_n(ring.cqTail, __ATOMIC_ACQUIRE);
+      while (head != cqTail)
+      {
+        const struct io_uring_cqe& cqe = ring.cqes[head & *ring.cqMask];
+        const std::size_t index = cqe.user_data;
+        if (cqe.res < 0)
+          results[index].error = -cqe.res;
+        else
+        {
+          results[index].error = 0;
+          statxToStat(ring.buffers[index - base], results[index].status);
+        }
+        done[index] = true;
+        ++completed;
+        ++head;
+      } // while
+      __atomic_store_n(ring.cqHead, head, __ATOMIC_RELEASE);
+    } // while
+    base += count;
+  } // while
+
+  if (ring.broken)
+  {
+    for (std::size_t i = 0; i < results.size(); ++i)
+    {
+      if (!done[i])
+      {
+        results[i].error = 0;
+        if (0 != statAt(directory, name(i), results[i].status))
+          results[i].error = errno;
+      }
+    } // for
+  }
+}
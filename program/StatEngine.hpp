@@ -0,0 +1,240 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef STATENGINE_HPP
+#define STATENGINE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include "DirectoryHandle.hpp"
+
+/* result of a status query of a StatEngine */
+struct StatResult {
+    struct stat status; /* status of the entry, only valid if error is zero */
+    int error;          /* zero on success, errno value of the failed query otherwise */
+};//struct
+
+
+/** \brief queries the status of a batch of entries relative to a directory
+ *
+ * Callers add the names of a batch of entries (e.g. one buffer of a
+ * DirectoryReader) and query them all at once. Symbolic links are never
+ * followed, like DirectoryHandle::statEntry() does.
+ *
+ * The synchronous engine simply calls statAt() for each entry. The io_uring
+ * engine submits the whole batch as IORING_OP_STATX requests with a single
+ * system call, so the kernel can work on all of them at once and a thread
+ * does not have to wait for each entry on high-latency storage.
+ *
+ * Each thread needs its own engine.
+ */
+class StatEngine
+{
+  public:
+    /* kinds of engines */
+    enum Kind { ekSynchronous, ekIoUring };
+
+    static const std::size_t cBatchSize = 256; /**< number of entries after which full() returns true */
+
+    /** fields that are queried via statx() - we only need type, mode, owner,
+        group, inode and number of hard links (the device is always filled
+        in), so the file system does not have to provide sizes, times and so on */
+    static const unsigned int cStatxMask = STATX_TYPE | STATX_MODE | STATX_NLINK | STATX_UID | STATX_GID | STATX_INO;
+
+
+    /** \brief destructor */
+    virtual ~StatEngine();
+
+
+    /** \brief adds an entry to the batch
+     *
+     * \param name    name of the entry, relative to the directory given to
+     *                query(). It does not have to be null-terminated.
+     * \param length  length of the name
+     * \param type    type of the entry (DT_DIR, DT_REG, ...), may be DT_UNKNOWN
+     * \remarks The name is copied, so it may become invalid after the call.
+     */
+    void add(const char * name, const std::size_t length, const unsigned char type);
+
+
+    /** \brief gets the number of entries in the batch */
+    std::size_t size() const;
+
+
+    /** \brief checks whether the batch should be queried before more entries are added */
+    bool full() const;
+
+
+    /** \brief removes all entries from the batch */
+    void clear();
+
+
+    /** \brief gets the null-terminated name of an entry of the batch */
+    const char * name(const std::size_t index) const;
+
+
+    /** \brief gets the length of the name of an entry of the batch */
+    std::size_t length(const std::size_t index) const;
+
+
+    /** \brief gets the type of an entry of the batch, as given to add() */
+    unsigned char type(const std::size_t index) const;
+
+
+    /** \brief queries the status of all entries of the batch
+     *
+     * \param directory  the directory that the names are relative to
+     * \param results    will hold one result per entry, in the order of add()
+     */
+    void query(const DirectoryHandle& directory, std::vector<StatResult>& results);
+
+
+    /** \brief creates an engine of the default kind
+     *
+     * \return Returns a new engine. If the default kind is ekIoUring, but
+     *         io_uring cannot be used, then a synchronous engine is returned.
+     */
+    static std::unique_ptr<StatEngine> create();
+
+
+    /** \brief queries the status of a single entry without following symbolic links
+     *
+     * Uses statx() with the mask cStatxMask and the flags given by
+     * setSynchronizeAttributes(), and fstatat() on kernels without statx().
+     *
+     * \param directory  file descriptor of the directory, or AT_FDCWD
+     * \param name       name of the entry, relative to directory
+     * \param status     buffer that will hold the status. Only type, mode,
+     *                   owner, group, inode and device are filled in.
+     * \return Returns zero on success. Returns -1 otherwise, errno is set.
+     */
+    static int statAt(const int directory, const char * name, struct stat& status);
+
+
+    /** \brief sets whether the file system has to synchronize attributes for queries
+     *
+     * \param synchronize  If set to false, queries use AT_STATX_DONT_SYNC, so
+     *                     network file systems like NFS may answer with cached
+     *                     attributes instead of asking the server again.
+     *                     Default is true (AT_STATX_SYNC_AS_STAT).
+     */
+    static void setSynchronizeAttributes(const bool synchronize);
+
+
+    /** \brief sets the kind of engines that create() returns
+     *
+     * \param kind  the kind of engine
+     * \return Returns true, if engines of that kind can be used on this system.
+     *         Returns false, if create() will fall back to synchronous engines.
+     */
+    static bool setDefaultKind(const Kind kind);
+  protected:
+    /** \brief constructor */
+    StatEngine();
+
+
+    /** \brief gets the flags for statx()
+     *
+     * \return Returns AT_SYMLINK_NOFOLLOW plus the synchronization flag.
+     */
+    static int statxFlags();
+
+
+    /** \brief converts the result of statx() to struct stat
+     *
+     * \param source       the result of statx()
+     * \param destination  the converted status, fields that are not part of
+     *                     cStatxMask are set to zero
+     */
+    static void statxToStat(const struct statx& source, struct stat& destination);
+
+
+    /** \brief queries the status of all entries of the batch
+     *
+     * \param directory  file descriptor of the directory, or AT_FDCWD
+     * \param results    vector with one element per entry, will hold the results
+     */
+    virtual void queryAll(const int directory, std::vector<StatResult>& results) = 0;
+  private:
+    /* entry of the batch */
+    struct Item {
+        std::string::size_type offset; /* offset of the name in mNames */
+        std::size_t length; /* length of the name */
+        unsigned char type; /* type of the entry */
+    };//struct
+
+    std::string mNames; /**< null-terminated names of all entries */
+    std::vector<Item> mItems; /**< entries of the batch */
+
+    static Kind sDefaultKind; /**< kind of engines returned by create() */
+    static bool sSynchronize; /**< whether attributes have to be synchronized */
+    static std::atomic<bool> sStatxAvailable; /**< false, if the kernel has no statx() */
+
+    // not copyable
+    StatEngine(const StatEngine& other) = delete;
+    StatEngine& operator=(const StatEngine& other) = delete;
+}; //class
+
+
+/** \brief engine that queries entries one by one via fstatat() */
+class SynchronousStatEngine: public StatEngine
+{
+  public:
+    /** \brief constructor */
+    SynchronousStatEngine();
+  protected:
+    virtual void queryAll(const int directory, std::vector<StatResult>& results);
+}; //class
+
+
+/** \brief engine that submits IORING_OP_STATX requests in batches via io_uring
+ *
+ * The ring is set up with the raw system calls, so no additional library is
+ * required. Use available() to check whether the kernel supports it.
+ */
+class IoUringStatEngine: public StatEngine
+{
+  public:
+    /** \brief constructor - sets up the ring */
+    IoUringStatEngine();
+
+
+    /** \brief destructor - releases the ring */
+    virtual ~IoUringStatEngine();
+
+
+    /** \brief checks whether the ring could be set up and supports statx
+     *
+     * \return Returns true, if the engine can be used.
+     */
+    bool available() const;
+  protected:
+    virtual void queryAll(const int directory, std::vector<StatResult>& results);
+  private:
+    struct Ring; /* memory mapped parts of the ring */
+
+    std::unique_ptr<Ring> mRing; /**< the ring, or NULL if it could not be set up */
+}; //class
+
+#endif // STATENGINE_HPP
@@ -0,0 +1,582 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include "StatFile.hpp"
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "AuxiliaryFunctions.hpp"
+#include "FileUtilities.hpp"
+#include "NameCache.hpp"
+#include "SaveRestore.hpp"
+
+namespace
+{
+  /* appends an integer in little endian byte order */
+  void putUint16(std::string& buffer, const std::uint32_t value)
+  {
+    buffer.push_back(static_cast<char>(value & 0xFF));
+    buffer.push_back(static_cast<char>((value >> 8) & 0xFF));
+  }
+
+  void putUint32(std::string& buffer, const std::uint32_t value)
+  {
+    buffer.push_back(static_cast<char>(value & 0xFF));
+    buffer.push_back(static_cast<char>((value >> 8) & 0xFF));
+    buffer.push_back(static_cast<char>((value >> 16) & 0xFF));
+    buffer.push_back(static_cast<char>((value >> 24) & 0xFF));
+  }
+
+  void putUint64(std::string& buffer, const std::uint64_t value)
+  {
+    putUint32(buffer, static_cast<std::uint32_t>(value));
+    putUint32(buffer, static_cast<std::uint32_t>(value >> 32));
+  }
+
+  /* reads an integer in little endian byte order */
+  std::uint32_t getUint16(const char * data)
+  {
+    const unsigned char * bytes = reinterpret_cast<const unsigned char*>(data);
+    return static_cast<std::uint32_t>(bytes[0]) | (static_cast<std::uint32_t>(bytes[1]) << 8);
+  }
+
+  std::uint32_t getUint32(const char * data)
+  {
+    const unsigned char * bytes = reinterpret_cast<const unsigned char*>(data);
+    return static_cast<std::uint32_t>(bytes[0]) | (static_cast<std::uint32_t>(bytes[1]) << 8)
+         | (static_cast<std::uint32_t>(bytes[2]) << 16) | (static_cast<std::uint32_t>(bytes[3]) << 24);
+  }
+
+  std::uint64_t getUint64(const char * data)
+  {
+    return static_cast<std::uint64_t>(getUint32(data)) | (static_cast<std::uint64_t>(getUint32(data + 4)) << 32);
+  }
+
+  /* Records of fragments for entries with several hard links are entry
+     records with the device and inode number (64 bits each) in front of the
+     length of the path. write() turns them into links. */
+  const char cLinkedEntry = 'L';
+  const std::size_t cLinkedEntrySize = BinaryStatFormat::cEntrySize + 16;
+
+  /* checks the header of a binary stat file and gets its flags */
+  bool checkBinaryHeader(const char * data, std::uint32_t& flags, std::string& error)
+  {
+    if (std::memcmp(data, BinaryStatFormat::cMagic, sizeof(BinaryStatFormat::cMagic)) != 0)
+    {
+      error = "File is not a binary stat file.";
+      return false;
+    }
+    const std::uint32_t version = getUint32(data + sizeof(BinaryStatFormat::cMagic));
+    if (version != BinaryStatFormat::cVersion)
+    {
+      error = "Unsupported version of binary stat file.";
+      return false;
+    }
+    flags = getUint32(data + sizeof(BinaryStatFormat::cMagic) + 4);
+    if ((flags & ~BinaryStatFormat::cFrontCoded) != 0)
+    {
+      error = "Binary stat file uses unsupported features.";
+      return false;
+    }
+    return true;
+  }
+
+  enum DecodeResult { drComplete, drTruncated, drInvalid };
+
+  /* decodes the record at the start of data, size is set to the size of the
+     record as soon as its header is complete */
+  DecodeResult decodeRecord(const char * data, const std::size_t remaining, const bool frontCoded,
+                            BinaryStatFormat::Record& record, std::size_t& size)
+  {
+    if (remaining == 0)
+      return drTruncated;
+    record.type = data[0];
+    std::size_t headerSize = 0;
+    switch (record.type)
+    {
+      case BinaryStatFormat::rtUser:
+      case BinaryStatFormat::rtGroup:
+           headerSize = BinaryStatFormat::cDefinitionSize;
+           if (remaining < headerSize)
+             return drTruncated;
+           record.id = getUint32(data + 1);
+           record.length = getUint32(data + 5);
+           break;
+      case BinaryStatFormat::rtEntry:
+           headerSize = frontCoded ? BinaryStatFormat::cFrontCodedEntrySize : BinaryStatFormat::cEntrySize;
+           if (remaining < headerSize)
+             return drTruncated;
+           record.mode = getUint16(data + 1);
+           record.user = getUint32(data + 3);
+           record.group = getUint32(data + 7);
+           record.shared = frontCoded ? getUint32(data + 11) : 0;
+           record.length = getUint32(data + headerSize - 4);
+           break;
+      case BinaryStatFormat::rtInode:
+           headerSize = BinaryStatFormat::cInodeSize;
+           if (remaining < headerSize)
+             return drTruncated;
+           record.mode = getUint16(data + 1);
+           record.user = getUint32(data + 3);
+           record.group = getUint32(data + 7);
+           record.length = 0;
+           break;
+      case BinaryStatFormat::rtLink:
+           headerSize = frontCoded ? BinaryStatFormat::cFrontCodedLinkSize : BinaryStatFormat::cLinkSize;
+           if (remaining < headerSize)
+             return drTruncated;
+           record.inode = getUint32(data + 1);
+           record.shared = frontCoded ? getUint32(data + 5) : 0;
+           record.length = getUint32(data + headerSize - 4);
+           break;
+      default:
+           // unknown record type
+           return drInvalid;
+    } // switch
+    size = headerSize + record.length;
+    if (remaining - headerSize < record.length)
+      return drTruncated;
+    record.text = data + headerSize;
+    return drComplete;
+  }
+} //namespace
+
+
+StatFileWriter::StatFileWriter(const StatFileFormat format, std::ostream& stream)
+: mFormat(format),
+  mStream(stream),
+  mUsers(),
+  mGroups(),
+  mInodes(),
+  mLinks(0),
+  mPreviousPath(),
+  mDefinitions(),
+  mRecords()
+{
+}
+
+bool StatFileWriter::begin()
+{
+  if (mFormat == sfText)
+    return true;
+  if (mFormat == sfDictionary)
+  {
+    mStream << DictionaryStatFormat::cHeader << '\n';
+    return mStream.good();
+  }
+  std::string header(BinaryStatFormat::cMagic, sizeof(BinaryStatFormat::cMagic));
+  putUint32(header, BinaryStatFormat::cVersion);
+  putUint32(header, BinaryStatFormat::cFrontCoded);
+  mStream.write(header.c_str(), header.size());
+  return mStream.good();
+}
+
+void StatFileWriter::encode(const FileStatus& status, const std::string& path, std::string& fragment) const
+{
+  if (mFormat == sfText)
+  {
+    SaveRestore::appendStatString(status, path, fragment);
+    fragment.push_back('\n');
+    return;
+  }
+
+  // Binary and dictionary files share the records of fragments. They get
+  // the IDs for now, write() replaces them by indices.
+  const bool linked = !S_ISDIR(status.mode) and (status.linkCount > 1);
+  fragment.push_back(linked ? cLinkedEntry : static_cast<char>(BinaryStatFormat::rtEntry));
+  putUint16(fragment, status.mode & 07777);
+  putUint32(fragment, status.userID);
+  putUint32(fragment, status.groupID);
+  if (linked)
+  {
+    putUint64(fragment, status.device);
+    putUint64(fragment, status.inode);
+  }
+  putUint32(fragment, path.size());
+  fragment.append(path);
+}
+
+std::uint32_t StatFileWriter::indexOf(std::unordered_map<std::uint32_t, std::uint32_t>& table, const std::uint32_t id, const char type, std::string& definitions)
+{
+  const std::unordered_map<std::uint32_t, std::uint32_t>::const_iterator found = table.find(id);
+  if (found != table.end())
+    return found->second;
+  // new ID: look up its name once, unknown names are stored as empty string
+  const std::string * cached = (type == BinaryStatFormat::rtUser) ? NameCache::shared().userName(id) : NameCache::shared().groupName(id);
+  const bool known = (cached != NULL);
+  std::string name = known ? *cached : std::string();
+  if (mFormat == sfDictionary)
+  {
+    definitions.append((type == BinaryStatFormat::rtUser) ? DictionaryStatFormat::cUser : DictionaryStatFormat::cGroup);
+    definitions.append(known ? name : std::string("?"));
+    definitions.push_back(' ');
+    appendUint(definitions, id);
+    definitions.push_back('\n');
+  }
+  else
+  {
+    if (!known)
+      name.clear();
+    definitions.push_back(type);
+    putUint32(definitions, id);
+    putUint32(definitions, name.size());
+    definitions.append(name);
+  }
+  const std::uint32_t index = table.size();
+  table[id] = index;
+  return index;
+}
+
+std::uint32_t StatFileWriter::inodeIndexOf(const std::uint64_t device, const std::uint64_t inode, const std::uint32_t mode,
+                                           const std::uint32_t user, const std::uint32_t group, std::string& definitions)
+{
+  bool inserted = false;
+  const std::uint32_t index = mInodes.insert(device, inode, mInodes.size(), inserted);
+  if (!inserted)
+  {
+    ++mLinks;
+    return index;
+  }
+  // first link of the inode: define its stats
+  if (mFormat == sfDictionary)
+  {
+    definitions.append(DictionaryStatFormat::cInode);
+    SaveRestore::appendModeString(mode, definitions);
+    definitions.push_back(' ');
+    appendUint(definitions, user);
+    definitions.push_back(' ');
+    appendUint(definitions, group);
+    definitions.push_back('\n');
+  }
+  else
+  {
+    definitions.push_back(static_cast<char>(BinaryStatFormat::rtInode));
+    putUint16(definitions, mode);
+    putUint32(definitions, user);
+    putUint32(definitions, group);
+  }
+  return index;
+}
+
+bool StatFileWriter::write(const std::string& fragment)
+{
+  if (mFormat == sfText)
+  {
+    mStream.write(fragment.c_str(), fragment.size());
+    return mStream.good();
+  }
+
+  // Indices and shared prefixes are determined in the order of the file, so
+  // the file does not depend on the order in which fragments were encoded.
+  // The buffers keep their capacity for the next fragments.
+  std::string& definitions = mDefinitions;
+  std::string& records = mRecords;
+  definitions.clear();
+  records.clear();
+  std::string::size_type offset = 0;
+  while (offset < fragment.size())
+  {
+    const char * record = fragment.c_str() + offset;
+    const bool linked = (record[0] == cLinkedEntry);
+    const std::size_t headerSize = linked ? cLinkedEntrySize : BinaryStatFormat::cEntrySize;
+    const std::uint32_t user = indexOf(mUsers, getUint32(record + 3), BinaryStatFormat::rtUser, definitions);
+    const std::uint32_t group = indexOf(mGroups, getUint32(record + 7), BinaryStatFormat::rtGroup, definitions);
+    const std::uint32_t length = getUint32(record + headerSize - 4);
+    const char * path = record + headerSize;
+    offset += headerSize + length;
+    std::uint32_t inode = 0;
+    if (linked)
+      inode = inodeIndexOf(getUint64(record + 11), getUint64(record + 19), getUint16(record + 1), user, group, definitions);
+    if ((mFormat == sfDictionary) and linked)
+    {
+      records.append(DictionaryStatFormat::cLink);
+      appendUint(records, inode);
+      records.push_back(' ');
+      records.append(path, length).push_back('\n');
+      continue;
+    }
+    if (mFormat == sfDictionary)
+    {
+      SaveRestore::appendModeString(getUint16(record + 1), records);
+      records.push_back(' ');
+      appendUint(records, user);
+      records.push_back(' ');
+      appendUint(records, group);
+      records.push_back(' ');
+      records.append(path, length).push_back('\n');
+      continue;
+    }
+
+    std::uint32_t shared = 0;
+    while ((shared < length) and (shared < mPreviousPath.size()) and (path[shared] == mPreviousPath[shared]))
+      ++shared;
+
+    if (linked)
+    {
+      records.push_back(static_cast<char>(BinaryStatFormat::rtLink));
+      putUint32(records, inode);
+    }
+    else
+    {
+      records.append(record, 3);
+      putUint32(records, user);
+      putUint32(records, group);
+    }
+    putUint32(records, shared);
+    putUint32(records, length - shared);
+    records.append(path + shared, length - shared);
+    mPreviousPath.replace(shared, std::string::npos, path + shared, length - shared);
+  } // while
+  if (!definitions.empty())
+    mStream.write(definitions.c_str(), definitions.size());
+  mStream.write(records.c_str(), records.size());
+  return mStream.good();
+}
+
+StatFileFormat StatFileWriter::format() const
+{
+  return mFormat;
+}
+
+unsigned long long StatFileWriter::links() const
+{
+  return mLinks;
+}
+
+
+MappedFile::MappedFile()
+: mData(NULL),
+  mSize(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+  if (mData != NULL)
+    munmap(const_cast<char*>(mData), mSize);
+}
+
+bool MappedFile::open(const std::string& fileName, std::string& error)
+{
+  const int fd = ::open(fileName.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0)
+  {
+    error = std::string("Could not open file: ") + strerror(errno);
+    return false;
+  }
+  struct stat statbuf;
+  if (fstat(fd, &statbuf) != 0)
+  {
+    error = std::string("Could not get size of file: ") + strerror(errno);
+    close(fd);
+    return false;
+  }
+  if (statbuf.st_size == 0)
+  {
+    // empty files cannot be mapped
+    close(fd);
+    return true;
+  }
+  void * mapped = mmap(NULL, statbuf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  const int errorCode = errno;
+  close(fd);
+  if (mapped == MAP_FAILED)
+  {
+    error = std::string("Could not map file into memory: ") + strerror(errorCode);
+    return false;
+  }
+  // stat files are read from front to back
+  madvise(mapped, statbuf.st_size, MADV_SEQUENTIAL);
+  mData = static_cast<const char*>(mapped);
+  mSize = statbuf.st_size;
+  return true;
+}
+
+const char * MappedFile::data() const
+{
+  return mData;
+}
+
+std::size_t MappedFile::size() const
+{
+  return mSize;
+}
+
+
+BinaryStatFile::BinaryStatFile()
+: mMapping(),
+  mData(NULL),
+  mSize(0),
+  mFlags(0)
+{
+}
+
+BinaryStatFile::~BinaryStatFile()
+{
+}
+
+bool BinaryStatFile::open(const std::string& fileName, std::string& error)
+{
+  if (!mMapping.open(fileName, error))
+    return false;
+  if (mMapping.size() < BinaryStatFormat::cHeaderSize)
+  {
+    error = "File is too short for a binary stat file.";
+    return false;
+  }
+  mData = mMapping.data();
+  mSize = mMapping.size();
+  return checkBinaryHeader(mData, mFlags, error);
+}
+
+bool BinaryStatFile::frontCoded() const
+{
+  return (mFlags & BinaryStatFormat::cFrontCoded) != 0;
+}
+
+std::size_t BinaryStatFile::begin() const
+{
+  return BinaryStatFormat::cHeaderSize;
+}
+
+std::size_t BinaryStatFile::end() const
+{
+  return mSize;
+}
+
+bool BinaryStatFile::next(std::size_t& offset, BinaryStatFormat::Record& record) const
+{
+  if (offset >= mSize)
+    return false;
+  std::size_t size = 0;
+  if (decodeRecord(mData + offset, mSize - offset, frontCoded(), record, size) != drComplete)
+    return false;
+  offset += size;
+  return true;
+}
+
+StatFileFormat BinaryStatFile::detectFormat(const std::string& fileName)
+{
+  std::ifstream stream(fileName.c_str(), std::ios::in | std::ios::binary);
+  char start[cDetectionSize];
+  stream.read(start, sizeof(start));
+  return detectFormat(start, stream.gcount());
+}
+
+StatFileFormat BinaryStatFile::detectFormat(const char * data, const std::size_t size)
+{
+  // The magic bytes are shorter than the signature of dictionary files.
+  if ((size >= sizeof(BinaryStatFormat::cMagic))
+      and (std::memcmp(data, BinaryStatFormat::cMagic, sizeof(BinaryStatFormat::cMagic)) == 0))
+    return sfBinary;
+  if ((size >= cDetectionSize)
+      and (std::memcmp(data, DictionaryStatFormat::cSignature, cDetectionSize) == 0))
+    return sfDictionary;
+  return sfText;
+}
+
+
+BinaryStatStream::BinaryStatStream(std::streambuf& input)
+: mInput(input),
+  mBuffer(),
+  mStart(0),
+  mEnd(0),
+  mOffset(0),
+  mEndOfInput(false),
+  mFlags(0)
+{
+}
+
+bool BinaryStatStream::open(std::string& error)
+{
+  mBuffer.resize(cBufferSize);
+  fill(BinaryStatFormat::cHeaderSize);
+  if (mEnd < BinaryStatFormat::cHeaderSize)
+  {
+    error = "File is too short for a binary stat file.";
+    return false;
+  }
+  if (!checkBinaryHeader(mBuffer.data(), mFlags, error))
+    return false;
+  mStart = BinaryStatFormat::cHeaderSize;
+  mOffset = BinaryStatFormat::cHeaderSize;
+  return true;
+}
+
+bool BinaryStatStream::frontCoded() const
+{
+  return (mFlags & BinaryStatFormat::cFrontCoded) != 0;
+}
+
+std::size_t BinaryStatStream::begin() const
+{
+  return BinaryStatFormat::cHeaderSize;
+}
+
+bool BinaryStatStream::next(std::size_t& offset, BinaryStatFormat::Record& record)
+{
+  while (true)
+  {
+    std::size_t size = 0;
+    const DecodeResult result = decodeRecord(mBuffer.data() + mStart, mEnd - mStart, frontCoded(), record, size);
+    if (result == drComplete)
+    {
+      mStart += size;
+      mOffset += size;
+      offset = mOffset;
+      return true;
+    }
+    if ((result == drInvalid) or mEndOfInput)
+      return false;
+    // The size of the record is known as soon as its header is complete, so
+    // the buffer only grows for records that are larger than the buffer.
+    if (!fill(size))
+      mEndOfInput = true;
+  } // while
+}
+
+bool BinaryStatStream::finished() const
+{
+  return mEndOfInput and (mStart == mEnd);
+}
+
+bool BinaryStatStream::fill(const std::size_t needed)
+{
+  // move the unread data to the front
+  if (mStart > 0)
+  {
+    std::memmove(mBuffer.data(), mBuffer.data() + mStart, mEnd - mStart);
+    mEnd -= mStart;
+    mStart = 0;
+  }
+  if (mBuffer.size() < needed)
+    mBuffer.resize(needed);
+  const std::size_t before = mEnd;
+  std::streamsize bytes = 0;
+  while ((mEnd < mBuffer.size())
+         and ((bytes = mInput.sgetn(mBuffer.data() + mEnd, mBuffer.size() - mEnd)) > 0))
+    mEnd += bytes;
+  return mEnd > before;
+}
@@ -0,0 +1,427 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef STATFILE_HPP
+#define STATFILE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "FileUtilities.hpp"
+#include "InodeMap.hpp"
+
+/* formats of stat files */
+enum StatFileFormat { sfText, sfDictionary, sfBinary };
+
+
+/** \brief layout of the text stat format with a dictionary of users and groups
+ *
+ * The first line is cHeader. Lines that start with cUser or cGroup define the
+ * next index of the user or group table, starting at zero. They contain the
+ * name ("?" if it was not known) and the ID, separated by a space, e.g.
+ *
+ *   #user root 0
+ *
+ * All other lines are entries like in plain text files, but with the indices
+ * of their user and group instead of name and ID:
+ *
+ *   rwxr-xr-x 0 0 path/of/entry
+ *
+ * Files that are not directories and have several hard links are saved as
+ * links. Lines that start with cInode define the next index of the inode
+ * table with the mode and the user and group indices of the inode, and lines
+ * that start with cLink are entries with the stats of an inode:
+ *
+ *   #inode rw-r--r-- 0 0
+ *   #link 0 path/of/first/link
+ *   #link 0 path/of/second/link
+ *
+ * Definitions always come before the first entry that uses them, so the file
+ * can be read in one pass, and every name has to be resolved only once.
+ */
+namespace DictionaryStatFormat
+{
+  const char cHeader[] = "#copy-file-stats dictionary 1"; /**< first line of the file, includes the version */
+  const char cSignature[] = "#copy-file-stats "; /**< start of the header line of any version */
+  const char cUser[] = "#user "; /**< start of a user definition */
+  const char cGroup[] = "#group "; /**< start of a group definition */
+  const char cInode[] = "#inode "; /**< start of an inode definition */
+  const char cLink[] = "#link "; /**< start of an entry that is a hard link of an inode */
+} //namespace
+
+
+/** \brief layout of the binary stat file format
+ *
+ * All integers are unsigned and stored in little endian byte order. The file
+ * starts with the eight bytes of cMagic, followed by the version (32 bits) and
+ * flags (32 bits). Then records follow, each one starts with its type:
+ *
+ *   rtUser:  id (32 bits), length of name (32 bits), name
+ *   rtGroup: id (32 bits), length of name (32 bits), name
+ *   rtEntry: mode (16 bits), user index (32 bits), group index (32 bits),
+ *            length of path (32 bits), path
+ *   rtInode: mode (16 bits), user index (32 bits), group index (32 bits)
+ *   rtLink:  inode index (32 bits), length of path (32 bits), path
+ *
+ * If the flag cFrontCoded is set, then entries and links store the number of leading
+ * bytes that their path shares with the path of the previous entry (32 bits)
+ * before the length of the path, and the path only contains the remaining
+ * bytes. Parents are saved before their children, so most paths only add a
+ * name to a prefix of the previous path.
+ *
+ * User and group records define the next index of their table, starting at
+ * zero. A name of length zero means that the name was not known. Inode
+ * records define the next index of the inode table in the same way. Files
+ * that are not directories and have several hard links are saved as links to
+ * their inode instead of entries, like in dictionary files. Definitions
+ * always come before the first entry that uses them, so the file can be read
+ * in one pass.
+ */
+namespace BinaryStatFormat
+{
+  const char cMagic[8] = { '\x89', 'C', 'F', 'S', '\r', '\n', '\x1a', '\n' }; /**< first bytes of a binary stat file */
+  const std::uint32_t cVersion = 1; /**< current version of the format */
+  const std::size_t cHeaderSize = 16; /**< size of the file header in bytes */
+  const std::size_t cDefinitionSize = 9; /**< size of a user or group record without the name */
+  const std::size_t cEntrySize = 15; /**< size of an entry record without the path */
+  const std::size_t cFrontCodedEntrySize = 19; /**< size of a front-coded entry record without the path */
+  const std::size_t cInodeSize = 11; /**< size of an inode record */
+  const std::size_t cLinkSize = 9; /**< size of a link record without the path */
+  const std::size_t cFrontCodedLinkSize = 13; /**< size of a front-coded link record without the path */
+  const std::uint32_t cFrontCoded = 1; /**< flag for front-coded paths */
+
+  /* types of records */
+  enum RecordType { rtUser = 'u', rtGroup = 'g', rtEntry = 'e', rtInode = 'i', rtLink = 'l' };
+
+  /* decoded record of a binary stat file - names and paths are not copied */
+  struct Record {
+      char type;           /* one of the RecordType values */
+      std::uint32_t id;    /* user or group ID of a definition */
+      std::uint32_t mode;  /* permissions of an entry or inode */
+      std::uint32_t user;  /* index of the user definition of an entry or inode */
+      std::uint32_t group; /* index of the group definition of an entry or inode */
+      std::uint32_t inode; /* index of the inode definition of a link */
+      std::uint32_t shared; /* number of bytes of the previous path that are
+                               part of the path of an entry or link, zero if
+                               the file is not front-coded */
+      const char * text;   /* name of a definition or (the rest of the) path
+                              of an entry or link, not null-terminated */
+      std::size_t length;  /* length of text */
+  };//struct
+} //namespace
+
+
+/** \brief encodes the entries of a directory tree into a stat file
+ *
+ * Records are encoded into fragments first, and fragments are written in the
+ * order of the walk. This allows several threads to encode fragments at once,
+ * while one thread writes them. encode() is thread-safe, write() is not.
+ * The file is the same, no matter in which order the fragments were encoded.
+ */
+class StatFileWriter
+{
+  public:
+    /** \brief constructor
+     *
+     * \param format  format of the file
+     * \param stream  stream that the file is written to
+     */
+    StatFileWriter(const StatFileFormat format, std::ostream& stream);
+
+
+    /** \brief writes the file header, if the format has one
+     *
+     * \return Returns true, if the header was written. Returns false otherwise.
+     */
+    bool begin();
+
+
+    /** \brief appends the record of an entry to a fragment
+     *
+     * \param status    status of the entry
+     * \param path      path of the entry relative to the saved directory
+     * \param fragment  the fragment that gets the record
+     */
+    void encode(const FileStatus& status, const std::string& path, std::string& fragment) const;
+
+
+    /** \brief writes a fragment to the stream
+     *
+     * \param fragment  the fragment
+     * \return Returns true, if the fragment was written. Returns false otherwise.
+     * \remarks Entries of binary and dictionary files get their table indices
+     *          here, binary entries also get their front-coded paths.
+     *          Definitions of users, groups and inodes that the fragment uses
+     *          for the first time are written before it.
+     */
+    bool write(const std::string& fragment);
+
+
+    /** \brief gets the number of entries that were written as links of an
+     *         inode whose definition was written before, i.e. all hard links
+     *         of an inode except the first one
+     */
+    unsigned long long links() const;
+
+
+    /** \brief gets the format of the file */
+    StatFileFormat format() const;
+  private:
+    StatFileFormat mFormat; /**< format of the file */
+    std::ostream& mStream; /**< stream that the file is written to */
+    std::unordered_map<std::uint32_t, std::uint32_t> mUsers; /**< user ID -> index of its definition */
+    std::unordered_map<std::uint32_t, std::uint32_t> mGroups; /**< group ID -> index of its definition */
+    InodeMap<std::uint32_t> mInodes; /**< inode -> index of its definition */
+    unsigned long long mLinks; /**< number of links of inodes that were defined before */
+    std::string mPreviousPath; /**< path of the last written entry, for front coding */
+    std::string mDefinitions; /**< new definitions of the current fragment, reused to avoid allocations */
+    std::string mRecords; /**< records of the current fragment with indices, reused to avoid allocations */
+
+    /** \brief gets the index of an ID, appends a new definition if required
+     *
+     * \param table        mUsers or mGroups
+     * \param id           the user or group ID
+     * \param type         BinaryStatFormat::rtUser or BinaryStatFormat::rtGroup
+     * \param definitions  buffer for new definitions, in the format of the file
+     * \return Returns the index of the definition.
+     */
+    std::uint32_t indexOf(std::unordered_map<std::uint32_t, std::uint32_t>& table, const std::uint32_t id, const char type, std::string& definitions);
+
+    /** \brief gets the index of an inode, appends a new definition if required
+     *
+     * \param device       ID of the device that contains the inode
+     * \param inode        the inode number
+     * \param mode         permissions of the inode
+     * \param user         index of the user definition of the inode
+     * \param group        index of the group definition of the inode
+     * \param definitions  buffer for new definitions, in the format of the file
+     * \return Returns the index of the definition.
+     */
+    std::uint32_t inodeIndexOf(const std::uint64_t device, const std::uint64_t inode, const std::uint32_t mode,
+                               const std::uint32_t user, const std::uint32_t group, std::string& definitions);
+
+    // not copyable
+    StatFileWriter(const StatFileWriter& other) = delete;
+    StatFileWriter& operator=(const StatFileWriter& other) = delete;
+}; //class
+
+
+/** \brief read-only view of a file that is mapped into memory
+ *
+ * The kernel reads the pages when they are accessed and may drop them again
+ * under memory pressure, so even huge stat files do not need their size in
+ * memory.
+ */
+class MappedFile
+{
+  public:
+    /** \brief constructor - no file */
+    MappedFile();
+
+
+    /** \brief destructor - unmaps the file */
+    ~MappedFile();
+
+
+    /** \brief maps a file into memory for sequential reading
+     *
+     * \param fileName  name of the file
+     * \param error     will hold a message, if the function fails
+     * \return Returns true, if the file could be mapped. Returns false otherwise.
+     */
+    bool open(const std::string& fileName, std::string& error);
+
+
+    /** \brief gets the content of the file, NULL for empty files */
+    const char * data() const;
+
+
+    /** \brief gets the size of the file */
+    std::size_t size() const;
+  private:
+    const char * mData; /**< mapped file, or NULL */
+    std::size_t mSize; /**< size of the file */
+
+    // not copyable
+    MappedFile(const MappedFile& other) = delete;
+    MappedFile& operator=(const MappedFile& other) = delete;
+}; //class
+
+
+/** \brief read-only view of a binary stat file that is mapped into memory */
+class BinaryStatFile
+{
+  public:
+    static const std::size_t cDetectionSize = sizeof(DictionaryStatFormat::cSignature) - 1; /**< number of bytes that detectFormat() needs */
+
+
+    /** \brief constructor */
+    BinaryStatFile();
+
+
+    /** \brief destructor - unmaps the file */
+    ~BinaryStatFile();
+
+
+    /** \brief maps a binary stat file into memory and checks its header
+     *
+     * \param fileName  name of the file
+     * \param error     will hold a message, if the function fails
+     * \return Returns true, if the file could be mapped and has a supported
+     *         version. Returns false otherwise.
+     */
+    bool open(const std::string& fileName, std::string& error);
+
+
+    /** \brief checks whether the paths of the entries are front-coded
+     *
+     * \return Returns true, if the paths of entries have to be appended to
+     *         the given prefix of the previous path (see Record::shared).
+     */
+    bool frontCoded() const;
+
+
+    /** \brief gets the offset of the first record */
+    std::size_t begin() const;
+
+
+    /** \brief gets the size of the file, i.e. the offset after the last record */
+    std::size_t end() const;
+
+
+    /** \brief decodes the record at the given offset
+     *
+     * \param offset  offset of the record, will be set to the offset of the
+     *                next record on success
+     * \param record  variable that will hold the decoded record
+     * \return Returns true, if a complete record was decoded. Returns false,
+     *         if offset is at the end or the record is truncated or invalid.
+     */
+    bool next(std::size_t& offset, BinaryStatFormat::Record& record) const;
+
+
+    /** \brief detects the format of a stat file by its first bytes
+     *
+     * \param fileName  name of the file
+     * \return Returns sfBinary, if the file starts with the magic bytes of
+     *         the binary format. Returns sfDictionary, if the file starts with
+     *         the header of the dictionary format. Returns sfText otherwise.
+     */
+    static StatFileFormat detectFormat(const std::string& fileName);
+
+
+    /** \brief detects the format of a stat file by its first bytes
+     *
+     * \param data  the first bytes of the file, should be at least
+     *              cDetectionSize bytes unless the file is shorter
+     * \param size  number of bytes in data
+     * \return Returns the format, see detectFormat(const std::string&).
+     */
+    static StatFileFormat detectFormat(const char * data, const std::size_t size);
+
+  private:
+    MappedFile mMapping; /**< the mapped file */
+    const char * mData; /**< mapped file, or NULL */
+    std::size_t mSize; /**< size of the file */
+    std::uint32_t mFlags; /**< flags of the file header */
+
+    // not copyable
+    BinaryStatFile(const BinaryStatFile& other) = delete;
+    BinaryStatFile& operator=(const BinaryStatFile& other) = delete;
+}; //class
+
+
+/** \brief reads the records of a binary stat file from a stream buffer
+ *
+ * This is used for files that cannot be mapped, e.g. compressed files. The
+ * records are decoded in a buffer of fixed size, which only grows for records
+ * that do not fit into it, so the file never has to be in memory as a whole.
+ */
+class BinaryStatStream
+{
+  public:
+    static const std::size_t cBufferSize = 64 * 1024; /**< initial size of the buffer in bytes */
+
+
+    /** \brief constructor
+     *
+     * \param input  stream buffer that provides the content of the file
+     */
+    explicit BinaryStatStream(std::streambuf& input);
+
+
+    /** \brief reads and checks the header of the file
+     *
+     * \param error  will hold a message, if the function fails
+     * \return Returns true, if the file has a supported version. Returns
+     *         false otherwise.
+     */
+    bool open(std::string& error);
+
+
+    /** \brief checks whether the paths of the entries are front-coded, see BinaryStatFile::frontCoded() */
+    bool frontCoded() const;
+
+
+    /** \brief gets the offset of the first record */
+    std::size_t begin() const;
+
+
+    /** \brief decodes the next record
+     *
+     * \param offset  will be set to the offset of the next record on success
+     * \param record  variable that will hold the decoded record, its text is
+     *                valid until the next call
+     * \return Returns true, if a complete record was decoded. Returns false,
+     *         if the input is at its end or the record is truncated or invalid.
+     */
+    bool next(std::size_t& offset, BinaryStatFormat::Record& record);
+
+
+    /** \brief checks whether all records were read, i.e. whether the last call
+     *         of next() failed at the end of the input
+     */
+    bool finished() const;
+  private:
+    std::streambuf& mInput; /**< the input */
+    std::vector<char> mBuffer; /**< buffered part of the file */
+    std::size_t mStart; /**< start of the data in mBuffer that was not decoded yet */
+    std::size_t mEnd; /**< end of the data in mBuffer */
+    std::size_t mOffset; /**< offset of mStart in the file */
+    bool mEndOfInput; /**< whether the input has no more data */
+    std::uint32_t mFlags; /**< flags of the file header */
+
+    /** \brief moves the data that was not decoded yet to the front of the buffer and reads more
+     *
+     * \param needed  minimum size of the buffer
+     * \return Returns true, if data was read. Returns false otherwise.
+     */
+    bool fill(const std::size_t needed);
+
+    // not copyable
+    BinaryStatStream(const BinaryStatStream& other) = delete;
+    BinaryStatStream& operator=(const BinaryStatStream& other) = delete;
+}; //class
+
+#endif // STATFILE_HPP
@@ -0,0 +1,151 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include "TextParser.hpp"
+#include <cstring>
+
+TextView::TextView()
+: data(NULL),
+  size(0)
+{
+}
+
+TextView::TextView(const char * start, const std::size_t length)
+: data(start),
+  size(length)
+{
+}
+
+bool TextView::equals(const std::string& text) const
+{
+  return (text.size() == size) and (std::memcmp(text.data(), data, size) == 0);
+}
+
+bool TextView::startsWith(const char * prefix) const
+{
+  const std::size_t length = std::strlen(prefix);
+  return (length <= size) and (std::memcmp(prefix, data, length) == 0);
+}
+
+std::string TextView::str() const
+{
+  return std::string(data, size);
+}
+
+
+bool splitStatLine(const char * line, const std::size_t length, StatLineFields& fields)
+{
+  LineTokens tokens;
+  Tokenizer::fastest().scanLine(line, line + length, tokens);
+  return splitStatLine(TextView(line, length), tokens, fields);
+}
+
+bool splitStatLine(const TextView& line, const LineTokens& tokens, StatLineFields& fields)
+{
+  // The first five fields end with a space, the path is the rest.
+  if (tokens.spaceCount < LineTokens::cMaxSpaces)
+    return false;
+  TextView * const spaced[LineTokens::cMaxSpaces] = { &fields.mode, &fields.userName, &fields.userID, &fields.groupName, &fields.groupID };
+  const char * start = line.data;
+  for (unsigned int i = 0; i < LineTokens::cMaxSpaces; ++i)
+  {
+    spaced[i]->data = start;
+    spaced[i]->size = tokens.spaces[i] - start;
+    start = tokens.spaces[i] + 1;
+  } // for
+  fields.path.data = start;
+  fields.path.size = line.data + line.size - start;
+  return (fields.path.size > 0);
+}
+
+
+LineReader::LineReader(std::streambuf& input, const Tokenizer& tokenizer)
+: mInput(input),
+  mTokenizer(tokenizer),
+  mBuffer(cBlockSize),
+  mStart(0),
+  mEnd(0),
+  mEndOfInput(false)
+{
+}
+
+bool LineReader::next(TextView& line)
+{
+  LineTokens tokens;
+  return next(line, tokens);
+}
+
+bool LineReader::next(TextView& line, LineTokens& tokens)
+{
+  tokens.spaceCount = 0;
+  // Only the part after scanned has to be searched for the line break again.
+  std::size_t scanned = mStart;
+  while (true)
+  {
+    const char * newLine = mTokenizer.scanLine(mBuffer.data() + scanned, mBuffer.data() + mEnd, tokens);
+    if (newLine != NULL)
+    {
+      line.data = mBuffer.data() + mStart;
+      line.size = newLine - line.data;
+      mStart = newLine - mBuffer.data() + 1;
+      return true;
+    }
+    // refill() moves the line to the start of the buffer, which may be new
+    std::size_t offsets[LineTokens::cMaxSpaces];
+    for (unsigned int i = 0; i < tokens.spaceCount; ++i)
+      offsets[i] = tokens.spaces[i] - mBuffer.data() - mStart;
+    scanned = mEnd - mStart;
+    const bool refilled = refill();
+    for (unsigned int i = 0; i < tokens.spaceCount; ++i)
+      tokens.spaces[i] = mBuffer.data() + mStart + offsets[i];
+    if (!refilled)
+      break;
+  } // while
+  if (mStart == mEnd)
+    return false;
+  // last line without line break
+  line.data = mBuffer.data() + mStart;
+  line.size = mEnd - mStart;
+  mStart = mEnd;
+  return true;
+}
+
+bool LineReader::refill()
+{
+  if (mEndOfInput)
+    return false;
+  if (mStart > 0)
+  {
+    std::memmove(mBuffer.data(), mBuffer.data() + mStart, mEnd - mStart);
+    mEnd -= mStart;
+    mStart = 0;
+  }
+  // line is longer than the buffer
+  if (mEnd == mBuffer.size())
+    mBuffer.resize(mBuffer.size() * 2);
+  const std::streamsize bytes = mInput.sgetn(mBuffer.data() + mEnd, mBuffer.size() - mEnd);
+  if (bytes <= 0)
+  {
+    mEndOfInput = true;
+    return false;
+  }
+  mEnd += bytes;
+  return true;
+}
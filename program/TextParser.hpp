@@ -0,0 +1,144 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef TEXTPARSER_HPP
+#define TEXTPARSER_HPP
+
+#include <cstddef>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include "Tokenizer.hpp"
+
+/* part of a string that is not copied, like std::string_view of C++17 */
+struct TextView {
+    const char * data; /* first character, not null-terminated */
+    std::size_t size;  /* number of characters */
+
+    /* constructor - empty view */
+    TextView();
+
+    /* constructor */
+    TextView(const char * start, const std::size_t length);
+
+    /* returns true, if the view has the same characters as text */
+    bool equals(const std::string& text) const;
+
+    /* returns true, if the view starts with the characters of prefix */
+    bool startsWith(const char * prefix) const;
+
+    /* copies the characters into a string */
+    std::string str() const;
+};//struct
+
+
+/* fields of a line of a text stat file, the views point into the line */
+struct StatLineFields {
+    TextView mode;      /* mode string, e.g. "rwxr-xr-x" */
+    TextView userName;  /* name of the owner, "?" if it was not known */
+    TextView userID;    /* user ID as decimal number */
+    TextView groupName; /* name of the group, "?" if it was not known */
+    TextView groupID;   /* group ID as decimal number */
+    TextView path;      /* path of the entry, the rest of the line */
+};//struct
+
+
+/** \brief splits a line of a text stat file into its fields without copying them
+ *
+ * \param line    the line, without line break
+ * \param length  length of the line
+ * \param fields  will hold the fields of the line
+ * \return Returns true, if the line has all fields and a non-empty path.
+ *         Returns false otherwise.
+ * \remarks The path is the rest of the line after the group ID, so it may
+ *          contain spaces. The other fields are only checked for presence.
+ */
+bool splitStatLine(const char * line, const std::size_t length, StatLineFields& fields);
+
+
+/** \brief splits a line of a text stat file into its fields by its spaces
+ *
+ * \param line    the line, without line break
+ * \param tokens  spaces of the line, as found by Tokenizer::scanLine()
+ * \param fields  will hold the fields of the line
+ * \return Returns true, if the line has all fields and a non-empty path.
+ *         Returns false otherwise.
+ */
+bool splitStatLine(const TextView& line, const LineTokens& tokens, StatLineFields& fields);
+
+
+/** \brief reads lines from a stream buffer in large blocks
+ *
+ * Lines are returned as views into the reader's buffer, so they are not
+ * copied one by one. The buffer grows for lines that are longer than a block,
+ * so the length of lines is not limited.
+ */
+class LineReader
+{
+  public:
+    static const std::size_t cBlockSize = 64 * 1024; /**< number of bytes that are read at once */
+
+
+    /** \brief constructor
+     *
+     * \param input      the stream buffer that provides the data
+     * \param tokenizer  tokenizer that finds the line breaks
+     */
+    explicit LineReader(std::streambuf& input, const Tokenizer& tokenizer = Tokenizer::fastest());
+
+
+    /** \brief gets the next line
+     *
+     * \param line  will hold the line without the line break. It is valid
+     *              until the next call.
+     * \return Returns true, if a line was read. Returns false at the end of
+     *         the input.
+     * \remarks The last line does not need a line break.
+     */
+    bool next(TextView& line);
+
+
+    /** \brief gets the next line and the positions of its first spaces
+     *
+     * \param line    will hold the line without the line break. It is valid
+     *                until the next call.
+     * \param tokens  will hold the first spaces of the line
+     * \return Returns true, if a line was read. Returns false at the end of
+     *         the input.
+     * \remarks The line is only scanned once for both, so this is faster
+     *          than next() and a separate search for the spaces.
+     */
+    bool next(TextView& line, LineTokens& tokens);
+  private:
+    std::streambuf& mInput; /**< source of the data */
+    const Tokenizer& mTokenizer; /**< finds line breaks and spaces */
+    std::vector<char> mBuffer; /**< block of data that contains the current line */
+    std::size_t mStart; /**< start of the data in mBuffer that was not returned yet */
+    std::size_t mEnd; /**< end of the data in mBuffer */
+    bool mEndOfInput; /**< whether the input has no more data */
+
+    /** \brief moves the remaining data to the front of the buffer and reads more
+     *
+     * \return Returns true, if more data was read. Returns false otherwise.
+     */
+    bool refill();
+}; //class
+
+#endif // TEXTPARSER_HPP
@@ -0,0 +1,191 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include "Tokenizer.hpp"
+#include <cstring>
+#include <initializer_list>
+
+// The vectorised implementations use GCC's target attributes, so the rest of
+// the program does not need to be compiled for SSE2 or AVX2.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+  #define CFS_TOKENIZER_X86
+  #include <immintrin.h>
+#endif
+
+LineTokens::LineTokens()
+: spaceCount(0)
+{
+}
+
+/* appends the spaces of a bit mask to tokens, bit i stands for block[i] */
+static inline void addSpaces(const char * block, unsigned int mask, LineTokens& tokens)
+{
+  while ((mask != 0) and (tokens.spaceCount < LineTokens::cMaxSpaces))
+  {
+    tokens.spaces[tokens.spaceCount++] = block + __builtin_ctz(mask);
+    mask &= mask - 1;
+  } // while
+}
+
+static const char * scanScalar(const char * begin, const char * end, LineTokens& tokens)
+{
+  const char * lineEnd = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+  const char * const fieldsEnd = (lineEnd != NULL) ? lineEnd : end;
+  const char * start = begin;
+  while (tokens.spaceCount < LineTokens::cMaxSpaces)
+  {
+    const char * space = static_cast<const char*>(std::memchr(start, ' ', fieldsEnd - start));
+    if (space == NULL)
+      break;
+    tokens.spaces[tokens.spaceCount++] = space;
+    start = space + 1;
+  } // while
+  return lineEnd;
+}
+
+#ifdef CFS_TOKENIZER_X86
+__attribute__((target("sse2")))
+static const char * scanSSE2(const char * begin, const char * end, LineTokens& tokens)
+{
+  const __m128i newLines = _mm_set1_epi8('\n');
+  const __m128i spaces = _mm_set1_epi8(' ');
+  const char * block = begin;
+  for ( ; end - block >= 16; block += 16)
+  {
+    const __m128i data = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+    const unsigned int newLineMask = _mm_movemask_epi8(_mm_cmpeq_epi8(data, newLines));
+    if (tokens.spaceCount < LineTokens::cMaxSpaces)
+    {
+      unsigned int spaceMask = _mm_movemask_epi8(_mm_cmpeq_epi8(data, spaces));
+      // only spaces in front of the line break
+      if (newLineMask != 0)
+        spaceMask &= (newLineMask & -newLineMask) - 1;
+      addSpaces(block, spaceMask, tokens);
+    }
+    if (newLineMask != 0)
+      return block + __builtin_ctz(newLineMask);
+  } // for
+  return scanScalar(block, end, tokens);
+}
+
+__attribute__((target("avx2")))
+static const char * scanAVX2(const char * begin, const char * end, LineTokens& tokens)
+{
+  const __m256i newLines = _mm256_set1_epi8('\n');
+  const __m256i spaces = _mm256_set1_epi8(' ');
+  const char * block = begin;
+  for ( ; end - block >= 32; block += 32)
+  {
+    const __m256i data = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    const unsigned int newLineMask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(data, newLines));
+    if (tokens.spaceCount < LineTokens::cMaxSpaces)
+    {
+      unsigned int spaceMask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(data, spaces));
+      // only spaces in front of the line break
+      if (newLineMask != 0)
+        spaceMask &= (newLineMask & -newLineMask) - 1;
+      addSpaces(block, spaceMask, tokens);
+    }
+    if (newLineMask != 0)
+      return block + __builtin_ctz(newLineMask);
+  } // for
+  return scanSSE2(block, end, tokens);
+}
+#endif // CFS_TOKENIZER_X86
+
+/* checks whether the processor supports an implementation */
+static bool isSupported(const Tokenizer::Implementation implementation)
+{
+  #ifdef CFS_TOKENIZER_X86
+  // may be called before main(), e.g. by the constructor of a static object
+  __builtin_cpu_init();
+  #endif
+  switch (implementation)
+  {
+    case Tokenizer::tiScalar:
+         return true;
+    #ifdef CFS_TOKENIZER_X86
+    case Tokenizer::tiSSE2:
+         return __builtin_cpu_supports("sse2");
+    case Tokenizer::tiAVX2:
+         return __builtin_cpu_supports("avx2");
+    #endif
+    default:
+         return false;
+  } // swi
+}
+
+Tokenizer::Tokenizer()
+: Tokenizer(tiAVX2)
+{
+}
+
+Tokenizer::Tokenizer(const Implementation preferred)
+: mImplementation(tiScalar),
+  mScan(scanScalar)
+{
+  const std::vector<Implementation> available = supported();
+  for (const Implementation candidate : available)
+  {
+    if (candidate <= preferred)
+      mImplementation = candidate;
+  } // for
+  #ifdef CFS_TOKENIZER_X86
+  if (mImplementation == tiSSE2)
+    mScan = scanSSE2;
+  else if (mImplementation == tiAVX2)
+    mScan = scanAVX2;
+  #endif
+}
+
+Tokenizer::Implementation Tokenizer::implementation() const
+{
+  return mImplementation;
+}
+
+std::vector<Tokenizer::Implementation> Tokenizer::supported()
+{
+  std::vector<Implementation> result;
+  for (const Implementation candidate : { tiScalar, tiSSE2, tiAVX2 })
+  {
+    if (isSupported(candidate))
+      result.push_back(candidate);
+  } // for
+  return result;
+}
+
+const char * Tokenizer::name(const Implementation implementation)
+{
+  switch (implementation)
+  {
+    case tiSSE2:
+         return "SSE2";
+    case tiAVX2:
+         return "AVX2";
+    default:
+         return "scalar";
+  } // swi
+}
+
+const Tokenizer& Tokenizer::fastest()
+{
+  static const Tokenizer instance;
+  return instance;
+}
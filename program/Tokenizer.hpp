@@ -0,0 +1,103 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef TOKENIZER_HPP
+#define TOKENIZER_HPP
+
+#include <vector>
+
+/* boundaries of a line and its first fields, found by Tokenizer::scanLine() */
+struct LineTokens {
+    static const unsigned int cMaxSpaces = 5; /* number of spaces that are recorded */
+
+    const char * spaces[cMaxSpaces]; /* positions of the first spaces of the line */
+    unsigned int spaceCount; /* number of valid entries in spaces */
+
+    /* constructor - no spaces */
+    LineTokens();
+};//struct
+
+
+/** \brief finds line and field boundaries in text
+ *
+ * Lines end with '\n', fields are separated by ' '. Besides a scalar
+ * implementation there are SSE2 and AVX2 ones that check 16 and 32 bytes at
+ * once. The fastest one that the processor supports is chosen at runtime,
+ * so the program still runs on processors without them.
+ */
+class Tokenizer
+{
+  public:
+    /* available implementations */
+    enum Implementation { tiScalar, tiSSE2, tiAVX2 };
+
+
+    /** \brief constructor - uses the fastest supported implementation */
+    Tokenizer();
+
+
+    /** \brief constructor
+     *
+     * \param preferred  the implementation to use. If the processor does not
+     *                   support it, the fastest supported one that is slower
+     *                   is used instead.
+     */
+    explicit Tokenizer(const Implementation preferred);
+
+
+    /** \brief gets the implementation that is used */
+    Implementation implementation() const;
+
+
+    /** \brief finds the end of a line and the spaces in front of it
+     *
+     * \param begin   start of the text
+     * \param end     end of the text
+     * \param tokens  Spaces before the line break are appended to it, until
+     *                it has LineTokens::cMaxSpaces of them.
+     * \return Returns the position of the first '\n' in the text. Returns
+     *         NULL, if there is none.
+     * \remarks Spaces are appended and not replaced, so a line can be
+     *          scanned in several parts.
+     */
+    const char * scanLine(const char * begin, const char * end, LineTokens& tokens) const
+    {
+      return mScan(begin, end, tokens);
+    }
+
+
+    /** \brief gets the implementations that the processor supports, from slowest to fastest */
+    static std::vector<Implementation> supported();
+
+
+    /** \brief gets the name of an implementation, e.g. "AVX2" */
+    static const char * name(const Implementation implementation);
+
+
+    /** \brief gets a shared tokenizer that uses the fastest implementation */
+    static const Tokenizer& fastest();
+  private:
+    typedef const char * (*ScanFunction)(const char * begin, const char * end, LineTokens& tokens);
+
+    Implementation mImplementation; /**< the implementation that is used */
+    ScanFunction mScan; /**< function of the implementation */
+}; //class
+
+#endif // TOKENIZER_HPP
@@ -0,0 +1,150 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include "WorkStealingPool.hpp"
+#include <thread>
+#include <utility>
+
+WorkStealingPool::WorkStealingPool(const unsigned int workers)
+: mQueues(),
+  mQueued(0),
+  mPending(0),
+  mStop(false),
+  mIdleMutex(),
+  mIdle()
+{
+  const unsigned int count = (workers < 1) ? 1 : workers;
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    mQueues.push_back(std::unique_ptr<Queue>(new Queue()));
+  }
+}
+
+unsigned int WorkStealingPool::workers() const
+{
+  return mQueues.size();
+}
+
+void WorkStealingPool::submit(const unsigned int worker, Task task)
+{
+  Queue& queue = *mQueues[worker % mQueues.size()];
+  {
+    // counters are changed under the queue's lock to stay consistent with stop()
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (mStop)
+      return;
+    ++mPending;
+    ++mQueued;
+    queue.tasks.push_back(std::move(task));
+  }
+  // Lock before notifying, so that a worker cannot miss the notification
+  // between checking the counters and going to sleep.
+  std::lock_guard<std::mutex> lock(mIdleMutex);
+  mIdle.notify_one();
+}
+
+void WorkStealingPool::run()
+{
+  std::vector<std::thread> threads;
+  for (unsigned int i = 1; i < mQueues.size(); ++i)
+  {
+    threads.push_back(std::thread(&WorkStealingPool::work, this, i));
+  }
+  work(0);
+  for (std::thread& t : threads)
+  {
+    t.join();
+  }
+}
+
+void WorkStealingPool::stop()
+{
+  mStop = true;
+  // drop queued tasks
+  for (const std::unique_ptr<Queue>& queue : mQueues)
+  {
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    mQueued -= queue->tasks.size();
+    mPending -= queue->tasks.size();
+    queue->tasks.clear();
+  }
+  wakeAll();
+}
+
+bool WorkStealingPool::stopped() const
+{
+  return mStop;
+}
+
+bool WorkStealingPool::take(const unsigned int worker, Task& task)
+{
+  // own queue: newest task first
+  {
+    Queue& own = *mQueues[worker];
+    std::lock_guard<std::mutex> lock(own.mutex);
+    if (!own.tasks.empty())
+    {
+      task = std::move(own.tasks.back());
+      own.tasks.pop_back();
+      --mQueued;
+      return true;
+    }
+  }
+  // steal oldest task of another worker, it is likely the largest one
+  for (std::size_t i = 1; i < mQueues.size(); ++i)
+  {
+    Queue& other = *mQueues[(worker + i) % mQueues.size()];
+    std::lock_guard<std::mutex> lock(other.mutex);
+    if (!other.tasks.empty())
+    {
+      task = std::move(other.tasks.front());
+      other.tasks.pop_front();
+      --mQueued;
+      return true;
+    }
+  }
+  return false;
+}
+
+void WorkStealingPool::work(const unsigned int worker)
+{
+  Task task;
+  while (true)
+  {
+    if (take(worker, task))
+    {
+      task(worker);
+      task = nullptr;
+      if (--mPending == 0)
+        wakeAll();
+      continue;
+    }
+    std::unique_lock<std::mutex> lock(mIdleMutex);
+    mIdle.wait(lock, [this] { return (mQueued > 0) || (mPending == 0); });
+    if (mPending == 0)
+      return;
+  } // while
+}
+
+void WorkStealingPool::wakeAll()
+{
+  std::lock_guard<std::mutex> lock(mIdleMutex);
+  mIdle.notify_all();
+}
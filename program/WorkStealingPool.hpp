@@ -0,0 +1,120 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of an utility to copy file permissions + ownership.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#ifndef WORKSTEALINGPOOL_HPP
+#define WORKSTEALINGPOOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/** \brief thread pool where each worker has its own task queue
+ *
+ * Workers take tasks from the back of their own queue (so a worker continues
+ * with the most recently found work, e.g. the subdirectories of the directory
+ * it just read) and steal tasks from the front of other queues when their own
+ * queue is empty. Tasks may submit new tasks while they run. The pool is done
+ * when no task is queued or running anymore.
+ */
+class WorkStealingPool
+{
+  public:
+    /** type of tasks - the parameter is the index of the executing worker */
+    typedef std::function<void(const unsigned int worker)> Task;
+
+
+    /** \brief constructor
+     *
+     * \param workers  number of workers, values below one are raised to one
+     */
+    explicit WorkStealingPool(const unsigned int workers);
+
+
+    /** \brief gets the number of workers
+     *
+     * \return Returns the number of workers of the pool.
+     */
+    unsigned int workers() const;
+
+
+    /** \brief adds a task to the queue of a worker
+     *
+     * \param worker  index of the worker whose queue gets the task, usually
+     *                the worker that executes the calling task
+     * \param task    the task
+     */
+    void submit(const unsigned int worker, Task task);
+
+
+    /** \brief executes all tasks, including the ones that are submitted while running
+     *
+     * The calling thread acts as worker zero, the other workers get their
+     * own threads, which are joined before the function returns.
+     */
+    void run();
+
+
+    /** \brief discards all queued tasks, running tasks are completed
+     *
+     * Tasks submitted after the call are discarded, too.
+     */
+    void stop();
+
+
+    /** \brief checks whether stop() was called
+     *
+     * \return Returns true, if the pool was stopped.
+     */
+    bool stopped() const;
+  private:
+    /* task queue of one worker */
+    struct Queue
+    {
+      std::mutex mutex;
+      std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue> > mQueues; /**< one queue per worker */
+    std::atomic<std::size_t> mQueued;  /**< number of tasks in all queues */
+    std::atomic<std::size_t> mPending; /**< number of queued or running tasks */
+    std::atomic<bool> mStop; /**< whether the pool was stopped */
+    std::mutex mIdleMutex; /**< mutex for mIdle */
+    std::condition_variable mIdle; /**< signals new tasks or completion to idle workers */
+
+    /** \brief main loop of a worker */
+    void work(const unsigned int worker);
+
+    /** \brief takes a task from the own queue or steals one from another queue */
+    bool take(const unsigned int worker, Task& task);
+
+    /** \brief wakes up all idle workers */
+    void wakeAll();
+
+    // not copyable
+    WorkStealingPool(const WorkStealingPool& other) = delete;
+    WorkStealingPool& operator=(const WorkStealingPool& other) = delete;
+}; //class
+
+#endif // WORKSTEALINGPOOL_HPP
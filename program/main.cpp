@@ -19,11 +19,26 @@
 */
 
 #include <iostream>
+#include <unistd.h> //for STDOUT_FILENO
+#include "AuxiliaryFunctions.hpp"
+#include "CompressedFile.hpp"
+#include "DirectoryReader.hpp"
 #include "FileUtilities.hpp"
+#include "IDMapping.hpp"
+#include "LinkTracker.hpp"
+#include "LogSink.hpp"
+#include "MountBoundary.hpp"
+#include "PathFilter.hpp"
+#include "NameCache.hpp"
 #include "SaveRestore.hpp"
+#include "StatEngine.hpp"
 
 const int rcInvalidParameter = 1;
 
+/* Each job gets its own thread, task queue, directory buffer and stat
+   engine, so the number of jobs is limited. */
+const unsigned int cMaxJobs = 256;
+
 void showGPLNotice()
 {
   std::cout << "copy-file-stats\n"
@@ -73,6 +88,76 @@ void showHelp()
             << "  --restore        - indicates that stats shall be retrieved from a stat file\n"
             << "                     and not from a source directory.\n"
             << "                     Mutually exclusive with --save.\n"
+            << "  --dir-buffer KB  - use a buffer of KB kilobytes for reading directory\n"
+            << "                     entries. Larger buffers need fewer system calls for\n"
+            << "                     huge directories. Default is 256 KB.\n"
+            << "  --jobs N, -j N   - handle up to N directories in parallel when copying\n"
+            << "                     from directory to directory or when saving stats,\n"
+            << "                     and apply parts of the stat file in parallel when\n"
+            << "                     restoring stats.\n"
+            << "                     Default is 1, at most 256 jobs are used.\n"
+            << "  --io-uring       - query the status of files in batches via io_uring, so\n"
+            << "                     that many queries are in flight at once. Falls back\n"
+            << "                     to normal stat calls, if io_uring is not available.\n"
+            << "  --no-sync-attrs  - allow network file systems like NFS to use cached\n"
+            << "                     attributes instead of asking the server for each file.\n"
+            << "                     Faster, but changes by other clients may be missed.\n"
+            << "  --format=FORMAT  - format of the stat file written by --save: text (default),\n"
+            << "                     dict or bin. dict is text that lists each user and\n"
+            << "                     group only once. The binary format is smaller and\n"
+            << "                     faster to read. --restore detects the format.\n"
+            << "                     Both save the stats of files with several hard links\n"
+            << "                     once and refer to them from every link.\n"
+            << "  --compress=TYPE  - compress the stat file written by --save with gzip or\n"
+            << "                     zstd, or write it uncompressed (none). Default is\n"
+            << "                     gzip for names ending with .gz, zstd for names ending\n"
+            << "                     with .zst and none otherwise. --restore detects\n"
+            << "                     compressed files automatically.\n"
+            << "  --walk-dest      - when restoring, load the stat file into memory and\n"
+            << "                     read the destination directory once instead of looking\n"
+            << "                     up every path of the stat file. Faster on slow disks.\n"
+            << "                     Shows entries that are only listed on one side.\n"
+            << "                     Needs about 100 bytes of memory per line plus the\n"
+            << "                     length of the file names. Ignores --jobs.\n"
+            << "  --numeric-ids    - do not map user and group IDs to names or back. --save\n"
+            << "                     writes '?' instead of names, --restore only uses the\n"
+            << "                     IDs of the stat file and messages show IDs. Avoids\n"
+            << "                     slow lookups in directory services like LDAP.\n"
+            << "  --preload-ids    - read all users and groups from the databases once at\n"
+            << "                     start instead of looking up each name on its own.\n"
+            << "                     Names that the databases do not list (e.g. SSSD\n"
+            << "                     without enumeration) are treated as unknown.\n"
+            << "  --passwd FILE    - use the users of FILE, e.g. the /etc/passwd of a\n"
+            << "                     container image, instead of the user database for\n"
+            << "                     names of the stat file and in messages.\n"
+            << "  --group FILE     - use the groups of FILE, e.g. the /etc/group of a\n"
+            << "                     container image, instead of the group database.\n"
+            << "                     The database that is not replaced by a file is read\n"
+            << "                     once like with --preload-ids.\n"
+            << "  --map-uid F:T:N  - when restoring or copying, change N user IDs starting\n"
+            << "                     with F to the IDs starting with T, e.g. 0:100000:65536\n"
+            << "                     for a tree of a user namespace. IDs outside of all\n"
+            << "                     ranges are kept. Can be given several times.\n"
+            << "  --map-gid F:T:N  - same as --map-uid, but for group IDs\n"
+            << "  --one-file-system, -x\n"
+            << "                   - do not cross into other file systems that are mounted\n"
+            << "                     below the walked directory, e.g. NFS exports or /proc.\n"
+            << "                     Mount points and their content are skipped, verbose\n"
+            << "                     output lists them.\n"
+            << "  --exclude PATTERN\n"
+            << "                   - skip entries that match PATTERN, together with their\n"
+            << "                     content. Patterns without '/' match names, e.g. .git\n"
+            << "                     or *.tmp, others match paths relative to the walked\n"
+            << "                     directory, a leading '/' anchors them there. A\n"
+            << "                     trailing '/' only matches directories. '*' matches\n"
+            << "                     anything but '/', '**' matches anything. When\n"
+            << "                     restoring, lines of the stat file are filtered, too.\n"
+            << "  --include PATTERN\n"
+            << "                   - do not skip entries that match PATTERN. Rules are\n"
+            << "                     checked in the given order, the first match decides.\n"
+            << "  --exclude-from FILE\n"
+            << "                   - read exclude patterns from FILE, one per line. Empty\n"
+            << "                     lines and lines starting with '#' are skipped.\n"
             << "  SOURCE_DIR       - set source directory (i.e. reference directory) to\n"
             << "                     SOURCE_DIR\n"
             << "  DESTINATION_DIR  - set destination directory to DESTINATION_DIR\n"
@@ -98,6 +183,16 @@ int main(int argc, char **argv)
   bool hasForceOrDryRun = false;
   bool save = false;
   bool restore = false;
+  unsigned int jobs = 1;
+  bool walkDestination = false;
+  StatFileFormat format = sfText;
+  bool hasFormat = false;
+  Compression compression = cmNone;
+  bool hasCompression = false;
+  bool numericIDs = false;
+  bool preloadIDs = false;
+  std::string passwdFile = "";
+  std::string groupFile = "";
 
   if ((argc > 1) && (argv != NULL))
   {
@@ -205,6 +300,136 @@ int main(int argc, char **argv)
           }
           restore = true;
         } // if --restore
+        else if (param == "--dir-buffer")
+        {
+          unsigned int kiloBytes = 0;
+          if ((i + 1 >= argc) || (argv[i+1] == NULL) || !stringToUint(std::string(argv[i+1]), kiloBytes)
+              || (kiloBytes == 0))
+          {
+            std::cerr << "Error: Parameter --dir-buffer expects a positive number of kilobytes.\n";
+            return rcInvalidParameter;
+          }
+          DirectoryReader::setDefaultBufferSize(static_cast<std::size_t>(kiloBytes) * 1024);
+          ++i; // skip the size
+        } // if --dir-buffer
+        else if ((param == "--jobs") || (param == "-j"))
+        {
+          if ((i + 1 >= argc) || (argv[i+1] == NULL) || !stringToUint(std::string(argv[i+1]), jobs)
+              || (jobs == 0))
+          {
+            std::cerr << "Error: Parameter " << param << " expects a positive number of jobs.\n";
+            return rcInvalidParameter;
+          }
+          ++i; // skip the number
+        } // if --jobs
+        else if (param == "--io-uring")
+        {
+          if (!StatEngine::setDefaultKind(StatEngine::ekIoUring))
+            std::cout << "Info: io_uring is not available, using normal stat calls instead.\n";
+        } // if --io-uring
+        else if (param == "--no-sync-attrs")
+        {
+          StatEngine::setSynchronizeAttributes(false);
+        } // if --no-sync-attrs
+        else if (param == "--walk-dest")
+        {
+          walkDestination = true;
+        } // if --walk-dest
+        else if ((param == "--one-file-system") || (param == "-x"))
+        {
+          MountBoundary::shared().setEnabled(true);
+        } // if --one-file-system
+        else if ((param == "--exclude") || (param == "--include"))
+        {
+          if ((i + 1 >= argc) || (argv[i+1] == NULL)
+              || !PathFilter::shared().addRule(std::string(argv[i+1]), param == "--include"))
+          {
+            std::cerr << "Error: Parameter " << param << " expects a pattern.\n";
+            return rcInvalidParameter;
+          }
+          ++i; // skip the pattern
+        } // if --exclude or --include
+        else if (param == "--exclude-from")
+        {
+          if ((i + 1 >= argc) || (argv[i+1] == NULL) || (argv[i+1][0] == '\0'))
+          {
+            std::cerr << "Error: Parameter " << param << " expects a file name.\n";
+            return rcInvalidParameter;
+          }
+          if (!PathFilter::shared().addRulesFromFile(std::string(argv[i+1])))
+            return rcInvalidParameter;
+          ++i; // skip the file name
+        } // if --exclude-from
+        else if (param == "--numeric-ids")
+        {
+          numericIDs = true;
+        } // if --numeric-ids
+        else if (param == "--preload-ids")
+        {
+          preloadIDs = true;
+        } // if --preload-ids
+        else if ((param == "--passwd") || (param == "--group"))
+        {
+          if ((i + 1 >= argc) || (argv[i+1] == NULL) || (argv[i+1][0] == '\0'))
+          {
+            std::cerr << "Error: Parameter " << param << " expects a file name.\n";
+            return rcInvalidParameter;
+          }
+          if (param == "--passwd")
+            passwdFile = std::string(argv[i+1]);
+          else
+            groupFile = std::string(argv[i+1]);
+          ++i; // skip the file name
+        } // if --passwd or --group
+        else if ((param == "--map-uid") || (param == "--map-gid"))
+        {
+          if ((i + 1 >= argc) || (argv[i+1] == NULL))
+          {
+            std::cerr << "Error: Parameter " << param << " expects a range FIRST:TARGET:COUNT.\n";
+            return rcInvalidParameter;
+          }
+          const std::string range(argv[i+1]);
+          IDMapping& mapping = IDMapping::shared();
+          if (!((param == "--map-uid") ? mapping.addUserRange(range) : mapping.addGroupRange(range)))
+          {
+            std::cerr << "Error: \"" << range << "\" is not a valid range FIRST:TARGET:COUNT for "
+                      << param << " or it overlaps another range.\n";
+            return rcInvalidParameter;
+          }
+          ++i; // skip the range
+        } // if --map-uid or --map-gid
+        else if (param.substr(0, 9) == "--format=")
+        {
+          const std::string name = param.substr(9);
+          if ((name == "text") || (name == "txt"))
+            format = sfText;
+          else if ((name == "dict") || (name == "dictionary"))
+            format = sfDictionary;
+          else if ((name == "bin") || (name == "binary"))
+            format = sfBinary;
+          else
+          {
+            std::cerr << "Error: Unknown stat file format \"" << name << "\", expecting text, dict or bin.\n";
+            return rcInvalidParameter;
+          }
+          hasFormat = true;
+        } // if --format=...
+        else if (param.substr(0, 11) == "--compress=")
+        {
+          const std::string name = param.substr(11);
+          if (name == "none")
+            compression = cmNone;
+          else if ((name == "gzip") || (name == "gz"))
+            compression = cmGzip;
+          else if ((name == "zstd") || (name == "zst"))
+            compression = cmZstd;
+          else
+          {
+            std::cerr << "Error: Unknown compression \"" << name << "\", expecting none, gzip or zstd.\n";
+            return rcInvalidParameter;
+          }
+          hasCompression = true;
+        } // if --compress=...
         else if (sourceDir.empty())
         {
           sourceDir = param;
@@ -276,6 +501,51 @@ int main(int argc, char **argv)
     std::cout << "Info: The --dry-run option has no effect when used together with --save.\n";
   }
 
+  if (hasFormat and !save)
+  {
+    std::cout << "Info: The --format option has no effect without --save, the format of stat files is detected on restore.\n";
+  }
+
+  if (hasCompression and !save)
+  {
+    std::cout << "Info: The --compress option has no effect without --save, compressed stat files are detected on restore.\n";
+  }
+
+  // Without --compress the extension of the stat file decides.
+  if (save and !hasCompression)
+  {
+    compression = compressionOfFileName(destDir);
+  }
+  if (save and !compressionAvailable(compression))
+  {
+    std::cout << "Error: This build of copy-file-stats does not support the compression of the stat file.\n";
+    return rcInvalidParameter;
+  }
+
+  if (jobs > cMaxJobs)
+  {
+    std::cout << "Info: Using " << cMaxJobs << " instead of " << jobs << " jobs, more are not supported.\n";
+    jobs = cMaxJobs;
+  }
+
+  if (walkDestination and !restore)
+  {
+    std::cout << "Info: The --walk-dest option has no effect without --restore.\n";
+  }
+
+  if (numericIDs and (preloadIDs or !passwdFile.empty() or !groupFile.empty()))
+  {
+    std::cout << "Info: The options --preload-ids, --passwd and --group have no effect when used together with --numeric-ids.\n";
+    preloadIDs = false;
+    passwdFile.clear();
+    groupFile.clear();
+  }
+
+  if (save and !IDMapping::shared().empty())
+  {
+    std::cout << "Info: The options --map-uid and --map-gid have no effect when used together with --save.\n";
+  }
+
   // save user from possible mistakes
   if (destDir == "/")
   {
@@ -283,36 +553,73 @@ int main(int argc, char **argv)
     return 1;
   }
 
+  // The instance is only used for restoring, but its preloaded names are
+  // shared with saving and copying.
+  SaveRestore instance;
+  instance.setNumericIDs(numericIDs);
+  NameCache::shared().setNumeric(numericIDs);
+  if (preloadIDs or !passwdFile.empty() or !groupFile.empty())
+  {
+    IDNameList users;
+    IDNameList groups;
+    if (passwdFile.empty())
+      listUsers(users);
+    else if (!readIDNameFile(passwdFile, users))
+      return rcInvalidParameter;
+    if (groupFile.empty())
+      listGroups(groups);
+    else if (!readIDNameFile(groupFile, groups))
+      return rcInvalidParameter;
+    instance.preloadIDs(users, groups);
+  }
+
+  // From here on the messages are written in large blocks by a background
+  // thread. The sink writes the rest of them when main() returns.
+  LogSink sink(std::cout, STDOUT_FILENO);
+  bool success = false;
   if (save)
   {
     // save to a stat file
-    if (SaveRestore::save(sourceDir, destDir, verbose))
-    {
-      std::cout << "Success!\n";
-      return 0;
-    }
-    std::cout << "Failure!\n";
+    success = SaveRestore::save(sourceDir, destDir, verbose, jobs, format, compression);
   }
   else if (restore)
   {
     // restore from a stat file
-    SaveRestore instance;
-    if (instance.restore(destDir, sourceDir, adjustPermissions, adjustOwnership, verbose, dryRun))
-    {
-      std::cout << "Success!\n";
-      return 0;
-    }
-    std::cout << "Failure!\n";
+    success = instance.restore(destDir, sourceDir, adjustPermissions, adjustOwnership, verbose, dryRun, jobs, walkDestination);
   }
   else
   {
     // "default" directory to directory copying of stats
-    if (copy_stats_recursive(sourceDir, destDir, adjustPermissions, adjustOwnership, verbose, dryRun))
+    success = copy_stats_recursive(sourceDir, destDir, adjustPermissions, adjustOwnership, verbose, dryRun, jobs);
+  }
+
+  if (verbose)
+  {
+    LookupCounts lookups = NameCache::shared().counts();
+    lookups += instance.lookupCounts();
+    std::cout << "Name lookups: " << lookups.database << " in the user and group databases, "
+              << lookups.cached << " from caches\n";
+    if (!save)
+    {
+      std::cout << "Hard links: " << LinkTracker::shared().skipped()
+                << " entries skipped, another link of their inode got the same stats already\n";
+    }
+    if (MountBoundary::shared().enabled())
+    {
+      std::cout << "Mount points: " << MountBoundary::shared().mountPoints()
+                << " skipped, they are on another file system\n";
+    }
+    if (PathFilter::shared().active())
     {
-      std::cout << "Success!\n";
-      return 0;
+      std::cout << "Filters: " << PathFilter::shared().excluded() << " entries excluded\n";
     }
-    std::cout << "Failure!\n";
+    std::cout << "Peak memory usage: " << getPeakMemoryUsage() << " KB\n";
+  }
+  if (success)
+  {
+    std::cout << "Success!\n";
+    return 0;
   }
+  std::cout << "Failure!\n";
   return 1;
 }
@@ -0,0 +1,95 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of the test suite for copy-file-stats.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include <iostream>
+#include <string>
+#include "../../program/AuxiliaryFunctions.hpp"
+#include "../../program/FlatNameMap.hpp"
+
+int main()
+{
+  /* Covered functions in test:
+     This program checks that FlatNameMap finds every inserted name with its
+     value after the table has grown several times, that it does not find
+     other names, and that inserting a name again keeps the first value. */
+
+  FlatNameMap<unsigned int> map;
+  if ((map.find("root") != NULL) or (map.size() != 0))
+  {
+    std::cout << "Test failed!\nEmpty map finds a name.\n";
+    return 1;
+  }
+
+  const unsigned int count = 10000;
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    if (!map.insert("user" + uintToString(i), i))
+    {
+      std::cout << "Test failed!\nName user" << i << " was not inserted.\n";
+      return 1;
+    }
+  } // for
+  if (map.size() != count)
+  {
+    std::cout << "Test failed!\nMap has " << map.size() << " names instead of " << count << ".\n";
+    return 1;
+  }
+
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    const unsigned int * found = map.find("user" + uintToString(i));
+    if ((found == NULL) or (*found != i))
+    {
+      std::cout << "Test failed!\nName user" << i << " was not found or has the wrong value.\n";
+      return 1;
+    }
+    if ((map.find("group" + uintToString(i)) != NULL) or (map.find("user" + uintToString(i + count)) != NULL))
+    {
+      std::cout << "Test failed!\nA name that was not inserted was found.\n";
+      return 1;
+    }
+  } // for
+
+  // lookup of a part of a longer text, e.g. a field of a line
+  const std::string line = "rwxr-xr-x user42 42 users 100 file";
+  const unsigned int * found = map.find(line.data() + 10, 6);
+  if ((found == NULL) or (*found != 42) or (map.find(line.data() + 10, 7) != NULL))
+  {
+    std::cout << "Test failed!\nLookup by pointer and length does not work.\n";
+    return 1;
+  }
+
+  // names are only added once, the first value is kept
+  if (map.insert("user7", 1234) or (*map.find("user7") != 7) or (map.size() != count))
+  {
+    std::cout << "Test failed!\nInserting a name again changed the map.\n";
+    return 1;
+  }
+
+  // empty names are names, too
+  if (!map.insert("", 5) or (map.find("") == NULL) or (*map.find("") != 5))
+  {
+    std::cout << "Test failed!\nEmpty name is not handled.\n";
+    return 1;
+  }
+
+  std::cout << "All flat name map tests passed.\n";
+  return 0;
+}
@@ -0,0 +1,95 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of the test suite for copy-file-stats.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include <iostream>
+#include <string>
+#include "../../program/IDMapping.hpp"
+
+int main()
+{
+  /* Covered functions in test:
+     This program checks that IDMapping accepts valid ranges only, rejects
+     overlapping ranges, and maps the IDs at the borders of the ranges
+     correctly. User and group ranges are independent. */
+
+  IDMapping mapping;
+  if (!mapping.empty() or (mapping.mapUser(0) != 0) or (mapping.mapGroup(1234) != 1234))
+  {
+    std::cout << "Test failed!\nEmpty mapping changes IDs.\n";
+    return 1;
+  }
+
+  const char * const invalid[] = { "", "1", "1:2", "1:2:", ":2:3", "1:2:0", "a:2:3", "1:2:3:4",
+                                   "-1:2:3", "4294967295:0:1", "4294967294:0:3", "0:4294967295:1",
+                                   "0:4294967290:6", "1::3" };
+  for (const char * const range : invalid)
+  {
+    if (mapping.addUserRange(range) or mapping.addGroupRange(range) or !mapping.empty())
+    {
+      std::cout << "Test failed!\nInvalid range \"" << range << "\" was accepted.\n";
+      return 1;
+    }
+  } // for
+
+  if (!mapping.addUserRange("0:100000:65536") or !mapping.addUserRange("200000:1000:10")
+      or !mapping.addUserRange("65536:300000:1") or mapping.empty())
+  {
+    std::cout << "Test failed!\nValid user range was rejected.\n";
+    return 1;
+  }
+  const char * const overlapping[] = { "0:5:1", "65535:7:2", "199999:1:2", "200009:1:1", "100:1:100" };
+  for (const char * const range : overlapping)
+  {
+    if (mapping.addUserRange(range))
+    {
+      std::cout << "Test failed!\nOverlapping range \"" << range << "\" was accepted.\n";
+      return 1;
+    }
+  } // for
+
+  const unsigned int ids[][2] = { { 0, 100000 }, { 1, 100001 }, { 65535, 165535 }, { 65536, 300000 },
+                                  { 65537, 65537 }, { 199999, 199999 }, { 200000, 1000 },
+                                  { 200009, 1009 }, { 200010, 200010 }, { 4294967295u, 4294967295u } };
+  for (const auto& id : ids)
+  {
+    if (mapping.mapUser(id[0]) != id[1])
+    {
+      std::cout << "Test failed!\nUser ID " << id[0] << " was mapped to " << mapping.mapUser(id[0])
+                << " instead of " << id[1] << ".\n";
+      return 1;
+    }
+    // group IDs have their own ranges
+    if (mapping.mapGroup(id[0]) != id[0])
+    {
+      std::cout << "Test failed!\nGroup ID " << id[0] << " was mapped by a user range.\n";
+      return 1;
+    }
+  } // for
+
+  if (!mapping.addGroupRange("10:20:5") or (mapping.mapGroup(14) != 24) or (mapping.mapGroup(15) != 15)
+      or (mapping.mapUser(14) != 100014))
+  {
+    std::cout << "Test failed!\nGroup range is not applied correctly.\n";
+    return 1;
+  }
+
+  std::cout << "All ID mapping tests passed.\n";
+  return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of the test suite for copy-file-stats.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include "../../program/LogSink.hpp"
+
+/* reads the whole content of a temporary file */
+std::string readAll(std::FILE * file)
+{
+  std::string content;
+  char buffer[4096];
+  std::rewind(file);
+  std::size_t count = 0;
+  while ((count = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+    content.append(buffer, count);
+  return content;
+}
+
+/* writes messages and errors through a sink, returns false and prints a message on mismatch */
+bool check(const bool background)
+{
+  std::FILE * file = std::tmpfile();
+  if (file == NULL)
+  {
+    std::cout << "Test failed!\nCould not create a temporary file.\n";
+    return false;
+  }
+  std::ostringstream stream;
+  std::string expected;
+  {
+    LogSink sink(stream, fileno(file), background);
+    if (&LogSink::errors() == &std::cout)
+    {
+      std::cout << "Test failed!\nThe error channel of the sink is not active.\n";
+      std::fclose(file);
+      return false;
+    }
+    // more than two buffers, so the writer has to keep up
+    for (unsigned int i = 0; i < 100000; ++i)
+    {
+      stream << "Changing mode of \"dir/file" << i << "\" from 644 to 600.\n";
+      expected += "Changing mode of \"dir/file" + std::to_string(i) + "\" from 644 to 600.\n";
+      if (i % 30000 == 0)
+      {
+        // errors come after the messages that were written before them
+        LogSink::errors() << "Error: " << i << '\n';
+        expected += "Error: " + std::to_string(i) + '\n';
+      }
+    } // for
+    stream << "Success!\n";
+    expected += "Success!\n";
+  }
+  const std::string content = readAll(file);
+  std::fclose(file);
+  if (content != expected)
+  {
+    std::cout << "Test failed!\nThe sink wrote " << content.size() << " bytes, but "
+              << expected.size() << " bytes were expected"
+              << (background ? " (background writer)" : "") << ".\n";
+    return false;
+  }
+  if (!stream.str().empty() or (&LogSink::errors() != &std::cout))
+  {
+    std::cout << "Test failed!\nThe sink did not restore the stream.\n";
+    return false;
+  }
+  return true;
+}
+
+/* collects messages and errors like a parallel task, returns false and prints a message on mismatch */
+bool checkMessageBuffer()
+{
+  std::FILE * file = std::tmpfile();
+  if (file == NULL)
+  {
+    std::cout << "Test failed!\nCould not create a temporary file.\n";
+    return false;
+  }
+  std::ostringstream stream;
+  {
+    LogSink sink(stream, fileno(file), true);
+    MessageBuffer buffer;
+    if ((&LogSink::errors(buffer.messages()) != &buffer.errors())
+        or (&LogSink::errors(stream) != &LogSink::errors()))
+    {
+      std::cout << "Test failed!\nThe error stream of collected messages is wrong.\n";
+      std::fclose(file);
+      return false;
+    }
+    stream << "Before the task.\n";
+    buffer.messages() << "Changing mode of \"a\" from 644 to 600.\n";
+    LogSink::errors(buffer.messages()) << "Error while changing mode of \"b\".\n";
+    buffer.messages() << "Changing mode of \"c\" from 644 to 600.\n";
+    if (buffer.size() != 110)
+    {
+      std::cout << "Test failed!\nThe buffer has " << buffer.size() << " bytes instead of 110.\n";
+      std::fclose(file);
+      return false;
+    }
+    buffer.write(stream);
+    if (buffer.size() != 0)
+    {
+      std::cout << "Test failed!\nThe buffer was not cleared.\n";
+      std::fclose(file);
+      return false;
+    }
+    stream << "After the task.\n";
+  }
+  const std::string content = readAll(file);
+  std::fclose(file);
+  const std::string expected = "Before the task.\nChanging mode of \"a\" from 644 to 600.\n"
+      "Error while changing mode of \"b\".\nChanging mode of \"c\" from 644 to 600.\nAfter the task.\n";
+  if (content != expected)
+  {
+    std::cout << "Test failed!\nThe collected messages were written as \"" << content << "\".\n";
+    return false;
+  }
+  return true;
+}
+
+int main()
+{
+  /* Covered functions in test:
+     This program checks that LogSink writes all messages in the order they
+     were written, with and without background thread, that errors are
+     written after the messages in front of them, and that the stream and
+     the error channel are restored when the sink is destroyed. It also
+     checks that MessageBuffer keeps the order of collected messages and
+     errors. */
+
+  if (&LogSink::errors() != &std::cout)
+  {
+    std::cout << "Test failed!\nThere is an error channel without a sink.\n";
+    return 1;
+  }
+  if (!check(false) or !check(true) or !checkMessageBuffer())
+    return 1;
+
+  std::cout << "All log sink tests passed.\n";
+  return 0;
+}
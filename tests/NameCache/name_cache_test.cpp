@@ -0,0 +1,128 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of the test suite for copy-file-stats.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include <iostream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "../../program/FileUtilities.hpp"
+#include "../../program/NameCache.hpp"
+
+int main()
+{
+  /* Covered functions in test:
+     This program checks that NameCache returns the same names as the user
+     database, and that it keeps them: later calls return the same pointer,
+     also on other threads. IDs without names stay without names. Preloaded
+     and numeric caches do not use the user database at all. */
+
+  NameCache cache;
+  const unsigned int ids[] = { 0, 1, 2, 65534, 3999999999u, 4000000000u };
+  for (const unsigned int id : ids)
+  {
+    std::string expected;
+    const bool userKnown = getUserName(id, expected);
+    const std::string * user = cache.userName(id);
+    if ((user != NULL) != userKnown or (userKnown and (*user != expected)) or (cache.userName(id) != user))
+    {
+      std::cout << "Test failed!\nName of user " << id << " is wrong or not cached.\n";
+      return 1;
+    }
+    const bool groupKnown = getGroupName(id, expected);
+    const std::string * group = cache.groupName(id);
+    if ((group != NULL) != groupKnown or (groupKnown and (*group != expected)) or (cache.groupName(id) != group))
+    {
+      std::cout << "Test failed!\nName of group " << id << " is wrong or not cached.\n";
+      return 1;
+    }
+  } // for
+
+  // known names are added, but do not replace cached ones
+  cache.addUser(4000000001u, "someone");
+  cache.addGroup(4000000001u, "somegroup");
+  cache.addUser(4000000000u, "nobody-here");
+  if ((cache.userName(4000000001u) == NULL) or (*cache.userName(4000000001u) != "someone")
+      or (cache.groupName(4000000001u) == NULL) or (*cache.groupName(4000000001u) != "somegroup")
+      or (cache.userName(4000000000u) != NULL))
+  {
+    std::cout << "Test failed!\nAdded names are not returned as expected.\n";
+    return 1;
+  }
+
+  // several threads get the same entries
+  const std::string * const root = cache.userName(0);
+  std::vector<std::thread> threads;
+  std::vector<char> same(8, 0);
+  for (unsigned int i = 0; i < same.size(); ++i)
+  {
+    threads.push_back(std::thread([&cache, &same, root, i]()
+    {
+      bool result = true;
+      for (unsigned int j = 0; j < 10000; ++j)
+      {
+        result = result and (cache.userName(0) == root) and (cache.groupName(5000 + j % 50) == cache.groupName(5000 + j % 50));
+      } // for
+      same[i] = result ? 1 : 0;
+    }));
+  } // for
+  for (std::thread& thread : threads)
+    thread.join();
+  for (const char result : same)
+  {
+    if (result == 0)
+    {
+      std::cout << "Test failed!\nThreads got different entries.\n";
+      return 1;
+    }
+  } // for
+
+  if (cache.counts().database == 0 or cache.counts().cached == 0)
+  {
+    std::cout << "Test failed!\nLookups are not counted.\n";
+    return 1;
+  }
+
+  // preloaded lists are complete, other IDs have no name
+  NameCache preloaded;
+  IDNameList users;
+  users.push_back(std::make_pair(4000000002u, std::string("preloaded")));
+  IDNameList groups;
+  preloaded.preload(users, groups);
+  if ((preloaded.userName(4000000002u) == NULL) or (*preloaded.userName(4000000002u) != "preloaded")
+      or (preloaded.userName(0) != NULL) or (preloaded.groupName(0) != NULL)
+      or (preloaded.counts().database != 0) or (preloaded.counts().cached != 4))
+  {
+    std::cout << "Test failed!\nPreloaded cache does not return the preloaded names only.\n";
+    return 1;
+  }
+
+  // numeric cache has no names at all
+  NameCache numeric;
+  numeric.setNumeric(true);
+  if ((numeric.userName(0) != NULL) or (numeric.groupName(0) != NULL) or (numeric.counts().database != 0))
+  {
+    std::cout << "Test failed!\nNumeric cache returns names.\n";
+    return 1;
+  }
+
+  std::cout << "All name cache tests passed.\n";
+  return 0;
+}
@@ -0,0 +1,133 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of the test suite for copy-file-stats.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include <iostream>
+#include <string>
+#include "../../program/PathFilter.hpp"
+
+/* checks one entry of a walk, returns false and prints a message on mismatch */
+bool check(PathFilter& filter, const std::string& directory, const std::string& name, const unsigned char type, const bool expected)
+{
+  if (filter.excludes(directory, 0, name.c_str(), name.size(), type) != expected)
+  {
+    std::cout << "Test failed!\nEntry \"" << name << "\" in \"" << directory << "\" is "
+              << (expected ? "not excluded" : "excluded") << ".\n";
+    return false;
+  }
+  return true;
+}
+
+int main()
+{
+  /* Covered functions in test:
+     This program checks the matching of names, paths and wildcards by
+     PathFilter, that the first matching rule decides, that rules for
+     directories are checked again once the type of an entry is known, and
+     that paths of stat files are excluded with their parent directories. */
+
+  PathFilter empty;
+  if (empty.active() or !check(empty, "", "anything", DT_REG, false) or empty.addRule("/", false))
+  {
+    std::cout << "Test failed!\nEmpty filter excludes entries or accepts an empty pattern.\n";
+    return 1;
+  }
+
+  // names, suffixes, prefixes and other wildcards
+  PathFilter names;
+  names.addRule(".git", false);
+  names.addRule("*.tmp", false);
+  names.addRule("cache*", false);
+  names.addRule("file?.[ch]", false);
+  names.addRule("[!a-m]x", false);
+  if (!names.active()
+      or !check(names, "", ".git", DT_DIR, true) or !check(names, "a/b/", ".git", DT_DIR, true)
+      or !check(names, "a/", ".gitignore", DT_REG, false)
+      or !check(names, "a/", "x.tmp", DT_REG, true) or !check(names, "a/", "x.tmpl", DT_REG, false)
+      or !check(names, "", ".tmp", DT_REG, true)
+      or !check(names, "", "cache", DT_DIR, true) or !check(names, "", "caches", DT_DIR, true)
+      or !check(names, "", "mycache", DT_DIR, false)
+      or !check(names, "", "file1.c", DT_REG, true) or !check(names, "", "file2.h", DT_REG, true)
+      or !check(names, "", "file10.c", DT_REG, false) or !check(names, "", "file1.o", DT_REG, false)
+      or !check(names, "", "zx", DT_REG, true) or !check(names, "", "bx", DT_REG, false))
+    return 1;
+
+  // paths, anchored paths and "**"
+  PathFilter paths;
+  paths.addRule("/build", false);
+  paths.addRule("doc/*.html", false);
+  paths.addRule("src/**/gen", false);
+  if (!check(paths, "", "build", DT_DIR, true) or !check(paths, "sub/", "build", DT_DIR, false)
+      or !check(paths, "doc", "index.html", DT_REG, true) or !check(paths, "x/doc/", "index.html", DT_REG, true)
+      or !check(paths, "doc/sub", "index.html", DT_REG, false)
+      or !check(paths, "src/a/b", "gen", DT_DIR, true) or !check(paths, "src", "gen", DT_DIR, false))
+    return 1;
+  // directory of the walk given with a prefix that is not part of the relative path
+  const std::string directory = "/tmp/tree/doc";
+  if (!paths.excludes(directory, 9, "a.html", 6, DT_REG) or !paths.excludes(directory, 4, "a.html", 6, DT_REG))
+  {
+    std::cout << "Test failed!\nStart of the relative path is not respected.\n";
+    return 1;
+  }
+
+  // the first matching rule decides
+  PathFilter order;
+  order.addRule("*.c", true);
+  order.addRule("*", false);
+  order.addRule("keep.o", true);
+  if (!check(order, "", "main.c", DT_REG, false) or !check(order, "", "main.o", DT_REG, true)
+      or !check(order, "", "keep.o", DT_REG, true))
+    return 1;
+
+  // rules for directories need the type of the entry
+  PathFilter directories;
+  directories.addRule("out/", false);
+  if (!check(directories, "", "out", DT_DIR, true) or !check(directories, "", "out", DT_REG, false)
+      or !check(directories, "", "out", DT_UNKNOWN, false)
+      or !directories.excludesQueried("", 0, "out", 3, DT_UNKNOWN, S_IFDIR | 0755)
+      or directories.excludesQueried("", 0, "out", 3, DT_UNKNOWN, S_IFREG | 0644)
+      or directories.excludesQueried("", 0, "out", 3, DT_DIR, S_IFDIR | 0755))
+  {
+    std::cout << "Test failed!\nRules for directories are not applied by type.\n";
+    return 1;
+  }
+
+  // paths of stat files, parents are always directories
+  if (!directories.excludesPath("a/out/file") or directories.excludesPath("a/out")
+      or !directories.excludesQueriedPath("a/out", S_IFDIR | 0700)
+      or directories.excludesQueriedPath("a/out", S_IFREG | 0600)
+      or !directories.hides("a/out") or directories.hides("a/outer"))
+  {
+    std::cout << "Test failed!\nPaths are not excluded with their parents.\n";
+    return 1;
+  }
+  if (!names.excludesPath(".git/config") or !names.excludesPath("a/b.tmp") or names.excludesPath("a/b"))
+  {
+    std::cout << "Test failed!\nPaths are not excluded by names.\n";
+    return 1;
+  }
+  if (directories.excluded() != 4)
+  {
+    std::cout << "Test failed!\nFilter counts " << directories.excluded() << " excluded entries instead of 4.\n";
+    return 1;
+  }
+
+  std::cout << "All path filter tests passed.\n";
+  return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of the test suite for copy-file-stats.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include <iostream>
+#include <string>
+#include "../../program/PathIndex.hpp"
+
+int main()
+{
+  /* Covered functions in test:
+     This program checks that PathIndex gives each path one ID, finds every
+     path by its directory and name after the tables have grown several
+     times, does not find other paths, and gives back the inserted paths. */
+
+  PathIndex index;
+  if ((index.size() != 0) or (index.findDirectory("") != PathIndex::cNotFound)
+      or (index.find(PathIndex::cNotFound, "a", 1) != PathIndex::cNotFound))
+  {
+    std::cout << "Test failed!\nEmpty index finds a path.\n";
+    return 1;
+  }
+
+  // paths of a stat file: top level entries, directories and their content
+  const unsigned int count = 10000;
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    const std::string path = (i % 10 == 0) ? "top" + std::to_string(i)
+                           : "dir" + std::to_string(i / 100) + "/sub/file" + std::to_string(i);
+    if ((index.insert(path) != i) or (index.path(i) != path))
+    {
+      std::cout << "Test failed!\nPath " << path << " did not get the ID " << i << ".\n";
+      return 1;
+    }
+  } // for
+  if ((index.size() != count) or (index.insert("dir3/sub/file345") != 345) or (index.size() != count))
+  {
+    std::cout << "Test failed!\nIndex has " << index.size() << " paths instead of " << count << ".\n";
+    return 1;
+  }
+
+  // lookups like a walk of the destination directory does them
+  const PathIndex::Id top = index.findDirectory("");
+  for (unsigned int i = 0; i < count; ++i)
+  {
+    const PathIndex::Id directory = (i % 10 == 0) ? top : index.findDirectory("dir" + std::to_string(i / 100) + "/sub/");
+    const std::string name = ((i % 10 == 0) ? "top" : "file") + std::to_string(i);
+    if (index.find(directory, name.c_str(), name.size()) != i)
+    {
+      std::cout << "Test failed!\nPath with name " << name << " was not found.\n";
+      return 1;
+    }
+    const std::string other = ((i % 10 == 0) ? "file" : "top") + std::to_string(i);
+    if (index.find(directory, other.c_str(), other.size()) != PathIndex::cNotFound)
+    {
+      std::cout << "Test failed!\nPath with name " << other << " was found in the wrong directory.\n";
+      return 1;
+    }
+  } // for
+
+  // directories only exist, if paths are in them
+  if ((index.findDirectory("dir3/") != PathIndex::cNotFound) or (index.findDirectory("dir3/sub") != PathIndex::cNotFound)
+      or (index.find(top, "dir3", 4) != PathIndex::cNotFound))
+  {
+    std::cout << "Test failed!\nA directory without paths was found.\n";
+    return 1;
+  }
+
+  std::cout << "All path index tests passed.\n";
+  return 0;
+}
@@ -0,0 +1,81 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of the test suite for copy-file-stats.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "../../../program/AuxiliaryFunctions.hpp"
+#include "../../../program/FileUtilities.hpp"
+#include "../../../program/SaveRestore.hpp"
+
+int main()
+{
+  /* Covered functions in test:
+     This program compares the integers of uintToChars() and the lines of
+     SaveRestore::appendStatString() with the output of iostreams. */
+
+  const unsigned int values[] = { 0, 1, 9, 10, 11, 99, 100, 101, 999, 1000, 4711, 9999, 10000, 65534, 65535,
+                                  99999, 100000, 999999, 1000000, 9999999, 10000000, 99999999, 100000000,
+                                  999999999, 1000000000, 1234567890, 4294967294u, 4294967295u };
+  for (const unsigned int value : values)
+  {
+    std::ostringstream expected;
+    expected << value;
+    char digits[cMaxUintChars];
+    const std::string result(digits, uintToChars(digits, value));
+    if ((result != expected.str()) or (uintToString(value) != expected.str()))
+    {
+      std::cout << "Test failed!\n";
+      std::cout << "Digits of " << expected.str() << " were \"" << result << "\".\n";
+      return 1;
+    }
+  } // for
+
+  // lines have to look like they were put together from their parts
+  for (const unsigned int value : values)
+  {
+    FileStatus status;
+    status.mode = S_IFREG | (value & 07777);
+    status.userID = value;
+    status.groupID = value / 3;
+    std::string userName;
+    if (!getUserName(status.userID, userName))
+      userName = "?";
+    std::string groupName;
+    if (!getGroupName(status.groupID, groupName))
+      groupName = "?";
+    std::ostringstream expected;
+    std::string modeString;
+    SaveRestore::appendModeString(status.mode, modeString);
+    expected << "previous\n" << modeString << ' ' << userName << ' ' << status.userID << ' '
+             << groupName << ' ' << status.groupID << " some path/with spaces";
+    std::string line = "previous\n";
+    SaveRestore::appendStatString(status, "some path/with spaces", line);
+    if (line != expected.str())
+    {
+      std::cout << "Test failed!\n";
+      std::cout << "Line was \"" << line << "\", but it should be \"" << expected.str() << "\".\n";
+      return 1;
+    }
+  } // for
+
+  std::cout << "All \"stat string\" tests passed.\n";
+  return 0;
+}
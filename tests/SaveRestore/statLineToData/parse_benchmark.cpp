@@ -0,0 +1,144 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of the test suite for copy-file-stats.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include <chrono>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include "../../../program/AuxiliaryFunctions.hpp"
+#include "../../../program/SaveRestore.hpp"
+#include "../../../program/TextParser.hpp"
+
+/* Covered functions in test:
+   This program compares the throughput of two ways to parse the lines of a
+   text stat file:
+     - getline() into a buffer of 256 bytes and SaveRestore::statLineToData(),
+       like restore() did before
+     - LineReader, which finds line breaks and spaces with Tokenizer, and
+       splitStatLine(), like restore() does now
+   Both have to yield the same data, and the throughput of each one is shown
+   in lines per second. Names are "?", so that only the parsing is measured
+   and not the user database.
+*/
+
+/* sums of the parsed values, to compare the results of both parsers */
+struct Totals {
+    unsigned long long lines;
+    unsigned long long modes;
+    unsigned long long IDs;
+    unsigned long long pathLength;
+};//struct
+
+/* shows the throughput of a parser */
+void showThroughput(const std::string& name, const Totals& totals, const std::chrono::steady_clock::duration& duration)
+{
+  const double seconds = std::chrono::duration<double>(duration).count();
+  std::cout << name << ": " << totals.lines << " lines in " << seconds << " s, "
+            << static_cast<unsigned long long>(totals.lines / seconds) << " lines/s\n";
+}
+
+int main(int argc, char** argv)
+{
+  unsigned int lineCount = 1000000;
+  if ((argc > 1) && (argv != NULL) && (argv[1] != NULL) && !stringToUint(std::string(argv[1]), lineCount))
+  {
+    std::cout << "Hint: This program expects the number of lines as optional parameter.\n";
+    return 1;
+  }
+
+  // typical lines of a stat file, paths are shorter than 256 characters so
+  // that getline() can handle them
+  std::string data;
+  for (unsigned int i = 0; i < lineCount; ++i)
+  {
+    data += (i % 3 == 0) ? "rwxr-xr-x ? " : "rw-r--r-- ? ";
+    data += uintToString(1000 + i % 4) + " ? " + uintToString(100 + i % 7)
+          + " directory" + uintToString(i / 100) + "/some/deeper/path/file" + uintToString(i) + ".txt\n";
+  } // for
+
+  SaveRestore parser;
+  mode_t mode;
+  uid_t UID;
+  gid_t GID;
+  std::string file;
+
+  // getline() and statLineToData()
+  Totals legacy = { 0, 0, 0, 0 };
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+  {
+    std::istringstream stream(data);
+    const unsigned int cMaxLine = 256;
+    char buffer[cMaxLine];
+    while (stream.getline(buffer, cMaxLine-1))
+    {
+      buffer[cMaxLine-1] = '\0';
+      const std::string line = std::string(buffer);
+      if (!parser.statLineToData(line, mode, UID, GID, file))
+      {
+        std::cout << "Error: statLineToData() failed for line \"" << line << "\".\n";
+        return 1;
+      }
+      ++legacy.lines;
+      legacy.modes += mode;
+      legacy.IDs += UID + GID;
+      legacy.pathLength += file.size();
+    } // while
+  }
+  showThroughput("getline + statLineToData", legacy, std::chrono::steady_clock::now() - start);
+
+  // LineReader and splitStatLine()
+  Totals blocks = { 0, 0, 0, 0 };
+  start = std::chrono::steady_clock::now();
+  {
+    std::stringbuf input(data);
+    LineReader reader(input);
+    TextView line;
+    LineTokens tokens;
+    StatLineFields fields;
+    unsigned int userID;
+    unsigned int groupID;
+    while (reader.next(line, tokens))
+    {
+      if (!splitStatLine(line, tokens, fields)
+          || !SaveRestore::stringToMode(fields.mode.data, fields.mode.size, mode)
+          || !stringToUint(fields.userID.data, fields.userID.size, userID)
+          || !stringToUint(fields.groupID.data, fields.groupID.size, groupID))
+      {
+        std::cout << "Error: splitStatLine() failed for line \"" << line.str() << "\".\n";
+        return 1;
+      }
+      file.assign(fields.path.data, fields.path.size);
+      ++blocks.lines;
+      blocks.modes += mode;
+      blocks.IDs += userID + groupID;
+      blocks.pathLength += file.size();
+    } // while
+  }
+  showThroughput("LineReader + splitStatLine", blocks, std::chrono::steady_clock::now() - start);
+
+  if ((legacy.lines != lineCount) || (blocks.lines != lineCount) || (legacy.modes != blocks.modes)
+      || (legacy.IDs != blocks.IDs) || (legacy.pathLength != blocks.pathLength))
+  {
+    std::cout << "Error: Results of both parsers differ!\n";
+    return 1;
+  }
+  std::cout << "Both parsers yield the same data.\n";
+  return 0;
+}
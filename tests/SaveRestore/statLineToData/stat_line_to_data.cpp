@@ -0,0 +1,110 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of the test suite for copy-file-stats.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "../../../program/SaveRestore.hpp"
+#include "../../../program/TextParser.hpp"
+
+int main()
+{
+  /* Covered functions in test:
+     This program tests the return values of SaveRestore::statLineToData() and
+     checks that LineReader returns lines of any length. Names are "?", so the
+     IDs are used as they are. */
+
+  const std::string longPath = std::string(300, 'a') + "/" + std::string(5000, 'b');
+
+  // line, expected result, mode, UID, GID, file
+  std::vector<std::tuple<std::string, bool, mode_t, uid_t, gid_t, std::string> > tests;
+
+  tests.push_back(std::make_tuple("", false, 0, 0, 0, ""));
+  tests.push_back(std::make_tuple("rw-r--r--", false, 0, 0, 0, ""));
+  tests.push_back(std::make_tuple("rw-r--r-- ? 1000 ? 100", false, 0, 0, 0, ""));
+  tests.push_back(std::make_tuple("rw-r--r-- ? 1000 ? 100 ", false, 0, 0, 0, ""));
+  tests.push_back(std::make_tuple("rw-r--r-x- ? 1000 ? 100 file", false, 0, 0, 0, ""));
+  tests.push_back(std::make_tuple("rw-r--r-- ? 10a0 ? 100 file", false, 0, 0, 0, ""));
+  tests.push_back(std::make_tuple("rw-r--r-- ? 1000 ? -100 file", false, 0, 0, 0, ""));
+  tests.push_back(std::make_tuple("rw-r--r-- ? 1000 ? 100 file", true, 0644, 1000, 100, "file"));
+  tests.push_back(std::make_tuple("rwxr-x--- ? 0 ? 0 /", true, 0750, 0, 0, "/"));
+  tests.push_back(std::make_tuple("rw-r--r-- ? 1000 ? 100 file with  spaces ", true, 0644, 1000, 100, "file with  spaces "));
+  tests.push_back(std::make_tuple("rwsr-sr-t ? 4294967294 ? 65534 dir/sub/file", true, 07755, 4294967294u, 65534, "dir/sub/file"));
+  tests.push_back(std::make_tuple("rw------- ? 1 ? 2 " + longPath, true, 0600, 1, 2, longPath));
+
+  SaveRestore sr;
+  std::string data;
+  //check all test cases for statLineToData()
+  for (const std::tuple<std::string, bool, mode_t, uid_t, gid_t, std::string>& tup : tests)
+  {
+    mode_t mode = 0;
+    uid_t UID = 0;
+    gid_t GID = 0;
+    std::string file;
+    const bool result = sr.statLineToData(std::get<0>(tup), mode, UID, GID, file);
+    if (result != std::get<1>(tup))
+    {
+      std::cout << "Test failed!\n";
+      std::cout << "Line was \"" << std::get<0>(tup).substr(0, 80) << "\".\n";
+      std::cout << "Result was " << (result ? "true" : "false") << ", but " << (std::get<1>(tup) ? "true" : "false") << " was expected.\n";
+      return 1;
+    } //if
+
+    //Check data - but only for tests that shall return true.
+    if (std::get<1>(tup) && ((mode != std::get<2>(tup)) || (UID != std::get<3>(tup))
+        || (GID != std::get<4>(tup)) || (file != std::get<5>(tup))))
+    {
+      std::cout << "Test failed!\n";
+      std::cout << "Line was \"" << std::get<0>(tup).substr(0, 80) << "\".\n";
+      std::cout << "Returned data was " << std::oct << mode << std::dec << ", " << UID << ", " << GID
+                << ", \"" << file.substr(0, 80) << "\", but it should be " << std::oct << std::get<2>(tup)
+                << std::dec << ", " << std::get<3>(tup) << ", " << std::get<4>(tup) << ", \""
+                << std::get<5>(tup).substr(0, 80) << "\" instead.\n";
+      return 1;
+    } //if
+    data += std::get<0>(tup) + "\n";
+  } //for
+
+  //LineReader has to return the same lines, even those longer than a block
+  data += std::string(3 * LineReader::cBlockSize, 'c');
+  std::stringbuf input(data);
+  LineReader reader(input);
+  TextView line;
+  for (const std::tuple<std::string, bool, mode_t, uid_t, gid_t, std::string>& tup : tests)
+  {
+    if (!reader.next(line) || !line.equals(std::get<0>(tup)))
+    {
+      std::cout << "Test failed!\n";
+      std::cout << "LineReader did not return the line \"" << std::get<0>(tup).substr(0, 80) << "\".\n";
+      return 1;
+    } //if
+  } //for
+  if (!reader.next(line) || !line.equals(std::string(3 * LineReader::cBlockSize, 'c')) || reader.next(line))
+  {
+    std::cout << "Test failed!\n";
+    std::cout << "LineReader did not return the last line without line break.\n";
+    return 1;
+  } //if
+
+  std::cout << "All \"stat line to data\" tests passed.\n";
+  return 0;
+}
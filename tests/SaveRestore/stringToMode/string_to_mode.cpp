@@ -24,10 +24,36 @@
 #include <vector>
 #include "../../../program/SaveRestore.hpp"
 
+/* mode string of a file mode, character by character */
+std::string referenceModeString(const mode_t mode)
+{
+  std::string result;
+  result += (mode & S_IRUSR) ? 'r' : '-';
+  result += (mode & S_IWUSR) ? 'w' : '-';
+  if (mode & S_ISUID)
+    result += (mode & S_IXUSR) ? 's' : 'S';
+  else
+    result += (mode & S_IXUSR) ? 'x' : '-';
+  result += (mode & S_IRGRP) ? 'r' : '-';
+  result += (mode & S_IWGRP) ? 'w' : '-';
+  if (mode & S_ISGID)
+    result += (mode & S_IXGRP) ? 's' : 'S';
+  else
+    result += (mode & S_IXGRP) ? 'x' : '-';
+  result += (mode & S_IROTH) ? 'r' : '-';
+  result += (mode & S_IWOTH) ? 'w' : '-';
+  if (mode & S_ISVTX)
+    result += (mode & S_IXOTH) ? 't' : 'T';
+  else
+    result += (mode & S_IXOTH) ? 'x' : '-';
+  return result;
+}
+
 int main()
 {
   /* Covered functions in test:
-     This program tests the return values of SaveRestore::stringToMode(). */
+     This program tests the return values of SaveRestore::stringToMode() and
+     the strings of SaveRestore::appendModeString() for all 4096 modes. */
 
   std::vector<std::tuple<std::string, bool, mode_t> > tests;
 
@@ -101,6 +127,52 @@ int main()
     } //if
   } //for
 
+  //check all 4096 modes in both directions
+  for (mode_t mode = 0; mode < 010000; ++mode)
+  {
+    const std::string expected = referenceModeString(mode);
+    std::string modeString = "prefix";
+    SaveRestore::appendModeString(mode, modeString);
+    if (modeString != "prefix" + expected)
+    {
+      std::cout << "Test failed!\n";
+      const std::ios::fmtflags flags = std::cout.flags();
+      std::cout << "Mode string of " << std::oct << mode << " was \"" << modeString.substr(6)
+                << "\", but it should be \"" << expected << "\".\n";
+      std::cout.flags(flags);
+      return 1;
+    } //if
+    mode_t decoded = 0;
+    if (!SaveRestore::stringToMode(expected, decoded) || (decoded != mode))
+    {
+      std::cout << "Test failed!\n";
+      const std::ios::fmtflags flags = std::cout.flags();
+      std::cout << "Mode string \"" << expected << "\" was not decoded to " << std::oct << mode << ".\n";
+      std::cout.flags(flags);
+      return 1;
+    } //if
+  } //for
+
+  //check every character at every position of a mode string
+  const std::string allowed[9] = { "r-", "w-", "xsS-", "r-", "w-", "xsS-", "r-", "w-", "xtT-" };
+  for (unsigned int position = 0; position < 9; ++position)
+  {
+    for (unsigned int c = 0; c < 256; ++c)
+    {
+      std::string modeString = "---------";
+      modeString[position] = static_cast<char>(c);
+      const bool expected = (c != 0) && (allowed[position].find(static_cast<char>(c)) != std::string::npos);
+      mode_t mode = 0;
+      if (SaveRestore::stringToMode(modeString, mode) != expected)
+      {
+        std::cout << "Test failed!\n";
+        std::cout << "Character " << c << " at position " << position << " should be "
+                  << (expected ? "valid" : "invalid") << ".\n";
+        return 1;
+      } //if
+    } //for c
+  } //for position
+
   std::cout << "All \"string to file mode\" tests passed.\n";
   return 0;
 }
@@ -0,0 +1,92 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of the test suite for copy-file-stats.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "../../program/AuxiliaryFunctions.hpp"
+#include "../../program/Tokenizer.hpp"
+
+/* Covered functions in test:
+   This program measures the throughput of all implementations of
+   Tokenizer::scanLine() that the processor supports. It splits typical lines
+   of a text stat file into lines and fields again and again, and shows the
+   number of lines and bytes per second of each implementation. All of them
+   have to find the same number of lines and spaces.
+*/
+
+int main(int argc, char** argv)
+{
+  unsigned int lineCount = 1000000;
+  if ((argc > 1) && (argv != NULL) && (argv[1] != NULL) && !stringToUint(std::string(argv[1]), lineCount))
+  {
+    std::cout << "Hint: This program expects the number of lines as optional parameter.\n";
+    return 1;
+  }
+
+  // typical lines of a text stat file
+  std::string data;
+  for (unsigned int i = 0; i < lineCount; ++i)
+  {
+    data += (i % 3 == 0) ? "rwxr-xr-x user " : "rw-r--r-- user ";
+    data += uintToString(1000 + i % 4) + " group " + uintToString(100 + i % 7)
+          + " directory" + uintToString(i / 100) + "/some/deeper/path/file" + uintToString(i) + ".txt\n";
+  } // for
+
+  const unsigned int cRepetitions = 5;
+  unsigned long long expectedSpaces = 0;
+  for (const Tokenizer::Implementation implementation : Tokenizer::supported())
+  {
+    const Tokenizer tokenizer(implementation);
+    unsigned long long lines = 0;
+    unsigned long long spaces = 0;
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (unsigned int repetition = 0; repetition < cRepetitions; ++repetition)
+    {
+      const char * next = data.data();
+      const char * const end = data.data() + data.size();
+      LineTokens tokens;
+      while (next < end)
+      {
+        tokens.spaceCount = 0;
+        const char * lineEnd = tokenizer.scanLine(next, end, tokens);
+        if (lineEnd == NULL)
+          lineEnd = end;
+        ++lines;
+        spaces += tokens.spaceCount;
+        next = lineEnd + 1;
+      } // while
+    } // for
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << Tokenizer::name(implementation) << ": " << lines << " lines in " << seconds << " s, "
+              << static_cast<unsigned long long>(lines / seconds) << " lines/s, "
+              << static_cast<unsigned long long>(cRepetitions * data.size() / seconds / 1000000) << " MB/s\n";
+
+    if ((lines != static_cast<unsigned long long>(cRepetitions) * lineCount)
+        or ((expectedSpaces != 0) and (spaces != expectedSpaces)))
+    {
+      std::cout << "Error: The " << Tokenizer::name(implementation) << " implementation found "
+                << lines << " lines and " << spaces << " spaces, but that is not the expected result.\n";
+      return 1;
+    }
+    expectedSpaces = spaces;
+  } // for
+  return 0;
+}
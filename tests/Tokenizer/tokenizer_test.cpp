@@ -0,0 +1,101 @@
+/*
+ -------------------------------------------------------------------------------
+    This file is part of the test suite for copy-file-stats.
+    Copyright (C) 2015  Dirk Stolle
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ -------------------------------------------------------------------------------
+*/
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../../program/Tokenizer.hpp"
+
+/* reference: finds the line break and the spaces in front of it byte by byte */
+const char * scanReference(const char * begin, const char * end, LineTokens& tokens)
+{
+  for (const char * pos = begin; pos < end; ++pos)
+  {
+    if (*pos == '\n')
+      return pos;
+    if ((*pos == ' ') and (tokens.spaceCount < LineTokens::cMaxSpaces))
+      tokens.spaces[tokens.spaceCount++] = pos;
+  } // for
+  return NULL;
+}
+
+int main()
+{
+  /* Covered functions in test:
+     This program checks that all implementations of Tokenizer::scanLine()
+     that the processor supports find the same line breaks and spaces as a
+     simple byte-by-byte search, at all positions relative to the blocks of
+     16 and 32 bytes. */
+
+  const std::vector<Tokenizer::Implementation> implementations = Tokenizer::supported();
+  if (implementations.empty() or (implementations[0] != Tokenizer::tiScalar))
+  {
+    std::cout << "Test failed!\nThe scalar implementation has to be supported everywhere.\n";
+    return 1;
+  }
+
+  // random text with many spaces and line breaks, and some bytes >= 0x80
+  std::srand(42);
+  std::string text;
+  const char alphabet[] = "  \n abcdefghijklmnopqrstuvwxyz-/\xc3\xa4\xff";
+  for (unsigned int i = 0; i < 20000; ++i)
+    text += alphabet[std::rand() % (sizeof(alphabet) - 1)];
+  // long lines and lines with more than five spaces
+  text += std::string(100, 'x') + " " + std::string(70, 'y') + "\n" + std::string(300, ' ') + "\n" + std::string(1000, 'z');
+
+  for (const Tokenizer::Implementation implementation : implementations)
+  {
+    const Tokenizer tokenizer(implementation);
+    if (tokenizer.implementation() != implementation)
+    {
+      std::cout << "Test failed!\nTokenizer does not use the " << Tokenizer::name(implementation) << " implementation.\n";
+      return 1;
+    }
+    std::cout << "Testing " << Tokenizer::name(implementation) << " implementation...\n";
+    // start at every offset, end at different distances to the end
+    for (std::string::size_type start = 0; start < text.size(); ++start)
+    {
+      const char * const begin = text.data() + start;
+      const char * const end = text.data() + text.size() - (start % 67);
+      if (begin > end)
+        continue;
+      LineTokens expectedTokens;
+      LineTokens tokens;
+      // start with some spaces of a previous part of the line
+      expectedTokens.spaceCount = tokens.spaceCount = start % 3;
+      const char * const expected = scanReference(begin, end, expectedTokens);
+      const char * const found = tokenizer.scanLine(begin, end, tokens);
+      bool equal = (found == expected) and (tokens.spaceCount == expectedTokens.spaceCount);
+      for (unsigned int i = start % 3; equal and (i < tokens.spaceCount); ++i)
+        equal = (tokens.spaces[i] == expectedTokens.spaces[i]);
+      if (!equal)
+      {
+        std::cout << "Test failed!\nResult of the " << Tokenizer::name(implementation)
+                  << " implementation differs from the expected one for text at offset "
+                  << start << " with length " << (end - begin) << ".\n";
+        return 1;
+      }
+    } // for start
+  } // for implementation
+
+  std::cout << "All tokenizer tests passed.\n";
+  return 0;
+}
@@ -0,0 +1,92 @@
+#!/bin/bash
+
+# This file is part of the test suite for copy-file-stats.
+# Copyright (C) 2015  Dirk Stolle
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+
+# check parameter
+if [[ -z $1 ]]
+then
+  echo "Error: Expecting one parameter - path of executable copy-file-stats!"
+  return 1
+fi
+
+# get default user and group
+USER_ID=`id -u`
+GROUP_ID=`id -g`
+
+#include create_directory and create_file functions
+source ${BASH_SOURCE%/*}/../../script-includes/creation.sh
+
+# create source and destination directory for the test
+SOURCE_DIR=`mktemp --directory --tmpdir testSaveRestoreXXXXXXXXXX`
+DESTINATION_DIR=`mktemp --directory --tmpdir testSaveRestoreXXXXXXXXXX`
+
+for DIR in $SOURCE_DIR $DESTINATION_DIR
+do
+  create_file $DIR/alpha 0755
+  create_file $DIR/beta 0644
+  create_directory $DIR/sub 0755
+  create_file $DIR/sub/gamma 0640
+done
+
+if [[ $? -ne 0 ]]
+then
+  echo "Failed to create test files!"
+  exit 1
+fi
+
+echo "Files created successfully in $SOURCE_DIR and $DESTINATION_DIR!"
+
+LOG_FILE=`mktemp --dry-run --tmpdir=/tmp logXXXXXXXX`
+
+# Both trees have the same owner, so only the mapping causes changes.
+$1 --dry-run --numeric-ids --map-uid $USER_ID:4000:1 --map-gid $GROUP_ID:4001:1 $SOURCE_DIR $DESTINATION_DIR > $LOG_FILE
+TEST_EXIT_CODE=$?
+
+if [[ $TEST_EXIT_CODE -eq 0 ]]
+then
+  COUNT=`grep --count "^Would change ownership of .* to 4000:4001\.\.\.$" $LOG_FILE`
+  if [[ $COUNT -eq 4 ]]
+  then
+    echo "All entries would get the mapped IDs. :)"
+  else
+    echo "Error: $COUNT instead of 4 entries would get the mapped IDs."
+    cat $LOG_FILE
+    TEST_EXIT_CODE=1
+  fi
+else
+  echo "Executable returned non-zero exit code $TEST_EXIT_CODE."
+fi
+
+# without mapping nothing changes
+if [[ $TEST_EXIT_CODE -eq 0 ]]
+then
+  $1 --dry-run --map-uid 4000:$USER_ID:1 $SOURCE_DIR $DESTINATION_DIR > $LOG_FILE && \
+  ! grep --quiet "^Would change ownership" $LOG_FILE
+  TEST_EXIT_CODE=$?
+fi
+
+# clean up
+rm -rf $SOURCE_DIR $DESTINATION_DIR
+rm -f $LOG_FILE
+
+if [[ $TEST_EXIT_CODE -eq 0 ]]
+then
+  exit 0
+else
+  exit 1
+fi
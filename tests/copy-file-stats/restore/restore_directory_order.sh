@@ -0,0 +1,76 @@
+#!/bin/bash
+
+# This file is part of the test suite for copy-file-stats.
+# Copyright (C) 2015  Dirk Stolle
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+# check parameter
+if [[ -z $1 ]]
+then
+  echo "Error: Expecting one parameter - path of executable copy-file-stats!"
+  return 1
+fi
+
+# get default user name and group
+USER_NAME=`id -un`
+USER_ID=`id -u`
+GROUP_NAME=`id -gn`
+GROUP_ID=`id -g`
+
+#include create_directory and create_file functions
+source ${BASH_SOURCE%/*}/../../script-includes/creation.sh
+
+# Directories lose their search permission during the restore, but their
+# content has to be restored anyway - sequentially and in parallel.
+TEST_EXIT_CODE=0
+for JOBS in 1 4
+do
+  # create base directory where the test shall take place
+  BASE_DIR=`mktemp --directory --tmpdir testSaveRestoreXXXXXXXXXX`
+  STAT_FILE=`mktemp --tmpdir=/tmp statfileXXXXXXXX`
+
+  create_directory $BASE_DIR/locked 0755
+  create_file $BASE_DIR/locked/alpha 0600
+  create_directory $BASE_DIR/locked/inner 0755
+  create_file $BASE_DIR/locked/inner/beta 0600
+  create_directory $BASE_DIR/opened 0000
+
+  echo "rw------- $USER_NAME $USER_ID $GROUP_NAME $GROUP_ID locked" > $STAT_FILE
+  echo "r--r--r-- $USER_NAME $USER_ID $GROUP_NAME $GROUP_ID locked/alpha" >> $STAT_FILE
+  echo "r-------- $USER_NAME $USER_ID $GROUP_NAME $GROUP_ID locked/inner" >> $STAT_FILE
+  echo "r--r----- $USER_NAME $USER_ID $GROUP_NAME $GROUP_ID locked/inner/beta" >> $STAT_FILE
+  echo "rwxr-xr-x $USER_NAME $USER_ID $GROUP_NAME $GROUP_ID opened" >> $STAT_FILE
+
+  $1 --restore --force $STAT_FILE $BASE_DIR --jobs $JOBS
+  if [[ $? -ne 0 ]]
+  then
+    echo "Error: Restore with $JOBS job(s) failed."
+    TEST_EXIT_CODE=1
+  fi
+
+  # check modes, directories have to be accessible for that
+  chmod 0700 $BASE_DIR/locked $BASE_DIR/locked/inner
+  MODES=`stat -c %a $BASE_DIR/locked/alpha $BASE_DIR/locked/inner/beta $BASE_DIR/opened | tr '\n' ' '`
+  if [[ "$MODES" != "444 440 755 " ]]
+  then
+    echo "Error: Unexpected modes after restore with $JOBS job(s): $MODES"
+    TEST_EXIT_CODE=1
+  fi
+
+  # clean up
+  rm -rf $BASE_DIR
+  rm -f $STAT_FILE
+done
+
+exit $TEST_EXIT_CODE
@@ -0,0 +1,142 @@
+#!/bin/bash
+
+# This file is part of the test suite for copy-file-stats.
+# Copyright (C) 2015  Dirk Stolle
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# check parameter
+if [[ -z $1 ]]
+then
+  echo "Error: Expecting one parameter - path of executable copy-file-stats!"
+  return 1
+fi
+
+# create base directory where the test shall take place
+BASE_DIR=`mktemp --directory --tmpdir testSaveRestoreXXXXXXXXXX`
+
+#include create_directory and create_file functions
+source ${BASH_SOURCE%/*}/../../script-includes/creation.sh
+# create some files with the permissions that shall be restored
+create_file $BASE_DIR/alpha 0640
+create_file $BASE_DIR/junk.tmp 0604
+create_directory $BASE_DIR/build 0750
+create_file $BASE_DIR/build/out 0604
+create_directory $BASE_DIR/sub 0751
+create_file $BASE_DIR/sub/beta 0644
+create_file $BASE_DIR/sub/build 0755
+create_directory $BASE_DIR/sub/.git 0700
+create_file $BASE_DIR/sub/.git/config 0604
+
+if [[ $? -ne 0 ]]
+then
+  echo "Failed to create test files!"
+  exit 1
+fi
+
+echo "Files created successfully in $BASE_DIR!"
+
+# names for stat files
+REFERENCE_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfile_compareXXXXXXXX`
+FILTERED_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfile_filteredXXXXXXXX`
+CHANGED_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfile_changedXXXXXXXX`
+OUTPUT_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfileXXXXXXXX`
+PATTERN_FILE=`mktemp --dry-run --tmpdir=/tmp patternsXXXXXXXX`
+COPY_DIR=`mktemp --dry-run --tmpdir testSaveRestoreXXXXXXXXXX`
+LOG_FILE=`mktemp --dry-run --tmpdir=/tmp logXXXXXXXX`
+# lines of the entries that the filters exclude
+EXCLUDED_LINES=' (junk\.tmp|build|build/out|sub/\.git|sub/\.git/config)$'
+
+printf '# version control\n.git\n\n' > $PATTERN_FILE
+FILTERS=(--exclude '*.tmp' --exclude /build/ --exclude-from $PATTERN_FILE)
+
+# checks that entries that are not excluded have the stats of the reference
+# and excluded entries still have the stats of the changed tree
+#   $1 - stat file after the run
+#   $2 - stat file of the changed tree
+function check_stats
+{
+  diff <(grep -v -E "$EXCLUDED_LINES" $1) <(grep -v -E "$EXCLUDED_LINES" $REFERENCE_STAT_FILE) && \
+  diff <(grep -E "$EXCLUDED_LINES" $1) <(grep -E "$EXCLUDED_LINES" $2)
+}
+
+# The filtered file is the reference without the excluded entries.
+$1 --save $BASE_DIR $REFERENCE_STAT_FILE && \
+$1 --save $BASE_DIR $FILTERED_STAT_FILE "${FILTERS[@]}" > $LOG_FILE && \
+grep --quiet '^Filters: 3 entries excluded' $LOG_FILE && \
+grep -v -E "$EXCLUDED_LINES" $REFERENCE_STAT_FILE | cmp - $FILTERED_STAT_FILE && \
+[[ `grep --count -E "$EXCLUDED_LINES" $REFERENCE_STAT_FILE` -eq 5 ]]
+SAVE_EXIT_CODE=$?
+
+# change all permissions, then restore them from the complete stat file, the
+# filters keep the changed permissions of excluded entries
+TEST_EXIT_CODE=0
+if [[ $SAVE_EXIT_CODE -eq 0 ]]
+then
+  for OPTIONS in "--jobs 1" "--jobs 4" "--walk-dest"
+  do
+    chmod -R u+rwx,go-rwx,-s,-t $BASE_DIR/*
+    $1 --save $BASE_DIR $CHANGED_STAT_FILE > /dev/null && \
+    $1 --restore --force $REFERENCE_STAT_FILE $BASE_DIR "${FILTERS[@]}" $OPTIONS > $LOG_FILE && \
+    ! grep --quiet 'does not exist' $LOG_FILE && \
+    $1 --save $BASE_DIR $OUTPUT_STAT_FILE > /dev/null && \
+    check_stats $OUTPUT_STAT_FILE $CHANGED_STAT_FILE
+    TEST_EXIT_CODE=$?
+    rm -f $CHANGED_STAT_FILE $OUTPUT_STAT_FILE
+    if [[ $TEST_EXIT_CODE -ne 0 ]]
+    then
+      echo "Restore with $OPTIONS failed:"
+      cat $LOG_FILE
+      break
+    fi
+  done
+fi
+
+# copies from directory to directory use the same filters
+if [[ $TEST_EXIT_CODE -eq 0 ]]
+then
+  cp -a $BASE_DIR $COPY_DIR && \
+  chmod -R u+rwx,go-rwx,-s,-t $COPY_DIR/* && \
+  $1 --save $COPY_DIR $CHANGED_STAT_FILE > /dev/null && \
+  $1 --force $BASE_DIR $COPY_DIR "${FILTERS[@]}" --jobs 2 > $LOG_FILE && \
+  $1 --save $COPY_DIR $OUTPUT_STAT_FILE > /dev/null && \
+  check_stats $OUTPUT_STAT_FILE $CHANGED_STAT_FILE
+  TEST_EXIT_CODE=$?
+  if [[ $TEST_EXIT_CODE -ne 0 ]]
+  then
+    echo "Copy failed:"
+    cat $LOG_FILE
+  fi
+fi
+
+if [[ $SAVE_EXIT_CODE -eq 0 && $TEST_EXIT_CODE -eq 0 ]]
+then
+  echo "Excluded entries were skipped as expected. :)"
+  RESULT=0
+else
+  echo "Executable returned non-zero exit code or entries were not excluded:"
+  echo "-- Save exit code: $SAVE_EXIT_CODE"
+  echo "-- Test exit code: $TEST_EXIT_CODE"
+  echo "Reference file:"
+  cat $REFERENCE_STAT_FILE
+  RESULT=1
+fi
+
+# clean up
+# -- test directories
+rm -rf $BASE_DIR $COPY_DIR
+# -- stat files
+rm -f $REFERENCE_STAT_FILE $FILTERED_STAT_FILE $CHANGED_STAT_FILE $OUTPUT_STAT_FILE $PATTERN_FILE $LOG_FILE
+
+exit $RESULT
@@ -0,0 +1,141 @@
+#!/bin/bash
+
+# This file is part of the test suite for copy-file-stats.
+# Copyright (C) 2015  Dirk Stolle
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# check parameter
+if [[ -z $1 ]]
+then
+  echo "Error: Expecting one parameter - path of executable copy-file-stats!"
+  return 1
+fi
+
+# create base directory where the test shall take place
+BASE_DIR=`mktemp --directory --tmpdir testSaveRestoreXXXXXXXXXX`
+
+#include create_directory and create_file functions
+source ${BASH_SOURCE%/*}/../../script-includes/creation.sh
+# create some files with the permissions that shall be restored, alpha and
+# gamma have several hard links
+create_file $BASE_DIR/alpha 0640
+create_file $BASE_DIR/beta 0644
+create_file $BASE_DIR/gamma 4750
+create_directory $BASE_DIR/sub 0751
+create_directory $BASE_DIR/sub/marine 1770
+ln $BASE_DIR/alpha $BASE_DIR/sub/alpha_link
+ln $BASE_DIR/alpha $BASE_DIR/sub/marine/alpha_link
+ln $BASE_DIR/gamma $BASE_DIR/sub/gamma_link
+
+if [[ $? -ne 0 ]]
+then
+  echo "Failed to create test files!"
+  exit 1
+fi
+
+echo "Files created successfully in $BASE_DIR!"
+
+# names for stat files
+REFERENCE_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfile_compareXXXXXXXX`
+DICTIONARY_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfile_dictionaryXXXXXXXX`
+BINARY_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfile_binaryXXXXXXXX`
+OUTPUT_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfileXXXXXXXX`
+COPY_DIR=`mktemp --dry-run --tmpdir testSaveRestoreXXXXXXXXXX`
+LOG_FILE=`mktemp --dry-run --tmpdir=/tmp logXXXXXXXX`
+
+$1 --save $BASE_DIR $REFERENCE_STAT_FILE && \
+$1 --save $BASE_DIR $DICTIONARY_STAT_FILE --format=dict > $LOG_FILE && \
+grep --quiet '^Hard links: 3 entries were saved as links' $LOG_FILE && \
+$1 --save $BASE_DIR $BINARY_STAT_FILE --format=bin --jobs 4 > $LOG_FILE && \
+grep --quiet '^Hard links: 3 entries were saved as links' $LOG_FILE
+SAVE_EXIT_CODE=$?
+
+# each inode is defined once, all of its links refer to it
+[[ `grep --count '^#inode ' $DICTIONARY_STAT_FILE` -eq 2 ]] && \
+[[ `grep --count '^#link ' $DICTIONARY_STAT_FILE` -eq 5 ]] && \
+grep --quiet '^#link [0-9]* sub/marine/alpha_link$' $DICTIONARY_STAT_FILE
+CMP_EXIT_CODE=$?
+
+# change all permissions, then restore them from every file, only one link
+# of each inode has to be changed
+TEST_EXIT_CODE=0
+for STAT_FILE in $REFERENCE_STAT_FILE $DICTIONARY_STAT_FILE $BINARY_STAT_FILE
+do
+  for OPTIONS in "--jobs 1" "--jobs 4" "--walk-dest"
+  do
+    chmod -R u+rwx,go-rwx,-s,-t $BASE_DIR/*
+    $1 --restore --force $STAT_FILE $BASE_DIR $OPTIONS > $LOG_FILE && \
+    grep --quiet '^Hard links: 3 entries skipped' $LOG_FILE
+    TEST_EXIT_CODE=$?
+    if [[ $TEST_EXIT_CODE -ne 0 ]]
+    then
+      echo "Restore of $STAT_FILE with $OPTIONS failed:"
+      cat $LOG_FILE
+      break 2
+    fi
+  done
+done
+
+# copies from directory to directory handle each inode once, too
+if [[ $TEST_EXIT_CODE -eq 0 ]]
+then
+  cp -a $BASE_DIR $COPY_DIR && \
+  chmod -R u+rwx,go-rwx,-s,-t $COPY_DIR/* && \
+  $1 --force $BASE_DIR $COPY_DIR > $LOG_FILE && \
+  grep --quiet '^Hard links: 3 entries skipped' $LOG_FILE
+  TEST_EXIT_CODE=$?
+fi
+
+# save current directory status in plain text format
+$1 --save $BASE_DIR $OUTPUT_STAT_FILE
+OUTPUT_EXIT_CODE=$?
+
+if [[ $SAVE_EXIT_CODE -eq 0 && $CMP_EXIT_CODE -eq 0 && $TEST_EXIT_CODE -eq 0 && $OUTPUT_EXIT_CODE -eq 0 ]]
+then
+  diff $OUTPUT_STAT_FILE $REFERENCE_STAT_FILE
+  # files are identical, if return code of diff is zero
+  DIFF_EXIT_CODE=$?
+  if [[ $DIFF_EXIT_CODE -ne 0 ]]
+  then
+    echo "Error: Files are NOT identical."
+    echo "File after restore:"
+    cat $OUTPUT_STAT_FILE
+    echo "File before restore:"
+    cat $REFERENCE_STAT_FILE
+    echo "---- end of files ---"
+  else
+    echo "Both stat files are identical. :)"
+  fi
+else
+  echo "Executable returned non-zero exit code or links are not handled:"
+  echo "-- Save exit code: $SAVE_EXIT_CODE"
+  echo "-- Compare exit code: $CMP_EXIT_CODE"
+  echo "-- Test exit code: $TEST_EXIT_CODE"
+  echo "-- Output exit code: $OUTPUT_EXIT_CODE"
+  DIFF_EXIT_CODE=2
+fi
+
+# clean up
+# -- test directories
+rm -rf $BASE_DIR $COPY_DIR
+# -- stat files
+rm -f $REFERENCE_STAT_FILE $DICTIONARY_STAT_FILE $BINARY_STAT_FILE $OUTPUT_STAT_FILE $LOG_FILE
+
+if [[ $DIFF_EXIT_CODE -eq 0 ]]
+then
+  exit 0
+else
+  exit 1
+fi
@@ -0,0 +1,144 @@
+#!/bin/bash
+
+# This file is part of the test suite for copy-file-stats.
+# Copyright (C) 2015  Dirk Stolle
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# check parameter
+if [[ -z $1 ]]
+then
+  echo "Error: Expecting one parameter - path of executable copy-file-stats!"
+  return 1
+fi
+
+# create base directory where the test shall take place
+BASE_DIR=`mktemp --directory --tmpdir testSaveRestoreXXXXXXXXXX`
+
+#include create_directory and create_file functions
+source ${BASH_SOURCE%/*}/../../script-includes/creation.sh
+# create some files with the permissions that shall be restored
+create_file $BASE_DIR/alpha 0755
+create_file $BASE_DIR/beta 0644
+create_file $BASE_DIR/gamma 4750
+create_directory $BASE_DIR/sub 0751
+create_file $BASE_DIR/sub/epsilon 0124
+create_directory $BASE_DIR/sub/marine 1770
+create_file $BASE_DIR/sub/marine/anachronistic 0644
+
+if [[ $? -ne 0 ]]
+then
+  echo "Failed to create test files!"
+  exit 1
+fi
+
+echo "Files created successfully in $BASE_DIR!"
+
+USER_ID=`id -u`
+GROUP_ID=`id -g`
+
+# names for stat files and databases of an "image"
+REFERENCE_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfile_compareXXXXXXXX`
+IMAGE_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfile_imageXXXXXXXX`
+SHIFTED_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfile_shiftedXXXXXXXX`
+OUTPUT_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfileXXXXXXXX`
+PASSWD_FILE=`mktemp --tmpdir=/tmp passwdXXXXXXXX`
+GROUP_FILE=`mktemp --tmpdir=/tmp groupXXXXXXXX`
+LOG_FILE=`mktemp --dry-run --tmpdir=/tmp logXXXXXXXX`
+
+# The image knows the current user and group under other names.
+echo "# users of the image" > $PASSWD_FILE
+echo "imageuser:x:$USER_ID:$GROUP_ID:Image User:/home/imageuser:/bin/sh" >> $PASSWD_FILE
+echo "+nisuser::::::" >> $PASSWD_FILE
+echo "imagegroup:x:$GROUP_ID:" > $GROUP_FILE
+echo "" >> $GROUP_FILE
+
+$1 --save $BASE_DIR $REFERENCE_STAT_FILE
+SAVE_EXIT_CODE=$?
+
+# names of the image have to win over the IDs of the stat file
+awk '{ $2 = "imageuser"; $3 = "12345"; $4 = "imagegroup"; $5 = "12345"; print }' $REFERENCE_STAT_FILE > $IMAGE_STAT_FILE
+# IDs of a user namespace are shifted back by the mapping
+awk '{ $2 = "?"; $3 = "5000"; $4 = "?"; $5 = "5990"; print }' $REFERENCE_STAT_FILE > $SHIFTED_STAT_FILE
+
+# change all permissions, then restore them from both files
+chmod -R u+rwx,go-rwx,-s,-t $BASE_DIR/*
+for JOBS in 1 4
+do
+  $1 --restore --force $IMAGE_STAT_FILE $BASE_DIR --passwd $PASSWD_FILE --group $GROUP_FILE --jobs $JOBS && \
+  $1 --restore --force $SHIFTED_STAT_FILE $BASE_DIR --map-uid 5000:$USER_ID:1 --map-gid 5990:$GROUP_ID:20 --jobs $JOBS
+  TEST_EXIT_CODE=$?
+  if [[ $TEST_EXIT_CODE -ne 0 ]]
+  then
+    break
+  fi
+done
+
+# mapped IDs are shown by a dry run
+if [[ $TEST_EXIT_CODE -eq 0 ]]
+then
+  $1 --restore --dry-run $REFERENCE_STAT_FILE $BASE_DIR --numeric-ids --map-uid $USER_ID:4000:1 --map-gid $GROUP_ID:4001:1 > $LOG_FILE && \
+  [[ `grep --count "to 4000:4001\.\.\.$" $LOG_FILE` -eq `wc -l < $REFERENCE_STAT_FILE` ]]
+  TEST_EXIT_CODE=$?
+fi
+
+# invalid files and ranges are rejected
+if [[ $TEST_EXIT_CODE -eq 0 ]]
+then
+  echo "broken line" >> $GROUP_FILE
+  ! $1 --restore --dry-run $IMAGE_STAT_FILE $BASE_DIR --group $GROUP_FILE && \
+  ! $1 --restore --dry-run $IMAGE_STAT_FILE $BASE_DIR --map-uid 0:100:10 --map-uid 5:200:1
+  TEST_EXIT_CODE=$?
+fi
+
+# save current directory status in plain text format
+$1 --save $BASE_DIR $OUTPUT_STAT_FILE
+OUTPUT_EXIT_CODE=$?
+
+if [[ $SAVE_EXIT_CODE -eq 0 && $TEST_EXIT_CODE -eq 0 && $OUTPUT_EXIT_CODE -eq 0 ]]
+then
+  diff $OUTPUT_STAT_FILE $REFERENCE_STAT_FILE
+  # files are identical, if return code of diff is zero
+  DIFF_EXIT_CODE=$?
+  if [[ $DIFF_EXIT_CODE -ne 0 ]]
+  then
+    echo "Error: Files are NOT identical."
+    echo "File after restore:"
+    cat $OUTPUT_STAT_FILE
+    echo "File before restore:"
+    cat $REFERENCE_STAT_FILE
+    echo "---- end of files ---"
+  else
+    echo "Both stat files are identical. :)"
+  fi
+else
+  echo "Executable returned unexpected exit code:"
+  echo "-- Save exit code: $SAVE_EXIT_CODE"
+  echo "-- Test exit code: $TEST_EXIT_CODE"
+  echo "-- Output exit code: $OUTPUT_EXIT_CODE"
+  DIFF_EXIT_CODE=2
+fi
+
+# clean up
+# -- test directory
+rm -rf $BASE_DIR
+# -- stat files and databases
+rm -f $REFERENCE_STAT_FILE $IMAGE_STAT_FILE $SHIFTED_STAT_FILE $OUTPUT_STAT_FILE $PASSWD_FILE $GROUP_FILE $LOG_FILE
+
+if [[ $DIFF_EXIT_CODE -eq 0 ]]
+then
+  exit 0
+else
+  exit 1
+fi
@@ -0,0 +1,111 @@
+#!/bin/bash
+
+# This file is part of the test suite for copy-file-stats.
+# Copyright (C) 2015  Dirk Stolle
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# check parameter
+if [[ -z $1 ]]
+then
+  echo "Error: Expecting one parameter - path of executable copy-file-stats!"
+  return 1
+fi
+
+# create base directory where the test shall take place
+BASE_DIR=`mktemp --directory --tmpdir testSaveRestoreXXXXXXXXXX`
+
+#include create_directory and create_file functions
+source ${BASH_SOURCE%/*}/../../script-includes/creation.sh
+
+# create files whose paths are much longer than 256 characters, some of them
+# with spaces in their names
+LONG_NAME=abcdefghijklmnopqrstuvwxyz0123456789abcdefghijklmnopqrstuvwxyz0123456789
+create_file $BASE_DIR/alpha 0755
+create_directory $BASE_DIR/$LONG_NAME 0751
+create_directory $BASE_DIR/$LONG_NAME/$LONG_NAME 0750
+create_directory "$BASE_DIR/$LONG_NAME/$LONG_NAME/with some  spaces $LONG_NAME" 0710
+create_file $BASE_DIR/$LONG_NAME/$LONG_NAME/$LONG_NAME.1 0644
+create_file $BASE_DIR/$LONG_NAME/$LONG_NAME/$LONG_NAME.2 0604
+create_file "$BASE_DIR/$LONG_NAME/$LONG_NAME/with some  spaces $LONG_NAME/$LONG_NAME  .txt" 0640
+create_file "$BASE_DIR/$LONG_NAME/$LONG_NAME/with some  spaces $LONG_NAME/$LONG_NAME.bin" 4750
+
+if [[ $? -ne 0 ]]
+then
+  echo "Failed to create test files!"
+  exit 1
+fi
+
+echo "Files created successfully in $BASE_DIR!"
+
+# names for stat files
+REFERENCE_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfile_compareXXXXXXXX`
+OUTPUT_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfileXXXXXXXX`
+
+# save current state in plain text format
+$1 --save $BASE_DIR $REFERENCE_STAT_FILE
+SAVE_EXIT_CODE=$?
+
+# change all permissions, then restore them from the stat file
+chmod -R u+rwx,go-rwx,-s,-t $BASE_DIR/*
+for JOBS in 1 4
+do
+  $1 --restore --force $REFERENCE_STAT_FILE $BASE_DIR --jobs $JOBS
+  TEST_EXIT_CODE=$?
+  if [[ $TEST_EXIT_CODE -ne 0 ]]
+  then
+    break
+  fi
+done
+
+# save current directory status in plain text format
+$1 --save $BASE_DIR $OUTPUT_STAT_FILE
+OUTPUT_EXIT_CODE=$?
+
+if [[ $SAVE_EXIT_CODE -eq 0 && $TEST_EXIT_CODE -eq 0 && $OUTPUT_EXIT_CODE -eq 0 ]]
+then
+  diff $OUTPUT_STAT_FILE $REFERENCE_STAT_FILE
+  # files are identical, if return code of diff is zero
+  DIFF_EXIT_CODE=$?
+  if [[ $DIFF_EXIT_CODE -ne 0 ]]
+  then
+    echo "Error: Files are NOT identical."
+    echo "File after restore:"
+    cat $OUTPUT_STAT_FILE
+    echo "File before restore:"
+    cat $REFERENCE_STAT_FILE
+    echo "---- end of files ---"
+  else
+    echo "Both stat files are identical. :)"
+  fi
+else
+  echo "Executable returned non-zero exit code:"
+  echo "-- Save exit code: $SAVE_EXIT_CODE"
+  echo "-- Test exit code: $TEST_EXIT_CODE"
+  echo "-- Output exit code: $OUTPUT_EXIT_CODE"
+  DIFF_EXIT_CODE=2
+fi
+
+# clean up
+# -- test directory
+rm -rf $BASE_DIR
+# -- stat files
+rm -f $REFERENCE_STAT_FILE $OUTPUT_STAT_FILE
+
+if [[ $DIFF_EXIT_CODE -eq 0 ]]
+then
+  exit 0
+else
+  exit 1
+fi
@@ -0,0 +1,147 @@
+#!/bin/bash
+
+# This file is part of the test suite for copy-file-stats.
+# Copyright (C) 2015  Dirk Stolle
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# check parameter
+if [[ -z $1 ]]
+then
+  echo "Error: Expecting one parameter - path of executable copy-file-stats!"
+  return 1
+fi
+
+# create base directory where the test shall take place
+BASE_DIR=`mktemp --directory --tmpdir testSaveRestoreXXXXXXXXXX`
+
+#include create_directory and create_file functions
+source ${BASH_SOURCE%/*}/../../script-includes/creation.sh
+
+# create some files with the permissions that shall be restored
+create_file $BASE_DIR/alpha 0755
+create_file $BASE_DIR/beta 0644
+create_file $BASE_DIR/gamma 4750
+create_directory $BASE_DIR/sub 0751
+create_file $BASE_DIR/sub/epsilon 0124
+create_file $BASE_DIR/sub/riemann 0654
+create_directory $BASE_DIR/sub/marine 1770
+create_file $BASE_DIR/sub/marine/anachronistic 0644
+create_file $BASE_DIR/sub/marine/brontosaurus 0500
+create_directory $BASE_DIR/trivial 0700
+for i in 1 2 3 4 5 6 7 8
+do
+  create_directory $BASE_DIR/trivial/dir$i 0755
+  create_file $BASE_DIR/trivial/dir$i/file$i 0640
+done
+
+if [[ $? -ne 0 ]]
+then
+  echo "Failed to create test files!"
+  exit 1
+fi
+
+# names for stat files
+REFERENCE_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfile_compareXXXXXXXX`
+NUMERIC_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfile_numericXXXXXXXX`
+OUTPUT_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfileXXXXXXXX`
+LOG_FILE=`mktemp --dry-run --tmpdir=/tmp logXXXXXXXX`
+
+# save reference with names, current state without them
+$1 --save $BASE_DIR $REFERENCE_STAT_FILE && \
+$1 --save $BASE_DIR $NUMERIC_STAT_FILE --numeric-ids --preload-ids
+SAVE_EXIT_CODE=$?
+
+# names of numeric file have to be '?', everything else is the same
+awk '{ $2 = "?"; $4 = "?"; print }' $REFERENCE_STAT_FILE | cmp - $NUMERIC_STAT_FILE
+CMP_EXIT_CODE=$?
+
+# Put the name of another user into the numeric file. --numeric-ids has to
+# ignore it and use the ID of the current user.
+if [[ `id -u` -eq 0 ]]
+then
+  OTHER_USER=nobody
+else
+  OTHER_USER=root
+fi
+sed --in-place "s/^\([^ ]*\) ? /\1 $OTHER_USER /" $NUMERIC_STAT_FILE
+
+# change all permissions, then restore them from the numeric file
+chmod -R u+rwx,go-rwx,-s,-t $BASE_DIR/*
+for JOBS in 1 4
+do
+  $1 --restore --force $NUMERIC_STAT_FILE $BASE_DIR --numeric-ids --jobs $JOBS > $LOG_FILE
+  TEST_EXIT_CODE=$?
+  # names are not looked up at all
+  if [[ $TEST_EXIT_CODE -eq 0 ]]
+  then
+    grep --quiet '^Name lookups: 0 in the user and group databases' $LOG_FILE
+    TEST_EXIT_CODE=$?
+  fi
+  if [[ $TEST_EXIT_CODE -ne 0 ]]
+  then
+    cat $LOG_FILE
+    break
+  fi
+done
+
+# preloaded names do not need any lookups either
+if [[ $TEST_EXIT_CODE -eq 0 ]]
+then
+  $1 --restore --force $REFERENCE_STAT_FILE $BASE_DIR --preload-ids --jobs 4 > $LOG_FILE && \
+  grep --quiet '^Name lookups: 0 in the user and group databases' $LOG_FILE
+  TEST_EXIT_CODE=$?
+fi
+
+# save current directory status in plain text format
+$1 --save $BASE_DIR $OUTPUT_STAT_FILE
+OUTPUT_EXIT_CODE=$?
+
+if [[ $SAVE_EXIT_CODE -eq 0 && $CMP_EXIT_CODE -eq 0 && $TEST_EXIT_CODE -eq 0 && $OUTPUT_EXIT_CODE -eq 0 ]]
+then
+  diff $OUTPUT_STAT_FILE $REFERENCE_STAT_FILE
+  # files are identical, if return code of diff is zero
+  DIFF_EXIT_CODE=$?
+  if [[ $DIFF_EXIT_CODE -ne 0 ]]
+  then
+    echo "Error: Files are NOT identical."
+    echo "File after restore:"
+    cat $OUTPUT_STAT_FILE
+    echo "File before restore:"
+    cat $REFERENCE_STAT_FILE
+    echo "---- end of files ---"
+  else
+    echo "Both stat files are identical. :)"
+  fi
+else
+  echo "Executable returned non-zero exit code or numeric file is wrong:"
+  echo "-- Save exit code: $SAVE_EXIT_CODE"
+  echo "-- Compare exit code: $CMP_EXIT_CODE"
+  echo "-- Test exit code: $TEST_EXIT_CODE"
+  echo "-- Output exit code: $OUTPUT_EXIT_CODE"
+  DIFF_EXIT_CODE=2
+fi
+
+# clean up
+# -- test directory
+rm -rf $BASE_DIR
+# -- stat files
+rm -f $REFERENCE_STAT_FILE $NUMERIC_STAT_FILE $OUTPUT_STAT_FILE $LOG_FILE
+
+if [[ $DIFF_EXIT_CODE -eq 0 ]]
+then
+  exit 0
+else
+  exit 1
+fi
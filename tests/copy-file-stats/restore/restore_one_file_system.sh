@@ -0,0 +1,155 @@
+#!/bin/bash
+
+# This file is part of the test suite for copy-file-stats.
+# Copyright (C) 2015  Dirk Stolle
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# check parameter
+if [[ -z $1 ]]
+then
+  echo "Error: Expecting one parameter - path of executable copy-file-stats!"
+  return 1
+fi
+
+# create base directory where the test shall take place
+BASE_DIR=`mktemp --directory --tmpdir testSaveRestoreXXXXXXXXXX`
+
+#include create_directory and create_file functions
+source ${BASH_SOURCE%/*}/../../script-includes/creation.sh
+# another file system is mounted below the base directory, this needs root
+create_directory $BASE_DIR/mnt 0755
+if ! mount -t tmpfs none $BASE_DIR/mnt > /dev/null 2>&1
+then
+  echo "Info: Could not mount a tmpfs (not root?), skipping the test."
+  rm -rf $BASE_DIR
+  exit 0
+fi
+
+# create some files with the permissions that shall be restored
+create_file $BASE_DIR/alpha 0640
+create_directory $BASE_DIR/sub 0751
+create_file $BASE_DIR/sub/beta 0604
+chmod 0750 $BASE_DIR/mnt
+create_file $BASE_DIR/mnt/inner 0604
+create_directory $BASE_DIR/mnt/deep 0710
+create_file $BASE_DIR/mnt/deep/file 0601
+
+if [[ $? -ne 0 ]]
+then
+  echo "Failed to create test files!"
+  umount $BASE_DIR/mnt
+  rm -rf $BASE_DIR
+  exit 1
+fi
+
+echo "Files created successfully in $BASE_DIR!"
+
+# names for stat files
+REFERENCE_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfile_compareXXXXXXXX`
+PRUNED_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfile_prunedXXXXXXXX`
+GHOST_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfile_ghostXXXXXXXX`
+CHANGED_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfile_changedXXXXXXXX`
+OUTPUT_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfileXXXXXXXX`
+COPY_DIR=`mktemp --dry-run --tmpdir testSaveRestoreXXXXXXXXXX`
+LOG_FILE=`mktemp --dry-run --tmpdir=/tmp logXXXXXXXX`
+MOUNT_LINES=' mnt(/.*)?$'
+
+# checks that entries outside of the mount have the stats of the reference
+# and entries in it still have the stats of the changed tree
+#   $1 - stat file after the run
+#   $2 - stat file of the changed tree
+function check_stats
+{
+  diff <(grep -v -E "$MOUNT_LINES" $1) <(grep -v -E "$MOUNT_LINES" $REFERENCE_STAT_FILE) && \
+  diff <(grep -E "$MOUNT_LINES" $1) <(grep -E "$MOUNT_LINES" $2)
+}
+
+# The pruned file is the reference without the mount point and its content.
+$1 --save $BASE_DIR $REFERENCE_STAT_FILE && \
+$1 --save $BASE_DIR $PRUNED_STAT_FILE --one-file-system > $LOG_FILE && \
+grep --quiet --fixed-strings "Info: \"$BASE_DIR/mnt\" is on another file system" $LOG_FILE && \
+grep --quiet '^Mount points: 1 skipped' $LOG_FILE && \
+grep -v -E "$MOUNT_LINES" $REFERENCE_STAT_FILE | cmp - $PRUNED_STAT_FILE && \
+[[ `grep --count -E "$MOUNT_LINES" $REFERENCE_STAT_FILE` -eq 4 ]] && \
+cp $REFERENCE_STAT_FILE $GHOST_STAT_FILE && \
+grep ' mnt/deep/file$' $REFERENCE_STAT_FILE | sed 's/file$/ghost/' >> $GHOST_STAT_FILE
+SAVE_EXIT_CODE=$?
+
+# change all permissions, then restore them with -x, the mount keeps the
+# changed permissions. The stat file has an extra line for an entry in the
+# mount that does not exist, it must not be looked up.
+TEST_EXIT_CODE=0
+if [[ $SAVE_EXIT_CODE -eq 0 ]]
+then
+  for OPTIONS in "--jobs 1" "--jobs 4" "--walk-dest"
+  do
+    chmod -R u+rwx,go-rwx,-s,-t $BASE_DIR/*
+    $1 --save $BASE_DIR $CHANGED_STAT_FILE > /dev/null && \
+    $1 --restore --force $GHOST_STAT_FILE $BASE_DIR -x $OPTIONS > $LOG_FILE && \
+    grep --quiet --fixed-strings "Info: \"$BASE_DIR/mnt\" is on another file system" $LOG_FILE && \
+    ! grep --quiet 'does not exist' $LOG_FILE && \
+    $1 --save $BASE_DIR $OUTPUT_STAT_FILE > /dev/null && \
+    check_stats $OUTPUT_STAT_FILE $CHANGED_STAT_FILE
+    TEST_EXIT_CODE=$?
+    rm -f $CHANGED_STAT_FILE $OUTPUT_STAT_FILE
+    if [[ $TEST_EXIT_CODE -ne 0 ]]
+    then
+      echo "Restore with $OPTIONS failed:"
+      cat $LOG_FILE
+      break
+    fi
+  done
+fi
+
+# copies from directory to directory do not cross into the mount of the
+# source, the copy is just a normal directory
+if [[ $TEST_EXIT_CODE -eq 0 ]]
+then
+  cp -a $BASE_DIR $COPY_DIR && \
+  chmod -R u+rwx,go-rwx,-s,-t $COPY_DIR/* && \
+  $1 --save $COPY_DIR $CHANGED_STAT_FILE > /dev/null && \
+  $1 --force --one-file-system $BASE_DIR $COPY_DIR > $LOG_FILE && \
+  grep --quiet --fixed-strings "Info: \"$BASE_DIR/mnt\" is on another file system" $LOG_FILE && \
+  $1 --save $COPY_DIR $OUTPUT_STAT_FILE > /dev/null && \
+  check_stats $OUTPUT_STAT_FILE $CHANGED_STAT_FILE
+  TEST_EXIT_CODE=$?
+  if [[ $TEST_EXIT_CODE -ne 0 ]]
+  then
+    echo "Copy failed:"
+    cat $LOG_FILE
+  fi
+fi
+
+if [[ $SAVE_EXIT_CODE -eq 0 && $TEST_EXIT_CODE -eq 0 ]]
+then
+  echo "Mount was skipped as expected. :)"
+  RESULT=0
+else
+  echo "Executable returned non-zero exit code or the mount was not skipped:"
+  echo "-- Save exit code: $SAVE_EXIT_CODE"
+  echo "-- Test exit code: $TEST_EXIT_CODE"
+  echo "Reference file:"
+  cat $REFERENCE_STAT_FILE
+  RESULT=1
+fi
+
+# clean up
+# -- test directories
+umount $BASE_DIR/mnt
+rm -rf $BASE_DIR $COPY_DIR
+# -- stat files
+rm -f $REFERENCE_STAT_FILE $PRUNED_STAT_FILE $GHOST_STAT_FILE $CHANGED_STAT_FILE $OUTPUT_STAT_FILE $LOG_FILE
+
+exit $RESULT
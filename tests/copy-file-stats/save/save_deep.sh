@@ -0,0 +1,147 @@
+#!/bin/bash
+
+# This file is part of the test suite for copy-file-stats.
+# Copyright (C) 2015  Dirk Stolle
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# check parameter
+if [[ -z $1 ]]
+then
+  echo "Error: Expecting one parameter - executable path of copy-file-stats!"
+  return 1
+fi
+
+# create base directory where the test shall take place
+BASE_DIR=`mktemp --directory --tmpdir testSaveRestoreXXXXXXXXXX`
+
+# get default user name and group
+USER_NAME=`id -un`
+USER_ID=`id -u`
+GROUP_NAME=`id -gn`
+GROUP_ID=`id -g`
+
+#include create_directory and create_file functions
+source ${BASH_SOURCE%/*}/../../script-includes/creation.sh
+
+# create a tree that is deeper than the limit of open directories
+CURRENT_DIR=$BASE_DIR
+for i in `seq 1 100`
+do
+  create_file $CURRENT_DIR/file$i 0640
+  create_directory $CURRENT_DIR/deep$i 0750
+  create_directory $CURRENT_DIR/flat$i 0700
+  create_file $CURRENT_DIR/flat$i/leaf 0604
+  CURRENT_DIR=$CURRENT_DIR/deep$i
+done
+
+# a tree that is deeper than the limit of open files of the runs below, with
+# sibling directories before and after the deep one, so the walks have to
+# open closed levels again when they return to them
+LIMITED_DIR=$BASE_DIR/limited
+create_directory $LIMITED_DIR 0755
+CURRENT_DIR=$LIMITED_DIR
+for i in `seq 1 200`
+do
+  create_directory $CURRENT_DIR/a 0750
+  create_file $CURRENT_DIR/a/leaf 0640
+  create_directory $CURRENT_DIR/d 0755
+  create_directory $CURRENT_DIR/z 0700
+  create_file $CURRENT_DIR/z/leaf 0604
+  CURRENT_DIR=$CURRENT_DIR/d
+done
+
+if [[ $? -ne 0 ]]
+then
+  echo "Failed to create test files!"
+  exit 1
+fi
+
+echo "Files created successfully in $BASE_DIR!"
+
+# name for stat file of iterative save
+OUTPUT_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfileXXXXXXXX`
+# ... and for stat file of parallel save, which does not use the stack
+REFERENCE_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfile_compareXXXXXXXX`
+# stat files and copy of the tree for runs with a low limit of open files
+LIMITED_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfile_limitedXXXXXXXX`
+COPY_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfile_copyXXXXXXXX`
+COPY_DIR=`mktemp --dry-run --tmpdir testSaveRestoreXXXXXXXXXX`
+
+# run test
+$1 --save $BASE_DIR $OUTPUT_STAT_FILE && \
+$1 --save $BASE_DIR $REFERENCE_STAT_FILE --jobs 4
+# ...and save its exit code
+TEST_EXIT_CODE=$?
+
+# Save and copy the limited tree with only 64 open files. The copy starts
+# with other permissions, so it has to be walked completely, too.
+if [[ $TEST_EXIT_CODE -eq 0 ]]
+then
+  cp -a $LIMITED_DIR $COPY_DIR && \
+  chmod -R go-rwx $COPY_DIR && \
+  ( ulimit -n 64 && \
+    $1 --save $LIMITED_DIR $LIMITED_STAT_FILE > /dev/null && \
+    $1 --force $LIMITED_DIR $COPY_DIR > /dev/null ) && \
+  $1 --save $COPY_DIR $COPY_STAT_FILE > /dev/null && \
+  [[ `grep --count '/leaf$' $LIMITED_STAT_FILE` -eq 400 ]] && \
+  diff $LIMITED_STAT_FILE $COPY_STAT_FILE
+  if [[ $? -ne 0 ]]
+  then
+    echo "Error: Walks with a low limit of open files failed."
+    TEST_EXIT_CODE=1
+  fi
+fi
+
+if [[ $TEST_EXIT_CODE -eq 0 ]]
+then
+  # Order of lines has to be the same, too, so compare without sorting.
+  diff $OUTPUT_STAT_FILE $REFERENCE_STAT_FILE
+  # files are identical, if return code of diff is zero
+  DIFF_EXIT_CODE=$?
+  if [[ $DIFF_EXIT_CODE -ne 0 ]]
+  then
+    echo "Error: Files are NOT identical."
+    echo "File of iterative save:"
+    cat $OUTPUT_STAT_FILE
+    echo "File of parallel save:"
+    cat $REFERENCE_STAT_FILE
+    echo "---- end of files ---"
+  fi
+else
+  echo "Executable returned non-zero exit code ($TEST_EXIT_CODE)."
+  DIFF_EXIT_CODE=2
+fi
+
+# clean up
+# -- test directories
+rm -rf $BASE_DIR $COPY_DIR
+rm -f $LIMITED_STAT_FILE $COPY_STAT_FILE
+# -- stat file
+if [[ -f $OUTPUT_STAT_FILE ]]
+then
+  rm -f $OUTPUT_STAT_FILE
+fi
+# -- stat file of parallel save
+if [[ -f $REFERENCE_STAT_FILE ]]
+then
+  rm -f $REFERENCE_STAT_FILE
+fi
+
+if [[ $TEST_EXIT_CODE -eq 0 && $DIFF_EXIT_CODE -eq 0 ]]
+then
+  exit 0
+else
+  exit 1
+fi
@@ -0,0 +1,130 @@
+#!/bin/bash
+
+# This file is part of the test suite for copy-file-stats.
+# Copyright (C) 2015  Dirk Stolle
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# check parameter
+if [[ -z $1 ]]
+then
+  echo "Error: Expecting one parameter - executable path of copy-file-stats!"
+  return 1
+fi
+
+# create base directory where the test shall take place
+BASE_DIR=`mktemp --directory --tmpdir testSaveRestoreXXXXXXXXXX`
+
+# get default user name and group
+USER_NAME=`id -un`
+USER_ID=`id -u`
+GROUP_NAME=`id -gn`
+GROUP_ID=`id -g`
+
+#include create_directory and create_file functions
+source ${BASH_SOURCE%/*}/../../script-includes/creation.sh
+
+# create some files
+create_file $BASE_DIR/alpha 0755
+create_file $BASE_DIR/beta 0644
+create_file $BASE_DIR/gamma 0640
+create_file $BASE_DIR/delta 0600
+
+# -- create subdirectory
+create_directory $BASE_DIR/sub 0777
+
+# -- create some files in subdirectory
+create_file $BASE_DIR/sub/epsilon 0124
+create_file $BASE_DIR/sub/riemann 0654
+create_file $BASE_DIR/sub/zeta 0432
+
+# -- create directory within subdirectory
+create_directory $BASE_DIR/sub/marine 0777
+
+# create some files in .../sub/marine
+create_file $BASE_DIR/sub/marine/anachronistic 0644
+create_file $BASE_DIR/sub/marine/brontosaurus 0500
+create_file $BASE_DIR/sub/marine/catharsis 0404
+
+# -- create another subdirectory
+create_directory $BASE_DIR/trivial 0777
+
+# -- create a few more directories, so that there are more directories
+for i in 1 2 3 4 5 6 7 8
+do
+  create_directory $BASE_DIR/trivial/dir$i 0755
+  create_file $BASE_DIR/trivial/dir$i/file$i 0640
+  create_directory $BASE_DIR/trivial/dir$i/inner 0700
+  create_file $BASE_DIR/trivial/dir$i/inner/file$i 0604
+done
+
+if [[ $? -ne 0 ]]
+then
+  echo "Failed to create test files!"
+  exit 1
+fi
+
+echo "Files created successfully in $BASE_DIR!"
+
+# name for stat file of sequential save
+OUTPUT_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfileXXXXXXXX`
+# ... and for stat file of save via io_uring
+REFERENCE_STAT_FILE=`mktemp --dry-run --tmpdir=/tmp statfile_compareXXXXXXXX`
+
+# run test
+$1 --save $BASE_DIR $REFERENCE_STAT_FILE && \
+$1 --save $BASE_DIR $OUTPUT_STAT_FILE --io-uring
+# ...and save its exit code
+TEST_EXIT_CODE=$?
+
+if [[ $TEST_EXIT_CODE -eq 0 ]]
+then
+  # Order of lines has to be the same, too, so compare without sorting.
+  diff $OUTPUT_STAT_FILE $REFERENCE_STAT_FILE
+  # files are identical, if return code of diff is zero
+  DIFF_EXIT_CODE=$?
+  if [[ $DIFF_EXIT_CODE -ne 0 ]]
+  then
+    echo "Error: Files are NOT identical."
+    echo "File of save via io_uring:"
+    cat $OUTPUT_STAT_FILE
+    echo "File of sequential save:"
+    cat $REFERENCE_STAT_FILE
+    echo "---- end of files ---"
+  fi
+else
+  echo "Executable returned non-zero exit code ($TEST_EXIT_CODE)."
+  DIFF_EXIT_CODE=2
+fi
+
+# clean up
+# -- test directory
+rm -rf $BASE_DIR
+# -- stat file
+if [[ -f $OUTPUT_STAT_FILE ]]
+then
+  rm -f $OUTPUT_STAT_FILE
+fi
+# -- stat file generated from template
+if [[ -f $REFERENCE_STAT_FILE ]]
+then
+  rm -f $REFERENCE_STAT_FILE
+fi
+
+if [[ $TEST_EXIT_CODE -eq 0 && $DIFF_EXIT_CODE -eq 0 ]]
+then
+  exit 0
+else
+  exit 1
+fi